@@ -0,0 +1,89 @@
+"""Times the Python side of a tree build: the mesh buffer getters and the copies the Blender import
+makes from them (see python_classes/mesh_utils.py). Prints a JSON report in the same layout as
+m_tree_bench.
+
+Usage: python bench_python.py [--min-time seconds] [--out report.json]
+"""
+
+import argparse
+import json
+import os
+import statistics
+import time
+
+import numpy as np
+from m_tree import m_tree
+
+
+def make_mesh(density):
+    trunk = m_tree.TrunkFunction()
+    branch = m_tree.BranchFunction()
+    branch.distribution.density = density
+    sub_branch = m_tree.BranchFunction()
+    sub_branch.distribution.density = density
+    branch.add_child(sub_branch)
+    trunk.add_child(branch)
+    tree = m_tree.Tree()
+    tree.set_trunk_function(trunk)
+    tree.execute_functions()
+    return m_tree.ManifoldMesher().mesh_tree(tree)
+
+
+def measure(name, function, min_time):
+    function()
+    times = []
+    while sum(times) < min_time or len(times) < 3:
+        start = time.perf_counter()
+        function()
+        times.append(time.perf_counter() - start)
+    return {
+        "name": name,
+        "iterations": len(times),
+        "min_ms": min(times) * 1000,
+        "median_ms": statistics.median(times) * 1000,
+        "mean_ms": statistics.fmean(times) * 1000,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--min-time", type=float, default=0.5)
+    parser.add_argument("--out")
+    args = parser.parse_args()
+
+    results = []
+    for density_name, density in (("low", 0.25), ("medium", 0.5), ("high", 1.0)):
+        mesh = make_mesh(density)
+        getters = {
+            "vertices": mesh.get_vertices,
+            "polygons": mesh.get_polygons,
+            "uvs": mesh.get_uvs,
+            "uv_loops": mesh.get_uv_loops,
+            "radius": lambda mesh=mesh: mesh.get_float_attribute("radius"),
+        }
+        for getter_name, getter in getters.items():
+            results.append(measure(f"getter/{getter_name}/{density_name}", getter, args.min_time))
+            results.append(
+                measure(
+                    f"getter_copy/{getter_name}/{density_name}",
+                    lambda getter=getter: np.copy(getter()).ravel(),
+                    args.min_time,
+                )
+            )
+
+    report = json.dumps(
+        {
+            "context": {"hardware_threads": os.cpu_count(), "min_time": args.min_time},
+            "benchmarks": results,
+        },
+        indent=2,
+    )
+    if args.out:
+        with open(args.out, "w") as file:
+            file.write(report)
+    else:
+        print(report)
+
+
+if __name__ == "__main__":
+    main()
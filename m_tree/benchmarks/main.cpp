@@ -0,0 +1,451 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "source/leaf/LeafShapeGenerator.hpp"
+#include "source/mesh/Mesh.hpp"
+#include "source/meshers/manifold_mesher/ManifoldMesher.hpp"
+#include "source/meshers/manifold_mesher/smoothing.hpp"
+#include "source/meshers/splines_mesher/BasicMesher.hpp"
+#include "source/tree/Tree.hpp"
+#include "source/tree_functions/BranchFunction.hpp"
+#include "source/tree_functions/GrowthFunction.hpp"
+#include "source/tree_functions/TrunkFunction.hpp"
+
+using namespace Mtree;
+
+// =====================================================================
+// Allocation tracking: every global allocation of the process is counted
+// =====================================================================
+
+static std::atomic<size_t> allocation_count{0};
+static std::atomic<size_t> allocated_bytes{0};
+
+static void* counted_allocation(const size_t size)
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size == 0 ? 1 : size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+static void* counted_aligned_allocation(const size_t size, const std::align_val_t alignment)
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	size_t align = std::max((size_t)alignment, sizeof(void*));
+#if defined(_WIN32)
+	void* pointer = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+	size_t rounded_size = (std::max(size, (size_t)1) + align - 1) / align * align;
+	void* pointer = std::aligned_alloc(align, rounded_size);
+#endif
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+static void aligned_free(void* pointer)
+{
+#if defined(_WIN32)
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void* operator new(size_t size) { return counted_allocation(size); }
+void* operator new[](size_t size) { return counted_allocation(size); }
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return counted_aligned_allocation(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return counted_aligned_allocation(size, alignment);
+}
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { aligned_free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { aligned_free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { aligned_free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { aligned_free(pointer); }
+
+// Peak resident set size of the process in KiB. On Linux the peak is reset before each benchmark,
+// elsewhere it is the peak of the process so far.
+static size_t get_peak_rss_kb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize / 1024;
+	return 0;
+#elif defined(__linux__)
+	std::ifstream status{"/proc/self/status"};
+	std::string line;
+	while (std::getline(status, line))
+		if (line.rfind("VmHWM:", 0) == 0)
+			return std::strtoull(line.c_str() + 6, nullptr, 10);
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (size_t)usage.ru_maxrss / 1024; // bytes on macOS
+#endif
+}
+
+static void reset_peak_rss()
+{
+#if defined(__linux__)
+	std::ofstream clear_refs{"/proc/self/clear_refs"};
+	clear_refs << "5";
+#endif
+}
+
+// =====================================================================
+// Benchmark runner
+// =====================================================================
+
+struct BenchmarkResult
+{
+	std::string name;
+	int iterations = 0;
+	double min_ms = 0;
+	double median_ms = 0;
+	double mean_ms = 0;
+	double allocations = 0; // per iteration
+	double allocated_bytes = 0;
+	size_t peak_rss_kb = 0;
+	std::vector<std::pair<std::string, double>> counters;
+};
+
+static double min_time = .5; // seconds spent measuring each case
+static int max_iterations = 1000;
+static std::atomic<size_t> optimization_barrier{0};
+
+// Keeps the result of a measured call observable so that it isn't optimized away
+template <typename T> void keep(const T& value)
+{
+	optimization_barrier.fetch_add((size_t)&value & 1, std::memory_order_relaxed);
+}
+
+class State
+{
+  private:
+	std::string benchmark_name;
+	std::vector<BenchmarkResult>& results;
+
+  public:
+	State(std::string name, std::vector<BenchmarkResult>& results)
+	    : benchmark_name(std::move(name)), results(results) {};
+
+	// Times f over repeated iterations after a warmup call. setup runs before every call, outside
+	// of the measured time and allocations.
+	template <typename Setup, typename F>
+	BenchmarkResult& measure(const std::string& case_name, Setup&& setup, F&& f)
+	{
+		using Clock = std::chrono::steady_clock;
+		BenchmarkResult result;
+		result.name = benchmark_name + (case_name.empty() ? "" : "/" + case_name);
+		reset_peak_rss();
+		setup();
+		f();
+
+		std::vector<double> times;
+		size_t allocations = 0;
+		size_t bytes = 0;
+		double total = 0;
+		while ((total < min_time || times.size() < 3) && (int)times.size() < max_iterations)
+		{
+			setup();
+			size_t allocations_before = allocation_count.load();
+			size_t bytes_before = allocated_bytes.load();
+			auto start = Clock::now();
+			f();
+			double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			allocations += allocation_count.load() - allocations_before;
+			bytes += allocated_bytes.load() - bytes_before;
+			times.push_back(elapsed * 1000);
+			total += elapsed;
+		}
+
+		result.iterations = (int)times.size();
+		std::sort(times.begin(), times.end());
+		result.min_ms = times.front();
+		result.median_ms = times[times.size() / 2];
+		result.mean_ms = total * 1000 / times.size();
+		result.allocations = (double)allocations / times.size();
+		result.allocated_bytes = (double)bytes / times.size();
+		result.peak_rss_kb = get_peak_rss_kb();
+		results.push_back(std::move(result));
+		return results.back();
+	}
+
+	template <typename F> BenchmarkResult& measure(const std::string& case_name, F&& f)
+	{
+		return measure(case_name, []() {}, std::forward<F>(f));
+	}
+};
+
+struct Benchmark
+{
+	std::string name;
+	void (*function)(State&);
+};
+
+static std::vector<Benchmark>& get_benchmarks()
+{
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+#define BENCHMARK(name) \
+	static void bench_##name(State& state); \
+	static const bool registered_##name = \
+	    (get_benchmarks().push_back({#name, bench_##name}), true); \
+	static void bench_##name(State& state)
+
+// =====================================================================
+// Fixtures
+// =====================================================================
+
+struct Density
+{
+	const char* name;
+	float branch_density;
+	int growth_iterations;
+};
+
+static const Density densities[] = {{"low", .25f, 3}, {"medium", .5f, 4}, {"high", 1, 5}};
+
+static std::shared_ptr<TrunkFunction> make_pipeline(const Density& density, const bool growth)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	branch->distribution->density = density.branch_density;
+	trunk->add_child(branch);
+	if (growth)
+	{
+		auto growth_function = std::make_shared<GrowthFunction>();
+		growth_function->iterations = density.growth_iterations;
+		branch->add_child(growth_function);
+	}
+	else
+	{
+		auto sub_branch = std::make_shared<BranchFunction>();
+		sub_branch->distribution->density = density.branch_density;
+		branch->add_child(sub_branch);
+	}
+	return trunk;
+}
+
+// =====================================================================
+// Benchmarks
+// =====================================================================
+
+BENCHMARK(pipeline_branches)
+{
+	for (const Density& density : densities)
+	{
+		Tree tree(make_pipeline(density, false));
+		state.measure(density.name, [&]() { tree.execute_functions(); })
+		    .counters.push_back({"nodes", (double)tree.get_node_count()});
+	}
+}
+
+BENCHMARK(pipeline_growth)
+{
+	for (const Density& density : densities)
+	{
+		Tree tree(make_pipeline(density, true));
+		state.measure(density.name, [&]() { tree.execute_functions(); })
+		    .counters.push_back({"nodes", (double)tree.get_node_count()});
+	}
+}
+
+BENCHMARK(manifold_mesher)
+{
+	for (const Density& density : densities)
+	{
+		Tree tree(make_pipeline(density, false));
+		tree.execute_functions();
+		for (int threads : {1, 0})
+		{
+			ManifoldMesher mesher;
+			mesher.threads = threads;
+			Mesh mesh;
+			std::string name = std::string(density.name) + (threads == 1 ? "/serial" : "/parallel");
+			state.measure(name, [&]() { mesh = mesher.mesh_tree(tree); })
+			    .counters.push_back({"vertices", (double)mesh.vertices.size()});
+		}
+	}
+}
+
+BENCHMARK(basic_mesher)
+{
+	for (const Density& density : densities)
+	{
+		Tree tree(make_pipeline(density, false));
+		tree.execute_functions();
+		BasicMesher mesher;
+		Mesh mesh;
+		state.measure(density.name, [&]() { mesh = mesher.mesh_tree(tree); })
+		    .counters.push_back({"vertices", (double)mesh.vertices.size()});
+	}
+}
+
+BENCHMARK(smooth_mesh)
+{
+	Tree tree(make_pipeline(densities[1], false));
+	tree.execute_functions();
+	ManifoldMesher mesher;
+	mesher.smooth_iterations = 0;
+	const Mesh reference = mesher.mesh_tree(tree);
+	for (int threads : {1, 0})
+	{
+		Mesh mesh;
+		state.measure(
+		    threads == 1 ? "serial" : "parallel", [&]() { mesh = reference.clone(); },
+		    [&]() { MeshProcessing::Smoothing::smooth_mesh(mesh, 4, 1, nullptr, threads); });
+	}
+}
+
+BENCHMARK(leaf_generate)
+{
+	for (bool venation : {false, true})
+	{
+		LeafShapeGenerator generator;
+		generator.enable_venation = venation;
+		Mesh mesh;
+		state.measure(venation ? "venation" : "plain", [&]() { mesh = generator.generate(); })
+		    .counters.push_back({"vertices", (double)mesh.vertices.size()});
+	}
+}
+
+// The Python getters are views over the mesh buffers, the Blender import then copies them into
+// flat arrays (see python_classes/mesh_utils.py). This measures that copy from C++; the getters
+// themselves are measured by bench_python.py.
+BENCHMARK(mesh_buffer_copy)
+{
+	Tree tree(make_pipeline(densities[1], false));
+	tree.execute_functions();
+	ManifoldMesher mesher;
+	const Mesh mesh = mesher.mesh_tree(tree);
+	std::vector<float> vertices;
+	std::vector<int> polygons;
+	std::vector<float> uvs;
+	state.measure("",
+	              [&]()
+	              {
+		              vertices.assign(&mesh.vertices[0][0], &mesh.vertices[0][0] +
+		                                                          mesh.vertices.size() * 3);
+		              polygons.assign(&mesh.polygons[0][0], &mesh.polygons[0][0] +
+		                                                          mesh.polygons.size() * 4);
+		              uvs.assign(&mesh.uvs[0][0], &mesh.uvs[0][0] + mesh.uvs.size() * 2);
+		              keep(vertices);
+	              });
+}
+
+// =====================================================================
+// Report
+// =====================================================================
+
+static std::string to_json(const std::vector<BenchmarkResult>& results)
+{
+	std::ostringstream json;
+	json.precision(6);
+	json << "{\n  \"context\": {\"hardware_threads\": " << std::thread::hardware_concurrency()
+#ifdef NDEBUG
+	     << ", \"build\": \"release\""
+#else
+	     << ", \"build\": \"debug\""
+#endif
+	     << ", \"min_time\": " << min_time << "},\n  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		json << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+		     << "\", \"iterations\": " << result.iterations << ", \"min_ms\": " << result.min_ms
+		     << ", \"median_ms\": " << result.median_ms << ", \"mean_ms\": " << result.mean_ms
+		     << ", \"allocations\": " << result.allocations
+		     << ", \"allocated_bytes\": " << result.allocated_bytes
+		     << ", \"peak_rss_kb\": " << result.peak_rss_kb;
+		for (auto& [counter, value] : result.counters)
+			json << ", \"" << counter << "\": " << value;
+		json << "}";
+	}
+	json << "\n  ]\n}\n";
+	return json.str();
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::string output;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else if (argument == "--out" && i + 1 < argc)
+			output = argv[++i];
+		else if (argument == "--min-time" && i + 1 < argc)
+			min_time = std::atof(argv[++i]);
+		else if (argument == "--max-iterations" && i + 1 < argc)
+			max_iterations = std::max(1, std::atoi(argv[++i]));
+		else
+		{
+			std::cerr << "usage: m_tree_bench [--filter substring] [--out report.json] "
+			             "[--min-time seconds] [--max-iterations count]"
+			          << std::endl;
+			return 2;
+		}
+	}
+
+	std::vector<BenchmarkResult> results;
+	for (const Benchmark& benchmark : get_benchmarks())
+	{
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+			continue;
+		size_t first = results.size();
+		State state{benchmark.name, results};
+		benchmark.function(state);
+		for (size_t i = first; i < results.size(); i++)
+			std::cerr << "  " << results[i].name << ": " << results[i].median_ms << " ms"
+			          << std::endl;
+	}
+
+	std::string json = to_json(results);
+	if (output.empty())
+	{
+		std::cout << json;
+		return 0;
+	}
+	std::ofstream file{output};
+	file << json;
+	return file ? 0 : 1;
+}
@@ -1,28 +1,219 @@
 #include <iostream>
+#include <cstring>
 #include <exception>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/numpy.h>
 
+#include "source/mesh/AttributePacking.hpp"
+#include "source/mesh/InterleavedMesh.hpp"
 #include "source/mesh/Mesh.hpp"
+#include "source/mesh/MeshSink.hpp"
+#include "source/io/AssetFile.hpp"
 #include "source/tree/Tree.hpp"
+#include "source/tree/TreeBuild.hpp"
+#include "source/tree/ForestBuilder.hpp"
+#include "source/tree/ParameterSweep.hpp"
+#include "source/tree/SegmentIndex.hpp"
 #include "source/tree_functions/base_types/Property.hpp"
 #include "source/tree_functions/TrunkFunction.hpp"
 #include "source/tree_functions/BranchFunction.hpp"
 #include "source/tree_functions/CrownShape.hpp"
 #include "source/tree_functions/GrowthFunction.hpp"
+#include "source/tree_functions/GrowthSnapshotCache.hpp"
+#include "source/tree_functions/LeavesFunction.hpp"
 #include "source/tree_functions/PipeRadiusFunction.hpp"
+#include "source/tree_functions/SimplifyFunction.hpp"
 #include "source/meshers/splines_mesher/BasicMesher.hpp"
+#include "source/meshers/manifold_mesher/BranchInstancer.hpp"
 #include "source/meshers/manifold_mesher/ManifoldMesher.hpp"
+#include "source/meshers/manifold_mesher/PivotPainterBaker.hpp"
 #include "source/leaf/LeafPresets.hpp"
 #include "source/leaf/LeafShapeGenerator.hpp"
+#include "source/leaf/LeafMeshCache.hpp"
+#include "source/leaf/ImpostorBaker.hpp"
 #include "source/leaf/LeafLODGenerator.hpp"
 
 
 using namespace Mtree;
 namespace py = pybind11;
 
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be tightly packed");
+static_assert(sizeof(Vector2) == 2 * sizeof(float), "Vector2 must be tightly packed");
+static_assert(sizeof(std::array<int, 4>) == 4 * sizeof(int), "polygons must be tightly packed");
+static_assert(sizeof(std::array<int, 3>) == 3 * sizeof(int), "triangles must be tightly packed");
+
+// Flat NumPy view over contiguous mesh storage of element_count elements of `components` scalars.
+// No data is copied: the Mesh python object is the base of the array and is kept alive by it.
+// Views are invalidated if the mesh buffers are resized afterwards.
+template <typename Scalar, typename Element>
+py::array_t<Scalar> flat_view(const Element* data, const size_t element_count,
+                              const size_t components, py::handle base)
+{
+    if (element_count == 0)
+        return py::array_t<Scalar>(0);
+    return py::array_t<Scalar>({(py::ssize_t)(element_count * components)},
+                               {(py::ssize_t)sizeof(Scalar)},
+                               reinterpret_cast<const Scalar*>(data), base);
+}
+
+// Leaf placements handed to Python, exposed as views over the packed records
+struct LeafInstanceBuffer
+{
+    std::vector<LeafInstance> instances;
+};
+
+// (count, components) NumPy view over one field of packed records, striding over the records.
+// As with flat_view, base is the python object owning the records.
+template <typename Scalar, typename Record, typename Field>
+py::array_t<Scalar> record_view(const std::vector<Record>& records, Field Record::*field,
+                                const size_t components, py::object base)
+{
+    if (records.empty())
+        return py::array_t<Scalar>(std::vector<py::ssize_t>{0, (py::ssize_t)components});
+    return py::array_t<Scalar>({(py::ssize_t)records.size(), (py::ssize_t)components},
+                               {(py::ssize_t)sizeof(Record), (py::ssize_t)sizeof(Scalar)},
+                               reinterpret_cast<const Scalar*>(&(records[0].*field)), base);
+}
+
+template <typename Scalar, typename Field>
+py::array_t<Scalar> leaf_view(py::object self, Field LeafInstance::*field, const size_t components)
+{
+    return record_view<Scalar>(self.cast<LeafInstanceBuffer&>().instances, field, components, self);
+}
+
+template <typename Scalar, typename Field>
+py::array_t<Scalar> branch_instance_view(py::object self, Field BranchInstance::*field,
+                                         const size_t components)
+{
+    return record_view<Scalar>(self.cast<InstancedTreeMesh&>().instances, field, components,
+                               self);
+}
+
+// BufferSink writing straight into NumPy arrays allocated by the caller (sized from
+// predict_counts), which it keeps alive. Arrays must be writable, C contiguous, float32 for
+// vertices, normals, uvs and attributes and int32 for polygons, triangles and their uv loops.
+struct ArraySink : BufferSink
+{
+    std::vector<py::array> arrays;
+
+    template <typename Scalar> Scalar* bind(py::object object, const int components, int& count)
+    {
+        if (object.is_none())
+            return nullptr;
+        auto array = object.cast<py::array>();
+        if (!py::isinstance<py::array_t<Scalar>>(array) || !(array.flags() & py::array::c_style) ||
+            !array.writeable() || array.size() % components != 0)
+            throw std::invalid_argument("sink arrays must be writable contiguous arrays of the "
+                                        "mesh scalar types");
+        arrays.push_back(array);
+        count = (int)(array.size() / components);
+        return static_cast<Scalar*>(array.mutable_data());
+    }
+
+    void set_attribute(const std::string& name, py::object object)
+    {
+        if (capacity.vertices == 0)
+            throw std::invalid_argument("attribute arrays need a vertex array");
+        int count = 0;
+        auto array = object.cast<py::array>();
+        int components = (int)(array.size() / capacity.vertices);
+        float* data = bind<float>(object, std::max(components, 1), count);
+        if (count != capacity.vertices)
+            throw std::invalid_argument("attribute " + name + " must have one element per vertex");
+        attributes[name] = AttributeBuffer{data, components * sizeof(float)};
+    }
+};
+
+// Float arrays read by the Pivot Painter baker, converted to contiguous float32 when needed
+using FloatArray = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+std::span<const float> as_floats(const FloatArray& array)
+{
+    return {array.data(), (size_t)array.size()};
+}
+
+std::span<const Vector3> as_vectors(const FloatArray& array)
+{
+    if (array.size() % 3 != 0)
+        throw std::invalid_argument("vector arrays must have 3 components per element");
+    return {reinterpret_cast<const Vector3*>(array.data()), (size_t)array.size() / 3};
+}
+
+// Data of a preallocated output array, which must be writable, C contiguous and hold `size`
+// scalars of dtype
+void* get_output_buffer(py::array array, const py::dtype& dtype, const size_t size)
+{
+    if (!array.dtype().is(dtype) || !(array.flags() & py::array::c_style) ||
+        !array.writeable() || (size_t)array.size() != size)
+        throw std::invalid_argument("output arrays must be writable contiguous arrays of " +
+                                    std::to_string(size) + " " +
+                                    py::str(dtype).cast<std::string>());
+    return array.mutable_data();
+}
+
+// Bytes of each part of a footprint, with the sum of the parts under "total"
+py::dict to_dict(const MemoryFootprint& footprint)
+{
+    py::dict parts;
+    for (const auto& [name, bytes] : footprint.parts)
+        parts[py::str(name)] = bytes;
+    parts["total"] = footprint.total();
+    return parts;
+}
+
+// Runs a sweep without holding the GIL and returns its columns as NumPy arrays, the bounds of shape
+// (variants, 3), along with the list of meshes when they are built
+template <Mesher T>
+py::dict run_sweep(const ParameterSweep& sweep,
+                   const std::vector<std::shared_ptr<TreeFunction>>& variants, const T& mesher)
+{
+    SweepTable table;
+    {
+        py::gil_scoped_release release;
+        table = sweep.run(variants, mesher);
+    }
+    py::ssize_t count = (py::ssize_t)table.size();
+    auto vectors = [&](const std::vector<Vector3>& values)
+    {
+        return py::array_t<float>({count, (py::ssize_t)3},
+                                  reinterpret_cast<const float*>(values.data()));
+    };
+    py::dict columns;
+    columns["node_count"] = py::array_t<int>(count, table.node_counts.data());
+    columns["bounds_min"] = vectors(table.bounds_min);
+    columns["bounds_max"] = vectors(table.bounds_max);
+    columns["crown_fit"] = py::array_t<float>(count, table.crown_fits.data());
+    columns["vertex_count"] = py::array_t<int>(count, table.vertex_counts.data());
+    columns["polygon_count"] = py::array_t<int>(count, table.polygon_counts.data());
+    if (sweep.build_meshes)
+    {
+        py::list meshes;
+        for (Mesh& mesh : table.meshes)
+            meshes.append(py::cast(std::move(mesh)));
+        columns["meshes"] = meshes;
+    }
+    return columns;
+}
+
+// NumPy type of the scalars of a packed format
+py::dtype get_packed_dtype(const PackedFormat format)
+{
+    switch (format)
+    {
+    case PackedFormat::Float16:
+        return py::dtype("float16");
+    case PackedFormat::Snorm16:
+        return py::dtype::of<int16_t>();
+    case PackedFormat::Snorm8:
+        return py::dtype::of<int8_t>();
+    case PackedFormat::UInt16:
+        return py::dtype::of<uint16_t>();
+    default:
+        return py::dtype::of<float>();
+    }
+}
 
 PYBIND11_MODULE(m_tree, m) {
 
@@ -37,6 +228,17 @@ PYBIND11_MODULE(m_tree, m) {
         .value("Open", VenationType::Open)
         .value("Closed", VenationType::Closed);
 
+    py::enum_<LeafTriangulation>(m, "LeafTriangulation")
+        .value("Rings", LeafTriangulation::Rings)
+        .value("Delaunay", LeafTriangulation::Delaunay);
+
+    py::enum_<PackedFormat>(m, "PackedFormat")
+        .value("Float32", PackedFormat::Float32)
+        .value("Float16", PackedFormat::Float16)
+        .value("Snorm16", PackedFormat::Snorm16)
+        .value("Snorm8", PackedFormat::Snorm8)
+        .value("UInt16", PackedFormat::UInt16);
+
     py::class_<LeafPreset>(m, "LeafPreset")
         .def(py::init<>())
         .def_readwrite("name", &LeafPreset::name)
@@ -86,18 +288,103 @@ PYBIND11_MODULE(m_tree, m) {
         .def_readwrite("cross_curvature", &LeafShapeGenerator::cross_curvature)
         .def_readwrite("vein_displacement", &LeafShapeGenerator::vein_displacement)
         .def_readwrite("edge_curl", &LeafShapeGenerator::edge_curl)
+        .def_readwrite("triangulation", &LeafShapeGenerator::triangulation)
+        .def_readwrite("target_triangles", &LeafShapeGenerator::target_triangles)
+        .def_readwrite("min_triangle_angle", &LeafShapeGenerator::min_triangle_angle)
+        .def_readwrite("vein_steiner_points", &LeafShapeGenerator::vein_steiner_points)
         .def_readwrite("contour_resolution", &LeafShapeGenerator::contour_resolution)
         .def_readwrite("seed", &LeafShapeGenerator::seed)
-        .def("generate", &LeafShapeGenerator::generate);
+        .def_readwrite("threads", &LeafShapeGenerator::threads)
+        .def("generate", &LeafShapeGenerator::generate, py::call_guard<py::gil_scoped_release>())
+        .def("generate_cached", &LeafShapeGenerator::generate_cached,
+             py::call_guard<py::gil_scoped_release>())
+        .def("get_fingerprint", &LeafShapeGenerator::get_fingerprint);
+
+    // Global cache behind LeafShapeGenerator.generate_cached
+    m.def("invalidate_leaf_cache", [](const LeafShapeGenerator& generator)
+        {
+            return LeafMeshCache::get_global().invalidate(generator);
+        });
+    m.def("clear_leaf_cache", []() { LeafMeshCache::get_global().clear(); });
+    m.def("set_leaf_cache_capacity", [](int capacity)
+        {
+            LeafMeshCache::get_global().set_capacity(capacity);
+        });
+    m.def("get_leaf_cache_size", []() { return LeafMeshCache::get_global().size(); });
+
+    py::class_<BillboardClustering>(m, "BillboardClustering")
+        .def(py::init<>())
+        .def_readwrite("card_budget", &BillboardClustering::card_budget)
+        .def_readwrite("cards_per_cluster", &BillboardClustering::cards_per_cluster)
+        .def_readwrite("iterations", &BillboardClustering::iterations)
+        .def_readwrite("margin", &BillboardClustering::margin)
+        .def_readwrite("seed", &BillboardClustering::seed)
+        .def_readwrite("threads", &BillboardClustering::threads);
 
     py::class_<LeafLODGenerator>(m, "LeafLODGenerator")
         .def(py::init<>())
         .def("generate_card", &LeafLODGenerator::generate_card)
-        .def("generate_billboard_cloud", &LeafLODGenerator::generate_billboard_cloud,
+        .def("generate_billboard_cloud",
+             py::overload_cast<const std::vector<Vector3>&, int>(
+                 &LeafLODGenerator::generate_billboard_cloud),
              py::arg("positions"), py::arg("num_planes") = 3)
+        .def("generate_billboard_cloud",
+             [](LeafLODGenerator& self, const std::vector<Vector3>& positions,
+                const BillboardClustering& clustering)
+             {
+                 py::gil_scoped_release release;
+                 return self.generate_billboard_cloud(positions, clustering);
+             },
+             py::arg("positions"), py::arg("clustering"))
         .def("get_impostor_view_directions", &LeafLODGenerator::get_impostor_view_directions,
              py::arg("resolution") = 12);
 
+    // Atlas images are flat views of size * size * 4 (albedo, normals) or size * size (depth)
+    // scalars, rows from the bottom of the atlas
+    py::class_<ImpostorAtlas>(m, "ImpostorAtlas")
+        .def_readonly("resolution", &ImpostorAtlas::resolution)
+        .def_readonly("tile_size", &ImpostorAtlas::tile_size)
+        .def_readonly("radius", &ImpostorAtlas::radius)
+        .def_property_readonly("center", [](const ImpostorAtlas& atlas)
+            {
+                return std::array<float, 3>{atlas.center.x(), atlas.center.y(), atlas.center.z()};
+            })
+        .def("get_size", &ImpostorAtlas::get_size)
+        .def("get_albedo", [](py::object self)
+            {
+                auto& atlas = self.cast<ImpostorAtlas&>();
+                return flat_view<uint8_t>(atlas.albedo.data(), atlas.albedo.size(), 4, self);
+            })
+        .def("get_normals", [](py::object self)
+            {
+                auto& atlas = self.cast<ImpostorAtlas&>();
+                return flat_view<uint8_t>(atlas.normals.data(), atlas.normals.size(), 4, self);
+            })
+        .def("get_depth", [](py::object self)
+            {
+                auto& atlas = self.cast<ImpostorAtlas&>();
+                return flat_view<float>(atlas.depth.data(), atlas.depth.size(), 1, self);
+            });
+
+    py::class_<ImpostorBaker>(m, "ImpostorBaker")
+        .def(py::init<>())
+        .def_readwrite("resolution", &ImpostorBaker::resolution)
+        .def_readwrite("tile_size", &ImpostorBaker::tile_size)
+        .def_readwrite("threads", &ImpostorBaker::threads)
+        // One (r, g, b) albedo per mesh, typically the tree mesh and the leaf mesh
+        .def("bake", [](const ImpostorBaker& baker, const std::vector<const Mesh*>& meshes,
+                        const std::vector<std::array<float, 3>>& albedos)
+            {
+                if (albedos.size() != meshes.size())
+                    throw std::invalid_argument("bake needs one albedo per mesh");
+                std::vector<ImpostorMesh> items;
+                for (size_t i = 0; i < meshes.size(); i++)
+                    items.push_back({meshes[i], Vector3{albedos[i][0], albedos[i][1],
+                                                        albedos[i][2]}});
+                py::gil_scoped_release release;
+                return baker.bake(items);
+            }, py::arg("meshes"), py::arg("albedos"));
+
     py::enum_<CrownShape>(m, "CrownShape")
         .value("Conical", CrownShape::Conical)
         .value("Spherical", CrownShape::Spherical)
@@ -136,7 +423,9 @@ PYBIND11_MODULE(m_tree, m) {
 
     py::class_<TreeFunction, std::shared_ptr<TreeFunction>>(m, "TreeFunction")
         .def_readwrite("seed", &TreeFunction::seed)
-        .def("add_child", &TreeFunction::add_child);
+        .def("add_child", &TreeFunction::add_child)
+        .def("clear_children", &TreeFunction::clear_children)
+        .def("clone", &TreeFunction::clone);
 
     py::class_<ConstantProperty, std::shared_ptr<ConstantProperty>>(m, "ConstantProperty")
         .def(py::init<>())
@@ -187,6 +476,12 @@ PYBIND11_MODULE(m_tree, m) {
         .def_readwrite("power", &PipeRadiusFunction::power)
         ;
 
+    py::class_<SimplifyFunction, std::shared_ptr<SimplifyFunction>, TreeFunction>(m, "SimplifyFunction")
+        .def(py::init<>())
+        .def_readwrite("angle_tolerance", &SimplifyFunction::angle_tolerance)
+        .def_readwrite("radius_tolerance", &SimplifyFunction::radius_tolerance)
+        ;
+
     py::class_<BranchFunction, std::shared_ptr<BranchFunction>, TreeFunction>(m, "BranchFunction")
         .def(py::init<>())
         .def_readwrite("length", &BranchFunction::length)
@@ -197,6 +492,8 @@ PYBIND11_MODULE(m_tree, m) {
         .def_readwrite("randomness", &BranchFunction::randomness)
         .def_readwrite("flatness", &BranchFunction::flatness)
         .def_readwrite("start_angle", &BranchFunction::start_angle)
+        .def_readwrite("collision_avoidance", &BranchFunction::collision_avoidance)
+        .def_readwrite("threads", &BranchFunction::threads)
         // Parameter groupings
         .def_readwrite("split", &BranchFunction::split)
         .def_readwrite("gravity", &BranchFunction::gravity)
@@ -227,31 +524,246 @@ PYBIND11_MODULE(m_tree, m) {
         // Flowering parameters
         .def_readwrite("enable_flowering", &GrowthFunction::enable_flowering)
         .def_readwrite("flower_threshold", &GrowthFunction::flower_threshold)
+        // Shadow propagation light model
+        .def_readwrite("enable_shadows", &GrowthFunction::enable_shadows)
+        .def_readwrite("shadow_voxel_size", &GrowthFunction::shadow_voxel_size)
+        .def_readwrite("shadow_strength", &GrowthFunction::shadow_strength)
+        .def_readwrite("shadow_decay", &GrowthFunction::shadow_decay)
+        .def_readwrite("shadow_depth", &GrowthFunction::shadow_depth)
+        .def_readwrite("threads", &GrowthFunction::threads)
+        .def_readwrite("cache_iterations", &GrowthFunction::cache_iterations)
         ;
 
+    // Global cache behind GrowthFunction.cache_iterations
+    m.def("clear_growth_cache", []() { GrowthSnapshotCache::get_global().clear(); });
+    m.def("set_growth_cache_memory_cap", [](size_t bytes)
+        {
+            GrowthSnapshotCache::get_global().set_memory_cap(bytes);
+        });
+    m.def("get_growth_cache_memory_usage", []()
+        {
+            return GrowthSnapshotCache::get_global().get_memory_usage();
+        });
+
 
     py::class_<Tree>(m, "Tree")
         .def(py::init<>())
         .def("set_trunk_function", &Tree::set_first_function)
         .def("get_trunk_function", &Tree::get_first_function)
-        .def("execute_functions", &Tree::execute_functions);
+        .def("execute_functions", [](Tree& tree) { tree.execute_functions(); },
+             py::call_guard<py::gil_scoped_release>())
+        .def("execute_functions_async", [](Tree& tree)
+            {
+                return std::make_unique<TreeBuild>(tree);
+            }, py::keep_alive<0, 1>())
+        .def("build_async", [](Tree& tree, const ManifoldMesher& mesher,
+                               std::optional<PreviewSettings> preview)
+            {
+                return std::make_unique<TreeBuild>(tree, std::make_unique<ManifoldMesher>(mesher),
+                                                   preview);
+            }, py::arg("mesher"), py::arg("preview") = py::none(), py::keep_alive<0, 1>())
+        .def("build_async", [](Tree& tree, const BasicMesher& mesher,
+                               std::optional<PreviewSettings> preview)
+            {
+                return std::make_unique<TreeBuild>(tree, std::make_unique<BasicMesher>(mesher),
+                                                   preview);
+            }, py::arg("mesher"), py::arg("preview") = py::none(), py::keep_alive<0, 1>())
+        .def("get_node_count", &Tree::get_node_count)
+        .def_readwrite("cache_functions", &Tree::cache_functions)
+        .def("get_cached_state_count", &Tree::get_cached_state_count)
+        .def("clear_function_cache", &Tree::clear_function_cache)
+        .def_readwrite("profile", &Tree::profile)
+        .def("get_profile", [](Tree& tree)
+            {
+                py::list entries;
+                for (const Profiler::ReportEntry& entry : tree.get_profiler().get_report())
+                {
+                    py::dict counters;
+                    for (const auto& [name, value] : entry.counters)
+                        counters[py::str(name)] = value;
+                    py::dict item;
+                    item["path"] = entry.path;
+                    item["calls"] = entry.calls;
+                    item["total_ms"] = entry.total_ms;
+                    item["self_ms"] = entry.self_ms;
+                    item["counters"] = counters;
+                    entries.append(item);
+                }
+                return entries;
+            })
+        .def("get_profile_trace", [](Tree& tree) { return tree.get_profiler().to_chrome_trace(); })
+        .def("write_profile_trace", [](Tree& tree, const std::string& path)
+            {
+                tree.get_profiler().write_chrome_trace(path);
+            })
+        .def("memory_footprint", [](const Tree& tree) { return to_dict(tree.memory_footprint()); })
+        .def_readwrite("track_memory", &Tree::track_memory)
+        .def("get_execution_memory_peak", &Tree::get_execution_memory_peak)
+        .def("get_meshing_memory_peak", &Tree::get_meshing_memory_peak);
 
-    py::class_<Mesh>(m, "Mesh")
-        .def("get_vertices", [](const Mesh& mesh)
+    py::class_<PreviewSettings>(m, "PreviewSettings")
+        .def(py::init<>())
+        .def_readwrite("resolution_factor", &PreviewSettings::resolution_factor)
+        .def_readwrite("radial_resolution", &PreviewSettings::radial_resolution)
+        .def_readwrite("time_budget_ms", &PreviewSettings::time_budget_ms);
+
+    // Handle on a build running on a background thread, the tree it builds is kept alive by it.
+    // Python is expected to poll is_done (from a timer) rather than block in wait.
+    py::class_<TreeBuild>(m, "TreeBuild")
+        .def("is_done", &TreeBuild::is_done)
+        .def("is_cancelled", &TreeBuild::is_cancelled)
+        .def("cancel", &TreeBuild::cancel)
+        .def("get_progress", &TreeBuild::get_progress)
+        .def("wait", &TreeBuild::wait, py::call_guard<py::gil_scoped_release>())
+        .def("get_mesh", &TreeBuild::get_mesh, py::return_value_policy::reference_internal,
+             py::call_guard<py::gil_scoped_release>())
+        .def("has_preview", &TreeBuild::has_preview)
+        .def("get_preview", &TreeBuild::get_preview, py::return_value_policy::reference_internal);
+
+    py::class_<ForestItem>(m, "ForestItem")
+        .def(py::init([](int seed, std::array<float, 3> position, float rotation, float scale)
+            {
+                return ForestItem{seed, Vector3{position[0], position[1], position[2]}, rotation,
+                                  scale};
+            }),
+             py::arg("seed") = 0, py::arg("position") = std::array<float, 3>{0, 0, 0},
+             py::arg("rotation") = 0.f, py::arg("scale") = 1.f)
+        .def_readwrite("seed", &ForestItem::seed)
+        .def_property("position",
+            [](const ForestItem& item)
+            {
+                return std::array<float, 3>{item.position.x(), item.position.y(), item.position.z()};
+            },
+            [](ForestItem& item, std::array<float, 3> position)
             {
-        	    py::array_t<float> result(mesh.vertices.size() * 3);
-			    py::buffer_info buff = result.request();
+                item.position = Vector3{position[0], position[1], position[2]};
+            })
+        .def_readwrite("rotation", &ForestItem::rotation)
+        .def_readwrite("scale", &ForestItem::scale);
+
+    // Builds the meshes of a list of items without holding the GIL, one tree per pool task
+    py::class_<ForestBuilder>(m, "ForestBuilder")
+        .def(py::init<std::shared_ptr<TreeFunction>>())
+        .def_readwrite("threads", &ForestBuilder::threads)
+        .def("build", &ForestBuilder::build<ManifoldMesher>,
+             py::call_guard<py::gil_scoped_release>())
+        .def("build", &ForestBuilder::build<BasicMesher>,
+             py::call_guard<py::gil_scoped_release>())
+        .def("stream", &ForestBuilder::stream<ManifoldMesher>,
+             py::call_guard<py::gil_scoped_release>())
+        .def("stream", &ForestBuilder::stream<BasicMesher>,
+             py::call_guard<py::gil_scoped_release>());
 
-			    float* ptr = (float*)buff.ptr;
-			    for (int i = 0; i < mesh.vertices.size(); i++)
-			    {
-				    for (size_t j = 0; j < 3; j++)
-				    {
-					    ptr[i*3+j] = mesh.vertices[i][j];
-				    }
-			    }
+    // Measures variants of a function graph in one call, see run_sweep for the columns returned
+    py::class_<ParameterSweep>(m, "ParameterSweep")
+        .def(py::init<>())
+        .def_readwrite("threads", &ParameterSweep::threads)
+        .def_readwrite("build_meshes", &ParameterSweep::build_meshes)
+        .def_readwrite("crown_shape", &ParameterSweep::crown_shape)
+        .def_readwrite("crown_base", &ParameterSweep::crown_base)
+        .def_readwrite("crown_bins", &ParameterSweep::crown_bins)
+        .def("run", &run_sweep<ManifoldMesher>, py::arg("variants"), py::arg("mesher"))
+        .def("run", &run_sweep<BasicMesher>, py::arg("variants"), py::arg("mesher"));
+
+    // Spatial queries over the nodes of an executed tree, results are node indices in pre-order
+    // and hits are (node, distance) tuples or None
+    auto to_vector = [](std::array<float, 3> v) { return Vector3{v[0], v[1], v[2]}; };
+    auto to_hit = [](const SegmentIndex& index, SegmentIndex::Hit hit) -> py::object
+    {
+        if (!hit.is_valid())
+            return py::none();
+        return py::make_tuple(index.get_segment(hit.segment).node, hit.distance);
+    };
+    py::class_<SegmentIndex>(m, "SegmentIndex")
+        .def(py::init([](Tree& tree, float cell_size)
+            {
+                SegmentIndex index{cell_size};
+                index.build(tree.get_arena());
+                return index;
+            }),
+             py::arg("tree"), py::arg("cell_size") = 0.f)
+        .def("get_cell_size", &SegmentIndex::get_cell_size)
+        .def("__len__", &SegmentIndex::size)
+        .def("query_radius", [to_vector](const SegmentIndex& index, std::array<float, 3> point,
+                                         float radius)
+            {
+                std::vector<int> nodes;
+                index.for_each_in_radius(to_vector(point), radius, [&](const int segment)
+                    {
+                        nodes.push_back(index.get_segment(segment).node);
+                    });
+                return nodes;
+            })
+        .def("nearest", [to_vector, to_hit](const SegmentIndex& index, std::array<float, 3> point,
+                                            float max_distance)
+            {
+                return to_hit(index, index.nearest(to_vector(point), max_distance));
+            },
+             py::arg("point"), py::arg("max_distance") = std::numeric_limits<float>::infinity())
+        .def("raycast", [to_vector, to_hit](const SegmentIndex& index, std::array<float, 3> origin,
+                                            std::array<float, 3> direction, float max_distance,
+                                            int ignored_node)
+            {
+                return to_hit(index, index.raycast(to_vector(origin),
+                                                   to_vector(direction).normalized(), max_distance,
+                                                   ignored_node));
+            },
+             py::arg("origin"), py::arg("direction"),
+             py::arg("max_distance") = std::numeric_limits<float>::infinity(),
+             py::arg("ignored_node") = -1);
+
+    py::class_<LeavesFunction>(m, "LeavesFunction")
+        .def(py::init<>())
+        .def_readwrite("density", &LeavesFunction::density)
+        .def_readwrite("max_radius", &LeavesFunction::max_radius)
+        .def_readwrite("size", &LeavesFunction::size)
+        .def_readwrite("size_randomness", &LeavesFunction::size_randomness)
+        .def_readwrite("leaf_angle", &LeavesFunction::leaf_angle)
+        .def_readwrite("phyllotaxis_angle", &LeavesFunction::phyllotaxis_angle)
+        .def_readwrite("up_alignment", &LeavesFunction::up_alignment)
+        .def_readwrite("template_count", &LeavesFunction::template_count)
+        .def_readwrite("seed", &LeavesFunction::seed)
+        .def_readwrite("threads", &LeavesFunction::threads)
+        .def("execute", [](const LeavesFunction& function, Tree& tree)
+            {
+                return LeafInstanceBuffer{function.execute(tree)};
+            }, py::call_guard<py::gil_scoped_release>());
+
+    // Views are (count, components) arrays striding over the 40 bytes records, get_bytes returns
+    // the packed records themselves for engines that upload them as is
+    py::class_<LeafInstanceBuffer>(m, "LeafInstanceBuffer")
+        .def("__len__", [](const LeafInstanceBuffer& buffer) { return buffer.instances.size(); })
+        .def("get_positions", [](py::object self)
+            {
+                return leaf_view<float>(self, &LeafInstance::position, 3);
+            })
+        .def("get_rotations", [](py::object self)
+            {
+                return leaf_view<float>(self, &LeafInstance::rotation, 4);
+            })
+        .def("get_scales", [](py::object self)
+            {
+                return leaf_view<float>(self, &LeafInstance::scale, 1);
+            })
+        .def("get_template_ids", [](py::object self)
+            {
+                return leaf_view<int32_t>(self, &LeafInstance::template_id, 1);
+            })
+        .def("get_nodes", [](py::object self)
+            {
+                return leaf_view<int32_t>(self, &LeafInstance::node, 1);
+            })
+        .def("get_bytes", [](const LeafInstanceBuffer& buffer)
+            {
+                return py::bytes(reinterpret_cast<const char*>(buffer.instances.data()),
+                                 buffer.instances.size() * sizeof(LeafInstance));
+            });
 
-			    return result;
+    py::class_<Mesh>(m, "Mesh")
+        .def("get_vertices", [](py::object self)
+            {
+                auto& mesh = self.cast<Mesh&>();
+                return flat_view<float>(mesh.vertices.data(), mesh.vertices.size(), 3, self);
             })
         .def("has_float_attribute", [](const Mesh& mesh, std::string name)
             {
@@ -267,101 +779,346 @@ PYBIND11_MODULE(m_tree, m) {
                     return false;
                 return dynamic_cast<Attribute<Vector3>*>(it->second.get()) != nullptr;
             })
-        .def("get_float_attribute", [](const Mesh& mesh, std::string name)
+        .def("get_float_attribute", [](py::object self, std::string name)
             {
-                if (mesh.attributes.count(name) == 0)
+                auto& mesh = self.cast<Mesh&>();
+                auto attribute = mesh.get_attribute<float>(name);
+                if (!attribute.is_valid())
                 {
                     throw std::invalid_argument("attribute " + name + " doesn't exist");
                 }
-                auto& attribute = *static_cast<Attribute<float>*>(mesh.attributes.at(name).get());
-                py::array_t<float> result(mesh.vertices.size());
-                py::buffer_info buff = result.request();
-
-                float* ptr = (float*)buff.ptr;
-                for (int i = 0; i < mesh.vertices.size(); i++)
-                {
-                    ptr[i] = attribute.data[i];
-                }
-                return result;
+                return flat_view<float>(attribute.data().data(), mesh.vertices.size(), 1, self);
             })
-        .def("get_vector3_attribute", [](const Mesh& mesh, std::string name)
+        .def("get_vector3_attribute", [](py::object self, std::string name)
             {
-                if (mesh.attributes.count(name) == 0)
+                auto& mesh = self.cast<Mesh&>();
+                auto attribute = mesh.get_attribute<Vector3>(name);
+                if (!attribute.is_valid())
                 {
                     throw std::invalid_argument("attribute " + name + " doesn't exist");
                 }
-                auto& attribute = *static_cast<Attribute<Vector3>*>(mesh.attributes.at(name).get());
-                py::array_t<float> result(mesh.vertices.size() * 3);
-                py::buffer_info buff = result.request();
-
-                float* ptr = (float*)buff.ptr;
-                for (int i = 0; i < mesh.vertices.size(); i++)
-                {
-                    ptr[i*3] = attribute.data[i][0];
-                    ptr[i*3 + 1] = attribute.data[i][1];
-                    ptr[i*3 + 2] = attribute.data[i][2];
-                }
-                return result;
+                return flat_view<float>(attribute.data().data(), mesh.vertices.size(), 3, self);
+            })
+        .def("get_normals", [](py::object self)
+            {
+                auto& mesh = self.cast<Mesh&>();
+                return flat_view<float>(mesh.normals.data(), mesh.normals.size(), 3, self);
             })
-        .def("get_polygons", [](const Mesh& mesh)
+        .def("get_polygons", [](py::object self)
             {
-                py::array_t<int> result(mesh.polygons.size() * 4);
-             	py::buffer_info buff = result.request();
+                auto& mesh = self.cast<Mesh&>();
+                return flat_view<int>(mesh.polygons.data(), mesh.polygons.size(), 4, self);
+            })
+        .def("get_uvs", [](py::object self)
+            {
+                auto& mesh = self.cast<Mesh&>();
+                return flat_view<float>(mesh.uvs.data(), mesh.uvs.size(), 2, self);
+            })
+        .def("get_uv_loops", [](py::object self)
+            {
+                auto& mesh = self.cast<Mesh&>();
+                return flat_view<int>(mesh.uv_loops.data(), mesh.uv_loops.size(), 4, self);
+            })
+        // Faces with three vertices, following the polygons, 3 indices each
+        .def("get_triangles", [](py::object self)
+            {
+                auto& mesh = self.cast<Mesh&>();
+                return flat_view<int>(mesh.triangles.data(), mesh.triangles.size(), 3, self);
+            })
+        .def("get_uv_triangles", [](py::object self)
+            {
+                auto& mesh = self.cast<Mesh&>();
+                return flat_view<int>(mesh.uv_triangles.data(), mesh.uv_triangles.size(), 3,
+                                      self);
+            })
+        .def("get_face_count", &Mesh::get_face_count)
+        .def("memory_footprint", [](const Mesh& mesh) { return to_dict(mesh.memory_footprint()); })
+        // Copy of a float or Vector3 attribute in a compact format, (vertices, components)
+        .def("get_packed_attribute", [](const Mesh& mesh, std::string name, PackedFormat format)
+            {
+                auto it = mesh.attributes.find(name);
+                if (it == mesh.attributes.end())
+                    throw std::invalid_argument("attribute " + name + " doesn't exist");
+                PackedAttribute packed = pack_attribute(*it->second, format);
+                py::dtype dtype = get_packed_dtype(format);
+                py::array array{dtype, {(py::ssize_t)packed.count, (py::ssize_t)packed.components}};
+                std::memcpy(array.mutable_data(), packed.data.data(), packed.data.size());
+                return array;
+            })
+        // Welded interleaved vertex buffer and triangle index buffer, see InterleavedMesh
+        .def("get_interleaved",
+             [](const Mesh& mesh, const std::vector<std::string>& attributes,
+                bool optimize_vertex_cache)
+             {
+                 py::gil_scoped_release release;
+                 return interleave_mesh(mesh, attributes, optimize_vertex_cache);
+             },
+             py::arg("attributes") = std::vector<std::string>{},
+             py::arg("optimize_vertex_cache") = true);
 
-             	int* ptr = (int*)buff.ptr;
-             	for (int i = 0; i < mesh.polygons.size(); i++)
-             	{
-             		for (int j = 0; j < 4; j++)
-             		{
-             			ptr[i * 4 + j] = mesh.polygons[i][j];
-             		}
-             	}
-             	return result;
+    // Vertices are flat views of stride floats per vertex, indices of three uint32 per triangle
+    py::class_<InterleavedMesh>(m, "InterleavedMesh")
+        .def_readonly("stride", &InterleavedMesh::stride)
+        .def_property_readonly("layout", [](const InterleavedMesh& mesh)
+            {
+                py::list layout;
+                for (const auto& element : mesh.layout)
+                    layout.append(py::make_tuple(element.name, element.offset, element.components));
+                return layout;
             })
-        .def("get_uvs", [](const Mesh& mesh)
+        .def("get_vertex_count", &InterleavedMesh::get_vertex_count)
+        .def("get_vertices", [](py::object self)
             {
-                py::array_t<float> result(mesh.uvs.size() * 2);
-                py::buffer_info buff = result.request();
+                auto& mesh = self.cast<InterleavedMesh&>();
+                return flat_view<float>(mesh.vertices.data(), mesh.get_vertex_count(), mesh.stride,
+                                        self);
+            })
+        .def("get_indices", [](py::object self)
+            {
+                auto& mesh = self.cast<InterleavedMesh&>();
+                return flat_view<uint32_t>(mesh.indices.data(), mesh.indices.size() / 3, 3, self);
+            });
 
-                float* ptr = (float*)buff.ptr;
-                for (int i = 0; i < mesh.uvs.size(); i++)
-                {
-                    for (size_t j = 0; j < 2; j++)
-                    {
-                        ptr[i * 2 + j] = mesh.uvs[i][j];
-                    }
-                }
 
-                return result;
-            })
-        .def("get_uv_loops", [](const Mesh& mesh)
+    // Consumers of meshes streamed chunk by chunk by stream_tree and ForestBuilder.stream
+    py::class_<MeshSink>(m, "MeshSink");
+
+    py::class_<MeshBuilderSink, MeshSink>(m, "MeshBuilderSink")
+        .def(py::init<>())
+        .def("get_mesh", [](MeshBuilderSink& sink) { return &sink.mesh; },
+             py::return_value_policy::reference_internal);
+
+    py::class_<BinaryFileSink, MeshSink>(m, "BinaryFileSink")
+        .def(py::init<std::string>())
+        .def_static("read_mesh", &BinaryFileSink::read_mesh,
+                    py::call_guard<py::gil_scoped_release>());
+
+    py::class_<ArraySink, MeshSink>(m, "ArraySink")
+        .def(py::init([](py::object vertices, py::object polygons, py::object uvs,
+                         py::object uv_loops, py::object triangles, py::object uv_triangles,
+                         py::object normals)
             {
-                py::array_t<int> result(mesh.uv_loops.size() * 4);
-                py::buffer_info buff = result.request();
+                auto sink = std::make_unique<ArraySink>();
+                sink->vertices = sink->bind<float>(vertices, 3, sink->capacity.vertices);
+                int normal_count = 0;
+                sink->normals = sink->bind<float>(normals, 3, normal_count);
+                if (sink->normals != nullptr && normal_count != sink->capacity.vertices)
+                    throw std::invalid_argument("normals must have one normal per vertex");
+                sink->polygons = sink->bind<int>(polygons, 4, sink->capacity.polygons);
+                sink->uvs = sink->bind<float>(uvs, 2, sink->capacity.uvs);
+                int uv_loop_count = 0;
+                sink->uv_loops = sink->bind<int>(uv_loops, 4, uv_loop_count);
+                if (sink->uv_loops != nullptr && uv_loop_count != sink->capacity.polygons)
+                    throw std::invalid_argument("uv_loops must have one loop per polygon");
+                sink->triangles = sink->bind<int>(triangles, 3, sink->capacity.triangles);
+                int uv_triangle_count = 0;
+                sink->uv_triangles = sink->bind<int>(uv_triangles, 3, uv_triangle_count);
+                if (sink->uv_triangles != nullptr && uv_triangle_count != sink->capacity.triangles)
+                    throw std::invalid_argument("uv_triangles must have one loop per triangle");
+                return sink;
+            }), py::arg("vertices"), py::arg("polygons"), py::arg("uvs") = py::none(),
+             py::arg("uv_loops") = py::none(), py::arg("triangles") = py::none(),
+             py::arg("uv_triangles") = py::none(), py::arg("normals") = py::none())
+        .def("set_attribute", &ArraySink::set_attribute);
 
-                int* ptr = (int*)buff.ptr;
-                for (int i = 0; i < mesh.uv_loops.size(); i++)
+    // Memory mapped asset files. Sections are read-only (count, components) NumPy views over the
+    // mapping, which the AssetFile python object keeps alive.
+    py::class_<AssetFile>(m, "AssetFile")
+        .def(py::init<std::string>())
+        // attribute_formats maps the exported attributes to their format, None exports every
+        // attribute as is
+        .def_static("write", [](const std::string& path, Tree* tree, const Mesh* mesh,
+                                std::optional<AttributeFormats> attribute_formats)
+            {
+                AssetFile::write(path, tree == nullptr ? nullptr : &tree->get_stems(), mesh,
+                                 attribute_formats ? &*attribute_formats : nullptr);
+            }, py::arg("path"), py::arg("tree") = nullptr, py::arg("mesh") = nullptr,
+            py::arg("attribute_formats") = py::none(), py::call_guard<py::gil_scoped_release>())
+        .def("get_section_names", [](const AssetFile& file)
+            {
+                std::vector<std::string> names;
+                for (const auto& section : file.get_sections())
+                    names.push_back(section.name);
+                return names;
+            })
+        .def("get_section", [](py::object self, const std::string& name)
+            {
+                const AssetFile::Section* section = self.cast<const AssetFile&>().find(name);
+                if (section == nullptr)
+                    throw std::invalid_argument("section " + name + " doesn't exist");
+                py::dtype dtype = py::dtype::of<uint8_t>();
+                switch (section->type)
                 {
-                    for (int j = 0; j < 4; j++)
-                    {
-                        ptr[i * 4 + j] = mesh.uv_loops[i][j];
-                    }
+                case AssetFile::ScalarType::Float32:
+                    dtype = py::dtype::of<float>();
+                    break;
+                case AssetFile::ScalarType::Int32:
+                    dtype = py::dtype::of<int32_t>();
+                    break;
+                case AssetFile::ScalarType::Float16:
+                    dtype = get_packed_dtype(PackedFormat::Float16);
+                    break;
+                case AssetFile::ScalarType::Snorm16:
+                    dtype = get_packed_dtype(PackedFormat::Snorm16);
+                    break;
+                case AssetFile::ScalarType::Snorm8:
+                    dtype = get_packed_dtype(PackedFormat::Snorm8);
+                    break;
+                case AssetFile::ScalarType::UInt16:
+                    dtype = get_packed_dtype(PackedFormat::UInt16);
+                    break;
+                default:
+                    break;
                 }
-                return result;
-            });
+                py::ssize_t item_size = dtype.itemsize();
+                py::array view{dtype,
+                               {(py::ssize_t)section->count, (py::ssize_t)section->components},
+                               {(py::ssize_t)section->components * item_size, item_size},
+                               section->data, self};
+                view.attr("setflags")(py::arg("write") = false);
+                return view;
+            })
+        .def("has_tree", &AssetFile::has_stems)
+        .def("has_mesh", &AssetFile::has_mesh)
+        .def("read_mesh", &AssetFile::read_mesh, py::call_guard<py::gil_scoped_release>())
+        .def("load_tree", [](const AssetFile& file, Tree& tree)
+            {
+                tree.get_stems() = file.read_stems();
+                tree.update_arena();
+            }, py::call_guard<py::gil_scoped_release>());
+
+    py::class_<PivotPainterBranch>(m, "PivotPainterBranch")
+        .def_readonly("stem_id", &PivotPainterBranch::stem_id)
+        .def_readonly("hierarchy_depth", &PivotPainterBranch::hierarchy_depth)
+        .def_property_readonly("pivot_position", [](const PivotPainterBranch& branch)
+            {
+                const Vector3& p = branch.pivot_position;
+                return std::array<float, 3>{p.x(), p.y(), p.z()};
+            })
+        .def_property_readonly("x_vector", [](const PivotPainterBranch& branch)
+            {
+                const Vector3& v = branch.x_vector;
+                return std::array<float, 3>{v.x(), v.y(), v.z()};
+            })
+        .def_readonly("extent", &PivotPainterBranch::extent);
 
+    // Pivot Painter 2.0 baking into NumPy arrays allocated by the caller. Per-vertex inputs are
+    // arrays of the ManifoldMesher attributes, (count, 3) for positions and directions.
+    py::class_<PivotPainterBaker>(m, "PivotPainterBaker")
+        .def(py::init<>())
+        .def_readwrite("texture_size", &PivotPainterBaker::texture_size)
+        .def_readwrite("threads", &PivotPainterBaker::threads)
+        .def("collect_tree_branches", [](const PivotPainterBaker& baker, Tree& tree)
+            {
+                return baker.collect_branches(tree.get_stems());
+            }, py::call_guard<py::gil_scoped_release>())
+        .def("collect_mesh_branches", [](const PivotPainterBaker& baker, FloatArray stem_ids,
+                                         FloatArray hierarchy_depths, FloatArray pivot_positions,
+                                         FloatArray directions, FloatArray extents)
+            {
+                py::gil_scoped_release release;
+                return baker.collect_branches(as_floats(stem_ids), as_floats(hierarchy_depths),
+                                              as_vectors(pivot_positions),
+                                              as_vectors(directions), as_floats(extents));
+            }, py::arg("stem_ids"), py::arg("hierarchy_depths"), py::arg("pivot_positions"),
+            py::arg("directions"), py::arg("extents"))
+        // float32 or float16 arrays of texture_size * texture_size * 4 scalars
+        .def("bake_textures", [](const PivotPainterBaker& baker,
+                                 const std::vector<PivotPainterBranch>& branches,
+                                 py::array pivot_index, py::array xvector_extent)
+            {
+                bool half = pivot_index.dtype().is(get_packed_dtype(PackedFormat::Float16));
+                PackedFormat format = half ? PackedFormat::Float16 : PackedFormat::Float32;
+                py::dtype dtype = get_packed_dtype(format);
+                size_t size = (size_t)baker.texture_size * baker.texture_size * 4;
+                void* pivot_data = get_output_buffer(pivot_index, dtype, size);
+                void* xvector_data = get_output_buffer(xvector_extent, dtype, size);
+                py::gil_scoped_release release;
+                baker.bake_textures(branches, format, pivot_data, xvector_data);
+            }, py::arg("branches"), py::arg("pivot_index"), py::arg("xvector_extent"))
+        // uint8 array of 4 scalars per vertex
+        .def("bake_vertex_colors", [](const PivotPainterBaker& baker,
+                                      const std::vector<PivotPainterBranch>& branches,
+                                      FloatArray stem_ids, py::array colors)
+            {
+                auto* data = static_cast<uint8_t*>(get_output_buffer(
+                    colors, py::dtype::of<uint8_t>(), (size_t)stem_ids.size() * 4));
+                py::gil_scoped_release release;
+                baker.bake_vertex_colors(branches, as_floats(stem_ids), data);
+            }, py::arg("branches"), py::arg("stem_ids"), py::arg("colors"))
+        // float32 array of 2 scalars per vertex
+        .def("bake_lookup_uvs", [](const PivotPainterBaker& baker, FloatArray stem_ids,
+                                   py::array uvs)
+            {
+                auto* data = static_cast<float*>(get_output_buffer(
+                    uvs, py::dtype::of<float>(), (size_t)stem_ids.size() * 2));
+                py::gil_scoped_release release;
+                baker.bake_lookup_uvs(as_floats(stem_ids), data);
+            }, py::arg("stem_ids"), py::arg("uvs"));
 
     py::class_<TreeMesher>(m, "TreeMesher");
 
     py::class_<BasicMesher>(m, "BasicMesher")
         .def(py::init<>())
-        .def("mesh_tree", &BasicMesher::mesh_tree);
+        .def("mesh_tree", &BasicMesher::mesh_tree, py::call_guard<py::gil_scoped_release>())
+        .def("stream_tree", &BasicMesher::stream_tree, py::call_guard<py::gil_scoped_release>());
 
     py::class_<ManifoldMesher>(m, "ManifoldMesher")
         .def(py::init<>())
         .def_readwrite("radial_n_points", &ManifoldMesher::radial_resolution)
         .def_readwrite("smooth_iterations", &ManifoldMesher::smooth_iterations)
-        .def("mesh_tree", &ManifoldMesher::mesh_tree);
+        .def_readwrite("threads", &ManifoldMesher::threads)
+        .def_readwrite("adaptive_resolution", &ManifoldMesher::adaptive_resolution)
+        .def_readwrite("resolution_tolerance", &ManifoldMesher::resolution_tolerance)
+        .def_readwrite("min_radial_n_points", &ManifoldMesher::min_radial_resolution)
+        .def_readwrite("wind_stiffness_scale", &ManifoldMesher::wind_stiffness_scale)
+        .def_readwrite("compute_normals", &ManifoldMesher::compute_normals)
+        .def_readwrite("chunk_vertices", &ManifoldMesher::chunk_vertices)
+        .def_readwrite("attributes", &ManifoldMesher::attributes)
+        .def_static("get_compact_attribute_formats",
+                    &ManifoldMesher::get_compact_attribute_formats)
+        .def("mesh_tree", &ManifoldMesher::mesh_tree, py::call_guard<py::gil_scoped_release>())
+        .def("stream_tree", &ManifoldMesher::stream_tree, py::call_guard<py::gil_scoped_release>())
+        .def("mesh_tree_lods", &ManifoldMesher::mesh_tree_lods, py::arg("tree"),
+             py::arg("tolerances"), py::call_guard<py::gil_scoped_release>());
+
+    py::class_<BranchInstancer>(m, "BranchInstancer")
+        .def(py::init<>())
+        .def_readwrite("max_error", &BranchInstancer::max_error)
+        .def_readwrite("min_nodes", &BranchInstancer::min_nodes)
+        .def_readwrite("min_instances", &BranchInstancer::min_instances)
+        .def_readwrite("threads", &BranchInstancer::threads)
+        .def("mesh_tree", &BranchInstancer::mesh_tree, py::arg("tree"), py::arg("mesher"),
+             py::call_guard<py::gil_scoped_release>());
+
+    // Instance views are (count, components) arrays striding over the instance records
+    py::class_<InstancedTreeMesh>(m, "InstancedTreeMesh")
+        .def_readonly("mesh", &InstancedTreeMesh::mesh)
+        .def_readonly("max_error", &InstancedTreeMesh::max_error)
+        .def("get_prototype_count",
+             [](const InstancedTreeMesh& result) { return result.prototypes.size(); })
+        .def("get_prototype", [](InstancedTreeMesh& result, const int index) -> Mesh&
+            {
+                return result.prototypes.at(index);
+            }, py::return_value_policy::reference_internal)
+        .def("get_instance_count",
+             [](const InstancedTreeMesh& result) { return result.instances.size(); })
+        .def("get_instance_positions", [](py::object self)
+            {
+                return branch_instance_view<float>(self, &BranchInstance::position, 3);
+            })
+        .def("get_instance_rotations", [](py::object self)
+            {
+                return branch_instance_view<float>(self, &BranchInstance::rotation, 4);
+            })
+        .def("get_instance_scales", [](py::object self)
+            {
+                return branch_instance_view<float>(self, &BranchInstance::scale, 1);
+            })
+        .def("get_instance_prototypes", [](py::object self)
+            {
+                return branch_instance_view<int32_t>(self, &BranchInstance::prototype, 1);
+            });
 
 
 #ifdef VERSION_INFO
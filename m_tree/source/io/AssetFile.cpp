@@ -0,0 +1,515 @@
+#include "AssetFile.hpp"
+#include "source/tree/NodeArena.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Mtree
+{
+
+namespace
+{
+using ScalarType = AssetFile::ScalarType;
+
+struct FileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t section_count;
+	uint32_t reserved;
+	uint64_t table_offset;
+	uint64_t file_size;
+};
+static_assert(sizeof(FileHeader) == 32);
+
+struct SectionEntry
+{
+	char name[40]; // null terminated
+	uint32_t type;
+	uint32_t components;
+	uint64_t offset;
+	uint64_t count;
+};
+static_assert(sizeof(SectionEntry) == 64);
+
+static_assert(sizeof(Vector3) == 3 * sizeof(float) && sizeof(Vector2) == 2 * sizeof(float));
+
+size_t get_scalar_size(const ScalarType type)
+{
+	switch (type)
+	{
+	case ScalarType::Bytes:
+	case ScalarType::Snorm8:
+		return 1;
+	case ScalarType::Float16:
+	case ScalarType::Snorm16:
+	case ScalarType::UInt16:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+ScalarType get_scalar_type(const PackedFormat format)
+{
+	switch (format)
+	{
+	case PackedFormat::Float16:
+		return ScalarType::Float16;
+	case PackedFormat::Snorm16:
+		return ScalarType::Snorm16;
+	case PackedFormat::Snorm8:
+		return ScalarType::Snorm8;
+	case PackedFormat::UInt16:
+		return ScalarType::UInt16;
+	default:
+		return ScalarType::Float32;
+	}
+}
+
+// Format of the scalars of a section that read_mesh decodes to floats, false for other sections
+bool get_packed_format(const ScalarType type, PackedFormat& format)
+{
+	switch (type)
+	{
+	case ScalarType::Float32:
+		format = PackedFormat::Float32;
+		return true;
+	case ScalarType::Float16:
+		format = PackedFormat::Float16;
+		return true;
+	case ScalarType::Snorm16:
+		format = PackedFormat::Snorm16;
+		return true;
+	case ScalarType::Snorm8:
+		format = PackedFormat::Snorm8;
+		return true;
+	case ScalarType::UInt16:
+		format = PackedFormat::UInt16;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Section to write, pointing to data that stays alive until the file is written
+struct PendingSection
+{
+	std::string name;
+	ScalarType type;
+	uint32_t components;
+	uint64_t count;
+	const void* data;
+};
+
+template <typename T>
+void add_section(std::vector<PendingSection>& sections, const std::string& name,
+                 const ScalarType type, const uint32_t components, const std::vector<T>& values)
+{
+	sections.push_back(PendingSection{name, type, components, values.size(), values.data()});
+}
+
+// Skeleton of the stems as flat arrays in arena order
+struct SkeletonArrays
+{
+	std::vector<int32_t> stem_roots;
+	std::vector<Vector3> stem_positions;
+	std::vector<int32_t> parents;
+	std::vector<float> positions_in_parent;
+	std::vector<Vector3> positions;
+	std::vector<Vector3> directions;
+	std::vector<Vector3> tangents;
+	std::vector<float> lengths;
+	std::vector<float> radii;
+	std::vector<int32_t> creator_ids;
+
+	SkeletonArrays(std::vector<Stem>& stems)
+	{
+		NodeArena arena;
+		arena.build(stems);
+		for (size_t i = 0; i < stems.size(); i++)
+		{
+			stem_roots.push_back(arena.roots[i]);
+			stem_positions.push_back(stems[i].position);
+		}
+		parents.assign(arena.parent.begin(), arena.parent.end());
+		positions_in_parent = arena.position_in_parent;
+		positions = arena.position;
+		for (int i = 0; i < arena.size(); i++)
+		{
+			const Node& node = arena[i];
+			directions.push_back(node.direction);
+			tangents.push_back(node.tangent);
+			lengths.push_back(node.length);
+			radii.push_back(node.radius);
+			creator_ids.push_back(node.creator_id);
+		}
+	}
+
+	void add_sections(std::vector<PendingSection>& sections) const
+	{
+		add_section(sections, "stem.root", ScalarType::Int32, 1, stem_roots);
+		add_section(sections, "stem.position", ScalarType::Float32, 3, stem_positions);
+		add_section(sections, "node.parent", ScalarType::Int32, 1, parents);
+		add_section(sections, "node.position_in_parent", ScalarType::Float32, 1,
+		            positions_in_parent);
+		add_section(sections, "node.position", ScalarType::Float32, 3, positions);
+		add_section(sections, "node.direction", ScalarType::Float32, 3, directions);
+		add_section(sections, "node.tangent", ScalarType::Float32, 3, tangents);
+		add_section(sections, "node.length", ScalarType::Float32, 1, lengths);
+		add_section(sections, "node.radius", ScalarType::Float32, 1, radii);
+		add_section(sections, "node.creator_id", ScalarType::Int32, 1, creator_ids);
+	}
+};
+
+// Packed attributes are kept in packed until the file is written
+void add_mesh_sections(std::vector<PendingSection>& sections, const Mesh& mesh,
+                       const AttributeFormats* attribute_formats,
+                       std::vector<PackedAttribute>& packed)
+{
+	add_section(sections, "mesh.vertices", ScalarType::Float32, 3, mesh.vertices);
+	add_section(sections, "mesh.uvs", ScalarType::Float32, 2, mesh.uvs);
+	add_section(sections, "mesh.polygons", ScalarType::Int32, 4, mesh.polygons);
+	add_section(sections, "mesh.uv_loops", ScalarType::Int32, 4, mesh.uv_loops);
+	add_section(sections, "mesh.triangles", ScalarType::Int32, 3, mesh.triangles);
+	add_section(sections, "mesh.uv_triangles", ScalarType::Int32, 3, mesh.uv_triangles);
+	if (!mesh.normals.empty())
+		add_section(sections, "mesh.normals", ScalarType::Float32, 3, mesh.normals);
+	if (attribute_formats != nullptr)
+	{
+		packed.reserve(attribute_formats->size());
+		for (auto& [name, format] : *attribute_formats)
+		{
+			auto it = mesh.attributes.find(name);
+			if (it == mesh.attributes.end())
+				continue;
+			packed.push_back(pack_attribute(*it->second, format));
+			sections.push_back(PendingSection{"attribute." + name, get_scalar_type(format),
+			                                  packed.back().components, packed.back().count,
+			                                  packed.back().data.data()});
+		}
+		return;
+	}
+	for (auto& [name, attribute] : mesh.attributes)
+	{
+		ScalarType type = ScalarType::Bytes;
+		uint32_t components = (uint32_t)attribute->get_element_size();
+		if (dynamic_cast<const Attribute<float>*>(attribute.get()) != nullptr)
+		{
+			type = ScalarType::Float32;
+			components = 1;
+		}
+		else if (dynamic_cast<const Attribute<Vector3>*>(attribute.get()) != nullptr)
+		{
+			type = ScalarType::Float32;
+			components = 3;
+		}
+		sections.push_back(PendingSection{"attribute." + name, type, components, attribute->size(),
+		                                  attribute->get_raw_data()});
+	}
+}
+
+uint64_t align(const uint64_t offset)
+{
+	return (offset + AssetFile::alignment - 1) / AssetFile::alignment * AssetFile::alignment;
+}
+} // namespace
+
+size_t AssetFile::Section::get_byte_size() const
+{
+	return (size_t)count * components * get_scalar_size(type);
+}
+
+void AssetFile::write(const std::string& path, std::vector<Stem>* stems, const Mesh* mesh,
+                      const AttributeFormats* attribute_formats)
+{
+	std::vector<PendingSection> sections;
+	std::vector<PackedAttribute> packed;
+	std::unique_ptr<SkeletonArrays> skeleton;
+	if (stems != nullptr)
+	{
+		skeleton = std::make_unique<SkeletonArrays>(*stems);
+		skeleton->add_sections(sections);
+	}
+	if (mesh != nullptr)
+		add_mesh_sections(sections, *mesh, attribute_formats, packed);
+
+	std::vector<SectionEntry> entries(sections.size());
+	uint64_t offset = align(sizeof(FileHeader) + sections.size() * sizeof(SectionEntry));
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		const PendingSection& section = sections[i];
+		if (section.name.size() >= sizeof(SectionEntry::name))
+			throw std::runtime_error("Section name " + section.name + " is too long");
+		SectionEntry& entry = entries[i];
+		std::memset(&entry, 0, sizeof(entry));
+		std::memcpy(entry.name, section.name.data(), section.name.size());
+		entry.type = (uint32_t)section.type;
+		entry.components = section.components;
+		entry.offset = offset;
+		entry.count = section.count;
+		offset = align(offset + section.count * section.components * get_scalar_size(section.type));
+	}
+	FileHeader header{magic, version, (uint32_t)sections.size(), 0, sizeof(FileHeader), offset};
+
+	std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+	if (!stream)
+		throw std::runtime_error("Cannot open " + path + " for writing");
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(reinterpret_cast<const char*>(entries.data()),
+	             entries.size() * sizeof(SectionEntry));
+	const char padding[alignment] = {};
+	uint64_t position = sizeof(FileHeader) + entries.size() * sizeof(SectionEntry);
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		stream.write(padding, entries[i].offset - position);
+		size_t byte_size = sections[i].count * sections[i].components *
+		                   get_scalar_size(sections[i].type);
+		stream.write(static_cast<const char*>(sections[i].data), byte_size);
+		position = entries[i].offset + byte_size;
+	}
+	stream.write(padding, header.file_size - position);
+	if (!stream)
+		throw std::runtime_error("Cannot write to " + path);
+}
+
+AssetFile::AssetFile(const std::string& path) : path(path)
+{
+	map();
+	try
+	{
+		auto invalid = [&](const std::string& reason)
+		{ return std::runtime_error(path + " is not a valid asset file: " + reason); };
+		if (size < sizeof(FileHeader))
+			throw invalid("truncated header");
+		FileHeader header;
+		std::memcpy(&header, data, sizeof(header));
+		if (header.magic != magic)
+			throw invalid("bad magic number");
+		if (header.version != version)
+			throw invalid("unsupported version " + std::to_string(header.version));
+		if (header.table_offset > size ||
+		    (size - header.table_offset) / sizeof(SectionEntry) < header.section_count)
+			throw invalid("truncated section table");
+
+		for (uint32_t i = 0; i < header.section_count; i++)
+		{
+			SectionEntry entry;
+			std::memcpy(&entry, data + header.table_offset + i * sizeof(SectionEntry),
+			            sizeof(entry));
+			if (std::memchr(entry.name, 0, sizeof(entry.name)) == nullptr)
+				throw invalid("unterminated section name");
+			if (entry.type < (uint32_t)ScalarType::Float32 ||
+			    entry.type > (uint32_t)ScalarType::UInt16)
+				throw invalid("unknown type of section " + std::string(entry.name));
+			Section section{entry.name, (ScalarType)entry.type, entry.components, entry.count,
+			                data + entry.offset};
+			uint64_t element_size = (uint64_t)entry.components * get_scalar_size(section.type);
+			if (entry.offset % alignment != 0 || entry.offset > size ||
+			    (element_size > 0 && (size - entry.offset) / element_size < entry.count))
+				throw invalid("section " + section.name + " is out of bounds");
+			sections.push_back(std::move(section));
+		}
+	}
+	catch (...)
+	{
+		unmap();
+		throw;
+	}
+}
+
+AssetFile::~AssetFile() { unmap(); }
+
+const AssetFile::Section* AssetFile::find(const std::string& name) const
+{
+	for (const Section& section : sections)
+		if (section.name == name)
+			return &section;
+	return nullptr;
+}
+
+void AssetFile::check_element_size(const Section& section, const size_t element_size) const
+{
+	if (section.components * get_scalar_size(section.type) != element_size)
+		throw std::runtime_error("Section " + section.name + " of " + path +
+		                         " doesn't have the requested element size");
+}
+
+std::vector<Stem> AssetFile::read_stems() const
+{
+	auto invalid = [&](const std::string& reason)
+	{ return std::runtime_error("Invalid skeleton in " + path + ": " + reason); };
+	auto roots = get<int32_t>("stem.root");
+	auto stem_positions = get<Vector3>("stem.position");
+	auto parents = get<int32_t>("node.parent");
+	auto positions_in_parent = get<float>("node.position_in_parent");
+	auto directions = get<Vector3>("node.direction");
+	auto tangents = get<Vector3>("node.tangent");
+	auto lengths = get<float>("node.length");
+	auto radii = get<float>("node.radius");
+	auto creator_ids = get<int32_t>("node.creator_id");
+
+	size_t node_count = parents.size();
+	for (size_t count : {positions_in_parent.size(), directions.size(), tangents.size(),
+	                     lengths.size(), radii.size(), creator_ids.size()})
+		if (count != node_count)
+			throw invalid("node sections differ in size");
+	if (roots.size() != stem_positions.size())
+		throw invalid("stem sections differ in size");
+
+	std::vector<Stem> stems;
+	stems.reserve(roots.size()); // nodes keep pointers to the stems
+	std::vector<Node*> nodes(node_count);
+	for (size_t i = 0; i < node_count; i++)
+	{
+		Node node{directions[i], tangents[i], lengths[i], radii[i], creator_ids[i]};
+		node.tangent = tangents[i];
+
+		int parent = parents[i];
+		if (parent == NodeArena::none)
+		{
+			if (stems.size() >= roots.size() || roots[stems.size()] != (int32_t)i)
+				throw invalid("roots don't match the parents");
+			stems.push_back(Stem{std::move(node), stem_positions[stems.size()]});
+			nodes[i] = &stems.back().node;
+			continue;
+		}
+		if (parent < 0 || parent >= (int)i)
+			throw invalid("nodes are not in pre-order");
+		auto child =
+		    std::make_shared<NodeChild>(NodeChild{std::move(node), positions_in_parent[i]});
+		nodes[parent]->children.push_back(child);
+		nodes[i] = &child->node;
+	}
+	return stems;
+}
+
+Mesh AssetFile::read_mesh() const
+{
+	auto to_vector = [](auto span) { return std::vector(span.begin(), span.end()); };
+	Mesh mesh;
+	mesh.vertices = to_vector(get<Vector3>("mesh.vertices"));
+	mesh.uvs = to_vector(get<Vector2>("mesh.uvs"));
+	mesh.polygons = to_vector(get<std::array<int, 4>>("mesh.polygons"));
+	mesh.uv_loops = to_vector(get<std::array<int, 4>>("mesh.uv_loops"));
+	mesh.triangles = to_vector(get<std::array<int, 3>>("mesh.triangles"));
+	mesh.uv_triangles = to_vector(get<std::array<int, 3>>("mesh.uv_triangles"));
+	mesh.normals = to_vector(get<Vector3>("mesh.normals"));
+	const std::string prefix = "attribute.";
+	for (const Section& section : sections)
+	{
+		if (section.name.rfind(prefix, 0) != 0)
+			continue;
+		if (section.count != mesh.vertices.size())
+			throw std::runtime_error("Attribute section " + section.name + " of " + path +
+			                         " doesn't have one element per vertex");
+		std::string name = section.name.substr(prefix.size());
+		PackedFormat format;
+		if (!get_packed_format(section.type, format))
+			continue;
+		if (section.type == ScalarType::Float32 && section.components == 1)
+			mesh.add_attribute<float>(name).data = to_vector(get<float>(section.name));
+		else if (section.type == ScalarType::Float32 && section.components == 3)
+			mesh.add_attribute<Vector3>(name).data = to_vector(get<Vector3>(section.name));
+		else if (section.components == 1)
+			mesh.add_attribute<float>(name).data =
+			    unpack_scalars(format, section.data, (size_t)section.count);
+		else if (section.components == 3)
+		{
+			std::vector<float> values =
+			    unpack_scalars(format, section.data, (size_t)section.count * 3);
+			auto& data = mesh.add_attribute<Vector3>(name).data;
+			data.resize((size_t)section.count);
+			for (size_t i = 0; i < data.size(); i++)
+				data[i] = Vector3{values[i * 3], values[i * 3 + 1], values[i * 3 + 2]};
+		}
+	}
+	return mesh;
+}
+
+#ifdef _WIN32
+void AssetFile::map()
+{
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Cannot open " + path);
+	file_handle = file;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		unmap();
+		throw std::runtime_error("Cannot map " + path);
+	}
+	size = (size_t)file_size.QuadPart;
+	mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle != nullptr)
+		data = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr)
+	{
+		unmap();
+		throw std::runtime_error("Cannot map " + path);
+	}
+}
+
+void AssetFile::unmap()
+{
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mapping_handle != nullptr)
+		CloseHandle(mapping_handle);
+	if (file_handle != nullptr)
+		CloseHandle(file_handle);
+	data = nullptr;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+	size = 0;
+}
+#else
+void AssetFile::map()
+{
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		throw std::runtime_error("Cannot open " + path);
+	struct stat status;
+	void* mapping = MAP_FAILED;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+	{
+		size = (size_t)status.st_size;
+		mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	}
+	::close(file); // the mapping keeps the file open
+	if (mapping == MAP_FAILED)
+	{
+		size = 0;
+		throw std::runtime_error("Cannot map " + path);
+	}
+	data = static_cast<const char*>(mapping);
+}
+
+void AssetFile::unmap()
+{
+	if (data != nullptr)
+		munmap(const_cast<char*>(data), size);
+	data = nullptr;
+	size = 0;
+}
+#endif
+
+} // namespace Mtree
@@ -0,0 +1,98 @@
+#pragma once
+#include "source/mesh/AttributePacking.hpp"
+#include "source/mesh/Mesh.hpp"
+#include "source/tree/Node.hpp"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Mtree
+{
+
+// Versioned binary file holding a tree skeleton and/or a mesh as named sections of flat arrays.
+// The file is a 32 byte header, a table of 64 byte section entries, then the sections, each
+// starting on a 64 byte boundary. Opening a file maps it in memory: sections are used in place
+// without being parsed, and are only copied when a Mesh or stems are rebuilt from them.
+//
+// Skeleton sections hold one element per node in the pre-order of NodeArena ("node.parent",
+// "node.direction", ...), plus "stem.root" and "stem.position" per stem. Growth state only lives
+// while a function runs and is not stored; the "growth.*" sections of older files are ignored.
+// Mesh sections are "mesh.vertices", "mesh.uvs", "mesh.polygons", "mesh.uv_loops",
+// "mesh.triangles", "mesh.uv_triangles" (missing from older files), "mesh.normals" (only when the
+// mesh has normals) and one "attribute.<name>" section per attribute. Values are stored in
+// native byte order. Attributes can be exported in a compact format (half floats, snorm or uint16
+// scalars), read_mesh decodes them back to floats.
+class AssetFile
+{
+  public:
+	enum class ScalarType : uint32_t
+	{
+		Float32 = 1,
+		Int32 = 2,
+		Bytes = 3, // records, components is the size of a record
+		Float16 = 4,
+		Snorm16 = 5,
+		Snorm8 = 6,
+		UInt16 = 7,
+	};
+
+	struct Section
+	{
+		std::string name;
+		ScalarType type;
+		uint32_t components;
+		uint64_t count;
+		const void* data;
+
+		size_t get_byte_size() const;
+	};
+
+	static constexpr uint32_t magic = 0x4641544D; // "MTAF"
+	static constexpr uint32_t version = 1;
+	static constexpr size_t alignment = 64;
+
+	// Writes the skeleton of the stems and the mesh, either can be null. Without formats every
+	// attribute is written as is, otherwise only the listed attributes are written, packed.
+	static void write(const std::string& path, std::vector<Stem>* stems, const Mesh* mesh,
+	                  const AttributeFormats* attribute_formats = nullptr);
+
+	// Maps the file, throws when it can't be opened or is not a valid asset file
+	AssetFile(const std::string& path);
+	~AssetFile();
+	AssetFile(const AssetFile&) = delete;
+	AssetFile& operator=(const AssetFile&) = delete;
+
+	const std::vector<Section>& get_sections() const { return sections; }
+	// Null when the file has no section of that name
+	const Section* find(const std::string& name) const;
+	// Elements of a section as T (a scalar, or a packed vector of the section scalars), empty
+	// when the section is missing. Throws when T doesn't match the section layout.
+	template <typename T> std::span<const T> get(const std::string& name) const
+	{
+		const Section* section = find(name);
+		if (section == nullptr)
+			return {};
+		check_element_size(*section, sizeof(T));
+		return {static_cast<const T*>(section->data), (size_t)section->count};
+	}
+
+	bool has_stems() const { return find("node.parent") != nullptr; }
+	bool has_mesh() const { return find("mesh.vertices") != nullptr; }
+	std::vector<Stem> read_stems() const;
+	Mesh read_mesh() const;
+
+  private:
+	std::string path;
+	const char* data = nullptr;
+	size_t size = 0;
+	void* file_handle = nullptr; // platform handles of the mapping
+	void* mapping_handle = nullptr;
+	std::vector<Section> sections;
+
+	void map();
+	void unmap();
+	void check_element_size(const Section& section, const size_t element_size) const;
+};
+
+} // namespace Mtree
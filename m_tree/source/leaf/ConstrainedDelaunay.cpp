@@ -0,0 +1,417 @@
+#include "ConstrainedDelaunay.hpp"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace Mtree
+{
+namespace
+{
+uint64_t edge_key(const int a, const int b) { return ((uint64_t)(uint32_t)a << 32) | (uint32_t)b; }
+} // namespace
+
+bool ConstrainedDelaunay::triangulate(const std::vector<Vector2>& polygon,
+                                      const std::vector<Vector2>& steiner_points)
+{
+	points.clear();
+	triangles.clear();
+	half_edges.clear();
+	segments.clear();
+	constraints.clear();
+	alive_count = 0;
+	set_boundary(polygon);
+	if (boundary_count < 3 || !ear_clip())
+		return false;
+	for (int i = 0; i < boundary_count; i++)
+	{
+		int next = (i + 1) % boundary_count;
+		segments.push_back({i, next});
+		constraints.insert(edge_key(i, next));
+		constraints.insert(edge_key(next, i));
+	}
+
+	// Delaunay but for the polygon edges
+	std::vector<std::pair<int, int>> edges;
+	for (const Triangle& triangle : triangles)
+		for (int k = 0; k < 3; k++)
+			edges.emplace_back(triangle.v[k], triangle.v[(k + 1) % 3]);
+	legalize(std::move(edges));
+
+	double area = 0;
+	for (const Triangle& triangle : triangles)
+	{
+		if (triangle.alive)
+			area += orient(points[triangle.v[0]], points[triangle.v[1]], points[triangle.v[2]]) / 2;
+	}
+	double max_area = area / std::max(target_triangles, 1);
+
+	// Steiner points are kept apart by about the size of the target triangles and use at most half
+	// of the budget, the other half is left for the refinement
+	double spacing = std::sqrt(max_area);
+	for (const Vector2& point : steiner_points)
+	{
+		if (alive_count >= target_triangles / 2)
+			break;
+		insert_point(point, spacing);
+	}
+	refine(max_area);
+	return true;
+}
+
+std::vector<std::array<int, 3>> ConstrainedDelaunay::get_triangles() const
+{
+	std::vector<std::array<int, 3>> result;
+	result.reserve(alive_count);
+	for (const Triangle& triangle : triangles)
+	{
+		if (triangle.alive)
+			result.push_back(triangle.v);
+	}
+	return result;
+}
+
+void ConstrainedDelaunay::set_boundary(const std::vector<Vector2>& polygon)
+{
+	boundary_count = 0;
+	if (polygon.size() < 3)
+		return;
+
+	Vector2 min_bound = polygon[0], max_bound = polygon[0];
+	for (const Vector2& point : polygon)
+	{
+		min_bound = min_bound.cwiseMin(point);
+		max_bound = max_bound.cwiseMax(point);
+	}
+	double scale = std::max((double)(max_bound - min_bound).maxCoeff(), 1e-10);
+	area_epsilon = 1e-12 * scale * scale;
+	circle_epsilon = area_epsilon * scale * scale;
+
+	double min_distance = 1e-7 * scale;
+	for (const Vector2& point : polygon)
+	{
+		if (points.empty() || (point - points.back()).norm() > min_distance)
+			points.push_back(point);
+	}
+	while (points.size() > 1 && (points.back() - points.front()).norm() <= min_distance)
+		points.pop_back();
+
+	double signed_area = 0;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const Vector2& next = points[(i + 1) % points.size()];
+		signed_area += (double)points[i].x() * next.y() - (double)next.x() * points[i].y();
+	}
+	if (signed_area < 0)
+		std::reverse(points.begin(), points.end());
+
+	// collinear points only split polygon edges
+	for (bool removed = true; removed && points.size() >= 3;)
+	{
+		removed = false;
+		for (size_t i = 0; i < points.size() && points.size() >= 3;)
+		{
+			const Vector2& prev = points[(i + points.size() - 1) % points.size()];
+			const Vector2& next = points[(i + 1) % points.size()];
+			if (std::abs(orient(prev, points[i], next)) <= area_epsilon)
+			{
+				points.erase(points.begin() + i);
+				removed = true;
+			}
+			else
+				i++;
+		}
+	}
+	boundary_count = points.size() >= 3 ? (int)points.size() : 0;
+}
+
+bool ConstrainedDelaunay::ear_clip()
+{
+	int n = boundary_count;
+	std::vector<int> prev(n), next(n);
+	for (int i = 0; i < n; i++)
+	{
+		prev[i] = (i + n - 1) % n;
+		next[i] = (i + 1) % n;
+	}
+
+	auto is_ear = [&](const int i)
+	{
+		const Vector2& a = points[prev[i]];
+		const Vector2& b = points[i];
+		const Vector2& c = points[next[i]];
+		if (orient(a, b, c) <= area_epsilon)
+			return false;
+		for (int j = next[next[i]]; j != prev[i]; j = next[j])
+		{
+			const Vector2& p = points[j];
+			if (orient(a, b, p) >= -area_epsilon && orient(b, c, p) >= -area_epsilon &&
+			    orient(c, a, p) >= -area_epsilon)
+				return false;
+		}
+		return true;
+	};
+
+	std::vector<char> ears(n);
+	for (int i = 0; i < n; i++)
+		ears[i] = is_ear(i);
+
+	int remaining = n;
+	int i = 0;
+	for (int visited = 0; remaining > 3;)
+	{
+		if (!ears[i])
+		{
+			i = next[i];
+			if (++visited > remaining) // a full turn without ear, the polygon is not simple
+				return false;
+			continue;
+		}
+		add_triangle(prev[i], i, next[i]);
+		next[prev[i]] = next[i];
+		prev[next[i]] = prev[i];
+		remaining--;
+		ears[prev[i]] = is_ear(prev[i]);
+		ears[next[i]] = is_ear(next[i]);
+		i = next[i];
+		visited = 0;
+	}
+	add_triangle(prev[i], i, next[i]);
+	return true;
+}
+
+int ConstrainedDelaunay::add_triangle(const int a, const int b, const int c)
+{
+	int t = (int)triangles.size();
+	triangles.push_back(Triangle{{a, b, c}});
+	half_edges[edge_key(a, b)] = t;
+	half_edges[edge_key(b, c)] = t;
+	half_edges[edge_key(c, a)] = t;
+	alive_count++;
+	return t;
+}
+
+void ConstrainedDelaunay::remove_triangle(const int t)
+{
+	auto& v = triangles[t].v;
+	half_edges.erase(edge_key(v[0], v[1]));
+	half_edges.erase(edge_key(v[1], v[2]));
+	half_edges.erase(edge_key(v[2], v[0]));
+	triangles[t].alive = false;
+	alive_count--;
+}
+
+int ConstrainedDelaunay::find_triangle(const int a, const int b) const
+{
+	auto it = half_edges.find(edge_key(a, b));
+	return it == half_edges.end() ? -1 : it->second;
+}
+
+int ConstrainedDelaunay::opposite(const int t, const int a, const int b) const
+{
+	for (int vertex : triangles[t].v)
+	{
+		if (vertex != a && vertex != b)
+			return vertex;
+	}
+	return -1;
+}
+
+bool ConstrainedDelaunay::is_constraint(const int a, const int b) const
+{
+	return constraints.contains(edge_key(a, b));
+}
+
+int ConstrainedDelaunay::find_encroached(const Vector2& p) const
+{
+	// inside the diametral circle of a segment, a thin triangle would be left along it
+	for (int s = 0; s < (int)segments.size(); s++)
+	{
+		const Vector2& a = points[segments[s][0]];
+		const Vector2& b = points[segments[s][1]];
+		double dot = ((double)a.x() - p.x()) * ((double)b.x() - p.x()) +
+		             ((double)a.y() - p.y()) * ((double)b.y() - p.y());
+		if (dot < 0)
+			return s;
+	}
+	return -1;
+}
+
+bool ConstrainedDelaunay::split_segment(const int s)
+{
+	auto [a, b] = segments[s];
+	int t = find_triangle(a, b);
+	double length_sq = (points[b] - points[a]).squaredNorm();
+	if (t < 0 || length_sq <= area_epsilon * 1e4)
+		return false;
+	int c = opposite(t, a, b);
+	int m = (int)points.size();
+	points.push_back((points[a] + points[b]) / 2);
+
+	constraints.erase(edge_key(a, b));
+	constraints.erase(edge_key(b, a));
+	for (int vertex : {a, b})
+	{
+		constraints.insert(edge_key(vertex, m));
+		constraints.insert(edge_key(m, vertex));
+	}
+	segments[s] = {a, m};
+	segments.push_back({m, b});
+
+	remove_triangle(t);
+	add_triangle(a, m, c);
+	add_triangle(m, b, c);
+	legalize({{b, c}, {c, a}});
+	return true;
+}
+
+double ConstrainedDelaunay::orient(const Vector2& a, const Vector2& b, const Vector2& c) const
+{
+	return ((double)b.x() - a.x()) * ((double)c.y() - a.y()) -
+	       ((double)b.y() - a.y()) * ((double)c.x() - a.x());
+}
+
+bool ConstrainedDelaunay::in_circle(const int a, const int b, const int c, const int d) const
+{
+	// positive when d is inside the circumcircle of the counter clockwise triangle abc
+	const Vector2& pd = points[d];
+	double adx = (double)points[a].x() - pd.x(), ady = (double)points[a].y() - pd.y();
+	double bdx = (double)points[b].x() - pd.x(), bdy = (double)points[b].y() - pd.y();
+	double cdx = (double)points[c].x() - pd.x(), cdy = (double)points[c].y() - pd.y();
+	double det = (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) +
+	             (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy) +
+	             (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+	return det > circle_epsilon;
+}
+
+void ConstrainedDelaunay::legalize(std::vector<std::pair<int, int>> edges)
+{
+	while (!edges.empty())
+	{
+		auto [a, b] = edges.back();
+		edges.pop_back();
+		if (is_constraint(a, b))
+			continue;
+		int t1 = find_triangle(a, b);
+		int t2 = find_triangle(b, a);
+		if (t1 < 0 || t2 < 0)
+			continue;
+		int c = opposite(t1, a, b);
+		int d = opposite(t2, b, a);
+		if (!in_circle(a, b, c, d))
+			continue;
+		// d inside the circumcircle of abc makes the quad a d b c convex, flip ab into cd
+		remove_triangle(t1);
+		remove_triangle(t2);
+		add_triangle(a, d, c);
+		add_triangle(d, b, c);
+		edges.insert(edges.end(), {{a, d}, {d, b}, {b, c}, {c, a}});
+	}
+}
+
+bool ConstrainedDelaunay::insert_point(const Vector2& p, const double min_distance)
+{
+	if (find_encroached(p) >= 0)
+		return false;
+	int t = -1;
+	for (int i = 0; i < (int)triangles.size() && t < 0; i++)
+	{
+		if (!triangles[i].alive)
+			continue;
+		auto& v = triangles[i].v;
+		if (orient(points[v[0]], points[v[1]], p) > area_epsilon &&
+		    orient(points[v[1]], points[v[2]], p) > area_epsilon &&
+		    orient(points[v[2]], points[v[0]], p) > area_epsilon)
+			t = i;
+	}
+	if (t < 0)
+		return false;
+	auto [a, b, c] = triangles[t].v;
+	for (int vertex : {a, b, c})
+	{
+		if ((points[vertex] - p).norm() < min_distance)
+			return false;
+	}
+
+	int index = (int)points.size();
+	points.push_back(p);
+	remove_triangle(t);
+	add_triangle(a, b, index);
+	add_triangle(b, c, index);
+	add_triangle(c, a, index);
+	legalize({{a, b}, {b, c}, {c, a}});
+	return true;
+}
+
+void ConstrainedDelaunay::refine(const double max_area)
+{
+	constexpr double pi = 3.14159265358979323846;
+	double min_sin = std::sin(std::clamp((double)min_angle, 0.0, 30.0) * pi / 180);
+
+	struct Candidate
+	{
+		double radius_sq;
+		int triangle;
+		// largest circumcircle first, oldest triangle on ties
+		bool operator<(const Candidate& other) const
+		{
+			return radius_sq < other.radius_sq ||
+			       (radius_sq == other.radius_sq && triangle > other.triangle);
+		}
+	};
+	std::priority_queue<Candidate> candidates;
+	size_t scanned = 0;
+	auto add_candidates = [&]()
+	{
+		for (; scanned < triangles.size(); scanned++)
+		{
+			if (!triangles[scanned].alive)
+				continue;
+			auto& v = triangles[scanned].v;
+			const Vector2 &a = points[v[0]], &b = points[v[1]], &c = points[v[2]];
+			double area = orient(a, b, c) / 2;
+			std::array<double, 3> lengths_sq{(double)(b - c).squaredNorm(),
+			                                 (double)(c - a).squaredNorm(),
+			                                 (double)(a - b).squaredNorm()};
+			std::sort(lengths_sq.begin(), lengths_sq.end());
+			// the smallest angle is opposite to the shortest edge
+			double smallest_sin = 2 * area / std::sqrt(lengths_sq[1] * lengths_sq[2]);
+			if (smallest_sin >= min_sin && area <= max_area)
+				continue;
+			double radius_sq =
+			    lengths_sq[0] * lengths_sq[1] * lengths_sq[2] / (16 * area * area);
+			candidates.push(Candidate{radius_sq, (int)scanned});
+		}
+	};
+
+	add_candidates();
+	while (alive_count < target_triangles && !candidates.empty())
+	{
+		Candidate candidate = candidates.top();
+		int t = candidate.triangle;
+		candidates.pop();
+		if (!triangles[t].alive)
+			continue;
+		auto& v = triangles[t].v;
+		const Vector2& a = points[v[0]];
+		double bx = (double)points[v[1]].x() - a.x(), by = (double)points[v[1]].y() - a.y();
+		double cx = (double)points[v[2]].x() - a.x(), cy = (double)points[v[2]].y() - a.y();
+		double d = 2 * (bx * cy - by * cx);
+		double ux = (cy * (bx * bx + by * by) - by * (cx * cx + cy * cy)) / d;
+		double uy = (bx * (cx * cx + cy * cy) - cx * (bx * bx + by * by)) / d;
+		Vector2 center((float)(a.x() + ux), (float)(a.y() + uy));
+		int segment = find_encroached(center);
+		if (segment >= 0)
+		{
+			// the triangle is tried again once the segment is split, unless the split removed it
+			if (split_segment(segment))
+			{
+				candidates.push(candidate);
+				add_candidates();
+			}
+		}
+		else if (insert_point(center, 0))
+			add_candidates();
+	}
+}
+
+} // namespace Mtree
@@ -0,0 +1,77 @@
+#pragma once
+#include "../mesh/Mesh.hpp"
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Mtree
+{
+
+// Constrained Delaunay triangulation of a simple polygon, refined for quality.
+// The polygon is ear clipped, then its inner edges are flipped until the triangulation is
+// Delaunay but for the polygon edges. Interior points are then inserted, the given Steiner points
+// first, then the circumcenters of the triangles that are too thin or too large, largest
+// circumcircle first, each insertion restoring the Delaunay property with edge flips. Polygon edges
+// whose diametral circle would contain a circumcenter are split at their midpoint instead
+// (Ruppert's refinement), so thin triangles along the contour are refined as well.
+class ConstrainedDelaunay
+{
+  public:
+	// Refinement stops once the triangulation has this many triangles
+	int target_triangles = 200;
+	// Triangles with a smaller angle are refined, in degrees (clamped to 30)
+	float min_angle = 25.0f;
+
+	// Triangulates the polygon, returns false when it has less than 3 points or no ear to clip,
+	// which self intersecting polygons can lead to.
+	// Vertices start with the polygon points in counter clockwise order, without the duplicate
+	// and collinear ones. Steiner points outside the polygon or too close to a vertex are skipped.
+	bool triangulate(const std::vector<Vector2>& polygon,
+	                 const std::vector<Vector2>& steiner_points = {});
+
+	const std::vector<Vector2>& get_vertices() const { return points; }
+	// Counter clockwise triangles
+	std::vector<std::array<int, 3>> get_triangles() const;
+	// Number of vertices of the polygon, the first ones. Midpoints splitting its edges come later
+	int get_boundary_count() const { return boundary_count; }
+
+  private:
+	struct Triangle
+	{
+		std::array<int, 3> v;
+		bool alive = true;
+	};
+
+	std::vector<Vector2> points;
+	std::vector<Triangle> triangles;
+	std::unordered_map<uint64_t, int> half_edges; // directed edge a -> b to the triangle holding it
+	std::vector<std::array<int, 2>> segments;     // polygon edges, counter clockwise
+	std::unordered_set<uint64_t> constraints;     // both directions of the segments
+	int boundary_count = 0;
+	int alive_count = 0;
+	double area_epsilon = 0;   // orientations below it count as collinear
+	double circle_epsilon = 0; // in circle tests below it count as cocircular
+
+	void set_boundary(const std::vector<Vector2>& polygon);
+	bool ear_clip();
+	int add_triangle(const int a, const int b, const int c);
+	void remove_triangle(const int t);
+	int find_triangle(const int a, const int b) const;
+	int opposite(const int t, const int a, const int b) const;
+	bool is_constraint(const int a, const int b) const;
+	// Segment whose diametral circle contains p, -1 if none
+	int find_encroached(const Vector2& p) const;
+	// Splits the segment and the triangle along it at its midpoint, false if it is too short
+	bool split_segment(const int s);
+	double orient(const Vector2& a, const Vector2& b, const Vector2& c) const;
+	bool in_circle(const int a, const int b, const int c, const int d) const;
+	void legalize(std::vector<std::pair<int, int>> edges);
+	// Inserts p inside the triangle containing it, false when p is outside the polygon, on an
+	// edge, closer than min_distance to a vertex or encroaching on a segment
+	bool insert_point(const Vector2& p, const double min_distance);
+	void refine(const double max_area);
+};
+
+} // namespace Mtree
@@ -0,0 +1,173 @@
+#include "ImpostorBaker.hpp"
+#include "LeafLODGenerator.hpp"
+#include "source/utilities/Parallel.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+
+namespace Mtree
+{
+
+namespace
+{
+struct ImpostorTriangle
+{
+	std::array<Vector3, 3> corners;
+	Vector3 normal;
+	std::array<uint8_t, 4> albedo;
+};
+
+uint8_t to_unorm8(const float value)
+{
+	return (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255);
+}
+
+void add_triangle(std::vector<ImpostorTriangle>& triangles, const Mesh& mesh, const int a,
+                  const int b, const int c, const std::array<uint8_t, 4>& albedo)
+{
+	const Vector3& p0 = mesh.vertices[a];
+	const Vector3& p1 = mesh.vertices[b];
+	const Vector3& p2 = mesh.vertices[c];
+	Vector3 normal = (p1 - p0).cross(p2 - p0);
+	float length = normal.norm();
+	if (length <= 1e-12f)
+		return; // degenerate, also drops the repeated corner of padded quads
+	triangles.push_back(ImpostorTriangle{{p0, p1, p2}, normal / length, albedo});
+}
+
+// Triangles of the meshes, quads split along their first diagonal
+std::vector<ImpostorTriangle> get_triangles(std::span<const ImpostorMesh> meshes)
+{
+	std::vector<ImpostorTriangle> triangles;
+	for (const ImpostorMesh& item : meshes)
+	{
+		const Mesh& mesh = *item.mesh;
+		std::array<uint8_t, 4> albedo{to_unorm8(item.albedo.x()), to_unorm8(item.albedo.y()),
+		                              to_unorm8(item.albedo.z()), 255};
+		for (const auto& polygon : mesh.polygons)
+		{
+			add_triangle(triangles, mesh, polygon[0], polygon[1], polygon[2], albedo);
+			if (polygon[3] != polygon[2])
+				add_triangle(triangles, mesh, polygon[0], polygon[2], polygon[3], albedo);
+		}
+		for (const auto& triangle : mesh.triangles)
+			add_triangle(triangles, mesh, triangle[0], triangle[1], triangle[2], albedo);
+	}
+	return triangles;
+}
+
+float edge(const Vector2& a, const Vector2& b, const Vector2& p)
+{
+	return (b.x() - a.x()) * (p.y() - a.y()) - (b.y() - a.y()) * (p.x() - a.x());
+}
+
+// Orthographic view of the bounding sphere from direction, rasterized into one tile
+void rasterize_tile(const std::vector<ImpostorTriangle>& triangles, const Vector3& direction,
+                    const int tile_x, const int tile_y, ImpostorAtlas& atlas)
+{
+	Vector3 right = Vector3::UnitZ().cross(direction);
+	if (right.norm() < 1e-4f)
+		right = Vector3::UnitX();
+	right.normalize();
+	Vector3 up = direction.cross(right);
+
+	int tile_size = atlas.tile_size;
+	int atlas_size = atlas.get_size();
+	float scale = tile_size * 0.5f / atlas.radius;
+	auto texel_index = [&](const int x, const int y)
+	{ return (size_t)(tile_y * tile_size + y) * atlas_size + tile_x * tile_size + x; };
+
+	for (const ImpostorTriangle& triangle : triangles)
+	{
+		std::array<Vector2, 3> screen;
+		std::array<float, 3> depth;
+		for (int i = 0; i < 3; i++)
+		{
+			Vector3 local = triangle.corners[i] - atlas.center;
+			screen[i] = Vector2{local.dot(right) * scale + tile_size * 0.5f,
+			                    local.dot(up) * scale + tile_size * 0.5f};
+			depth[i] = (atlas.radius - local.dot(direction)) / (2 * atlas.radius);
+		}
+		float area = edge(screen[0], screen[1], screen[2]);
+		if (std::abs(area) < 1e-9f)
+			continue;
+
+		float min_x = std::min({screen[0].x(), screen[1].x(), screen[2].x()});
+		float max_x = std::max({screen[0].x(), screen[1].x(), screen[2].x()});
+		float min_y = std::min({screen[0].y(), screen[1].y(), screen[2].y()});
+		float max_y = std::max({screen[0].y(), screen[1].y(), screen[2].y()});
+		int x_begin = std::max(0, (int)std::floor(min_x));
+		int x_end = std::min(tile_size - 1, (int)std::ceil(max_x));
+		int y_begin = std::max(0, (int)std::floor(min_y));
+		int y_end = std::min(tile_size - 1, (int)std::ceil(max_y));
+
+		// two sided: normals face the viewer
+		Vector3 normal = triangle.normal.dot(direction) < 0 ? -triangle.normal : triangle.normal;
+		std::array<uint8_t, 4> encoded_normal{to_unorm8(normal.x() * 0.5f + 0.5f),
+		                                      to_unorm8(normal.y() * 0.5f + 0.5f),
+		                                      to_unorm8(normal.z() * 0.5f + 0.5f), 255};
+		for (int y = y_begin; y <= y_end; y++)
+		{
+			for (int x = x_begin; x <= x_end; x++)
+			{
+				Vector2 p{x + 0.5f, y + 0.5f};
+				float w0 = edge(screen[1], screen[2], p) / area;
+				float w1 = edge(screen[2], screen[0], p) / area;
+				float w2 = edge(screen[0], screen[1], p) / area;
+				if (w0 < 0 || w1 < 0 || w2 < 0)
+					continue;
+				float z = w0 * depth[0] + w1 * depth[1] + w2 * depth[2];
+				size_t index = texel_index(x, y);
+				if (z >= atlas.depth[index])
+					continue;
+				atlas.depth[index] = std::max(z, 0.0f);
+				atlas.albedo[index] = triangle.albedo;
+				atlas.normals[index] = encoded_normal;
+			}
+		}
+	}
+}
+} // namespace
+
+ImpostorAtlas ImpostorBaker::bake(std::span<const ImpostorMesh> meshes) const
+{
+	ImpostorAtlas atlas;
+	atlas.resolution = std::max(resolution, 1);
+	atlas.tile_size = std::max(tile_size, 1);
+	size_t texel_count = (size_t)atlas.get_size() * atlas.get_size();
+	atlas.albedo.assign(texel_count, {0, 0, 0, 0});
+	atlas.normals.assign(texel_count, {128, 128, 255, 0});
+	atlas.depth.assign(texel_count, 1.0f);
+
+	std::vector<ImpostorTriangle> triangles = get_triangles(meshes);
+	if (triangles.empty())
+		return atlas;
+
+	Vector3 min = triangles[0].corners[0];
+	Vector3 max = min;
+	for (const auto& triangle : triangles)
+		for (const Vector3& corner : triangle.corners)
+		{
+			min = min.cwiseMin(corner);
+			max = max.cwiseMax(corner);
+		}
+	atlas.center = (min + max) * 0.5f;
+	for (const auto& triangle : triangles)
+		for (const Vector3& corner : triangle.corners)
+			atlas.radius = std::max(atlas.radius, (corner - atlas.center).norm());
+	atlas.radius = std::max(atlas.radius, 1e-6f);
+
+	LeafLODGenerator lod;
+	std::vector<Vector3> directions = lod.get_impostor_view_directions(atlas.resolution);
+	Parallel::parallel_for(
+	    (int)directions.size(),
+	    [&](int i)
+	    {
+		    rasterize_tile(triangles, directions[i], i % atlas.resolution, i / atlas.resolution,
+		                   atlas);
+	    },
+	    threads);
+	return atlas;
+}
+
+} // namespace Mtree
@@ -0,0 +1,47 @@
+#pragma once
+#include "../mesh/Mesh.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Mtree
+{
+
+// Hemi-octahedral impostor atlas of resolution * resolution tiles of tile_size texels. Tile (i, j)
+// shows the meshes seen from LeafLODGenerator::get_impostor_view_directions()[j * resolution + i],
+// framed on their bounding sphere. Texels are stored row by row from the bottom of the atlas.
+struct ImpostorAtlas
+{
+	int resolution = 0;
+	int tile_size = 0;
+	Vector3 center = Vector3::Zero();
+	float radius = 0;
+	std::vector<std::array<uint8_t, 4>> albedo;  // albedo, alpha is the coverage
+	std::vector<std::array<uint8_t, 4>> normals; // world space normal * 0.5 + 0.5, coverage
+	// Distance from the near side of the bounding sphere over its diameter, 1 where uncovered
+	std::vector<float> depth;
+
+	int get_size() const { return resolution * tile_size; }
+};
+
+// Mesh drawn into an impostor with a uniform albedo
+struct ImpostorMesh
+{
+	const Mesh* mesh;
+	Vector3 albedo;
+};
+
+// CPU rasterizer baking the tree and leaf meshes into an impostor atlas, one view tile per
+// parallel task
+class ImpostorBaker
+{
+  public:
+	int resolution = 12; // tiles per side of the atlas
+	int tile_size = 64;  // texels per side of a tile
+	int threads = 1;     // 0 uses every hardware thread
+
+	ImpostorAtlas bake(std::span<const ImpostorMesh> meshes) const;
+};
+
+} // namespace Mtree
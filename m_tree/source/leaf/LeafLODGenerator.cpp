@@ -1,11 +1,200 @@
 #include "LeafLODGenerator.hpp"
+#include "source/utilities/Parallel.hpp"
+#include "source/utilities/RandomGenerator.hpp"
+#include <Eigen/Eigenvalues>
 #include <Eigen/Geometry>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <limits>
 
 namespace Mtree
 {
 
+namespace
+{
+// Number of positions assigned to clusters by a single parallel task
+constexpr int assignment_block_size = 1024;
+
+// Uniform grid over the cluster centers, answering nearest center queries by searching shells of
+// cells around the query
+class CenterGrid
+{
+  public:
+	CenterGrid(const std::vector<Vector3>& centers, const Vector3& min, const Vector3& max)
+	    : centers{centers}, min{min}
+	{
+		float extent = std::max((max - min).maxCoeff(), 1e-6f);
+		cells_per_side = std::max(1, (int)std::ceil(std::cbrt((float)centers.size())));
+		cell_size = extent / cells_per_side;
+		cells.resize((size_t)cells_per_side * cells_per_side * cells_per_side);
+		for (int i = 0; i < (int)centers.size(); i++)
+			cells[get_cell_index(get_cell(centers[i]))].push_back(i);
+	}
+
+	// Closest center, the lowest index on ties
+	int find_nearest(const Vector3& position) const
+	{
+		Eigen::Vector3i cell = get_cell(position);
+		int best = -1;
+		float best_distance = std::numeric_limits<float>::max();
+		for (int shell = 0; shell < cells_per_side; shell++)
+		{
+			// centers of this shell are at least (shell - 1) cells away
+			float bound = (shell - 1) * cell_size;
+			if (best >= 0 && bound > 0 && bound * bound > best_distance)
+				break;
+			for_each_cell_of_shell(cell, shell,
+			                       [&](const int index)
+			                       {
+				                       for (int i : cells[index])
+				                       {
+					                       float distance = (centers[i] - position).squaredNorm();
+					                       if (distance < best_distance ||
+					                           (distance == best_distance && i < best))
+					                       {
+						                       best = i;
+						                       best_distance = distance;
+					                       }
+				                       }
+			                       });
+		}
+		return best;
+	}
+
+  private:
+	const std::vector<Vector3>& centers;
+	Vector3 min;
+	float cell_size;
+	int cells_per_side;
+	std::vector<std::vector<int>> cells;
+
+	Eigen::Vector3i get_cell(const Vector3& position) const
+	{
+		Eigen::Vector3i cell;
+		for (int axis = 0; axis < 3; axis++)
+			cell[axis] = std::clamp((int)((position[axis] - min[axis]) / cell_size), 0,
+			                        cells_per_side - 1);
+		return cell;
+	}
+
+	int get_cell_index(const Eigen::Vector3i& cell) const
+	{
+		return (cell.z() * cells_per_side + cell.y()) * cells_per_side + cell.x();
+	}
+
+	template <typename F>
+	void for_each_cell_of_shell(const Eigen::Vector3i& center, const int shell, F&& f) const
+	{
+		for (int z = center.z() - shell; z <= center.z() + shell; z++)
+			for (int y = center.y() - shell; y <= center.y() + shell; y++)
+				for (int x = center.x() - shell; x <= center.x() + shell; x++)
+				{
+					Eigen::Vector3i cell{x, y, z};
+					if ((cell - center).cwiseAbs().maxCoeff() != shell ||
+					    (cell.array() < 0).any() || (cell.array() >= cells_per_side).any())
+						continue;
+					f(get_cell_index(cell));
+				}
+	}
+};
+
+// k-means++ seeding, then Lloyd iterations. Returns the cluster of every position.
+std::vector<int> cluster_positions(const std::vector<Vector3>& positions, const int cluster_count,
+                                   const BillboardClustering& clustering)
+{
+	Vector3 min = positions[0];
+	Vector3 max = positions[0];
+	for (const auto& p : positions)
+	{
+		min = min.cwiseMin(p);
+		max = max.cwiseMax(p);
+	}
+
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(clustering.seed);
+	std::vector<Vector3> centers{positions[rand_gen.next_u64() % positions.size()]};
+	std::vector<float> distances(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		distances[i] = (positions[i] - centers[0]).squaredNorm();
+	while ((int)centers.size() < cluster_count)
+	{
+		double total = 0;
+		for (float distance : distances)
+			total += distance;
+		if (total <= 0)
+			break; // every position already is a center
+		double target = rand_gen.get_0_1() * total;
+		size_t chosen = 0;
+		for (double sum = distances[0]; sum <= target && chosen + 1 < positions.size();)
+			sum += distances[++chosen];
+		centers.push_back(positions[chosen]);
+		for (size_t i = 0; i < positions.size(); i++)
+			distances[i] = std::min(distances[i], (positions[i] - centers.back()).squaredNorm());
+	}
+
+	std::vector<int> assignment(positions.size(), -1);
+	int block_count = ((int)positions.size() + assignment_block_size - 1) / assignment_block_size;
+	for (int iteration = 0; iteration < std::max(clustering.iterations, 1); iteration++)
+	{
+		CenterGrid grid{centers, min, max};
+		std::atomic<bool> changed{false};
+		Parallel::parallel_for(
+		    block_count,
+		    [&](int block)
+		    {
+			    size_t begin = (size_t)block * assignment_block_size;
+			    size_t end = std::min(positions.size(), begin + assignment_block_size);
+			    for (size_t i = begin; i < end; i++)
+			    {
+				    int cluster = grid.find_nearest(positions[i]);
+				    if (cluster != assignment[i])
+				    {
+					    assignment[i] = cluster;
+					    changed = true;
+				    }
+			    }
+		    },
+		    clustering.threads);
+		if (!changed)
+			break;
+
+		std::vector<Vector3> sums(centers.size(), Vector3::Zero());
+		std::vector<int> counts(centers.size(), 0);
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			sums[assignment[i]] += positions[i];
+			counts[assignment[i]]++;
+		}
+		for (size_t c = 0; c < centers.size(); c++)
+			if (counts[c] > 0)
+				centers[c] = sums[c] / (float)counts[c];
+	}
+	return assignment;
+}
+
+void add_card(Mesh& mesh, const Vector3& center, const Vector3& axis_u, const Vector3& axis_v,
+              const Vector2& min, const Vector2& max)
+{
+	int base_idx = static_cast<int>(mesh.vertices.size());
+	mesh.vertices.push_back(center + axis_u * min.x() + axis_v * min.y());
+	mesh.vertices.push_back(center + axis_u * max.x() + axis_v * min.y());
+	mesh.vertices.push_back(center + axis_u * max.x() + axis_v * max.y());
+	mesh.vertices.push_back(center + axis_u * min.x() + axis_v * max.y());
+
+	mesh.uvs.push_back(Vector2(0.0f, 0.0f));
+	mesh.uvs.push_back(Vector2(1.0f, 0.0f));
+	mesh.uvs.push_back(Vector2(1.0f, 1.0f));
+	mesh.uvs.push_back(Vector2(0.0f, 1.0f));
+
+	mesh.triangles.push_back({base_idx, base_idx + 1, base_idx + 2});
+	mesh.triangles.push_back({base_idx, base_idx + 2, base_idx + 3});
+	mesh.uv_triangles.push_back({base_idx, base_idx + 1, base_idx + 2});
+	mesh.uv_triangles.push_back({base_idx, base_idx + 2, base_idx + 3});
+}
+} // namespace
+
 Mesh LeafLODGenerator::generate_card(const Mesh& source)
 {
 	Mesh card;
@@ -49,15 +238,13 @@ Mesh LeafLODGenerator::generate_card(const Mesh& source)
 	card.uvs.push_back(Vector2(1.0f, 1.0f));
 	card.uvs.push_back(Vector2(0.0f, 1.0f));
 
-	// Two triangles stored as degenerate quads (matching project convention)
-	// Triangle 1: 0, 1, 2, 2
-	card.polygons.push_back({0, 1, 2, 2});
-	// Triangle 2: 0, 2, 3, 3
-	card.polygons.push_back({0, 2, 3, 3});
+	// Two triangles
+	card.triangles.push_back({0, 1, 2});
+	card.triangles.push_back({0, 2, 3});
 
-	// UV loops matching polygons
-	card.uv_loops.push_back({0, 1, 2, 2});
-	card.uv_loops.push_back({0, 2, 3, 3});
+	// UV loops matching triangles
+	card.uv_triangles.push_back({0, 1, 2});
+	card.uv_triangles.push_back({0, 2, 3});
 
 	return card;
 }
@@ -125,12 +312,82 @@ Mesh LeafLODGenerator::generate_billboard_cloud(const std::vector<Vector3>& posi
 		cloud.uvs.push_back(Vector2(1.0f, 1.0f));
 		cloud.uvs.push_back(Vector2(0.0f, 1.0f));
 
-		// Two triangles per quad (degenerate quad format)
-		cloud.polygons.push_back({base_idx, base_idx + 1, base_idx + 2, base_idx + 2});
-		cloud.polygons.push_back({base_idx, base_idx + 2, base_idx + 3, base_idx + 3});
+		// Two triangles per quad
+		cloud.triangles.push_back({base_idx, base_idx + 1, base_idx + 2});
+		cloud.triangles.push_back({base_idx, base_idx + 2, base_idx + 3});
 
-		cloud.uv_loops.push_back({base_idx, base_idx + 1, base_idx + 2, base_idx + 2});
-		cloud.uv_loops.push_back({base_idx, base_idx + 2, base_idx + 3, base_idx + 3});
+		cloud.uv_triangles.push_back({base_idx, base_idx + 1, base_idx + 2});
+		cloud.uv_triangles.push_back({base_idx, base_idx + 2, base_idx + 3});
+	}
+
+	return cloud;
+}
+
+Mesh LeafLODGenerator::generate_billboard_cloud(const std::vector<Vector3>& positions,
+                                                const BillboardClustering& clustering)
+{
+	Mesh cloud;
+	int cards_per_cluster = std::clamp(clustering.cards_per_cluster, 1, 3);
+	int cluster_count = std::min(clustering.card_budget / cards_per_cluster, (int)positions.size());
+	if (cluster_count < 1)
+	{
+		return cloud;
+	}
+
+	std::vector<int> assignment = cluster_positions(positions, cluster_count, clustering);
+	std::vector<std::vector<Vector3>> clusters(cluster_count);
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		clusters[assignment[i]].push_back(positions[i]);
+	}
+
+	for (const auto& cluster : clusters)
+	{
+		if (cluster.empty())
+		{
+			continue;
+		}
+		Vector3 mean = Vector3::Zero();
+		for (const auto& p : cluster)
+		{
+			mean += p;
+		}
+		mean /= static_cast<float>(cluster.size());
+		Eigen::Matrix3f covariance = Eigen::Matrix3f::Zero();
+		for (const auto& p : cluster)
+		{
+			covariance += (p - mean) * (p - mean).transpose();
+		}
+
+		// Principal axes, from the main axis to the normal of the cluster plane
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(covariance);
+		std::array<Vector3, 3> axes{solver.eigenvectors().col(2), solver.eigenvectors().col(1),
+		                            Vector3::Zero()};
+		axes[2] = axes[0].cross(axes[1]).normalized();
+
+		Vector3 min = Vector3::Constant(std::numeric_limits<float>::max());
+		Vector3 max = -min;
+		for (const auto& p : cluster)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float coordinate = (p - mean).dot(axes[axis]);
+				min[axis] = std::min(min[axis], coordinate);
+				max[axis] = std::max(max[axis], coordinate);
+			}
+		}
+		min -= Vector3::Constant(clustering.margin);
+		max += Vector3::Constant(clustering.margin);
+
+		// Cards of the main plane, then of the planes containing the main axis and the normal,
+		// and the secondary axis and the normal
+		const std::array<std::array<int, 2>, 3> card_axes{{{0, 1}, {0, 2}, {1, 2}}};
+		for (int card = 0; card < cards_per_cluster; card++)
+		{
+			auto [u, v] = card_axes[card];
+			add_card(cloud, mean, axes[u], axes[v], Vector2(min[u], min[v]),
+			         Vector2(max[u], max[v]));
+		}
 	}
 
 	return cloud;
@@ -141,30 +398,37 @@ std::vector<Vector3> LeafLODGenerator::get_impostor_view_directions(int resoluti
 	std::vector<Vector3> directions;
 	directions.reserve(resolution * resolution);
 
-	// Generate evenly distributed directions on the upper hemisphere
-	// using spherical coordinates: theta (azimuth) and phi (elevation)
+	// Centers of the tiles of a hemi-octahedral atlas, row by row
 	for (int j = 0; j < resolution; ++j)
 	{
-		// Phi: elevation from the pole (0 = straight up, PI/2 = horizon)
-		// Distribute from nearly straight up to nearly horizontal
-		float phi = static_cast<float>(M_PI) * 0.5f * static_cast<float>(j + 1) /
-		            static_cast<float>(resolution + 1);
-
 		for (int i = 0; i < resolution; ++i)
 		{
-			// Theta: azimuth angle around Y axis
-			float theta = 2.0f * static_cast<float>(M_PI) * static_cast<float>(i) /
-			              static_cast<float>(resolution);
-
-			float x = std::sin(phi) * std::cos(theta);
-			float y = std::sin(phi) * std::sin(theta);
-			float z = std::cos(phi); // Always >= 0 for upper hemisphere
-
-			directions.push_back(Vector3(x, y, z).normalized());
+			Vector2 coordinates{(i + 0.5f) / resolution * 2 - 1, (j + 0.5f) / resolution * 2 - 1};
+			directions.push_back(get_hemi_octahedral_direction(coordinates));
 		}
 	}
 
 	return directions;
 }
 
+Vector3 LeafLODGenerator::get_hemi_octahedral_direction(const Vector2& coordinates)
+{
+	// The square is rotated by 45 degrees so that its corners map to the horizon
+	float x = (coordinates.x() + coordinates.y()) * 0.5f;
+	float y = (coordinates.x() - coordinates.y()) * 0.5f;
+	float z = 1.0f - std::abs(x) - std::abs(y);
+	return Vector3(x, y, std::max(z, 0.0f)).normalized();
+}
+
+Vector2 LeafLODGenerator::get_hemi_octahedral_coordinates(const Vector3& direction)
+{
+	Vector3 d = direction;
+	d.z() = std::abs(d.z());
+	float norm = std::abs(d.x()) + std::abs(d.y()) + d.z();
+	if (norm <= 0.0f)
+		return Vector2::Zero();
+	d /= norm;
+	return Vector2(d.x() + d.y(), d.x() - d.y());
+}
+
 } // namespace Mtree
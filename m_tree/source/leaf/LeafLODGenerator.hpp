@@ -9,6 +9,18 @@
 namespace Mtree
 {
 
+/// Clustered billboard cloud: leaf instances are grouped by k-means and every cluster gets cards
+/// fitted to its principal axes
+struct BillboardClustering
+{
+	int card_budget = 16;      // total number of cards
+	int cards_per_cluster = 2; // 1 to 3: the main plane of the cluster, then perpendicular planes
+	int iterations = 10;       // k-means iterations
+	float margin = 0.05f;      // added on each side of a cluster extent, about half a leaf
+	int seed = 0;
+	int threads = 1; // 0 uses every hardware thread
+};
+
 class LeafLODGenerator
 {
   public:
@@ -21,9 +33,21 @@ class LeafLODGenerator
 	/// Produces num_planes intersecting quads for silhouette coverage.
 	Mesh generate_billboard_cloud(const std::vector<Vector3>& positions, int num_planes = 3);
 
+	/// Generate a billboard cloud from leaf instance positions clustered by k-means. Clusters get
+	/// cards_per_cluster cards sized to their extent, card_budget / cards_per_cluster clusters at
+	/// most.
+	Mesh generate_billboard_cloud(const std::vector<Vector3>& positions,
+	                              const BillboardClustering& clustering);
+
 	/// Get evenly distributed directions on the upper hemisphere.
-	/// Returns resolution * resolution unit vectors for octahedral impostor baking.
+	/// Returns resolution * resolution unit vectors for octahedral impostor baking: the
+	/// direction of tile (i, j) of a hemi-octahedral atlas is at index j * resolution + i.
 	std::vector<Vector3> get_impostor_view_directions(int resolution = 12);
+
+	/// Hemi-octahedral mapping (Z up) between [-1, 1]^2 atlas coordinates and directions of the
+	/// upper hemisphere. Directions below the horizon are mirrored above it.
+	static Vector3 get_hemi_octahedral_direction(const Vector2& coordinates);
+	static Vector2 get_hemi_octahedral_coordinates(const Vector3& direction);
 };
 
 } // namespace Mtree
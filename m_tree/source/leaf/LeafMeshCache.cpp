@@ -0,0 +1,100 @@
+#include "LeafMeshCache.hpp"
+
+namespace Mtree
+{
+LeafMeshCache& LeafMeshCache::get_global()
+{
+	static LeafMeshCache cache;
+	return cache;
+}
+
+Mesh LeafMeshCache::get(const LeafShapeGenerator& generator)
+{
+	uint64_t key = generator.get_fingerprint();
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		auto it = index.find(key);
+		if (it != index.end())
+		{
+			hits++;
+			entries.splice(entries.begin(), entries, it->second);
+			return it->second->mesh->clone();
+		}
+		misses++;
+	}
+
+	// generate without holding the lock, concurrent misses on the same key keep the first mesh
+	LeafShapeGenerator copy = generator;
+	auto mesh = std::make_shared<const Mesh>(copy.generate());
+	Mesh result = mesh->clone();
+
+	std::lock_guard<std::mutex> lock{mutex};
+	if (capacity > 0 && index.find(key) == index.end())
+	{
+		entries.push_front(Entry{key, std::move(mesh)});
+		index[key] = entries.begin();
+		evict();
+	}
+	return result;
+}
+
+bool LeafMeshCache::invalidate(const LeafShapeGenerator& generator)
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	auto it = index.find(generator.get_fingerprint());
+	if (it == index.end())
+		return false;
+	entries.erase(it->second);
+	index.erase(it);
+	return true;
+}
+
+void LeafMeshCache::clear()
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	entries.clear();
+	index.clear();
+	hits = 0;
+	misses = 0;
+}
+
+void LeafMeshCache::set_capacity(int capacity)
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	this->capacity = std::max(capacity, 0);
+	evict();
+}
+
+void LeafMeshCache::evict()
+{
+	while ((int)entries.size() > capacity)
+	{
+		index.erase(entries.back().key);
+		entries.pop_back();
+	}
+}
+
+int LeafMeshCache::get_capacity() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return capacity;
+}
+
+int LeafMeshCache::size() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return (int)entries.size();
+}
+
+int LeafMeshCache::get_hit_count() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return hits;
+}
+
+int LeafMeshCache::get_miss_count() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return misses;
+}
+} // namespace Mtree
@@ -0,0 +1,54 @@
+#pragma once
+#include "../mesh/Mesh.hpp"
+#include "LeafShapeGenerator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace Mtree
+{
+
+// Least recently used cache of generated leaf meshes, keyed by the fingerprint of every
+// LeafShapeGenerator parameter that affects the mesh. Safe to use from several threads.
+class LeafMeshCache
+{
+  public:
+	explicit LeafMeshCache(int capacity = 32) : capacity(std::max(capacity, 0)) {};
+
+	// Process wide cache used by LeafShapeGenerator::generate_cached
+	static LeafMeshCache& get_global();
+
+	// Mesh generated with the parameters of generator, only generated on a miss. The returned
+	// mesh is a deep copy and can be modified freely.
+	Mesh get(const LeafShapeGenerator& generator);
+	// Removes the mesh of these parameters, returns false when it was not cached
+	bool invalidate(const LeafShapeGenerator& generator);
+	void clear();
+
+	void set_capacity(int capacity);
+	int get_capacity() const;
+	int size() const;
+	int get_hit_count() const;
+	int get_miss_count() const;
+
+  private:
+	struct Entry
+	{
+		uint64_t key;
+		std::shared_ptr<const Mesh> mesh;
+	};
+
+	mutable std::mutex mutex;
+	int capacity;
+	int hits = 0;
+	int misses = 0;
+	std::list<Entry> entries; // most recently used first
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+
+	void evict();
+};
+
+} // namespace Mtree
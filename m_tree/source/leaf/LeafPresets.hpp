@@ -20,6 +20,12 @@ enum class VenationType
 	Closed = 1
 };
 
+enum class LeafTriangulation
+{
+	Rings = 0,   // Concentric rings shrinking toward the centroid
+	Delaunay = 1 // Constrained Delaunay with a triangle budget and a minimum angle
+};
+
 struct LeafPreset
 {
 	std::string name;
@@ -1,5 +1,11 @@
 #include "LeafShapeGenerator.hpp"
+#include "ConstrainedDelaunay.hpp"
+#include "LeafMeshCache.hpp"
 #include "VenationGenerator.hpp"
+#include "../utilities/Fingerprint.hpp"
+#include "../utilities/Parallel.hpp"
+#include "../utilities/Profiler.hpp"
+#include "../utilities/RandomGenerator.hpp"
 #include <algorithm>
 #include <cmath>
 #include <limits>
@@ -86,8 +92,9 @@ std::vector<Vector2> LeafShapeGenerator::apply_margin(const std::vector<Vector2>
 		return contour;
 	}
 
-	std::mt19937 rng(asymmetry_seed);
-	std::uniform_real_distribution<float> asym_dist(-0.3f, 0.3f);
+	// each contour point draws its asymmetry from its own stream
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(asymmetry_seed);
 
 	std::vector<Vector2> result;
 	result.reserve(contour.size());
@@ -108,7 +115,8 @@ std::vector<Vector2> LeafShapeGenerator::apply_margin(const std::vector<Vector2>
 
 		float t = theta * static_cast<float>(tooth_count) / TWO_PI;
 		float frac = t - std::floor(t);
-		float asym_offset = (asymmetry_seed != 0) ? asym_dist(rng) : 0.0f;
+		float asym_offset =
+		    (asymmetry_seed != 0) ? 0.3f * rand_gen.derive(i).get_minus_1_1() : 0.0f;
 		float depth = tooth_depth * (1.0f + asym_offset);
 		float mod = 0.0f;
 
@@ -216,11 +224,11 @@ Mesh LeafShapeGenerator::triangulate(const std::vector<Vector2>& contour)
 			int c = ring_offset_inner + i_next;
 			int d = ring_offset_inner + i;
 
-			// Two triangles per quad, stored as degenerate quads
-			mesh.polygons.push_back({a, b, c, c});
-			mesh.uv_loops.push_back({0, 0, 0, 0});
-			mesh.polygons.push_back({a, c, d, d});
-			mesh.uv_loops.push_back({0, 0, 0, 0});
+			// Two triangles per quad
+			mesh.triangles.push_back({a, b, c});
+			mesh.uv_triangles.push_back({0, 0, 0});
+			mesh.triangles.push_back({a, c, d});
+			mesh.uv_triangles.push_back({0, 0, 0});
 		}
 	}
 
@@ -231,13 +239,40 @@ Mesh LeafShapeGenerator::triangulate(const std::vector<Vector2>& contour)
 		int i_next = (i + 1) % n;
 		int a = inner_ring_offset + i;
 		int b = inner_ring_offset + i_next;
-		mesh.polygons.push_back({a, b, centroid_idx, centroid_idx});
-		mesh.uv_loops.push_back({0, 0, 0, 0});
+		mesh.triangles.push_back({a, b, centroid_idx});
+		mesh.uv_triangles.push_back({0, 0, 0});
 	}
 
 	return mesh;
 }
 
+Mesh LeafShapeGenerator::triangulate_delaunay(const std::vector<Vector2>& contour,
+                                              const std::vector<VeinNode>& veins)
+{
+	ConstrainedDelaunay delaunay;
+	delaunay.target_triangles =
+	    target_triangles > 0 ? target_triangles : 3 * static_cast<int>(contour.size());
+	delaunay.min_angle = min_triangle_angle;
+
+	// Vein nodes closer than the triangle size to a vertex are skipped by the triangulator
+	std::vector<Vector2> steiner_points;
+	if (vein_steiner_points)
+	{
+		steiner_points.reserve(veins.size());
+		for (const auto& node : veins)
+			steiner_points.push_back(node.position);
+	}
+
+	Mesh mesh;
+	if (!delaunay.triangulate(contour, steiner_points))
+		return mesh;
+	for (const auto& pt : delaunay.get_vertices())
+		mesh.vertices.push_back(Vector3(pt.x(), pt.y(), 0.0f));
+	mesh.triangles = delaunay.get_triangles();
+	mesh.uv_triangles.resize(mesh.triangles.size());
+	return mesh;
+}
+
 LeafShapeGenerator::BBox2D
 LeafShapeGenerator::compute_contour_bbox(const std::vector<Vector2>& contour) const
 {
@@ -264,21 +299,73 @@ LeafShapeGenerator::compute_contour_bbox(const std::vector<Vector2>& contour) co
 	return bb;
 }
 
-void LeafShapeGenerator::apply_venation(Mesh& mesh, const std::vector<Vector2>& contour)
+static VenationGenerator make_venation(const LeafShapeGenerator& leaf)
+{
+	VenationGenerator venation;
+	venation.type = leaf.venation_type;
+	venation.vein_density = leaf.vein_density;
+	venation.kill_distance = leaf.kill_distance;
+	venation.attraction_distance = leaf.attraction_distance;
+	venation.growth_step_size = leaf.growth_step_size;
+	venation.seed = leaf.seed;
+	venation.threads = leaf.threads;
+	return venation;
+}
+
+std::vector<VeinNode> LeafShapeGenerator::generate_veins(const std::vector<Vector2>& contour)
+{
+	if (!enable_venation)
+		return {};
+	return make_venation(*this).generate_veins(contour);
+}
+
+void LeafShapeGenerator::apply_venation(Mesh& mesh, const std::vector<VeinNode>& veins)
 {
 	if (!enable_venation)
 		return;
+	make_venation(*this).compute_vein_distances(mesh, veins);
+}
 
-	VenationGenerator venation;
-	venation.type = venation_type;
-	venation.vein_density = vein_density;
-	venation.kill_distance = kill_distance;
-	venation.attraction_distance = attraction_distance;
-	venation.growth_step_size = growth_step_size;
-	venation.seed = seed;
-
-	auto veins = venation.generate_veins(contour);
-	venation.compute_vein_distances(mesh, veins);
+std::vector<float>
+LeafShapeGenerator::compute_edge_distances(const std::vector<Vector3>& vertices,
+                                           const std::vector<Vector2>& contour, const BBox2D& bb,
+                                           const float max_distance) const
+{
+	SegmentHash2D segment_hash(std::max(max_distance, std::max(bb.width, bb.height) / 256.0f),
+	                           Vector2(bb.min_x, bb.min_y), Vector2(bb.max_x, bb.max_y));
+	for (size_t ci = 0; ci < contour.size(); ++ci)
+	{
+		const Vector2& next = contour[(ci + 1) % contour.size()];
+		if ((next - contour[ci]).norm() < 1e-10f)
+			continue;
+		segment_hash.insert(static_cast<int>(ci), contour[ci], next);
+	}
+
+	// Vertices further than max_distance from every segment keep a distance of at least
+	// max_distance, the other ones get the exact minimum
+	std::vector<float> distances(vertices.size());
+	Parallel::parallel_for(
+	    static_cast<int>(vertices.size()),
+	    [&](int vi)
+	    {
+		    Vector2 pt(vertices[vi].x(), vertices[vi].y());
+		    float min_dist = max_distance;
+		    segment_hash.for_each_near(
+		        pt, max_distance,
+		        [&](int ci)
+		        {
+			        size_t next = (ci + 1) % contour.size();
+			        Vector2 seg = contour[next] - contour[ci];
+			        float seg_len = seg.norm();
+			        float t =
+			            std::clamp((pt - contour[ci]).dot(seg) / (seg_len * seg_len), 0.0f, 1.0f);
+			        Vector2 closest = contour[ci] + t * seg;
+			        min_dist = std::min(min_dist, (pt - closest).norm());
+		        });
+		    distances[vi] = min_dist;
+	    },
+	    threads);
+	return distances;
 }
 
 void LeafShapeGenerator::apply_deformation(Mesh& mesh, const std::vector<Vector2>& contour)
@@ -290,24 +377,12 @@ void LeafShapeGenerator::apply_deformation(Mesh& mesh, const std::vector<Vector2
 	if (bb.width < 1e-10f || bb.height < 1e-10f)
 		return;
 
-	// Compute min distance to contour edge for each vertex (for edge curl)
-	std::vector<float> edge_distances(mesh.vertices.size(), std::numeric_limits<float>::max());
-	for (size_t vi = 0; vi < mesh.vertices.size(); ++vi)
-	{
-		Vector2 pt(mesh.vertices[vi].x(), mesh.vertices[vi].y());
-		for (size_t ci = 0; ci < contour.size(); ++ci)
-		{
-			size_t next = (ci + 1) % contour.size();
-			Vector2 seg = contour[next] - contour[ci];
-			float seg_len = seg.norm();
-			if (seg_len < 1e-10f)
-				continue;
-			float t = std::clamp((pt - contour[ci]).dot(seg) / (seg_len * seg_len), 0.0f, 1.0f);
-			Vector2 closest = contour[ci] + t * seg;
-			float dist = (pt - closest).norm();
-			edge_distances[vi] = std::min(edge_distances[vi], dist);
-		}
-	}
+	// Edge curl fades out max_curl_dist away from the contour, further distances are all alike
+	float max_edge_dist = bb.width * 0.5f;
+	float max_curl_dist = max_edge_dist * 0.3f;
+	std::vector<float> edge_distances =
+	    edge_curl != 0.0f ? compute_edge_distances(mesh.vertices, contour, bb, max_curl_dist)
+	                      : std::vector<float>(mesh.vertices.size(), max_curl_dist);
 
 	// Apply deformations to Z coordinates
 	for (size_t i = 0; i < mesh.vertices.size(); ++i)
@@ -325,9 +400,7 @@ void LeafShapeGenerator::apply_deformation(Mesh& mesh, const std::vector<Vector2
 		z += cross_curvature * nx * nx * 0.3f;
 
 		// 3. Edge curl: inward curl based on distance from edge
-		float max_edge_dist = bb.width * 0.5f;
-		float edge_factor =
-		    1.0f - std::clamp(edge_distances[i] / (max_edge_dist * 0.3f), 0.0f, 1.0f);
+		float edge_factor = 1.0f - std::clamp(edge_distances[i] / max_curl_dist, 0.0f, 1.0f);
 		z += edge_curl * edge_factor * edge_factor * 0.2f;
 
 		v.z() = z;
@@ -365,21 +438,35 @@ void LeafShapeGenerator::compute_uvs(Mesh& mesh, const std::vector<Vector2>& con
 	}
 
 	// Set UV loops to reference the vertex UVs directly
-	for (size_t i = 0; i < mesh.polygons.size(); ++i)
-	{
-		mesh.uv_loops[i] = mesh.polygons[i]; // UV indices = vertex indices for planar projection
-	}
+	// UV indices = vertex indices for planar projection
+	mesh.uv_loops = mesh.polygons;
+	mesh.uv_triangles = mesh.triangles;
 }
 
 Mesh LeafShapeGenerator::generate()
 {
+	ProfileScope scope{"LeafShapeGenerator"};
 	// Pipeline
 	std::vector<Vector2> contour = sample_contour();
 	contour = apply_margin(contour);
-	Mesh mesh = triangulate(contour);
+	// Veins come first, Delaunay triangulation places vertices along them
+	std::vector<VeinNode> veins;
+	{
+		ProfileScope venation_scope{"venation"};
+		veins = generate_veins(contour);
+	}
+	Mesh mesh;
+	if (triangulation == LeafTriangulation::Delaunay)
+		mesh = triangulate_delaunay(contour, veins);
+	if (mesh.triangles.empty())
+		mesh = triangulate(contour);
 	compute_uvs(mesh, contour);
-	apply_venation(mesh, contour);
+	{
+		ProfileScope venation_scope{"venation"};
+		apply_venation(mesh, veins);
+	}
 	apply_deformation(mesh, contour);
+	scope.add_counter("vertices", (double)mesh.vertices.size());
 
 	// Shift origin to tip of leaf (max Y point on contour)
 	float max_y = -std::numeric_limits<float>::max();
@@ -401,4 +488,41 @@ Mesh LeafShapeGenerator::generate()
 	return mesh;
 }
 
+Mesh LeafShapeGenerator::generate_cached() const { return LeafMeshCache::get_global().get(*this); }
+
+uint64_t LeafShapeGenerator::get_fingerprint() const
+{
+	// threads only changes how the mesh is computed
+	Fingerprint fingerprint;
+	fingerprint.add(m);
+	fingerprint.add(a);
+	fingerprint.add(b);
+	fingerprint.add(n1);
+	fingerprint.add(n2);
+	fingerprint.add(n3);
+	fingerprint.add(aspect_ratio);
+	fingerprint.add(margin_type);
+	fingerprint.add(tooth_count);
+	fingerprint.add(tooth_depth);
+	fingerprint.add(tooth_sharpness);
+	fingerprint.add(asymmetry_seed);
+	fingerprint.add(enable_venation);
+	fingerprint.add(venation_type);
+	fingerprint.add(vein_density);
+	fingerprint.add(kill_distance);
+	fingerprint.add(attraction_distance);
+	fingerprint.add(growth_step_size);
+	fingerprint.add(midrib_curvature);
+	fingerprint.add(cross_curvature);
+	fingerprint.add(vein_displacement);
+	fingerprint.add(edge_curl);
+	fingerprint.add(triangulation);
+	fingerprint.add(target_triangles);
+	fingerprint.add(min_triangle_angle);
+	fingerprint.add(vein_steiner_points);
+	fingerprint.add(contour_resolution);
+	fingerprint.add(seed);
+	return fingerprint.get();
+}
+
 } // namespace Mtree
@@ -1,12 +1,14 @@
 #pragma once
 #include "../mesh/Mesh.hpp"
 #include "LeafPresets.hpp"
-#include <random>
+#include <cstdint>
 #include <vector>
 
 namespace Mtree
 {
 
+struct VeinNode;
+
 class LeafShapeGenerator
 {
   public:
@@ -40,26 +42,46 @@ class LeafShapeGenerator
 	float vein_displacement = 0.0f;
 	float edge_curl = 0.0f;
 
+	// Triangulation
+	LeafTriangulation triangulation = LeafTriangulation::Rings;
+	int target_triangles = 0;         // Delaunay triangle budget, 0 means three per contour point
+	float min_triangle_angle = 25.0f; // Delaunay triangles with a smaller angle are refined
+	bool vein_steiner_points = true;  // Delaunay adds inner vertices along the veins
+
 	// Resolution
 	int contour_resolution = 64;
 	int seed = 42;
+	int threads = 1; // 0 uses every hardware thread
 
 	Mesh generate();
+	// Same mesh as generate, looked up in (or added to) the global LeafMeshCache
+	Mesh generate_cached() const;
+	// Hash of every parameter that affects the generated mesh
+	uint64_t get_fingerprint() const;
+
+	struct BBox2D
+	{
+		float min_x, max_x, min_y, max_y, width, height, center_x;
+	};
+	BBox2D compute_contour_bbox(const std::vector<Vector2>& contour) const;
+	// Distance of every vertex to the closest contour segment, clamped to max_distance. Drives the
+	// edge curl, which fades out max_distance away from the contour.
+	std::vector<float> compute_edge_distances(const std::vector<Vector3>& vertices,
+	                                          const std::vector<Vector2>& contour,
+	                                          const BBox2D& bb, const float max_distance) const;
 
   private:
 	std::vector<Vector2> sample_contour();
 	std::vector<Vector2> apply_margin(const std::vector<Vector2>& contour);
 	Mesh triangulate(const std::vector<Vector2>& contour);
-	void apply_venation(Mesh& mesh, const std::vector<Vector2>& contour);
+	// Empty mesh when the contour is not a simple polygon
+	Mesh triangulate_delaunay(const std::vector<Vector2>& contour,
+	                          const std::vector<VeinNode>& veins);
+	std::vector<VeinNode> generate_veins(const std::vector<Vector2>& contour);
+	void apply_venation(Mesh& mesh, const std::vector<VeinNode>& veins);
 	void apply_deformation(Mesh& mesh, const std::vector<Vector2>& contour);
 	void compute_uvs(Mesh& mesh, const std::vector<Vector2>& contour);
 
-	struct BBox2D
-	{
-		float min_x, max_x, min_y, max_y, width, height, center_x;
-	};
-	BBox2D compute_contour_bbox(const std::vector<Vector2>& contour) const;
-
 	float superformula_radius(float theta, float effective_n1) const;
 };
 
@@ -1,4 +1,5 @@
 #include "VenationGenerator.hpp"
+#include "../utilities/Parallel.hpp"
 #include <algorithm>
 #include <cmath>
 #include <limits>
@@ -6,6 +7,10 @@
 namespace Mtree
 {
 
+// Vein influence falloff width, kVeinFalloffScale * normalized width + kVeinFalloffBase
+constexpr float kVeinFalloffScale = 0.06f;
+constexpr float kVeinFalloffBase = 0.005f;
+
 // =========================================================================
 // SpatialHash2D
 // =========================================================================
@@ -33,44 +38,84 @@ int SpatialHash2D::cell_index(int cx, int cy) const { return cy * grid_width_ +
 void SpatialHash2D::insert(int id, const Vector2& pos)
 {
 	auto [cx, cy] = to_cell(pos);
-	cells_[cell_index(cx, cy)].push_back({id, pos});
+	Cell& cell = cells_[cell_index(cx, cy)];
+	cell.ids.push_back(id);
+	cell.x.push_back(pos.x());
+	cell.y.push_back(pos.y());
 }
 
 std::vector<int> SpatialHash2D::query_radius(const Vector2& center, float radius) const
 {
 	std::vector<int> result;
-	float radius_sq = radius * radius;
+	query_radius(center, radius, result);
+	return result;
+}
+
+void SpatialHash2D::query_radius(const Vector2& center, float radius,
+                                 std::vector<int>& result) const
+{
+	result.clear();
+	for_each_in_radius(center, radius, [&](int id) { result.push_back(id); });
+}
 
+int SpatialHash2D::query_nearest(const Vector2& center, float radius) const
+{
+	int nearest = -1;
+	float nearest_dist_sq = radius * radius;
 	auto [cx_min, cy_min] = to_cell(center - Vector2(radius, radius));
 	auto [cx_max, cy_max] = to_cell(center + Vector2(radius, radius));
-
 	for (int cy = cy_min; cy <= cy_max; ++cy)
 	{
 		for (int cx = cx_min; cx <= cx_max; ++cx)
 		{
-			const auto& cell = cells_[cell_index(cx, cy)];
-			for (const auto& entry : cell)
+			const Cell& cell = cells_[cell_index(cx, cy)];
+			// branch-free scan for the cell minimum, ids are only looked at for the winner
+			float cell_best = std::numeric_limits<float>::max();
+			size_t cell_best_index = 0;
+			for (size_t i = 0; i < cell.ids.size(); ++i)
 			{
-				float dist_sq = (entry.position - center).squaredNorm();
-				if (dist_sq <= radius_sq)
-				{
-					result.push_back(entry.id);
-				}
+				float dx = cell.x[i] - center.x();
+				float dy = cell.y[i] - center.y();
+				float d = dx * dx + dy * dy;
+				cell_best_index = d < cell_best ? i : cell_best_index;
+				cell_best = std::min(cell_best, d);
+			}
+			if (!cell.ids.empty() && cell_best <= nearest_dist_sq &&
+			    (nearest < 0 || cell_best < nearest_dist_sq))
+			{
+				nearest_dist_sq = cell_best;
+				nearest = cell.ids[cell_best_index];
 			}
 		}
 	}
-
-	return result;
+	return nearest;
 }
 
 void SpatialHash2D::clear()
 {
 	for (auto& cell : cells_)
 	{
-		cell.clear();
+		cell.ids.clear();
+		cell.x.clear();
+		cell.y.clear();
 	}
 }
 
+// =========================================================================
+// SegmentHash2D
+// =========================================================================
+
+SegmentHash2D::SegmentHash2D(float cell_size, const Vector2& min_bound, const Vector2& max_bound)
+    : midpoints_(cell_size, min_bound, max_bound)
+{
+}
+
+void SegmentHash2D::insert(int id, const Vector2& a, const Vector2& b)
+{
+	max_half_length_ = std::max(max_half_length_, (b - a).norm() * 0.5f);
+	midpoints_.insert(id, (a + b) * 0.5f);
+}
+
 // =========================================================================
 // VenationGenerator helpers
 // =========================================================================
@@ -171,7 +216,7 @@ void VenationGenerator::compute_pipe_widths(std::vector<VeinNode>& nodes)
 
 std::vector<VenationGenerator::AuxinSource>
 VenationGenerator::generate_auxin_sources(const std::vector<Vector2>& contour,
-                                          std::mt19937& rng) const
+                                          const RandomGenerator& rand_gen) const
 {
 	// Compute contour bounding box
 	Vector2 min_b = contour[0], max_b = contour[0];
@@ -194,13 +239,15 @@ VenationGenerator::generate_auxin_sources(const std::vector<Vector2>& contour,
 
 	auxins.reserve(num_auxins);
 
-	std::uniform_real_distribution<float> dist_x(min_b.x(), max_b.x());
-	std::uniform_real_distribution<float> dist_y(min_b.y(), max_b.y());
-
 	int attempts = 0;
 	while (static_cast<int>(auxins.size()) < num_auxins && attempts < num_auxins * 10)
 	{
-		Vector2 pos(dist_x(rng), dist_y(rng));
+		// every attempt draws from its own stream
+		RandomGenerator attempt_gen = rand_gen.derive(attempts);
+		float x = attempt_gen.get_0_1();
+		float y = attempt_gen.get_0_1();
+		Vector2 pos(min_b.x() + x * (max_b.x() - min_b.x()),
+		            min_b.y() + y * (max_b.y() - min_b.y()));
 		if (point_in_contour(pos, contour))
 		{
 			auxins.push_back({pos, true});
@@ -216,8 +263,9 @@ std::vector<VeinNode> VenationGenerator::generate_veins(const std::vector<Vector
 	if (contour.size() < 3 || vein_density <= 0.0f)
 		return {};
 
-	std::mt19937 rng(seed);
-	auto auxins = generate_auxin_sources(contour, rng);
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(seed);
+	auto auxins = generate_auxin_sources(contour, rand_gen);
 	if (auxins.empty())
 		return {};
 
@@ -271,41 +319,38 @@ std::vector<VeinNode> VenationGenerator::generate_veins(const std::vector<Vector
 	// Effective kill distance: reduced for CLOSED type to allow denser growth
 	float effective_kill = (type == VenationType::Closed) ? kill_distance * 0.5f : kill_distance;
 
+	// Auxin spatial hash, only used to find the auxins reached by new vein nodes
+	SpatialHash2D auxin_hash(std::max(effective_kill, 1e-4f), min_b - pad, max_b + pad);
+	for (size_t ai = 0; ai < auxins.size(); ++ai)
+		auxin_hash.insert(static_cast<int>(ai), auxins[ai].position);
+
+	// Active auxins in generation order, compacted as they get killed
+	std::vector<int> active_auxins(auxins.size());
+	for (size_t ai = 0; ai < auxins.size(); ++ai)
+		active_auxins[ai] = static_cast<int>(ai);
+
+	// Scratch buffers reused between iterations
+	std::vector<Vector2> growth_dirs;
+	std::vector<int> growth_counts;
+	std::vector<int> nearby;
+
 	// Runions iterations
 	for (int iter = 0; iter < max_iterations; ++iter)
 	{
-		// For each vein node with attracted auxins, compute growth direction
-		std::vector<Vector2> growth_dirs(veins.size(), Vector2(0.0f, 0.0f));
-		std::vector<int> growth_counts(veins.size(), 0);
+		if (active_auxins.empty())
+			break;
 
-		int active_auxins = 0;
+		// For each vein node with attracted auxins, compute growth direction
+		growth_dirs.assign(veins.size(), Vector2(0.0f, 0.0f));
+		growth_counts.assign(veins.size(), 0);
 
-		for (const auto& auxin : auxins)
+		for (int ai : active_auxins)
 		{
-			if (!auxin.active)
-				continue;
-			active_auxins++;
-
-			auto candidates = vein_hash.query_radius(auxin.position, attraction_distance);
-			if (candidates.empty())
-				continue;
-
-			// Find nearest vein node
-			int nearest = -1;
-			float nearest_dist_sq = std::numeric_limits<float>::max();
-			for (int vid : candidates)
-			{
-				float d = (veins[vid].position - auxin.position).squaredNorm();
-				if (d < nearest_dist_sq)
-				{
-					nearest_dist_sq = d;
-					nearest = vid;
-				}
-			}
-
+			const Vector2& auxin_position = auxins[ai].position;
+			int nearest = vein_hash.query_nearest(auxin_position, attraction_distance);
 			if (nearest >= 0)
 			{
-				Vector2 dir = auxin.position - veins[nearest].position;
+				Vector2 dir = auxin_position - veins[nearest].position;
 				float len = dir.norm();
 				if (len > 1e-10f)
 				{
@@ -315,9 +360,6 @@ std::vector<VeinNode> VenationGenerator::generate_veins(const std::vector<Vector
 			}
 		}
 
-		if (active_auxins == 0)
-			break;
-
 		// Grow new vein nodes
 		bool any_grew = false;
 		int old_size = static_cast<int>(veins.size());
@@ -342,7 +384,7 @@ std::vector<VeinNode> VenationGenerator::generate_veins(const std::vector<Vector
 			// For CLOSED type: check if close to existing non-ancestor vein (form loops)
 			if (type == VenationType::Closed)
 			{
-				auto nearby = vein_hash.query_radius(new_pos, growth_step_size * 3.0f);
+				vein_hash.query_radius(new_pos, growth_step_size * 3.0f, nearby);
 				bool merged = false;
 				for (int nid : nearby)
 				{
@@ -380,20 +422,12 @@ std::vector<VeinNode> VenationGenerator::generate_veins(const std::vector<Vector
 			break;
 
 		// Kill auxin sources within kill_distance of any new vein node
-		float kill_sq = effective_kill * effective_kill;
 		for (int vi = old_size; vi < static_cast<int>(veins.size()); ++vi)
 		{
-			for (auto& auxin : auxins)
-			{
-				if (!auxin.active)
-					continue;
-				float d = (auxin.position - veins[vi].position).squaredNorm();
-				if (d <= kill_sq)
-				{
-					auxin.active = false;
-				}
-			}
+			auxin_hash.for_each_in_radius(veins[vi].position, effective_kill,
+			                              [&](int ai) { auxins[ai].active = false; });
 		}
+		std::erase_if(active_auxins, [&](int ai) { return !auxins[ai].active; });
 	}
 
 	// Compute pipe model widths
@@ -418,42 +452,93 @@ void VenationGenerator::compute_vein_distances(Mesh& mesh, const std::vector<Vei
 	for (const auto& node : veins)
 		max_width = std::max(max_width, node.width);
 
-	for (size_t vi = 0; vi < mesh.vertices.size(); ++vi)
+	// Every node is a segment to its parent, roots are points
+	Vector2 min_b = veins[0].position, max_b = veins[0].position;
+	for (const auto& node : veins)
 	{
-		Vector2 vpos(mesh.vertices[vi].x(), mesh.vertices[vi].y());
-		float min_dist = std::numeric_limits<float>::max();
-		float max_influence = 0.0f;
-
-		// Check distance to each vein segment
-		for (size_t ni = 0; ni < veins.size(); ++ni)
-		{
-			float d;
-			float w;
-
-			if (veins[ni].parent < 0)
-			{
-				// Root node: check point distance
-				d = (vpos - veins[ni].position).norm();
-				w = veins[ni].width / max_width;
-			}
-			else
-			{
-				d = distance_to_segment(vpos, veins[veins[ni].parent].position, veins[ni].position);
-				// Average width of segment endpoints
-				w = (veins[ni].width + veins[veins[ni].parent].width) * 0.5f / max_width;
-			}
-
-			min_dist = std::min(min_dist, d);
-
-			// Width-aware influence: thicker veins (midrib) get broader, stronger influence
-			float falloff_width = w * 0.06f + 0.005f;
-			float influence = w * std::exp(-d / falloff_width);
-			max_influence = std::max(max_influence, influence);
-		}
+		min_b = min_b.cwiseMin(node.position);
+		max_b = max_b.cwiseMax(node.position);
+	}
+	float cell_size = std::max({kVeinFalloffScale + kVeinFalloffBase, growth_step_size * 4.0f,
+	                            (max_b - min_b).maxCoeff() / 256.0f});
+	SegmentHash2D segment_hash(cell_size, min_b, max_b);
+	for (size_t ni = 0; ni < veins.size(); ++ni)
+	{
+		const VeinNode& start = veins[ni].parent < 0 ? veins[ni] : veins[veins[ni].parent];
+		segment_hash.insert(static_cast<int>(ni), start.position, veins[ni].position);
+	}
 
-		dist_attr.data[vi] = min_dist;
-		influence_attr.data[vi] = max_influence;
+	std::vector<Vector2> vertices(mesh.vertices.size());
+	Vector2 vertex_min = veins[0].position, vertex_max = veins[0].position;
+	for (size_t vi = 0; vi < mesh.vertices.size(); ++vi)
+	{
+		vertices[vi] = Vector2(mesh.vertices[vi].x(), mesh.vertices[vi].y());
+		vertex_min = vertex_min.cwiseMin(vertices[vi]);
+		vertex_max = vertex_max.cwiseMax(vertices[vi]);
 	}
+	// any search radius beyond this one sees every segment
+	float full_radius = (vertex_max.cwiseMax(max_b) - vertex_min.cwiseMin(min_b)).norm();
+
+	Parallel::parallel_for(
+	    static_cast<int>(vertices.size()),
+	    [&](int vi)
+	    {
+		    const Vector2& vpos = vertices[vi];
+		    float min_dist = std::numeric_limits<float>::max();
+		    float max_influence = 0.0f;
+
+		    auto visit_segment = [&](int ni)
+		    {
+			    float d;
+			    float w;
+
+			    if (veins[ni].parent < 0)
+			    {
+				    // Root node: check point distance
+				    d = (vpos - veins[ni].position).norm();
+				    w = veins[ni].width / max_width;
+			    }
+			    else
+			    {
+				    const VeinNode& parent = veins[veins[ni].parent];
+				    d = distance_to_segment(vpos, parent.position, veins[ni].position);
+				    // Average width of segment endpoints
+				    w = (veins[ni].width + parent.width) * 0.5f / max_width;
+			    }
+
+			    min_dist = std::min(min_dist, d);
+
+			    // Width-aware influence: thicker veins (midrib) get broader, stronger influence
+			    float falloff_width = w * kVeinFalloffScale + kVeinFalloffBase;
+			    float influence = w * std::exp(-d / falloff_width);
+			    max_influence = std::max(max_influence, influence);
+		    };
+
+		    // Widen the search until it provably contains the closest segment and the most
+		    // influent one: the influence of segments further than the radius is bounded by that
+		    // of a full width vein at the radius. Minimum and maximum don't depend on the visit
+		    // order so the result is the same as a scan of every segment.
+		    for (float radius = cell_size;; radius *= 2.0f)
+		    {
+			    min_dist = std::numeric_limits<float>::max();
+			    max_influence = 0.0f;
+			    if (radius >= full_radius)
+			    {
+				    for (size_t ni = 0; ni < veins.size(); ++ni)
+					    visit_segment(static_cast<int>(ni));
+				    break;
+			    }
+			    segment_hash.for_each_near(vpos, radius, visit_segment);
+			    float outside_influence =
+			        std::exp(-radius / (kVeinFalloffScale + kVeinFalloffBase));
+			    if (min_dist <= radius && max_influence >= outside_influence)
+				    break;
+		    }
+
+		    dist_attr.data[vi] = min_dist;
+		    influence_attr.data[vi] = max_influence;
+	    },
+	    threads);
 }
 
 } // namespace Mtree
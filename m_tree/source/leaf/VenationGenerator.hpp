@@ -1,39 +1,89 @@
 #pragma once
 #include "../mesh/Mesh.hpp"
 #include "LeafPresets.hpp"
-#include <random>
+#include "../utilities/RandomGenerator.hpp"
+#include <utility>
 #include <vector>
 
 namespace Mtree
 {
 
-// 2D grid spatial hash for O(1) neighbor lookups in bounded domain
+// 2D grid spatial hash for O(1) neighbor lookups in bounded domain.
+// Each cell stores its ids and coordinates as separate arrays so that distance loops over a cell
+// run on contiguous floats, and queries report through callbacks or caller-owned buffers.
 class SpatialHash2D
 {
   public:
-	struct Entry
-	{
-		int id;
-		Vector2 position;
-	};
-
 	SpatialHash2D(float cell_size, const Vector2& min_bound, const Vector2& max_bound);
 
 	void insert(int id, const Vector2& pos);
 	std::vector<int> query_radius(const Vector2& center, float radius) const;
+	// Same as above, reusing the storage of result
+	void query_radius(const Vector2& center, float radius, std::vector<int>& result) const;
+	// Id of the closest point within radius (first inserted on ties), -1 if there is none
+	int query_nearest(const Vector2& center, float radius) const;
 	void clear();
 
+	// Calls f(id) for every point within radius of center, cell by cell in insertion order
+	template <typename F> void for_each_in_radius(const Vector2& center, float radius, F&& f) const
+	{
+		float radius_sq = radius * radius;
+		auto [cx_min, cy_min] = to_cell(center - Vector2(radius, radius));
+		auto [cx_max, cy_max] = to_cell(center + Vector2(radius, radius));
+		for (int cy = cy_min; cy <= cy_max; ++cy)
+		{
+			for (int cx = cx_min; cx <= cx_max; ++cx)
+			{
+				const Cell& cell = cells_[cell_index(cx, cy)];
+				for (size_t i = 0; i < cell.ids.size(); ++i)
+				{
+					float dx = cell.x[i] - center.x();
+					float dy = cell.y[i] - center.y();
+					if (dx * dx + dy * dy <= radius_sq)
+						f(cell.ids[i]);
+				}
+			}
+		}
+	}
+
   private:
+	struct Cell
+	{
+		std::vector<int> ids;
+		std::vector<float> x;
+		std::vector<float> y;
+	};
+
 	float cell_size_;
 	Vector2 min_bound_;
 	int grid_width_ = 0;
 	int grid_height_ = 0;
-	std::vector<std::vector<Entry>> cells_;
+	std::vector<Cell> cells_;
 
 	std::pair<int, int> to_cell(const Vector2& pos) const;
 	int cell_index(int cx, int cy) const;
 };
 
+// Segments binned by their midpoint: a segment is within d of a point only if its midpoint is
+// within d + max_half_length, the half length of the longest segment
+class SegmentHash2D
+{
+  public:
+	SegmentHash2D(float cell_size, const Vector2& min_bound, const Vector2& max_bound);
+
+	void insert(int id, const Vector2& a, const Vector2& b);
+
+	// Calls f(id) for every segment within radius of center, and for some further ones
+	template <typename F> void for_each_near(const Vector2& center, float radius, F&& f) const
+	{
+		midpoints_.for_each_in_radius(center, radius + max_half_length_, std::forward<F>(f));
+	}
+
+  private:
+	SpatialHash2D midpoints_;
+	float max_half_length_ = 0.0f;
+};
+
 struct VeinNode
 {
 	Vector2 position;
@@ -51,6 +101,7 @@ class VenationGenerator
 	float attraction_distance = 0.08f;
 	int max_iterations = 300;
 	int seed = 42;
+	int threads = 1; // threads computing the vein distances, 0 uses every hardware thread
 
 	// Generate vein network within the contour boundary
 	// Returns empty vector if contour has < 3 points or density is 0
@@ -68,7 +119,7 @@ class VenationGenerator
 	};
 
 	std::vector<AuxinSource> generate_auxin_sources(const std::vector<Vector2>& contour,
-	                                                std::mt19937& rng) const;
+	                                                const RandomGenerator& rand_gen) const;
 	bool point_in_contour(const Vector2& point, const std::vector<Vector2>& contour) const;
 	float compute_contour_area(const std::vector<Vector2>& contour) const;
 	void compute_pipe_widths(std::vector<VeinNode>& nodes);
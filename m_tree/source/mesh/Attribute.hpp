@@ -1,6 +1,7 @@
 #pragma once
 #include <array>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 namespace Mtree
@@ -9,6 +10,15 @@ namespace Mtree
 struct AbstractAttribute
 {
 	virtual void add_data() = 0;
+	virtual void resize(const size_t size) = 0;
+	virtual void reserve(const size_t capacity) = 0;
+	virtual std::shared_ptr<AbstractAttribute> clone() const = 0;
+	// Appends the data of other, which must be an attribute of the same type
+	virtual void append(const AbstractAttribute& other) = 0;
+	virtual size_t size() const = 0;
+	virtual size_t get_element_size() const = 0;
+	virtual const void* get_raw_data() const = 0;
+	virtual size_t get_memory_size() const = 0; // bytes of the data
 };
 
 template <typename T> struct Attribute : AbstractAttribute
@@ -19,5 +29,35 @@ template <typename T> struct Attribute : AbstractAttribute
 	Attribute(std::string name) : name{name} {};
 
 	virtual void add_data() { data.emplace_back(); };
+	virtual void resize(const size_t size) { data.resize(size); };
+	virtual void reserve(const size_t capacity) { data.reserve(capacity); };
+	virtual std::shared_ptr<AbstractAttribute> clone() const
+	{
+		return std::make_shared<Attribute<T>>(*this);
+	};
+	virtual void append(const AbstractAttribute& other)
+	{
+		auto& source = dynamic_cast<const Attribute<T>&>(other).data;
+		data.insert(data.end(), source.begin(), source.end());
+	};
+	virtual size_t size() const { return data.size(); };
+	virtual size_t get_element_size() const { return sizeof(T); };
+	virtual const void* get_raw_data() const { return data.data(); };
+	virtual size_t get_memory_size() const { return data.capacity() * sizeof(T); };
+};
+
+// Typed reference to an attribute of a mesh, resolved once instead of looking the attribute up by
+// name for every element. It stays valid while the mesh keeps the attribute, even when its data is
+// resized.
+template <typename T> struct AttributeHandle
+{
+	Attribute<T>* attribute = nullptr;
+
+	AttributeHandle() = default;
+	AttributeHandle(Attribute<T>& attribute) : attribute{&attribute} {};
+
+	bool is_valid() const { return attribute != nullptr; }
+	std::vector<T>& data() const { return attribute->data; }
+	T& operator[](const size_t index) const { return attribute->data[index]; }
 };
 } // namespace Mtree
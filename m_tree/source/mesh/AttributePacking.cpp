@@ -0,0 +1,169 @@
+#include "AttributePacking.hpp"
+#include "Mesh.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace Mtree
+{
+
+namespace
+{
+template <typename T> void write_scalar(std::vector<uint8_t>& data, const size_t index, T value)
+{
+	std::memcpy(data.data() + index * sizeof(T), &value, sizeof(T));
+}
+
+template <typename T> T read_scalar(const void* data, const size_t index)
+{
+	T value;
+	std::memcpy(&value, static_cast<const uint8_t*>(data) + index * sizeof(T), sizeof(T));
+	return value;
+}
+
+template <typename T> T to_snorm(const float value, const float scale)
+{
+	return (T)std::lround(std::clamp(value, -1.f, 1.f) * scale);
+}
+
+uint16_t to_uint16(const float value)
+{
+	float rounded = std::round(value);
+	if (!(rounded >= 0 && rounded <= 65535))
+		throw std::runtime_error("Value " + std::to_string(value) + " doesn't fit in a uint16");
+	return (uint16_t)rounded;
+}
+
+void pack_scalars(const float* values, const size_t scalar_count, PackedAttribute& packed)
+{
+	packed.data.resize(scalar_count * get_packed_scalar_size(packed.format));
+	for (size_t i = 0; i < scalar_count; i++)
+	{
+		switch (packed.format)
+		{
+		case PackedFormat::Float32:
+			write_scalar(packed.data, i, values[i]);
+			break;
+		case PackedFormat::Float16:
+			write_scalar(packed.data, i, float_to_half(values[i]));
+			break;
+		case PackedFormat::Snorm16:
+			write_scalar(packed.data, i, to_snorm<int16_t>(values[i], 32767));
+			break;
+		case PackedFormat::Snorm8:
+			write_scalar(packed.data, i, to_snorm<int8_t>(values[i], 127));
+			break;
+		case PackedFormat::UInt16:
+			write_scalar(packed.data, i, to_uint16(values[i]));
+			break;
+		}
+	}
+}
+} // namespace
+
+size_t get_packed_scalar_size(const PackedFormat format)
+{
+	switch (format)
+	{
+	case PackedFormat::Float16:
+	case PackedFormat::Snorm16:
+	case PackedFormat::UInt16:
+		return 2;
+	case PackedFormat::Snorm8:
+		return 1;
+	default:
+		return 4;
+	}
+}
+
+uint16_t float_to_half(const float value)
+{
+	uint32_t bits = std::bit_cast<uint32_t>(value);
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+	if (magnitude >= 0x7F800000) // infinity or nan, nans stay quiet nans
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+	if (magnitude >= 0x477FF000) // rounds beyond the largest half
+		return sign | 0x7C00;
+	if (magnitude >= 0x38800000) // normal half
+	{
+		uint32_t rebased = magnitude - (112u << 23);
+		return sign | (uint16_t)((rebased + 0xFFF + ((rebased >> 13) & 1)) >> 13);
+	}
+	int exponent = (int)(magnitude >> 23);
+	if (exponent < 102) // below half of the smallest subnormal
+		return sign;
+	uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+	int shift = 126 - exponent;
+	uint32_t result = mantissa >> shift;
+	uint32_t remainder = mantissa & ((1u << shift) - 1);
+	uint32_t halfway = 1u << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (result & 1)))
+		result++;
+	return sign | (uint16_t)result;
+}
+
+float half_to_float(const uint16_t half)
+{
+	float sign = (half & 0x8000) ? -1.f : 1.f;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	if (exponent == 0)
+		return sign * std::ldexp((float)mantissa, -24);
+	uint32_t bits = ((uint32_t)(half & 0x8000) << 16) | (mantissa << 13);
+	bits |= exponent == 0x1F ? 0x7F800000 : (exponent + 112) << 23;
+	return std::bit_cast<float>(bits);
+}
+
+PackedAttribute pack_attribute(const AbstractAttribute& attribute, const PackedFormat format)
+{
+	PackedAttribute packed;
+	packed.format = format;
+	packed.count = attribute.size();
+	if (auto* scalars = dynamic_cast<const Attribute<float>*>(&attribute))
+	{
+		packed.components = 1;
+		pack_scalars(scalars->data.data(), packed.count, packed);
+	}
+	else if (auto* vectors = dynamic_cast<const Attribute<Vector3>*>(&attribute))
+	{
+		packed.components = 3;
+		pack_scalars(vectors->data.empty() ? nullptr : vectors->data[0].data(),
+		             packed.count * 3, packed);
+	}
+	else
+		throw std::runtime_error("Only float and Vector3 attributes can be packed");
+	return packed;
+}
+
+std::vector<float> unpack_scalars(const PackedFormat format, const void* data,
+                                  const size_t scalar_count)
+{
+	std::vector<float> values(scalar_count);
+	for (size_t i = 0; i < scalar_count; i++)
+	{
+		switch (format)
+		{
+		case PackedFormat::Float32:
+			values[i] = read_scalar<float>(data, i);
+			break;
+		case PackedFormat::Float16:
+			values[i] = half_to_float(read_scalar<uint16_t>(data, i));
+			break;
+		case PackedFormat::Snorm16:
+			values[i] = std::max(read_scalar<int16_t>(data, i) / 32767.f, -1.f);
+			break;
+		case PackedFormat::Snorm8:
+			values[i] = std::max(read_scalar<int8_t>(data, i) / 127.f, -1.f);
+			break;
+		case PackedFormat::UInt16:
+			values[i] = (float)read_scalar<uint16_t>(data, i);
+			break;
+		}
+	}
+	return values;
+}
+
+} // namespace Mtree
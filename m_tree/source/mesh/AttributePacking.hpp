@@ -0,0 +1,46 @@
+#pragma once
+#include "Attribute.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Mtree
+{
+
+// Storage formats of exported attributes
+enum class PackedFormat : uint32_t
+{
+	Float32 = 0,
+	Float16 = 1, // IEEE half float
+	Snorm16 = 2, // [-1, 1] mapped to int16, for unit vectors
+	Snorm8 = 3,  // [-1, 1] mapped to int8, for unit vectors
+	UInt16 = 4,  // rounded to uint16, for ids and depths
+};
+
+size_t get_packed_scalar_size(const PackedFormat format);
+
+// Round to nearest even, values beyond the half range become infinities
+uint16_t float_to_half(const float value);
+float half_to_float(const uint16_t half);
+
+// Float or Vector3 attribute converted to another format
+struct PackedAttribute
+{
+	PackedFormat format = PackedFormat::Float32;
+	uint32_t components = 0; // scalars per element
+	size_t count = 0;        // elements
+	std::vector<uint8_t> data;
+};
+
+// Throws when the attribute is neither float nor Vector3, or when a value doesn't fit in a uint16
+PackedAttribute pack_attribute(const AbstractAttribute& attribute, const PackedFormat format);
+// scalar_count scalars of packed data decoded as floats
+std::vector<float> unpack_scalars(const PackedFormat format, const void* data,
+                                  const size_t scalar_count);
+
+// Format of every exported attribute, the attributes it doesn't list are not exported
+using AttributeFormats = std::map<std::string, PackedFormat>;
+
+} // namespace Mtree
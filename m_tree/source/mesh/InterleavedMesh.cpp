@@ -0,0 +1,255 @@
+#include "InterleavedMesh.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace Mtree
+{
+
+namespace
+{
+struct Corner
+{
+	uint32_t vertex;
+	Vector2 uv;
+};
+
+// Corners of the triangles of the mesh, three per triangle
+std::vector<Corner> get_triangle_corners(const Mesh& mesh)
+{
+	auto get_uv = [&](const int index) -> Vector2
+	{ return index >= 0 && index < (int)mesh.uvs.size() ? mesh.uvs[index] : Vector2::Zero(); };
+
+	std::vector<Corner> corners;
+	corners.reserve((mesh.polygons.size() * 2 + mesh.triangles.size()) * 3);
+	auto add_triangle = [&](const int* vertices, const int* uvs, const std::array<int, 3>& order)
+	{
+		for (int k : order)
+			corners.push_back(Corner{(uint32_t)vertices[k], get_uv(uvs ? uvs[k] : -1)});
+	};
+	for (size_t i = 0; i < mesh.polygons.size(); i++)
+	{
+		const auto& polygon = mesh.polygons[i];
+		const int* uvs = i < mesh.uv_loops.size() ? mesh.uv_loops[i].data() : nullptr;
+		add_triangle(polygon.data(), uvs, {0, 1, 2});
+		if (polygon[3] != polygon[2])
+			add_triangle(polygon.data(), uvs, {0, 2, 3});
+	}
+	for (size_t i = 0; i < mesh.triangles.size(); i++)
+	{
+		const int* uvs = i < mesh.uv_triangles.size() ? mesh.uv_triangles[i].data() : nullptr;
+		add_triangle(mesh.triangles[i].data(), uvs, {0, 1, 2});
+	}
+	return corners;
+}
+
+std::vector<Vector3> get_vertex_normals(const Mesh& mesh, const std::vector<Corner>& corners)
+{
+	if (mesh.normals.size() == mesh.vertices.size())
+		return mesh.normals;
+	std::vector<Vector3> normals(mesh.vertices.size(), Vector3::Zero());
+	for (size_t i = 0; i + 2 < corners.size(); i += 3)
+	{
+		const Vector3& a = mesh.vertices[corners[i].vertex];
+		const Vector3& b = mesh.vertices[corners[i + 1].vertex];
+		const Vector3& c = mesh.vertices[corners[i + 2].vertex];
+		Vector3 normal = (b - a).cross(c - a); // its length is twice the area of the triangle
+		for (int k = 0; k < 3; k++)
+			normals[corners[i + k].vertex] += normal;
+	}
+	for (auto& normal : normals)
+	{
+		float length = normal.norm();
+		normal = length > 1e-12f ? Vector3{normal / length} : Vector3::UnitZ();
+	}
+	return normals;
+}
+} // namespace
+
+InterleavedMesh interleave_mesh(const Mesh& mesh, const std::vector<std::string>& attributes,
+                                const bool optimize_vertex_cache)
+{
+	InterleavedMesh result;
+	result.layout = {{"position", 0, 3}, {"normal", 3, 3}, {"uv", 6, 2}};
+	result.stride = 8;
+	std::vector<const float*> attribute_data;
+	for (const auto& name : attributes)
+	{
+		AttributeHandle<float> scalars = mesh.get_attribute<float>(name);
+		AttributeHandle<Vector3> vectors = mesh.get_attribute<Vector3>(name);
+		size_t size = scalars.is_valid() ? scalars.data().size() : 0;
+		if (vectors.is_valid())
+			size = vectors.data().size();
+		if (!scalars.is_valid() && !vectors.is_valid())
+			throw std::invalid_argument("Mesh has no float or Vector3 attribute " + name);
+		if (size != mesh.vertices.size())
+			throw std::invalid_argument("Attribute " + name + " doesn't have one value per vertex");
+		uint32_t components = scalars.is_valid() ? 1 : 3;
+		attribute_data.push_back(scalars.is_valid() ? scalars.data().data()
+		                                            : vectors.data().data()->data());
+		result.layout.push_back({name, result.stride, components});
+		result.stride += components;
+	}
+
+	// Welds the corners sharing a vertex and a uv. Welded vertices are sorted by source vertex.
+	std::vector<Corner> corners = get_triangle_corners(mesh);
+	std::vector<uint32_t> order(corners.size());
+	std::iota(order.begin(), order.end(), 0);
+	auto key = [&](const uint32_t i)
+	{ return std::make_tuple(corners[i].vertex, corners[i].uv.x(), corners[i].uv.y()); };
+	std::sort(order.begin(), order.end(),
+	          [&](const uint32_t a, const uint32_t b) { return key(a) < key(b); });
+	result.indices.resize(corners.size());
+	std::vector<uint32_t> sources; // corner of every welded vertex
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (i == 0 || key(order[i]) != key(order[i - 1]))
+			sources.push_back(order[i]);
+		result.indices[order[i]] = (uint32_t)sources.size() - 1;
+	}
+
+	if (optimize_vertex_cache)
+	{
+		Mtree::optimize_vertex_cache(result.indices, sources.size());
+		// vertices in first use order, so that the vertex fetches follow the triangles
+		std::vector<uint32_t> remap(sources.size(), std::numeric_limits<uint32_t>::max());
+		std::vector<uint32_t> used_sources;
+		used_sources.reserve(sources.size());
+		for (uint32_t& index : result.indices)
+		{
+			if (remap[index] == std::numeric_limits<uint32_t>::max())
+			{
+				remap[index] = (uint32_t)used_sources.size();
+				used_sources.push_back(sources[index]);
+			}
+			index = remap[index];
+		}
+		sources = std::move(used_sources);
+	}
+
+	std::vector<Vector3> normals = get_vertex_normals(mesh, corners);
+	result.vertices.resize(sources.size() * result.stride);
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		const Corner& corner = corners[sources[i]];
+		float* vertex = result.vertices.data() + i * result.stride;
+		const Vector3& position = mesh.vertices[corner.vertex];
+		const Vector3& normal = normals[corner.vertex];
+		std::copy_n(position.data(), 3, vertex);
+		std::copy_n(normal.data(), 3, vertex + 3);
+		std::copy_n(corner.uv.data(), 2, vertex + 6);
+		for (size_t a = 0; a < attribute_data.size(); a++)
+		{
+			const InterleavedElement& element = result.layout[3 + a];
+			std::copy_n(attribute_data[a] + (size_t)corner.vertex * element.components,
+			            element.components, vertex + element.offset);
+		}
+	}
+	return result;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices, const size_t vertex_count,
+                           const int cache_size)
+{
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	// triangles of every vertex as compressed rows
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (uint32_t vertex : indices)
+		offsets[vertex + 1]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+	std::vector<int> live_triangles(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+		live_triangles[v] = (int)(offsets[v + 1] - offsets[v]);
+	std::vector<int> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_ends;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	result.reserve(triangle_count * 3);
+
+	int time = cache_size + 1;
+	size_t cursor = 0;
+	int64_t fanning = indices[0];
+	while (fanning >= 0)
+	{
+		// emits every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++)
+		{
+			uint32_t triangle = adjacency[k];
+			if (emitted[triangle])
+				continue;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				dead_ends.push_back(vertex);
+				candidates.push_back(vertex);
+				live_triangles[vertex]--;
+				if (time - cache_time[vertex] > cache_size)
+					cache_time[vertex] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// next fanning vertex: the oldest candidate that stays in the cache while fanning
+		fanning = -1;
+		int best_priority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (live_triangles[vertex] <= 0)
+				continue;
+			int priority = 0;
+			if (time - cache_time[vertex] + 2 * live_triangles[vertex] <= cache_size)
+				priority = time - cache_time[vertex];
+			if (priority > best_priority)
+			{
+				best_priority = priority;
+				fanning = vertex;
+			}
+		}
+		// dead end: the most recent vertex with triangles left, else the next one in order
+		while (fanning < 0 && !dead_ends.empty())
+		{
+			uint32_t vertex = dead_ends.back();
+			dead_ends.pop_back();
+			if (live_triangles[vertex] > 0)
+				fanning = vertex;
+		}
+		for (; fanning < 0 && cursor < vertex_count; cursor++)
+			if (live_triangles[cursor] > 0)
+				fanning = (int64_t)cursor;
+	}
+	indices = std::move(result);
+}
+
+float get_average_cache_miss_ratio(const std::vector<uint32_t>& indices, const size_t vertex_count,
+                                   const int cache_size)
+{
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return 0;
+	// miss count when each vertex entered the cache: the FIFO still holds it while fewer than
+	// cache_size misses followed
+	std::vector<int64_t> entered(vertex_count, std::numeric_limits<int64_t>::min() / 2);
+	int64_t misses = 0;
+	for (uint32_t vertex : indices)
+	{
+		if (misses - entered[vertex] >= cache_size)
+			entered[vertex] = misses++;
+	}
+	return (float)misses / triangle_count;
+}
+
+} // namespace Mtree
@@ -0,0 +1,47 @@
+#pragma once
+#include "Mesh.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Mtree
+{
+
+// Element of the vertices of an InterleavedMesh, offset and components are counted in floats
+struct InterleavedElement
+{
+	std::string name;
+	uint32_t offset = 0;
+	uint32_t components = 0;
+};
+
+// Welded mesh with a single interleaved vertex buffer and a triangle index buffer, laid out so
+// that engines can upload it as is. Corners sharing a vertex and a uv become one vertex, uv
+// seams split vertices.
+struct InterleavedMesh
+{
+	std::vector<InterleavedElement> layout; // position, normal, uv, then the attributes
+	uint32_t stride = 0;                    // floats per vertex
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices; // three per triangle
+
+	size_t get_vertex_count() const { return stride == 0 ? 0 : vertices.size() / stride; }
+};
+
+// Quads are split along their first diagonal. Normals are the ones of the mesh when it has one
+// per vertex, area weighted face normals otherwise. attributes are float or Vector3 attributes of
+// the mesh, throws when one is missing. When optimize_vertex_cache is set, triangles are ordered
+// for the post transform vertex cache and vertices by first use.
+InterleavedMesh interleave_mesh(const Mesh& mesh, const std::vector<std::string>& attributes = {},
+                                const bool optimize_vertex_cache = true);
+
+// Tipsify (Sander et al. 2007): reorders the triangles of indices for a vertex cache of
+// cache_size entries, fanning around recently used vertices
+void optimize_vertex_cache(std::vector<uint32_t>& indices, const size_t vertex_count,
+                           const int cache_size = 16);
+
+// Vertex cache misses per triangle of a FIFO cache of cache_size entries
+float get_average_cache_miss_ratio(const std::vector<uint32_t>& indices, const size_t vertex_count,
+                                   const int cache_size = 16);
+
+} // namespace Mtree
@@ -21,10 +21,68 @@ int Mesh::add_vertex(const Vector3& position)
 	}
 	return (int)vertices.size() - 1;
 }
+void Mesh::reserve(const size_t vertex_count, const size_t polygon_count,
+                   const size_t triangle_count)
+{
+	vertices.reserve(vertex_count);
+	for (auto& attribute : attributes)
+	{
+		attribute.second->reserve(vertex_count);
+	}
+	polygons.reserve(polygon_count);
+	uv_loops.reserve(polygon_count);
+	triangles.reserve(triangle_count);
+	uv_triangles.reserve(triangle_count);
+}
+
+void Mesh::resize(const size_t vertex_count, const size_t polygon_count,
+                  const size_t triangle_count)
+{
+	vertices.resize(vertex_count);
+	for (auto& attribute : attributes)
+	{
+		attribute.second->resize(vertex_count);
+	}
+	polygons.resize(polygon_count);
+	uv_loops.resize(polygon_count);
+	triangles.resize(triangle_count);
+	uv_triangles.resize(triangle_count);
+}
+
 int Mesh::add_polygon()
 {
 	polygons.emplace_back();
 	uv_loops.emplace_back();
 	return (int)polygons.size() - 1;
 }
+
+int Mesh::add_triangle()
+{
+	triangles.emplace_back();
+	uv_triangles.emplace_back();
+	return (int)triangles.size() - 1;
+}
+
+MemoryFootprint Mesh::memory_footprint() const
+{
+	MemoryFootprint footprint;
+	footprint.add("vertices", get_capacity_bytes(vertices));
+	footprint.add("normals", get_capacity_bytes(normals));
+	footprint.add("uvs", get_capacity_bytes(uvs));
+	footprint.add("polygons", get_capacity_bytes(polygons));
+	footprint.add("uv_loops", get_capacity_bytes(uv_loops));
+	footprint.add("triangles", get_capacity_bytes(triangles));
+	footprint.add("uv_triangles", get_capacity_bytes(uv_triangles));
+	for (const auto& [name, attribute] : attributes)
+		footprint.add("attributes/" + name, attribute->get_memory_size());
+	return footprint;
+}
+
+Mesh Mesh::clone() const
+{
+	Mesh copy = *this;
+	for (auto& [name, attribute] : copy.attributes)
+		attribute = attribute->clone();
+	return copy;
+}
 } // namespace Mtree
@@ -1,5 +1,6 @@
 #pragma once
 #include "Attribute.hpp"
+#include "source/utilities/MemoryFootprint.hpp"
 #include <Eigen/Core>
 #include <array>
 #include <map>
@@ -22,8 +23,13 @@ class Mesh
 	std::vector<Vector3> vertices;
 	std::vector<Vector3> normals;
 	std::vector<Vector2> uvs;
+	// Quads, triangles among them repeating their last vertex
 	std::vector<std::array<int, 4>> polygons;
 	std::vector<std::array<int, 4>> uv_loops;
+	// Faces with three vertices, following the polygons. Meshes made of triangles only (leaves,
+	// cards) keep them here instead of padding them to quads.
+	std::vector<std::array<int, 3>> triangles;
+	std::vector<std::array<int, 3>> uv_triangles;
 	std::map<std::string, std::shared_ptr<AbstractAttribute>> attributes;
 
 	Mesh() {};
@@ -32,11 +38,35 @@ class Mesh
 	std::vector<std::array<int, 4>> get_polygons() { return this->polygons; };
 	int add_vertex(const Vector3& position);
 	int add_polygon();
+	int add_triangle();
+	// Polygons and triangles
+	size_t get_face_count() const { return polygons.size() + triangles.size(); }
+	// Bytes of each buffer, then of each attribute under "attributes/<name>"
+	MemoryFootprint memory_footprint() const;
+	// Copy that doesn't share its attributes with this mesh (plain copies share them)
+	Mesh clone() const;
+	// Reserves capacity for vertices (and their attributes), polygons and triangles (and their uv
+	// loops)
+	void reserve(const size_t vertex_count, const size_t polygon_count,
+	             const size_t triangle_count = 0);
+	// Sizes vertices, attributes, polygons, triangles and uv loops so meshers can write to them by
+	// index
+	void resize(const size_t vertex_count, const size_t polygon_count,
+	            const size_t triangle_count = 0);
 	template <class T> Attribute<T>& add_attribute(std::string name)
 	{
 		auto attribute = std::make_shared<Attribute<T>>(name);
 		attributes[name] = attribute;
 		return *attribute;
 	};
+	// Handle to an existing attribute, invalid when the mesh has no attribute of that name and type
+	template <class T> AttributeHandle<T> get_attribute(const std::string& name) const
+	{
+		auto it = attributes.find(name);
+		if (it == attributes.end())
+			return {};
+		auto* attribute = dynamic_cast<Attribute<T>*>(it->second.get());
+		return attribute == nullptr ? AttributeHandle<T>{} : AttributeHandle<T>{*attribute};
+	};
 };
 } // namespace Mtree
@@ -0,0 +1,257 @@
+#include "MeshSink.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Mtree
+{
+
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be tightly packed");
+static_assert(sizeof(Vector2) == 2 * sizeof(float), "Vector2 must be tightly packed");
+
+namespace
+{
+template <typename T> void append(std::vector<T>& destination, const std::vector<T>& source)
+{
+	destination.insert(destination.end(), source.begin(), source.end());
+}
+
+template <typename T> void write_value(std::ofstream& stream, const T& value)
+{
+	stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T> void write_vector(std::ofstream& stream, const std::vector<T>& values)
+{
+	stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T> T read_value(std::ifstream& stream)
+{
+	T value;
+	stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return value;
+}
+
+template <typename T> void read_vector(std::ifstream& stream, std::vector<T>& values, int count)
+{
+	values.resize(count);
+	stream.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+}
+
+template <typename T>
+void read_attribute(std::ifstream& stream, Mesh& mesh, const std::string& name, int count)
+{
+	read_vector(stream, mesh.add_attribute<T>(name).data, count);
+}
+} // namespace
+
+void offset_indices(Mesh& mesh, const int vertex_offset, const int uv_offset)
+{
+	for (auto& polygon : mesh.polygons)
+		for (int& index : polygon)
+			index += vertex_offset;
+	for (auto& uv_loop : mesh.uv_loops)
+		for (int& index : uv_loop)
+			index += uv_offset;
+	for (auto& triangle : mesh.triangles)
+		for (int& index : triangle)
+			index += vertex_offset;
+	for (auto& uv_triangle : mesh.uv_triangles)
+		for (int& index : uv_triangle)
+			index += uv_offset;
+}
+
+void MeshBuilderSink::begin(const MeshCounts& counts)
+{
+	mesh = Mesh{};
+	mesh.reserve(counts.vertices, counts.polygons, counts.triangles);
+	mesh.uvs.reserve(counts.uvs);
+}
+
+void MeshBuilderSink::write(const MeshChunk& chunk)
+{
+	size_t previous_vertex_count = mesh.vertices.size();
+	append(mesh.vertices, chunk.mesh.vertices);
+	append(mesh.normals, chunk.mesh.normals);
+	append(mesh.uvs, chunk.mesh.uvs);
+	append(mesh.polygons, chunk.mesh.polygons);
+	append(mesh.uv_loops, chunk.mesh.uv_loops);
+	append(mesh.triangles, chunk.mesh.triangles);
+	append(mesh.uv_triangles, chunk.mesh.uv_triangles);
+	for (auto& [name, attribute] : chunk.mesh.attributes)
+	{
+		auto it = mesh.attributes.find(name);
+		if (it == mesh.attributes.end())
+		{
+			// attribute first met in this chunk, the previous vertices get default values
+			auto added = attribute->clone();
+			added->resize(0);
+			added->resize(previous_vertex_count);
+			it = mesh.attributes.emplace(name, added).first;
+		}
+		it->second->append(*attribute);
+	}
+	for (auto& [name, attribute] : mesh.attributes)
+		attribute->resize(mesh.vertices.size());
+}
+
+BinaryFileSink::BinaryFileSink(const std::string& path) : path(path) {}
+
+void BinaryFileSink::begin(const MeshCounts& counts)
+{
+	stream.open(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+		throw std::runtime_error("Cannot open " + path + " for writing");
+	write_value(stream, magic);
+	write_value(stream, version);
+	// patched with the actual totals once the last chunk is written
+	write_value(stream, counts);
+	written = MeshCounts{};
+}
+
+void BinaryFileSink::write(const MeshChunk& chunk)
+{
+	const Mesh& mesh = chunk.mesh;
+	write_value(stream, (int32_t)mesh.vertices.size());
+	write_value(stream, (int32_t)mesh.uvs.size());
+	write_value(stream, (int32_t)mesh.polygons.size());
+	write_value(stream, (int32_t)mesh.triangles.size());
+	write_value(stream, (int32_t)mesh.attributes.size());
+	write_value(stream, (int32_t)mesh.normals.size());
+	write_vector(stream, mesh.vertices);
+	write_vector(stream, mesh.uvs);
+	write_vector(stream, mesh.polygons);
+	write_vector(stream, mesh.uv_loops);
+	write_vector(stream, mesh.triangles);
+	write_vector(stream, mesh.uv_triangles);
+	write_vector(stream, mesh.normals);
+	for (auto& [name, attribute] : mesh.attributes)
+	{
+		write_value(stream, (uint32_t)name.size());
+		stream.write(name.data(), name.size());
+		write_value(stream, (uint32_t)attribute->get_element_size());
+		stream.write(static_cast<const char*>(attribute->get_raw_data()),
+		             attribute->size() * attribute->get_element_size());
+	}
+	if (!stream)
+		throw std::runtime_error("Cannot write to " + path);
+	written.vertices += (int)mesh.vertices.size();
+	written.uvs += (int)mesh.uvs.size();
+	written.polygons += (int)mesh.polygons.size();
+	written.triangles += (int)mesh.triangles.size();
+}
+
+void BinaryFileSink::end()
+{
+	write_value(stream, (int32_t)-1); // end of the chunks
+	stream.seekp(2 * sizeof(uint32_t));
+	write_value(stream, written);
+	stream.close();
+	if (!stream)
+		throw std::runtime_error("Cannot write to " + path);
+}
+
+Mesh BinaryFileSink::read_mesh(const std::string& path)
+{
+	std::ifstream stream{path, std::ios::binary};
+	if (!stream)
+		throw std::runtime_error("Cannot open " + path);
+	if (read_value<uint32_t>(stream) != magic)
+		throw std::runtime_error(path + " is not a mesh stream");
+	uint32_t file_version = read_value<uint32_t>(stream);
+	if (file_version < 2 || file_version > version)
+		throw std::runtime_error(path + " is a mesh stream of unsupported version " +
+		                         std::to_string(file_version));
+
+	MeshBuilderSink builder;
+	builder.begin(read_value<MeshCounts>(stream));
+	while (true)
+	{
+		int32_t vertex_count = read_value<int32_t>(stream);
+		if (!stream || vertex_count < 0)
+			break;
+		int32_t uv_count = read_value<int32_t>(stream);
+		int32_t polygon_count = read_value<int32_t>(stream);
+		int32_t triangle_count = read_value<int32_t>(stream);
+		int32_t attribute_count = read_value<int32_t>(stream);
+		int32_t normal_count = file_version >= 3 ? read_value<int32_t>(stream) : 0;
+		Mesh mesh;
+		read_vector(stream, mesh.vertices, vertex_count);
+		read_vector(stream, mesh.uvs, uv_count);
+		read_vector(stream, mesh.polygons, polygon_count);
+		read_vector(stream, mesh.uv_loops, polygon_count);
+		read_vector(stream, mesh.triangles, triangle_count);
+		read_vector(stream, mesh.uv_triangles, triangle_count);
+		read_vector(stream, mesh.normals, normal_count);
+		for (int i = 0; i < attribute_count; i++)
+		{
+			std::string name(read_value<uint32_t>(stream), '\0');
+			stream.read(name.data(), name.size());
+			uint32_t element_size = read_value<uint32_t>(stream);
+			if (element_size == sizeof(float))
+				read_attribute<float>(stream, mesh, name, vertex_count);
+			else if (element_size == sizeof(Vector3))
+				read_attribute<Vector3>(stream, mesh, name, vertex_count);
+			else
+				stream.ignore((std::streamsize)element_size * vertex_count);
+		}
+		if (!stream)
+			throw std::runtime_error(path + " is truncated");
+		builder.write(MeshChunk{mesh, (int)builder.mesh.vertices.size(),
+		                        (int)builder.mesh.uvs.size(), (int)builder.mesh.polygons.size(),
+		                        (int)builder.mesh.triangles.size()});
+	}
+	return std::move(builder.mesh);
+}
+
+void BufferSink::write(const MeshChunk& chunk)
+{
+	const Mesh& mesh = chunk.mesh;
+	auto fits = [](const int offset, const size_t size, const int capacity)
+	{ return offset >= 0 && (size_t)offset + size <= (size_t)capacity; };
+	// null buffers skip their channel
+	auto fits_buffer = [&](const void* buffer, const int offset, const size_t size,
+	                       const int capacity)
+	{ return buffer == nullptr || fits(offset, size, capacity); };
+	// attribute channels are sized like the vertices
+	auto has_buffer = [](auto& entry) { return entry.second.data != nullptr; };
+	bool writes_vertices = vertices != nullptr || normals != nullptr ||
+	                       std::any_of(attributes.begin(), attributes.end(), has_buffer);
+	if ((writes_vertices && !fits(chunk.vertex_offset, mesh.vertices.size(), capacity.vertices)) ||
+	    !fits_buffer(uvs, chunk.uv_offset, mesh.uvs.size(), capacity.uvs) ||
+	    !fits_buffer(polygons, chunk.polygon_offset, mesh.polygons.size(), capacity.polygons) ||
+	    !fits_buffer(uv_loops, chunk.polygon_offset, mesh.uv_loops.size(), capacity.polygons) ||
+	    !fits_buffer(triangles, chunk.triangle_offset, mesh.triangles.size(),
+	                 capacity.triangles) ||
+	    !fits_buffer(uv_triangles, chunk.triangle_offset, mesh.uv_triangles.size(),
+	                 capacity.triangles))
+		throw std::runtime_error("Mesh chunk doesn't fit in the sink buffers");
+
+	auto copy = [](auto* destination, const int offset, const auto& source, const int components)
+	{
+		if (destination != nullptr)
+			std::memcpy(destination + (size_t)offset * components, source.data(),
+			            source.size() * sizeof(source[0]));
+	};
+	copy(vertices, chunk.vertex_offset, mesh.vertices, 3);
+	copy(normals, chunk.vertex_offset, mesh.normals, 3);
+	copy(uvs, chunk.uv_offset, mesh.uvs, 2);
+	copy(polygons, chunk.polygon_offset, mesh.polygons, 4);
+	copy(uv_loops, chunk.polygon_offset, mesh.uv_loops, 4);
+	copy(triangles, chunk.triangle_offset, mesh.triangles, 3);
+	copy(uv_triangles, chunk.triangle_offset, mesh.uv_triangles, 3);
+	for (auto& [name, buffer] : attributes)
+	{
+		auto it = mesh.attributes.find(name);
+		if (it == mesh.attributes.end() || buffer.data == nullptr)
+			continue;
+		const AbstractAttribute& attribute = *it->second;
+		if (attribute.get_element_size() != buffer.element_size)
+			throw std::runtime_error("Attribute " + name + " doesn't match its sink buffer");
+		std::memcpy(static_cast<char*>(buffer.data) + chunk.vertex_offset * buffer.element_size,
+		            attribute.get_raw_data(), attribute.size() * buffer.element_size);
+	}
+}
+
+} // namespace Mtree
@@ -0,0 +1,114 @@
+#pragma once
+#include "Mesh.hpp"
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace Mtree
+{
+
+// Number of elements a mesher will emit for a tree
+struct MeshCounts
+{
+	int vertices = 0;
+	int uvs = 0;
+	int polygons = 0;
+	int triangles = 0;
+};
+
+// Contiguous part of a streamed mesh: its vertices, uvs, polygons and triangles come right after
+// the ones of the previous chunks, at the given offsets. Faces and uv loops index the whole mesh.
+struct MeshChunk
+{
+	const Mesh& mesh;
+	int vertex_offset;
+	int uv_offset;
+	int polygon_offset;
+	int triangle_offset = 0;
+};
+
+// Shifts the faces and uv loops of a mesh so that it can be written as a chunk starting at the
+// given vertex and uv offsets
+void offset_indices(Mesh& mesh, const int vertex_offset, const int uv_offset);
+
+// Consumer of a mesh streamed in chunks, so that the whole mesh never has to be held in memory:
+// meshers build each chunk once the previous one is written. Chunks are written in order, from the
+// thread that called the mesher.
+class MeshSink
+{
+  public:
+	virtual ~MeshSink() = default;
+
+	// Called before the first chunk with the counts of the whole mesh, all zero when unknown
+	virtual void begin(const MeshCounts&) {}
+	virtual void write(const MeshChunk& chunk) = 0;
+	// Called after the last chunk
+	virtual void end() {}
+};
+
+// Gathers the chunks into a single mesh
+class MeshBuilderSink : public MeshSink
+{
+  public:
+	Mesh mesh;
+
+	void begin(const MeshCounts& counts) override;
+	void write(const MeshChunk& chunk) override;
+};
+
+// Writes the chunks to a binary file as they arrive: a header followed by one record per chunk,
+// each holding the raw vertices, uvs, polygons, triangles, uv loops, normals (when the mesh has
+// them) and attribute channels of the chunk.
+// Values are stored in native byte order, read_mesh rebuilds the whole mesh from a file.
+class BinaryFileSink : public MeshSink
+{
+  private:
+	std::ofstream stream;
+	std::string path;
+	MeshCounts written;
+
+  public:
+	static constexpr uint32_t magic = 0x534D544D; // "MTMS"
+	static constexpr uint32_t version = 3; // 2 adds the triangles, 3 the normals
+
+	BinaryFileSink(const std::string& path);
+	void begin(const MeshCounts& counts) override;
+	void write(const MeshChunk& chunk) override;
+	void end() override;
+
+	// Mesh stored in a file written by a BinaryFileSink, version 2 files have no normals.
+	// Attributes of 4 byte elements are read as float attributes and the ones of 12 bytes as
+	// Vector3 attributes.
+	static Mesh read_mesh(const std::string& path);
+};
+
+// Writes the chunks into flat buffers owned by the caller (NumPy arrays for instance), sized from
+// the counts of the mesh: 3 floats per vertex and per normal, 2 per uv, 4 ints per polygon and per
+// uv loop, 3 per triangle and per triangle uv loop.
+// Null buffers skip their channel, and attributes are only written when a buffer was registered
+// for them.
+class BufferSink : public MeshSink
+{
+  public:
+	struct AttributeBuffer
+	{
+		void* data;
+		size_t element_size;
+	};
+
+	float* vertices = nullptr;
+	float* normals = nullptr; // left untouched for chunks without normals
+	float* uvs = nullptr;
+	int* polygons = nullptr;
+	int* uv_loops = nullptr;
+	int* triangles = nullptr;
+	int* uv_triangles = nullptr;
+	std::map<std::string, AttributeBuffer> attributes;
+	MeshCounts capacity;
+
+	// throws when a chunk doesn't fit in the capacity or an attribute doesn't match its buffer
+	void write(const MeshChunk& chunk) override;
+};
+
+} // namespace Mtree
@@ -0,0 +1,15 @@
+#include "TreeMesher.hpp"
+
+namespace Mtree
+{
+
+void TreeMesher::stream_tree(Tree& tree, MeshSink& sink)
+{
+	Mesh mesh = mesh_tree(tree);
+	sink.begin(MeshCounts{(int)mesh.vertices.size(), (int)mesh.uvs.size(),
+	                      (int)mesh.polygons.size(), (int)mesh.triangles.size()});
+	sink.write(MeshChunk{mesh, 0, 0, 0, 0});
+	sink.end();
+}
+
+} // namespace Mtree
@@ -1,6 +1,8 @@
 #pragma once
 #include "source/mesh/Mesh.hpp"
+#include "source/mesh/MeshSink.hpp"
 #include "source/tree/Tree.hpp"
+#include "source/utilities/BuildControl.hpp"
 #include <concepts>
 
 namespace Mtree
@@ -16,6 +18,13 @@ class TreeMesher
   public:
 	virtual ~TreeMesher() = default;
 
+	// Optional control checked while meshing, owned by the caller
+	const BuildControl* control = nullptr;
+
 	virtual Mesh mesh_tree(Tree& tree) = 0;
+	// Streams the mesh to a sink. Meshers that can't split their output send it as one chunk.
+	virtual void stream_tree(Tree& tree, MeshSink& sink);
+	// Exact counts mesh_tree would produce for the tree, without building the mesh
+	virtual MeshCounts predict_counts(Tree& tree) = 0;
 };
 } // namespace Mtree
@@ -0,0 +1,241 @@
+#include "BranchInstancer.hpp"
+#include "source/utilities/GeometryUtilities.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Parallel.hpp"
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace Mtree
+{
+
+namespace
+{
+// Circle ManifoldMesher puts at the start or at the end of a node
+struct Circle
+{
+	Vector3 center;
+	float radius;
+	Vector3 right;
+	Vector3 up;
+};
+
+// Terminal side branch in the frame of its first node, scaled to a unit extent
+struct BranchShape
+{
+	Node* parent;
+	int child_index;
+	Vector3 pivot;
+	Eigen::Matrix3f frame; // columns: tangent, its cross product with the direction, direction
+	float scale;           // extent of the branch
+	std::vector<Node> nodes; // local copies without children
+	std::vector<Circle> circles;
+};
+
+// Nodes of the chain starting at node when none of them has a side branch, empty otherwise. A
+// lone child that doesn't start at the end of its parent is a side branch too.
+std::vector<const Node*> get_terminal_chain(const Node& node)
+{
+	std::vector<const Node*> chain{&node};
+	while (!chain.back()->is_leaf())
+	{
+		const auto& children = chain.back()->children;
+		if (children.size() > 1 || children[0]->position_in_parent != 1)
+			return {};
+		chain.push_back(&children[0]->node);
+	}
+	return chain;
+}
+
+BranchShape get_shape(Node& parent, const int child_index, const Vector3& pivot,
+                      const std::vector<const Node*>& chain)
+{
+	BranchShape shape{.parent = &parent,
+	                  .child_index = child_index,
+	                  .pivot = pivot,
+	                  .frame = Eigen::Matrix3f::Identity(),
+	                  .scale = 0,
+	                  .nodes = {},
+	                  .circles = {}};
+	Vector3 z = chain[0]->direction.normalized();
+	Vector3 x = Geometry::projected_on_plane(chain[0]->tangent, z);
+	x = x.squaredNorm() > 1e-12f ? Vector3{x.normalized()} : Geometry::get_orthogonal_vector(z);
+	shape.frame.col(0) = x;
+	shape.frame.col(1) = z.cross(x);
+	shape.frame.col(2) = z;
+	for (const Node* node : chain)
+		shape.scale += node->length;
+
+	Eigen::Matrix3f rotation = shape.frame.transpose();
+	Vector3 position = Vector3::Zero();
+	for (const Node* node : chain)
+	{
+		Node local{rotation * node->direction, Vector3::UnitX(), node->length / shape.scale,
+		           node->radius / shape.scale, node->creator_id};
+		local.tangent = rotation * node->tangent;
+		shape.nodes.push_back(std::move(local));
+	}
+	// same circles as add_circle: the start of the first node then the end of every node
+	auto add_circle = [&](const Vector3& center, const float radius, const Node& node)
+	{
+		shape.circles.push_back(
+		    Circle{center, radius, node.tangent, node.tangent.cross(node.direction)});
+	};
+	add_circle(position, shape.nodes[0].radius, shape.nodes[0]);
+	for (size_t i = 0; i < shape.nodes.size(); i++)
+	{
+		const Node& node = shape.nodes[i];
+		position += node.direction * node.length;
+		bool is_last = i + 1 == shape.nodes.size();
+		add_circle(position, is_last ? node.radius : shape.nodes[i + 1].radius, node);
+	}
+	return shape;
+}
+
+// Bound of the distance between the circle vertices of branch and those of prototype placed on
+// branch, infinity once above limit
+float get_error(const BranchShape& prototype, const BranchShape& branch, const float limit)
+{
+	float error = 0;
+	for (size_t i = 0; i < branch.circles.size(); i++)
+	{
+		const Circle& a = prototype.circles[i];
+		const Circle& b = branch.circles[i];
+		float circle_error = (a.center - b.center).norm() + std::abs(a.radius - b.radius) +
+		                     std::max(a.radius, b.radius) *
+		                         ((a.right - b.right).norm() + (a.up - b.up).norm());
+		error = std::max(error, circle_error * branch.scale);
+		if (error > limit)
+			return std::numeric_limits<float>::infinity();
+	}
+	return error;
+}
+
+// Terminal side branches of the stems, depth first
+std::vector<BranchShape> collect_branches(std::vector<Stem>& stems, const int min_nodes)
+{
+	std::vector<BranchShape> branches;
+	for (Stem& stem : stems)
+	{
+		NodeUtilities::visit_pre_order(
+		    stem.node, stem.position,
+		    [&](Node& node, const Vector3& position, auto&& visit_child)
+		    {
+			    for (size_t i = 0; i < node.children.size(); i++)
+			    {
+				    NodeChild& child = *node.children[i];
+				    if (i == 0)
+				    {
+					    visit_child(child.node, position + node.direction * node.length);
+					    continue;
+				    }
+				    Vector3 pivot = NodeUtilities::get_side_branch_pivot(node, child, position);
+				    std::vector<const Node*> chain = get_terminal_chain(child.node);
+				    if ((int)chain.size() >= min_nodes)
+					    branches.push_back(get_shape(node, (int)i, pivot, chain));
+				    else
+					    visit_child(child.node, pivot);
+			    }
+		    });
+	}
+	return branches;
+}
+} // namespace
+
+InstancedTreeMesh BranchInstancer::mesh_tree(Tree& tree, const ManifoldMesher& mesher) const
+{
+	std::vector<Stem> stems = NodeUtilities::copy_stems(tree.get_stems());
+	std::vector<BranchShape> branches = collect_branches(stems, std::max(min_nodes, 2));
+
+	// each branch joins the closest cluster of its node count, or starts a new one
+	std::vector<int> cluster_of(branches.size());
+	std::vector<int> prototype_branches; // first branch of every cluster
+	std::vector<int> cluster_sizes;
+	std::map<size_t, std::vector<int>> clusters_by_node_count;
+	std::vector<float> errors(branches.size(), 0);
+	for (size_t i = 0; i < branches.size(); i++)
+	{
+		std::vector<int>& candidates = clusters_by_node_count[branches[i].nodes.size()];
+		int best = -1;
+		float best_error = max_error;
+		for (int cluster : candidates)
+		{
+			const BranchShape& prototype = branches[prototype_branches[cluster]];
+			float error = get_error(prototype, branches[i], best_error);
+			if (error <= best_error)
+			{
+				best = cluster;
+				best_error = error;
+			}
+		}
+		if (best < 0)
+		{
+			best = (int)prototype_branches.size();
+			best_error = 0;
+			prototype_branches.push_back((int)i);
+			cluster_sizes.push_back(0);
+			candidates.push_back(best);
+		}
+		cluster_of[i] = best;
+		errors[i] = best_error;
+		cluster_sizes[best]++;
+	}
+
+	InstancedTreeMesh result;
+	std::vector<int> prototype_of_cluster(prototype_branches.size(), -1);
+	std::vector<int> instanced_prototypes;
+	std::vector<std::pair<Node*, int>> removed_children;
+	for (size_t i = 0; i < branches.size(); i++)
+	{
+		int cluster = cluster_of[i];
+		if (cluster_sizes[cluster] < std::max(min_instances, 1))
+			continue;
+		if (prototype_of_cluster[cluster] < 0)
+		{
+			prototype_of_cluster[cluster] = (int)instanced_prototypes.size();
+			instanced_prototypes.push_back(prototype_branches[cluster]);
+		}
+		const BranchShape& branch = branches[i];
+		result.instances.push_back(
+		    BranchInstance{branch.pivot, Eigen::Quaternionf{branch.frame}.normalized(),
+		                   branch.scale, prototype_of_cluster[cluster]});
+		result.max_error = std::max(result.max_error, errors[i]);
+		removed_children.emplace_back(branch.parent, branch.child_index);
+	}
+
+	// the side children of a node are removed from the last one so that indices stay valid
+	std::sort(removed_children.begin(), removed_children.end(),
+	          [](const auto& a, const auto& b)
+	          { return a.first != b.first ? a.first < b.first : a.second > b.second; });
+	for (auto& [parent, child_index] : removed_children)
+		parent->children.erase(parent->children.begin() + child_index);
+
+	Tree remaining;
+	remaining.get_stems() = std::move(stems);
+	ManifoldMesher tree_mesher = mesher;
+	result.mesh = tree_mesher.mesh_tree(remaining);
+
+	result.prototypes.resize(instanced_prototypes.size());
+	Parallel::parallel_for(
+	    (int)instanced_prototypes.size(),
+	    [&](const int i)
+	    {
+		    const BranchShape& shape = branches[instanced_prototypes[i]];
+		    Node root = shape.nodes[0];
+		    Node* last = &root;
+		    for (size_t k = 1; k < shape.nodes.size(); k++)
+		    {
+			    last->children.push_back(std::make_shared<NodeChild>(NodeChild{shape.nodes[k], 1}));
+			    last = &last->children.back()->node;
+		    }
+		    Tree prototype;
+		    prototype.get_stems().push_back(Stem{std::move(root), Vector3::Zero()});
+		    ManifoldMesher prototype_mesher = mesher;
+		    prototype_mesher.threads = 1;
+		    result.prototypes[i] = prototype_mesher.mesh_tree(prototype);
+	    },
+	    threads);
+	return result;
+}
+
+} // namespace Mtree
@@ -0,0 +1,49 @@
+#pragma once
+#include "ManifoldMesher.hpp"
+#include <Eigen/Geometry>
+#include <cstdint>
+#include <vector>
+
+namespace Mtree
+{
+
+// Placement of one instanced branch: a vertex v of the prototype is at position + rotation * v *
+// scale
+struct BranchInstance
+{
+	Vector3 position;
+	Eigen::Quaternion<float, Eigen::DontAlign> rotation; // stored as x, y, z, w
+	float scale;
+	int32_t prototype;
+};
+static_assert(sizeof(BranchInstance) == 36, "BranchInstance must stay a packed 36 bytes record");
+
+// Mesh of a tree whose repeated terminal branches are replaced by instances of a few prototypes
+struct InstancedTreeMesh
+{
+	Mesh mesh; // the tree without the instanced branches
+	// Prototypes start at the origin, grow along +Z and have an extent of 1
+	std::vector<Mesh> prototypes;
+	std::vector<BranchInstance> instances;
+	float max_error = 0; // largest error bound of an instance, in world units
+};
+
+// Finds the terminal side branches (chains without side branches of their own) that have the same
+// node count and the same shape within max_error, once expressed in the frame of their first
+// node and scaled to a unit extent. Clusters of at least min_instances branches are meshed once
+// and instanced, the other branches stay in the tree mesh.
+// The error of an instance bounds the distance between the circle vertices of its branch and
+// those of the placed prototype, before smoothing. Instanced branches are not stitched to their
+// parent, whose surface is closed where they start.
+class BranchInstancer
+{
+  public:
+	float max_error = .01f;
+	int min_nodes = 2;     // shorter branches stay in the tree mesh, at least 2
+	int min_instances = 2; // smaller clusters stay in the tree mesh
+	int threads = 1;       // 0 uses every hardware thread
+
+	InstancedTreeMesh mesh_tree(Tree& tree, const ManifoldMesher& mesher) const;
+};
+
+} // namespace Mtree
@@ -2,9 +2,15 @@
 #include "smoothing.hpp"
 #include "source/utilities/GeometryUtilities.hpp"
 #include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Parallel.hpp"
+#include "source/utilities/Profiler.hpp"
 #include <algorithm>
 #include <iostream>
+#include <memory_resource>
 #include <numbers>
+#include <numeric>
+#include <span>
+#include <unordered_map>
 
 using namespace Mtree;
 using namespace Mtree::NodeUtilities;
@@ -16,6 +22,82 @@ namespace
 // Golden angle in radians: PI * (3 - sqrt(5)) ~= 2.39996
 constexpr float GOLDEN_ANGLE_RAD = 2.39996322972865f;
 
+// Number of vertices whose normal is fixed up by a single parallel task
+constexpr int normal_block_size = 4096;
+
+// Number of chains or junctions meshed by a single parallel task, with one scratch lease
+constexpr int scratch_block_size = 64;
+
+// Circles of up to this many points share tables built once, larger ones get a table per thread
+constexpr int shared_unit_circle_max = 128;
+
+// cos and sin of the angle of every point of a circle
+struct UnitCircle
+{
+	std::vector<float> cos;
+	std::vector<float> sin;
+};
+
+UnitCircle make_unit_circle(const int radial_n_points)
+{
+	UnitCircle circle;
+	for (int i = 0; i < radial_n_points; i++)
+	{
+		float angle = (float)i / radial_n_points * 2 * std::numbers::pi_v<float>;
+		circle.cos.push_back(cos(angle));
+		circle.sin.push_back(sin(angle));
+	}
+	return circle;
+}
+
+const UnitCircle& get_unit_circle(const int radial_n_points)
+{
+	static const std::vector<UnitCircle> shared = []()
+	{
+		std::vector<UnitCircle> circles;
+		for (int n = 0; n <= shared_unit_circle_max; n++)
+			circles.push_back(make_unit_circle(n));
+		return circles;
+	}();
+	if (radial_n_points <= shared_unit_circle_max)
+		return shared[radial_n_points];
+	thread_local std::unordered_map<int, UnitCircle> larger;
+	auto it = larger.find(radial_n_points);
+	if (it == larger.end())
+		it = larger.emplace(radial_n_points, make_unit_circle(radial_n_points)).first;
+	return it->second;
+}
+
+// Points of a circle, written as multiply-adds of the right and up vectors. N is the point count
+// when it is known at compile time, the loop is then unrolled.
+template <int N>
+void write_circle_points(const UnitCircle& unit, const int radial_n_points, const Vector3& right,
+                         const Vector3& up, const float radius, const Vector3& center,
+                         Vector3* points)
+{
+	const int n = N > 0 ? N : radial_n_points;
+	const float* cos = unit.cos.data();
+	const float* sin = unit.sin.data();
+	for (int i = 0; i < n; i++)
+		points[i] = (cos[i] * right + sin[i] * up) * radius + center;
+}
+
+void write_circle_points(const UnitCircle& unit, const int n, const Vector3& right,
+                         const Vector3& up, const float radius, const Vector3& center,
+                         Vector3* points)
+{
+	switch (n)
+	{
+	case 4: return write_circle_points<4>(unit, n, right, up, radius, center, points);
+	case 6: return write_circle_points<6>(unit, n, right, up, radius, center, points);
+	case 8: return write_circle_points<8>(unit, n, right, up, radius, center, points);
+	case 12: return write_circle_points<12>(unit, n, right, up, radius, center, points);
+	case 16: return write_circle_points<16>(unit, n, right, up, radius, center, points);
+	case 32: return write_circle_points<32>(unit, n, right, up, radius, center, points);
+	default: return write_circle_points<0>(unit, n, right, up, radius, center, points);
+	}
+}
+
 struct CircleDesignator
 {
 	int vertex_index;
@@ -28,6 +110,34 @@ struct IndexRange
 	int max_index;
 };
 
+// Next write position in the preallocated mesh buffers
+struct MeshCursor
+{
+	int vertex = 0;
+	int uv = 0;
+	int polygon = 0;
+};
+
+// Vertex count of the circles of a chain: fixed, or lowered along the chain to the fewest vertices
+// keeping the circles within `tolerance` of the true surface (the gap at the middle of an edge
+// being radius * (1 - cos(pi / n)))
+struct RingResolution
+{
+	bool adaptive = false;
+	int min_n = 4;
+	float tolerance = 0;
+
+	int get_next(const int current_n, const float radius) const
+	{
+		if (!adaptive || tolerance <= 0 || current_n <= min_n)
+			return current_n;
+		if (tolerance >= radius)
+			return min_n;
+		float needed = std::numbers::pi_v<float> / std::acos(1 - tolerance / radius);
+		return std::clamp((int)std::ceil(needed), min_n, current_n);
+	}
+};
+
 // Context for Pivot Painter 2.0 attributes
 struct PivotPainterContext
 {
@@ -35,120 +145,285 @@ struct PivotPainterContext
 	int hierarchy_depth;
 	Vector3 pivot_position;
 	float branch_extent;
+	// Wind parameters, see ManifoldMesher::AttributeNames
+	int parent_stem_id;
+	int grandparent_stem_id;
+	float branch_radius; // radius of the first node, the stiffness is derived from it
+	float wind_phase;
+};
+
+// In [0, 1): slender branches bend, thick and short ones barely move
+float get_wind_stiffness(const PivotPainterContext& pp_ctx, const float scale)
+{
+	float ratio = scale * pp_ctx.branch_radius / std::max(pp_ctx.branch_extent, 1e-6f);
+	return ratio / (1 + ratio);
+}
+
+// Phase offset in [0, 1) of a branch whose phyllotaxis angle on its parent is angle
+float get_wind_phase(const float parent_phase, const float angle)
+{
+	float phase = parent_phase + angle / (2 * std::numbers::pi_v<float>);
+	return phase - std::floor(phase);
+}
+
+// Mesh being written with its attributes resolved once per mesh_tree call. It holds the slices of
+// the layout from origin on, indices handed to the target are the ones of the whole tree. Vertices
+// written before origin, by the earlier chunks of a stream, are read from halo.
+struct MeshTarget
+{
+	Mesh& mesh;
+	AttributeHandle<float> smooth_amount;
+	AttributeHandle<float> radius;
+	AttributeHandle<Vector3> direction;
+	// Pivot Painter attributes
+	AttributeHandle<float> stem_id;
+	AttributeHandle<float> hierarchy_depth;
+	AttributeHandle<Vector3> pivot_position;
+	AttributeHandle<float> branch_extent;
+	// Phyllotaxis attribute
+	AttributeHandle<float> phyllotaxis_angle;
+	// Wind attributes
+	AttributeHandle<float> wind_stiffness;
+	AttributeHandle<float> wind_phase;
+	AttributeHandle<float> wind_parent_id;
+	AttributeHandle<float> wind_grandparent_id;
+	float wind_stiffness_scale = 0;
+	// Per-vertex normals, null when they are not computed
+	std::vector<Vector3>* normals = nullptr;
+	MeshCursor origin = {};
+	const std::unordered_map<int, Vector3>* halo = nullptr;
+
+	Vector3& vertex(const int index) const { return mesh.vertices[index - origin.vertex]; }
+	Vector3& normal(const int index) const { return (*normals)[index - origin.vertex]; }
+	Vector2& uv(const int index) const { return mesh.uvs[index - origin.uv]; }
+	std::array<int, 4>& polygon(const int index) const
+	{
+		return mesh.polygons[index - origin.polygon];
+	}
+	std::array<int, 4>& uv_loop(const int index) const
+	{
+		return mesh.uv_loops[index - origin.polygon];
+	}
+	const Vector3& read_vertex(const int index) const
+	{
+		return index >= origin.vertex ? vertex(index) : halo->at(index);
+	}
+
+	void set_vertex_attributes(const int tree_index, const float smooth, const float vertex_radius,
+	                           const Vector3& vertex_direction, const PivotPainterContext& pp_ctx,
+	                           const float phyllotaxis_value) const
+	{
+		int index = tree_index - origin.vertex;
+		// Attributes that were not requested have invalid handles
+		if (smooth_amount.is_valid())
+			smooth_amount[index] = smooth;
+		if (radius.is_valid())
+			radius[index] = vertex_radius;
+		if (direction.is_valid())
+			direction[index] = vertex_direction;
+		// Set Pivot Painter attributes
+		if (stem_id.is_valid())
+			stem_id[index] = (float)pp_ctx.stem_id;
+		if (hierarchy_depth.is_valid())
+			hierarchy_depth[index] = (float)pp_ctx.hierarchy_depth;
+		if (pivot_position.is_valid())
+			pivot_position[index] = pp_ctx.pivot_position;
+		if (branch_extent.is_valid())
+			branch_extent[index] = pp_ctx.branch_extent;
+		if (phyllotaxis_angle.is_valid())
+			phyllotaxis_angle[index] = phyllotaxis_value;
+		if (wind_stiffness.is_valid())
+			wind_stiffness[index] = get_wind_stiffness(pp_ctx, wind_stiffness_scale);
+		if (wind_phase.is_valid())
+			wind_phase[index] = pp_ctx.wind_phase;
+		if (wind_parent_id.is_valid())
+			wind_parent_id[index] = (float)pp_ctx.parent_stem_id;
+		if (wind_grandparent_id.is_valid())
+			wind_grandparent_id[index] = (float)pp_ctx.grandparent_stem_id;
+	}
+};
+
+// A run of nodes following first children, meshed as consecutive circles
+struct ChainJob
+{
+	const Node* node;
+	Vector3 position;
+	CircleDesignator base;
+	float uv_y;
+	PivotPainterContext pp_ctx;
+	int section_index;
+	bool add_start_circle; // stems begin with a circle at the base of their first node
+	MeshCursor cursor;
+};
+
+// Geometry connecting the first circle of a side branch to the circles of its parent node
+struct JunctionJob
+{
+	const Node* parent;
+	const NodeChild* child;
+	Vector3 child_position;
+	CircleDesignator parent_base;
+	CircleDesignator parent_end; // follows parent_base, with as many or fewer vertices
+	IndexRange child_range;
+	float uv_y;
+	PivotPainterContext pp_ctx;
+	MeshCursor cursor;
+};
+
+// Side branch met while walking a chain, planned once every branch before it is laid out
+struct PendingSideBranch
+{
+	const Node* parent;
+	int child_index;
+	Vector3 parent_position;
+	CircleDesignator parent_base;
+	CircleDesignator parent_end;
+	IndexRange child_range;
+	float uv_y;
+	float uv_growth;
+	PivotPainterContext parent_pp_ctx;
+	int section_index; // of the circle ending the parent node
 };
 
-// Calculate total extent (length) of a branch recursively
-float calculate_branch_extent(const Node& node)
+// Every chain and junction of the tree with the slice of the mesh buffers it writes to.
+// Slices follow the depth-first order of the tree, so chains can be meshed in any order.
+// A junction reads the circles of its parent node, whose base circle can come from the junction of
+// the parent branch, so junctions are grouped by hierarchy depth and levels are stitched in order.
+// A part of the layout holds the slices from origin to size, the whole tree starts at zero.
+struct MeshLayout
 {
-	float extent = node.length;
-	if (!node.is_leaf() && node.children.size() > 0)
+	std::vector<ChainJob> chains;
+	std::vector<std::vector<JunctionJob>> junction_levels;
+	MeshCursor origin;
+	MeshCursor size;
+
+	size_t get_memory_size() const
 	{
-		// Follow the main continuation (first child)
-		extent += calculate_branch_extent(node.children[0]->node);
+		size_t bytes = get_capacity_bytes(chains) + get_capacity_bytes(junction_levels);
+		for (const auto& junctions : junction_levels)
+			bytes += get_capacity_bytes(junctions);
+		return bytes;
 	}
-	return extent;
-}
+};
 
 float get_smooth_amount(const float radius, const float node_length)
 {
 	return std::min(1.f, radius / node_length);
 }
 
+// Adds a circle of radial_n_points vertices at the given cursor.
+// When target is null only the cursor is advanced, which is how the layout is measured.
 CircleDesignator add_circle(const Vector3& node_position, const Node& node, float factor,
-                            const int radial_n_points, Mesh& mesh, const float uv_y,
-                            const PivotPainterContext& pp_ctx, const int section_index)
+                            const int radial_n_points, const MeshTarget* target,
+                            MeshCursor& cursor, const float uv_y, const PivotPainterContext& pp_ctx,
+                            const int section_index)
 {
+	CircleDesignator circle{cursor.vertex, cursor.uv, radial_n_points};
+	cursor.vertex += radial_n_points;
+	cursor.uv += radial_n_points + 1;
+	if (target == nullptr)
+		return circle;
+
 	const Vector3& right = node.tangent;
-	int vertex_index = mesh.vertices.size();
-	int uv_index = mesh.uvs.size();
 	Vector3 up = node.tangent.cross(node.direction);
 	Vector3 circle_position = node_position + node.length * factor * node.direction;
 	float radius = node.is_leaf()
 	                   ? node.radius
 	                   : Geometry::lerp(node.radius, node.children[0]->node.radius, factor);
-	auto& smooth_attr =
-	    *static_cast<Attribute<float>*>(mesh.attributes[AttributeNames::smooth_amount].get());
-	auto& radius_attr =
-	    *static_cast<Attribute<float>*>(mesh.attributes[AttributeNames::radius].get());
 	float smooth_amount = get_smooth_amount(radius, node.length);
-	auto& direction_attr =
-	    *static_cast<Attribute<Vector3>*>(mesh.attributes[AttributeNames::direction].get());
-	// Pivot Painter attributes
-	auto& stem_id_attr =
-	    *static_cast<Attribute<float>*>(mesh.attributes[AttributeNames::stem_id].get());
-	auto& hierarchy_depth_attr =
-	    *static_cast<Attribute<float>*>(mesh.attributes[AttributeNames::hierarchy_depth].get());
-	auto& pivot_position_attr =
-	    *static_cast<Attribute<Vector3>*>(mesh.attributes[AttributeNames::pivot_position].get());
-	auto& branch_extent_attr =
-	    *static_cast<Attribute<float>*>(mesh.attributes[AttributeNames::branch_extent].get());
-	// Phyllotaxis attribute
-	auto& phyllotaxis_attr =
-	    *static_cast<Attribute<float>*>(mesh.attributes[AttributeNames::phyllotaxis_angle].get());
+	// Phyllotaxis angle is the same for all vertices in this cross-section
 	float phyllotaxis_value = std::fmod(section_index * GOLDEN_ANGLE_RAD, 2.0f * (float)M_PI);
+	// The tube is a cone along the node, its normals lean toward the tip where it narrows
+	float slope = node.is_leaf() || node.length <= 0
+	                  ? 0
+	                  : (node.children[0]->node.radius - node.radius) / node.length;
 
-	for (size_t i = 0; i < radial_n_points; i++)
+	const UnitCircle& unit = get_unit_circle(radial_n_points);
+	write_circle_points(unit, radial_n_points, right, up, radius, circle_position,
+	                    &target->vertex(circle.vertex_index));
+	if (target->normals != nullptr)
 	{
-		float angle = (float)i / radial_n_points * 2 * std::numbers::pi_v<float>;
-		Vector3 point = cos(angle) * right + sin(angle) * up;
-		point = point * radius + circle_position;
-		int index = mesh.add_vertex(point);
-		smooth_attr.data[index] = smooth_amount;
-		radius_attr.data[index] = radius;
-		direction_attr.data[index] = node.direction;
-		// Set Pivot Painter attributes
-		stem_id_attr.data[index] = (float)pp_ctx.stem_id;
-		hierarchy_depth_attr.data[index] = (float)pp_ctx.hierarchy_depth;
-		pivot_position_attr.data[index] = pp_ctx.pivot_position;
-		branch_extent_attr.data[index] = pp_ctx.branch_extent;
-		// Set phyllotaxis angle (same for all vertices in this cross-section)
-		phyllotaxis_attr.data[index] = phyllotaxis_value;
-		mesh.uvs.emplace_back((float)i / radial_n_points, uv_y);
+		for (int i = 0; i < radial_n_points; i++)
+		{
+			Vector3 radial = unit.cos[i] * right + unit.sin[i] * up;
+			target->normal(circle.vertex_index + i) =
+			    (radial - slope * node.direction).normalized();
+		}
 	}
-	mesh.uvs.emplace_back(1, uv_y);
-	return CircleDesignator{
-	    .vertex_index = vertex_index, .uv_index = uv_index, .radial_n = radial_n_points};
+	for (int i = 0; i < radial_n_points; i++)
+	{
+		target->set_vertex_attributes(circle.vertex_index + i, smooth_amount, radius,
+		                              node.direction, pp_ctx, phyllotaxis_value);
+		target->uv(circle.uv_index + i) = Vector2{(float)i / radial_n_points, uv_y};
+	}
+	target->uv(circle.uv_index + radial_n_points) = Vector2{1, uv_y};
+	return circle;
 }
 
-bool is_index_in_branch_mask(const std::vector<IndexRange>& mask, const int index,
-                             const int radial_n_points)
+// Flags the points of a circle covered by the ranges of mask, from min_index up to max_index
+// excluded. Ranges past the end of the circle (max_index < min_index) wrap around.
+std::pmr::vector<bool> get_branch_mask_flags(std::span<const IndexRange> mask,
+                                             const int radial_n_points,
+                                             std::pmr::memory_resource* scratch)
 {
-	int offset = radial_n_points / 2;
+	std::pmr::vector<bool> flags(radial_n_points, false, scratch);
 	for (auto range : mask)
 	{
-		int i = index;
-		if (range.max_index < range.min_index)
-		{
-			i = (i + offset) % radial_n_points;
-			range.min_index = (range.min_index + offset) % radial_n_points;
-			range.max_index = (range.max_index + offset) % radial_n_points;
-		}
-		if (i >= range.min_index && i < range.max_index)
-		{
-			return true;
-		}
+		int count = (range.max_index - range.min_index + radial_n_points) % radial_n_points;
+		for (int i = 0; i < count; i++)
+			flags[(range.min_index + i) % radial_n_points] = true;
 	}
-	return false;
+	return flags;
 }
 
+// Vertex of a circle of second_n vertices facing vertex i of one of first_n >= second_n vertices,
+// second_n for the last ones, which face its first vertex
+int get_facing_index(const int i, const int first_n, const int second_n)
+{
+	return (i * second_n + first_n - 1) / first_n;
+}
+
+// Bridges a circle to one with as many or fewer vertices: edge i of the first circle faces the
+// vertices get_facing_index(i) and get_facing_index(i + 1) of the second one, which makes a
+// triangle (stored as a quad repeating its last vertex) when they are the same. Edges covered by
+// the ranges of mask are left open for the junctions of side branches.
 void bridge_circles(const CircleDesignator& first_circle, const CircleDesignator& second_circle,
-                    const int radial_n_points, Mesh& mesh, std::vector<IndexRange>* mask = nullptr)
+                    const MeshTarget* target, MeshCursor& cursor,
+                    std::span<const IndexRange> mask = {},
+                    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
 {
-	for (int i = 0; i < radial_n_points; i++)
+	int n = first_circle.radial_n;
+	int m = second_circle.radial_n;
+	std::pmr::vector<bool> masked =
+	    mask.empty() ? std::pmr::vector<bool>{} : get_branch_mask_flags(mask, n, scratch);
+	for (int i = 0; i < n; i++)
 	{
-		if (mask != nullptr && is_index_in_branch_mask(*mask, i, radial_n_points))
+		if (!mask.empty() && masked[i])
+		{
+			continue;
+		}
+		int polygon_index = cursor.polygon++;
+		if (target == nullptr)
+			continue;
+		int next = i + 1 < n ? i + 1 : 0;
+		int facing = get_facing_index(i, n, m);
+		int facing_next = get_facing_index(i + 1, n, m);
+		int a = first_circle.vertex_index;
+		int b = second_circle.vertex_index;
+		// no need for modulo on the uvs since a circle with n points has n
+		// differnt 3d coordinates but n+1 different uv coordinates
+		int uv_a = first_circle.uv_index;
+		int uv_b = second_circle.uv_index;
+		if (facing == facing_next)
 		{
+			target->polygon(polygon_index) = {a + i, a + next, b + facing % m, b + facing % m};
+			target->uv_loop(polygon_index) = {uv_a + i, uv_a + i + 1, uv_b + facing,
+			                                  uv_b + facing};
 			continue;
 		}
-		int polygon_index = mesh.add_polygon();
-		mesh.polygons[polygon_index] = {
-		    first_circle.vertex_index + i, first_circle.vertex_index + (i + 1) % radial_n_points,
-		    second_circle.vertex_index + (i + 1) % radial_n_points, second_circle.vertex_index + i};
-		mesh.uv_loops[polygon_index] = {// no need for modulo since a circle with n points has n
-		                                // differnt 3d coordinates but n+1 different uv coordinates
-		                                first_circle.uv_index + i, first_circle.uv_index + (i + 1),
-		                                second_circle.uv_index + (i + 1),
-		                                second_circle.uv_index + i};
+		target->polygon(polygon_index) = {a + i, a + next, b + facing_next % m, b + facing};
+		target->uv_loop(polygon_index) = {uv_a + i, uv_a + i + 1, uv_b + facing_next,
+		                                  uv_b + facing};
 	}
 }
 
@@ -179,9 +454,10 @@ IndexRange get_branch_indices_on_circle(const int radial_n_points, const float c
 	return IndexRange{min_index, max_index};
 }
 
-std::vector<IndexRange> get_children_ranges(const Node& node, const int radial_n_points)
+std::pmr::vector<IndexRange> get_children_ranges(const Node& node, const int radial_n_points,
+                                                 std::pmr::memory_resource* scratch)
 {
-	std::vector<IndexRange> ranges;
+	std::pmr::vector<IndexRange> ranges{scratch};
 	for (size_t i = 1; i < node.children.size(); i++)
 	{
 		auto& child = node.children[i];
@@ -194,88 +470,91 @@ std::vector<IndexRange> get_children_ranges(const Node& node, const int radial_n
 	return ranges;
 }
 
-std::vector<int> get_child_index_order(const CircleDesignator& parent_base,
-                                       const int child_radial_n, const IndexRange child_range,
-                                       const NodeChild& child, const Node& parent, const Mesh& mesh)
+// Vertices around the hole a side branch leaves between the circles of its parent node: its range
+// on the base circle followed by the vertices facing it on the end circle, in reverse order.
+// Vertices of the end circle facing several ones of the base circle appear once.
+std::pmr::vector<int> get_child_index_order(const CircleDesignator& parent_base,
+                                            const CircleDesignator& parent_end,
+                                            const int child_radial_n, const IndexRange child_range,
+                                            std::pmr::memory_resource* scratch)
 {
-	int start = child_range.min_index + parent_base.vertex_index;
-	std::vector<int> child_base_indices;
-	child_base_indices.resize((size_t)child_radial_n);
-
+	int n = parent_base.radial_n;
+	int m = parent_end.radial_n;
+	std::pmr::vector<int> child_base_indices(scratch);
+	child_base_indices.reserve((size_t)child_radial_n);
 	for (int i = 0; i < child_radial_n / 2; i++)
+		child_base_indices.push_back((child_range.min_index + i) % n + parent_base.vertex_index);
+	for (int i = child_radial_n / 2 - 1; i >= 0; i--)
 	{
-		int lower_index =
-		    (child_range.min_index + i) % parent_base.radial_n + parent_base.vertex_index;
-		int upper_index = lower_index + parent_base.radial_n;
-		int vertex_index = start + (i % (child_radial_n / 2));
-
-		child_base_indices[i] = lower_index;
-		child_base_indices[(size_t)child_radial_n - i - 1] = upper_index;
+		int lower_index = (child_range.min_index + i) % n;
+		int upper_index = get_facing_index(lower_index, n, m) % m + parent_end.vertex_index;
+		if (upper_index != child_base_indices.back())
+			child_base_indices.push_back(upper_index);
 	}
 	return child_base_indices;
 }
 
-void add_child_base_geometry(const std::vector<int>& child_base_indices,
+// Stitches the circle of a side branch to the vertices around its hole, which can be fewer: vertex
+// k of the circle faces the point k * hole_n / radial_n of the hole loop, polygons whose circle
+// edge faces a single vertex of the loop are triangles.
+void add_child_base_geometry(std::span<const int> child_base_indices,
                              const CircleDesignator& child_base, const float child_radius,
                              const Vector3& child_pos, const int offset, const float smooth_amount,
-                             Mesh& mesh, const PivotPainterContext& pp_ctx, const int section_index)
-{
-	auto& smooth_attr = *static_cast<Attribute<float>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::smooth_amount].get());
-	auto& radius_attr = *static_cast<Attribute<float>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::radius].get());
-	auto& direction_attr = *static_cast<Attribute<Vector3>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::direction].get());
-	// Pivot Painter attributes
-	auto& stem_id_attr = *static_cast<Attribute<float>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::stem_id].get());
-	auto& hierarchy_depth_attr = *static_cast<Attribute<float>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::hierarchy_depth].get());
-	auto& pivot_position_attr = *static_cast<Attribute<Vector3>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::pivot_position].get());
-	auto& branch_extent_attr = *static_cast<Attribute<float>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::branch_extent].get());
-	// Phyllotaxis attribute
-	auto& phyllotaxis_attr = *static_cast<Attribute<float>*>(
-	    mesh.attributes[ManifoldMesher::AttributeNames::phyllotaxis_angle].get());
+                             const MeshTarget& target, MeshCursor& cursor,
+                             const PivotPainterContext& pp_ctx, const int section_index)
+{
 	float phyllotaxis_value = std::fmod(section_index * GOLDEN_ANGLE_RAD, 2.0f * (float)M_PI);
+	int radial_n = child_base.radial_n;
+	int hole_n = (int)child_base_indices.size();
+	auto hole_vertex = [&](const int position)
+	{ return child_base_indices[(size_t)(position % hole_n)]; };
 
-	Vector3 direction =
-	    (mesh.vertices[child_base_indices[2]] - mesh.vertices[child_base_indices[0]])
-	        .cross(mesh.vertices[child_base_indices[1]] - mesh.vertices[child_base_indices[0]])
-	        .normalized();
+	const Vector3& first = target.read_vertex(child_base_indices[0]);
+	Vector3 direction = (target.read_vertex(child_base_indices[2]) - first)
+	                        .cross(target.read_vertex(child_base_indices[1]) - first)
+	                        .normalized();
 
 	Vector3 child_base_center{0, 0, 0};
 	for (auto& i : child_base_indices)
-		child_base_center += mesh.vertices[(size_t)i];
+		child_base_center += target.read_vertex(i);
 	child_base_center /= child_base_indices.size();
 
-	for (int i = 0; i < child_base.radial_n; i++)
+	int uv_start = child_base.uv_index - radial_n * 2;
+	for (int i = 0; i < radial_n; i++)
 	{
-		int index = (i + offset) % child_base.radial_n;
-		Vector3 vertex = mesh.vertices[child_base_indices[(size_t)index]];
+		int index = (i + offset) % radial_n;
+		int position = index * hole_n / radial_n;
+		int next_position = (index + 1) * hole_n / radial_n;
+		int remainder = index * hole_n % radial_n;
+		Vector3 vertex = target.read_vertex(hole_vertex(position));
+		if (remainder != 0)
+		{
+			vertex = Geometry::lerp(vertex, target.read_vertex(hole_vertex(position + 1)),
+			                        (float)remainder / radial_n);
+		}
 		vertex = (vertex - child_base_center).normalized() * child_radius + child_pos;
-		int added_vertex_index = mesh.add_vertex(vertex);
-		smooth_attr.data[added_vertex_index] = smooth_amount;
-		radius_attr.data[added_vertex_index] = child_radius;
-		direction_attr.data[added_vertex_index] = direction;
-		// Set Pivot Painter attributes
-		stem_id_attr.data[added_vertex_index] = (float)pp_ctx.stem_id;
-		hierarchy_depth_attr.data[added_vertex_index] = (float)pp_ctx.hierarchy_depth;
-		pivot_position_attr.data[added_vertex_index] = pp_ctx.pivot_position;
-		branch_extent_attr.data[added_vertex_index] = pp_ctx.branch_extent;
-		// Set phyllotaxis angle
-		phyllotaxis_attr.data[added_vertex_index] = phyllotaxis_value;
+		int added_vertex_index = cursor.vertex++;
+		target.vertex(added_vertex_index) = vertex;
+		target.set_vertex_attributes(added_vertex_index, smooth_amount, child_radius, direction,
+		                             pp_ctx, phyllotaxis_value);
 
-		int polygon_index = mesh.add_polygon();
-		mesh.polygons[polygon_index] = {
-		    child_base_indices[index], child_base_indices[(index + 1) % child_base.radial_n],
-		    child_base.vertex_index + (i + 1) % child_base.radial_n, child_base.vertex_index + i};
-		int uv_start = child_base.uv_index - child_base.radial_n * 2;
-		mesh.uv_loops[polygon_index] = {
-		    uv_start + index, uv_start + (index + 1) % child_base.radial_n,
-		    uv_start + child_base.radial_n + (index + 1) % child_base.radial_n,
-		    uv_start + child_base.radial_n + index};
+		int polygon_index = cursor.polygon++;
+		int circle_vertex = child_base.vertex_index + i;
+		int circle_next = child_base.vertex_index + (i + 1) % radial_n;
+		int outer_uv = uv_start + index;
+		int inner_uv = uv_start + radial_n + index;
+		int inner_next_uv = uv_start + radial_n + (index + 1) % radial_n;
+		if (position == next_position)
+		{
+			target.polygon(polygon_index) = {hole_vertex(position), circle_next, circle_vertex,
+			                                 circle_vertex};
+			target.uv_loop(polygon_index) = {outer_uv, inner_next_uv, inner_uv, inner_uv};
+			continue;
+		}
+		target.polygon(polygon_index) = {hole_vertex(position), hole_vertex(next_position),
+		                                 circle_next, circle_vertex};
+		target.uv_loop(polygon_index) = {outer_uv, uv_start + (index + 1) % radial_n,
+		                                 inner_next_uv, inner_uv};
 	}
 }
 
@@ -291,10 +570,17 @@ float get_child_twist(const Node& child, const Node& parent)
 	                 2 * std::numbers::pi_v<float>);
 }
 
-int add_child_base_uvs(float parent_uv_y, const Node& parent, const NodeChild& child,
-                       const IndexRange child_range, const int child_radial_n,
-                       const int parent_radial_n, Mesh& mesh)
+int add_child_base_uvs(float parent_uv_y, const Node& parent, const IndexRange child_range,
+                       const int child_radial_n, const int parent_radial_n,
+                       const MeshTarget* target, MeshCursor& cursor)
 {
+	int uv_index = cursor.uv;
+	int circle_uv_start_index = uv_index + 2 * (child_radial_n / 2) + child_radial_n;
+	cursor.uv = circle_uv_start_index + child_radial_n + 1;
+	if (target == nullptr)
+		return circle_uv_start_index;
+	auto uvs = [&](const int index) -> Vector2& { return target->uv(index); };
+
 	float uv_growth = parent.length / (parent.radius + .001f) / (2 * std::numbers::pi_v<float>);
 	for (size_t i = 0; i < 2;
 	     i++) // recreating outer uvs (but without continuous (no looping back to x=0)
@@ -305,7 +591,7 @@ int add_child_base_uvs(float parent_uv_y, const Node& parent, const NodeChild& c
 		for (size_t j = 0; j < child_radial_n / 2; j++)
 		{
 			float uv_x = (x_start + j * step) / parent_radial_n;
-			mesh.uvs.emplace_back(uv_x, uv_y);
+			uvs(uv_index++) = Vector2{uv_x, uv_y};
 		}
 	}
 
@@ -318,56 +604,61 @@ int add_child_base_uvs(float parent_uv_y, const Node& parent, const NodeChild& c
 		float angle = (float)i / (child_radial_n - 1) * 2 * std::numbers::pi_v<float> +
 		              std::numbers::pi_v<float>;
 		Vector2 uv_position = Vector2{cos(angle), sin(angle)} * uv_circle_radius + uv_circle_center;
-		mesh.uvs.push_back(uv_position);
+		uvs(uv_index++) = uv_position;
 	}
-	int circle_uv_start_index = mesh.uvs.size();
 
 	for (int i = 0; i < child_radial_n; i++)
 	{
-		mesh.uvs.emplace_back((float)i / child_radial_n, parent_uv_y);
+		uvs(uv_index++) = Vector2{(float)i / child_radial_n, parent_uv_y};
 	}
-	mesh.uvs.emplace_back(1, parent_uv_y);
+	uvs(uv_index) = Vector2{1, parent_uv_y};
 
 	return circle_uv_start_index;
 }
 
-CircleDesignator add_child_circle(const Node& parent, const NodeChild& child,
-                                  const Vector3& child_pos, const Vector3& parent_pos,
-                                  const CircleDesignator& parent_base, const IndexRange child_range,
-                                  const float uv_y, Mesh& mesh, const PivotPainterContext& pp_ctx)
+int get_child_radial_n(const IndexRange child_range, const int parent_radial_n)
 {
-	float smooth_amount = get_smooth_amount(child.node.radius, parent.length);
+	return 2 * ((child_range.max_index - child_range.min_index + parent_radial_n) %
+	                parent_radial_n +
+	            1); // number of vertices in child circle
+}
+
+// Lays out (target == null) or writes the junction of a side branch and returns the circle the side
+// branch starts from.
+CircleDesignator add_child_circle(const JunctionJob& junction, const MeshTarget* target,
+                                  MeshCursor& cursor, std::pmr::memory_resource* scratch)
+{
+	const Node& parent = *junction.parent;
+	const NodeChild& child = *junction.child;
+	const CircleDesignator& parent_base = junction.parent_base;
+	int child_radial_n = get_child_radial_n(junction.child_range, parent_base.radial_n);
 
-	int child_radial_n =
-	    2 * ((child_range.max_index - child_range.min_index + parent_base.radial_n) %
-	             parent_base.radial_n +
-	         1); // number of vertices in child circle
-	std::vector<int> child_base_indices =
-	    get_child_index_order(parent_base, child_radial_n, child_range, child, parent, mesh);
+	CircleDesignator child_base{cursor.vertex, cursor.uv, child_radial_n};
+	child_base.uv_index = add_child_base_uvs(junction.uv_y, parent, junction.child_range,
+	                                         child_radial_n, parent_base.radial_n, target, cursor);
+	if (target == nullptr)
+	{
+		cursor.vertex += child_radial_n;
+		cursor.polygon += child_radial_n;
+		return child_base;
+	}
+
+	float smooth_amount = get_smooth_amount(child.node.radius, parent.length);
+	std::pmr::vector<int> child_base_indices = get_child_index_order(
+	    parent_base, junction.parent_end, child_radial_n, junction.child_range, scratch);
 
 	float child_twist = get_child_twist(child.node, parent);
 	int offset = (int)(child_twist / (2 * std::numbers::pi_v<float>)*child_radial_n -
 	                   child_radial_n / 4 + child_radial_n) %
 	             child_radial_n;
 
-	CircleDesignator child_base{(int)mesh.vertices.size(), (int)mesh.uvs.size(), child_radial_n};
-	child_base.uv_index = add_child_base_uvs(uv_y, parent, child, child_range, child_radial_n,
-	                                         parent_base.radial_n, mesh);
 	// Side branch base is section_index=0 (start of a new branch)
-	add_child_base_geometry(child_base_indices, child_base, child.node.radius, child_pos, offset,
-	                        smooth_amount, mesh, pp_ctx, 0);
+	add_child_base_geometry(child_base_indices, child_base, child.node.radius,
+	                        junction.child_position, offset, smooth_amount, *target, cursor,
+	                        junction.pp_ctx, 0);
 	return child_base;
 }
 
-Vector3 get_side_child_position(const Node& parent, const NodeChild& child,
-                                const Vector3& node_position)
-{
-	Vector3 tangent =
-	    Geometry::projected_on_plane(child.node.direction, parent.direction).normalized();
-	return node_position + parent.direction * parent.length * child.position_in_parent +
-	       tangent * parent.radius;
-}
-
 bool has_side_branches(const Node& node)
 {
 	if (node.children.size() < 2)
@@ -381,63 +672,611 @@ bool has_side_branches(const Node& node)
 	return false;
 }
 
-void mesh_node_rec(const Node& node, const Vector3& node_position, const CircleDesignator& base,
-                   Mesh& mesh, const float uv_y, const PivotPainterContext& pp_ctx,
-                   int& stem_id_counter, int section_index)
+// Meshes a chain: one circle per node, bridged to the circle of the previous node.
+// Side branches are not followed; when side_branches is set they are appended to it, the ones of
+// a same node in reverse order so that a stack of pending branches pops them in tree order.
+MeshCursor mesh_chain(const ChainJob& chain, const RingResolution& resolution,
+                      const MeshTarget* target, std::vector<PendingSideBranch>* side_branches,
+                      std::pmr::memory_resource* scratch)
 {
-	if (node.children.size() < 2)
+	MeshCursor cursor = chain.cursor;
+	if (chain.add_start_circle)
 	{
-		float uv_growth = node.length / (node.radius + .001f) / (2 * M_PI);
-		auto child_circle = add_circle(node_position, node, 1, base.radial_n, mesh,
-		                               uv_y + uv_growth, pp_ctx, section_index);
-		bridge_circles(base, child_circle, base.radial_n, mesh);
-		Vector3 child_pos = NodeUtilities::get_position_in_node(node_position, node, 1);
+		add_circle(chain.position, *chain.node, 0, chain.base.radial_n, target, cursor, 0,
+		           chain.pp_ctx, 0);
+	}
 
-		if (!node.is_leaf())
+	const Node* node = chain.node;
+	Vector3 node_position = chain.position;
+	CircleDesignator base = chain.base;
+	float uv_y = chain.uv_y;
+	int section_index = chain.section_index;
+	while (true)
+	{
+		float uv_growth = node->length / (node->radius + .001f) / (2 * M_PI);
+		float end_radius = node->is_leaf() ? node->radius : node->children[0]->node.radius;
+		int radial_n = resolution.get_next(base.radial_n, end_radius);
+		auto end_circle = add_circle(node_position, *node, 1, radial_n, target, cursor,
+		                             uv_y + uv_growth, chain.pp_ctx, section_index);
+		if (node->children.size() < 2)
+		{
+			bridge_circles(base, end_circle, target, cursor);
+		}
+		else
 		{
-			mesh_node_rec(node.children[0]->node, child_pos, child_circle, mesh, uv_y + uv_growth,
-			              pp_ctx, stem_id_counter, section_index + 1);
+			// the holes of the side branches are ranges of the base circle
+			std::pmr::vector<IndexRange> children_ranges =
+			    get_children_ranges(*node, base.radial_n, scratch);
+			bridge_circles(base, end_circle, target, cursor, children_ranges, scratch);
+			for (int i = (int)node->children.size() - 1; side_branches != nullptr && i > 0; i--)
+			{
+				side_branches->push_back(PendingSideBranch{
+				    node, i, node_position, base, end_circle, children_ranges[i - 1], uv_y,
+				    uv_growth, chain.pp_ctx, section_index});
+			}
 		}
+
+		if (node->is_leaf())
+			break;
+
+		// first child is the continuity of the branch
+		node_position = NodeUtilities::get_position_in_node(node_position, *node, 1);
+		node = &node->children[0]->node;
+		base = end_circle;
+		uv_y += uv_growth;
+		section_index++;
 	}
-	else
+	return cursor;
+}
+
+// Walks the tree in the same depth-first order the mesh is built in and records, for every chain
+// and junction, the slice of the mesh buffers it will write. One layout is planned per resolution:
+// they share the walk, the stem ids and the pivot painter contexts, only their circles differ.
+// Branches get consecutive stem ids from stem_id_counter, which is left at the next free id.
+std::vector<MeshLayout> plan_mesh_layouts(std::span<Stem> stems, const int radial_resolution,
+                                          std::span<const RingResolution> resolutions,
+                                          int& stem_id_counter, ScratchArena* arena)
+{
+	size_t level_count = resolutions.size();
+	std::vector<MeshLayout> layouts(level_count);
+	// every level meets the same side branches in the same order, with its own circles
+	std::vector<std::vector<PendingSideBranch>> pending(level_count);
+	ScratchArena::Lease scratch = ScratchArena::lease(arena);
+
+	auto add_chain = [&](const size_t level, const ChainJob& chain)
+	{
+		MeshLayout& layout = layouts[level];
+		layout.chains.push_back(chain);
+		layout.size = mesh_chain(layout.chains.back(), resolutions[level], nullptr,
+		                         &pending[level], scratch.get());
+		scratch.rewind();
+	};
+
+	for (auto& stem : stems)
 	{
-		float uv_growth = node.length / (node.radius + .001f) / (2 * M_PI);
-		auto end_circle = add_circle(node_position, node, 1, base.radial_n, mesh, uv_y + uv_growth,
-		                             pp_ctx, section_index);
-		std::vector<IndexRange> children_ranges = get_children_ranges(node, base.radial_n);
-		bridge_circles(base, end_circle, base.radial_n, mesh, &children_ranges);
-		for (int i = 0; i < node.children.size(); i++)
+		if (stem.node.children.size() == 0)
+			continue;
+
+		// Initialize Pivot Painter context for this stem
+		PivotPainterContext pp_ctx;
+		pp_ctx.stem_id = stem_id_counter++;
+		pp_ctx.hierarchy_depth = 0;
+		pp_ctx.pivot_position = stem.position;
+		pp_ctx.branch_extent = get_branch_extent(stem.node);
+		pp_ctx.parent_stem_id = pp_ctx.stem_id;
+		pp_ctx.grandparent_stem_id = pp_ctx.stem_id;
+		pp_ctx.branch_radius = stem.node.radius;
+		pp_ctx.wind_phase = get_wind_phase(0, pp_ctx.stem_id * GOLDEN_ANGLE_RAD);
+
+		for (size_t level = 0; level < level_count; level++)
 		{
-			if (i == 0) // first child is the continuity of the branch
+			MeshCursor cursor = layouts[level].size;
+			CircleDesignator start_circle{cursor.vertex, cursor.uv, radial_resolution};
+			add_chain(level, ChainJob{.node = &stem.node,
+			                          .position = stem.position,
+			                          .base = start_circle,
+			                          .uv_y = 0,
+			                          .pp_ctx = pp_ctx,
+			                          .section_index = 1,
+			                          .add_start_circle = true,
+			                          .cursor = cursor});
+		}
+
+		// side branches of the deepest nodes are popped first, like in a recursive traversal
+		while (level_count > 0 && !pending[0].empty())
+		{
+			PendingSideBranch side = pending[0].back();
+			auto& child = *side.parent->children[side.child_index];
+			Vector3 child_pos = get_side_branch_pivot(*side.parent, child, side.parent_position);
+
+			// Create new context for side branch with incremented stem_id and depth
+			PivotPainterContext child_pp_ctx;
+			child_pp_ctx.stem_id = stem_id_counter++;
+			child_pp_ctx.hierarchy_depth = side.parent_pp_ctx.hierarchy_depth + 1;
+			child_pp_ctx.pivot_position = child_pos;
+			child_pp_ctx.branch_extent = get_branch_extent(child.node);
+			child_pp_ctx.parent_stem_id = side.parent_pp_ctx.stem_id;
+			child_pp_ctx.grandparent_stem_id = side.parent_pp_ctx.parent_stem_id;
+			child_pp_ctx.branch_radius = child.node.radius;
+			child_pp_ctx.wind_phase = get_wind_phase(side.parent_pp_ctx.wind_phase,
+			                                         side.section_index * GOLDEN_ANGLE_RAD);
+			int depth = child_pp_ctx.hierarchy_depth;
+
+			for (size_t level = 0; level < level_count; level++)
 			{
-				Vector3 child_pos = NodeUtilities::get_position_in_node(node_position, node, 1);
-				if (node.children.size() > 0)
+				PendingSideBranch level_side = pending[level].back();
+				pending[level].pop_back();
+				MeshLayout& layout = layouts[level];
+				MeshCursor cursor = layout.size;
+				JunctionJob junction{side.parent,          &child,
+				                     child_pos,            level_side.parent_base,
+				                     level_side.parent_end, level_side.child_range,
+				                     level_side.uv_y,      child_pp_ctx,
+				                     cursor};
+				if ((int)layout.junction_levels.size() < depth)
+					layout.junction_levels.resize(depth);
+				layout.junction_levels[depth - 1].push_back(junction);
+				auto child_base = add_child_circle(junction, nullptr, cursor, scratch.get());
+				// Side branches start with section_index=1 (0 was the base from add_child_circle)
+				add_chain(level, ChainJob{.node = &child.node,
+				                          .position = child_pos,
+				                          .base = child_base,
+				                          .uv_y = level_side.uv_y + level_side.uv_growth,
+				                          .pp_ctx = child_pp_ctx,
+				                          .section_index = 1,
+				                          .add_start_circle = false,
+				                          .cursor = cursor});
+			}
+		}
+	}
+	return layouts;
+}
+
+MeshLayout plan_mesh_layout(std::span<Stem> stems, const int radial_resolution,
+                            const RingResolution& resolution, int& stem_id_counter,
+                            ScratchArena* arena)
+{
+	return std::move(plan_mesh_layouts(stems, radial_resolution, std::span{&resolution, 1},
+	                                   stem_id_counter, arena)[0]);
+}
+
+RingResolution get_ring_resolution(const ManifoldMesher& mesher)
+{
+	return RingResolution{mesher.adaptive_resolution, std::max(mesher.min_radial_resolution, 3),
+	                      mesher.resolution_tolerance};
+}
+
+bool is_requested(const ManifoldMesher& mesher, const std::string& name)
+{
+	return std::find(mesher.attributes.begin(), mesher.attributes.end(), name) !=
+	       mesher.attributes.end();
+}
+
+// Invalid handle when the attribute is neither requested nor needed
+template <typename T>
+AttributeHandle<T> add_requested(Mesh& mesh, const ManifoldMesher& mesher, const std::string& name,
+                                 const bool needed = false)
+{
+	if (!needed && !is_requested(mesher, name))
+		return {};
+	return mesh.add_attribute<T>(name);
+}
+
+// Area weighted normals of the vertices of the junction polygons, which don't lie on the tubes the
+// analytic normals assume, or of every vertex when junction_polygons is null. Polygons are wound
+// clockwise seen from outside.
+void set_area_weighted_normals(Mesh& mesh, const std::vector<IndexRange>* junction_polygons,
+                               const int threads)
+{
+	auto get_corner_count = [](const std::array<int, 4>& polygon)
+	{ return polygon[3] == polygon[2] ? 3 : 4; };
+	std::vector<int> slots(mesh.vertices.size(), -1);
+	std::vector<int> fixed_vertices;
+	if (junction_polygons == nullptr)
+	{
+		fixed_vertices.resize(mesh.vertices.size());
+		std::iota(fixed_vertices.begin(), fixed_vertices.end(), 0);
+		slots = fixed_vertices;
+	}
+	else
+	{
+		for (const IndexRange& range : *junction_polygons)
+			for (int p = range.min_index; p < range.max_index; p++)
+				for (int k = 0; k < get_corner_count(mesh.polygons[p]); k++)
 				{
-					mesh_node_rec(node.children[0]->node, child_pos, end_circle, mesh,
-					              uv_y + uv_growth, pp_ctx, stem_id_counter, section_index + 1);
+					int vertex = mesh.polygons[p][k];
+					if (slots[vertex] >= 0)
+						continue;
+					slots[vertex] = (int)fixed_vertices.size();
+					fixed_vertices.push_back(vertex);
 				}
+	}
+
+	// polygons around every fixed vertex, in compressed rows
+	std::vector<int> offsets(fixed_vertices.size() + 1, 0);
+	auto for_each_fixed_corner = [&](auto&& f)
+	{
+		for (int p = 0; p < (int)mesh.polygons.size(); p++)
+			for (int k = 0; k < get_corner_count(mesh.polygons[p]); k++)
+				if (slots[mesh.polygons[p][k]] >= 0)
+					f(slots[mesh.polygons[p][k]], p);
+	};
+	for_each_fixed_corner([&](int slot, int) { offsets[slot + 1]++; });
+	for (size_t i = 0; i < fixed_vertices.size(); i++)
+		offsets[i + 1] += offsets[i];
+	std::vector<int> polygons(offsets.back());
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for_each_fixed_corner([&](int slot, int p) { polygons[fill[slot]++] = p; });
+
+	int block_count = ((int)fixed_vertices.size() + normal_block_size - 1) / normal_block_size;
+	Parallel::parallel_for(
+	    block_count,
+	    [&](int block)
+	    {
+		    int end = std::min((int)fixed_vertices.size(), (block + 1) * normal_block_size);
+		    for (int slot = block * normal_block_size; slot < end; slot++)
+		    {
+			    // the cross product of the diagonals is twice the area vector of the polygon
+			    Vector3 normal = Vector3::Zero();
+			    for (int i = offsets[slot]; i < offsets[slot + 1]; i++)
+			    {
+				    const auto& polygon = mesh.polygons[polygons[i]];
+				    Vector3 first = mesh.vertices[polygon[2]] - mesh.vertices[polygon[0]];
+				    Vector3 second = mesh.vertices[polygon[3]] - mesh.vertices[polygon[1]];
+				    normal += second.cross(first);
+			    }
+			    if (normal.squaredNorm() > 1e-20f)
+				    mesh.normals[fixed_vertices[slot]] = normal.normalized();
+		    }
+	    },
+	    threads);
+}
+
+// Part of the layout meshed as one chunk of a stream
+struct StreamedPart
+{
+	// Vertices of the earlier chunks read by the later ones, as they were before smoothing
+	std::unordered_map<int, Vector3>* halo;
+	// Vertices of this chunk read by the later ones, added to the halo
+	std::span<const int> kept;
+	// Memory held by the stream besides the chunk
+	size_t held_bytes;
+};
+
+// Makes the polygons of a part of the mesh starting at origin index its vertices. The vertices of
+// the earlier chunks they use are appended from the halo, their tree indices are returned.
+std::vector<int> localize_polygons(Mesh& mesh, const int origin,
+                                   const std::unordered_map<int, Vector3>& halo)
+{
+	int local_count = (int)mesh.vertices.size();
+	std::unordered_map<int, int> appended;
+	std::vector<int> outside;
+	for (auto& polygon : mesh.polygons)
+		for (int& index : polygon)
+		{
+			if (index >= origin)
+			{
+				index -= origin;
+				continue;
 			}
-			else
+			auto [it, inserted] = appended.try_emplace(index, local_count + (int)outside.size());
+			if (inserted)
 			{
-				auto& child = *node.children[i];
-				Vector3 child_pos = get_side_child_position(node, child, node_position);
-
-				// Create new context for side branch with incremented stem_id and depth
-				PivotPainterContext child_pp_ctx;
-				child_pp_ctx.stem_id = ++stem_id_counter;
-				child_pp_ctx.hierarchy_depth = pp_ctx.hierarchy_depth + 1;
-				child_pp_ctx.pivot_position = child_pos;
-				child_pp_ctx.branch_extent = calculate_branch_extent(child.node);
-
-				auto child_base =
-				    add_child_circle(node, child, child_pos, node_position, base,
-				                     children_ranges[i - 1], uv_y, mesh, child_pp_ctx);
-				// Side branches start with section_index=1 (0 was the base from add_child_circle)
-				mesh_node_rec(node.children[i]->node, child_pos, child_base, mesh, uv_y + uv_growth,
-				              child_pp_ctx, stem_id_counter, 1);
+				outside.push_back(index);
+				mesh.vertices.push_back(halo.at(index));
 			}
+			index = it->second;
+		}
+	return outside;
+}
+
+// Drops the vertices appended by localize_polygons and makes the polygons index the whole tree
+void globalize_polygons(Mesh& mesh, const int origin, const int local_count,
+                        std::span<const int> outside)
+{
+	mesh.vertices.resize(local_count);
+	if (!mesh.normals.empty())
+		mesh.normals.resize(local_count);
+	for (auto& polygon : mesh.polygons)
+		for (int& index : polygon)
+			index = index < local_count ? index + origin : outside[index - local_count];
+}
+
+// Writes the planned chains and junctions and smooths the result. Progress is reported from
+// progress_start to progress_end, and the memory used to memory_peak when it isn't null.
+// The mesh of a streamed part only holds its slices, the faces index the whole tree. It is smoothed
+// and its normals are computed on its own, the vertices of the earlier chunks staying in place.
+Mesh build_mesh(const ManifoldMesher& mesher, const MeshLayout& layout,
+                const RingResolution& resolution, ScratchArena* arena, MemoryPeak* memory_peak,
+                const float progress_start = 0, const float progress_end = 1,
+                const StreamedPart* part = nullptr)
+{
+	auto progress = [&](const float amount)
+	{
+		float value = Geometry::lerp(progress_start, progress_end, amount);
+		report_progress(mesher.control, "mesh", value);
+	};
+	Mesh mesh;
+	// Smoothing is weighted by the smooth amounts, they are computed whenever the mesh is smoothed
+	bool smooth = mesher.smooth_iterations > 0;
+	bool keep_smooth_amount = is_requested(mesher, AttributeNames::smooth_amount);
+	MeshTarget target{
+	    mesh,
+	    add_requested<float>(mesh, mesher, AttributeNames::smooth_amount, smooth),
+	    add_requested<float>(mesh, mesher, AttributeNames::radius),
+	    add_requested<Vector3>(mesh, mesher, AttributeNames::direction),
+	    // Pivot Painter 2.0 attributes
+	    add_requested<float>(mesh, mesher, AttributeNames::stem_id),
+	    add_requested<float>(mesh, mesher, AttributeNames::hierarchy_depth),
+	    add_requested<Vector3>(mesh, mesher, AttributeNames::pivot_position),
+	    add_requested<float>(mesh, mesher, AttributeNames::branch_extent),
+	    // Phyllotaxis attribute
+	    add_requested<float>(mesh, mesher, AttributeNames::phyllotaxis_angle),
+	    // Wind attributes
+	    add_requested<float>(mesh, mesher, AttributeNames::wind_stiffness),
+	    add_requested<float>(mesh, mesher, AttributeNames::wind_phase),
+	    add_requested<float>(mesh, mesher, AttributeNames::wind_parent_id),
+	    add_requested<float>(mesh, mesher, AttributeNames::wind_grandparent_id),
+	    mesher.wind_stiffness_scale};
+	target.origin = layout.origin;
+	if (part != nullptr)
+		target.halo = part->halo;
+
+	int vertex_count = layout.size.vertex - layout.origin.vertex;
+	mesh.resize(vertex_count, layout.size.polygon - layout.origin.polygon);
+	mesh.uvs.resize(layout.size.uv - layout.origin.uv);
+	if (mesher.compute_normals)
+	{
+		mesh.normals.resize(vertex_count, Vector3::UnitZ());
+		// smoothing moves every vertex off the tubes, its normals are computed from the faces
+		if (!smooth)
+			target.normals = &mesh.normals;
+	}
+
+	// Runs f(i, scratch) for every i in [0, count), in parallel blocks sharing a scratch lease
+	auto for_each_in_blocks = [&](const int count, auto&& f)
+	{
+		int block_count = (count + scratch_block_size - 1) / scratch_block_size;
+		Parallel::parallel_for(
+		    block_count,
+		    [&](int block)
+		    {
+			    ScratchArena::Lease scratch = ScratchArena::lease(arena);
+			    int end = std::min(count, (block + 1) * scratch_block_size);
+			    for (int i = block * scratch_block_size; i < end; i++)
+			    {
+				    f(i, scratch.get());
+				    scratch.rewind();
+			    }
+		    },
+		    mesher.threads);
+	};
+
+	// Chains only write their own slices. Junctions read the circles of their parent node, so
+	// they are stitched once every chain is written.
+	progress(0);
+	{
+		ProfileScope scope{"chains"};
+		scope.add_counter("chains", (double)layout.chains.size());
+		for_each_in_blocks((int)layout.chains.size(),
+		                   [&](int i, std::pmr::memory_resource* scratch)
+		                   {
+			                   check_cancelled(mesher.control);
+			                   mesh_chain(layout.chains[i], resolution, &target, nullptr, scratch);
+		                   });
+	}
+	progress(.5f);
+	std::vector<IndexRange> junction_polygons; // polygons written by each junction
+	{
+		ProfileScope scope{"junctions"};
+		for (auto& junctions : layout.junction_levels)
+		{
+			scope.add_counter("junctions", (double)junctions.size());
+			size_t first = junction_polygons.size();
+			junction_polygons.resize(first + junctions.size());
+			for_each_in_blocks(
+			    (int)junctions.size(),
+			    [&](int i, std::pmr::memory_resource* scratch)
+			    {
+				    MeshCursor cursor = junctions[i].cursor;
+				    add_child_circle(junctions[i], &target, cursor, scratch);
+				    junction_polygons[first + i] = {
+				        junctions[i].cursor.polygon - layout.origin.polygon,
+				        cursor.polygon - layout.origin.polygon};
+			    });
+		}
+	}
+	std::vector<int> outside_vertices;
+	if (part != nullptr)
+	{
+		for (int index : part->kept)
+			(*part->halo)[index] = target.vertex(index);
+		outside_vertices = localize_polygons(mesh, layout.origin.vertex, *part->halo);
+	}
+
+	progress(.75f);
+	size_t written_bytes = 0; // held once the geometry is written, only measured when tracked
+	if (memory_peak != nullptr)
+	{
+		written_bytes = mesh.memory_footprint().total() + layout.get_memory_size() +
+		                get_capacity_bytes(junction_polygons) +
+		                (arena != nullptr ? arena->get_capacity() : 0) +
+		                (part != nullptr ? part->held_bytes : 0);
+		memory_peak->record(written_bytes);
+	}
+	if (smooth)
+	{
+		ProfileScope scope{"smooth_mesh"};
+		MeshProcessing::Smoothing::Adjacency adjacency;
+		{
+			ProfileScope adjacency_scope{"adjacency"};
+			adjacency.build(mesh);
+		}
+		// the iterations alternate between the vertices and a copy of them
+		if (memory_peak != nullptr)
+			memory_peak->record(written_bytes + adjacency.get_memory_size() +
+			                    get_capacity_bytes(mesh.vertices));
+		// the vertices of the earlier chunks are not moved
+		std::vector<float>& weights = target.smooth_amount.data();
+		weights.resize(mesh.vertices.size(), 0);
+		MeshProcessing::Smoothing::smooth_mesh(mesh, adjacency, mesher.smooth_iterations, 1,
+		                                       &weights, mesher.threads);
+		weights.resize(vertex_count);
+	}
+	if (!keep_smooth_amount)
+		mesh.attributes.erase(AttributeNames::smooth_amount);
+	if (mesher.compute_normals)
+	{
+		ProfileScope scope{"normals"};
+		mesh.normals.resize(mesh.vertices.size(), Vector3::UnitZ());
+		set_area_weighted_normals(mesh, smooth ? nullptr : &junction_polygons, mesher.threads);
+	}
+	if (part != nullptr)
+		globalize_polygons(mesh, layout.origin.vertex, vertex_count, outside_vertices);
+	return mesh;
+}
+
+// Chain or junction of a layout
+struct LayoutSlice
+{
+	MeshCursor cursor;
+	const ChainJob* chain; // null for junctions
+	const JunctionJob* junction;
+	int level; // of the junction
+};
+
+// Slices of the layout in buffer order, each writes at least one vertex
+std::vector<LayoutSlice> get_slices(const MeshLayout& layout)
+{
+	std::vector<LayoutSlice> slices;
+	for (auto& chain : layout.chains)
+		slices.push_back(LayoutSlice{chain.cursor, &chain, nullptr, 0});
+	for (int level = 0; level < (int)layout.junction_levels.size(); level++)
+		for (auto& junction : layout.junction_levels[level])
+			slices.push_back(LayoutSlice{junction.cursor, nullptr, &junction, level});
+	std::sort(slices.begin(), slices.end(), [](const LayoutSlice& a, const LayoutSlice& b)
+	          { return a.cursor.vertex < b.cursor.vertex; });
+	return slices;
+}
+
+// Vertices written before a slice that its faces use: the base circle of a side branch chain, the
+// circles of the parent node of a junction, whose positions it reads
+std::pmr::vector<int> get_earlier_vertices(const LayoutSlice& slice,
+                                           std::pmr::memory_resource* scratch)
+{
+	if (slice.junction != nullptr)
+	{
+		const JunctionJob& junction = *slice.junction;
+		const CircleDesignator& parent_base = junction.parent_base;
+		int child_radial_n = get_child_radial_n(junction.child_range, parent_base.radial_n);
+		return get_child_index_order(parent_base, junction.parent_end, child_radial_n,
+		                             junction.child_range, scratch);
+	}
+	std::pmr::vector<int> vertices(scratch);
+	if (!slice.chain->add_start_circle)
+	{
+		vertices.resize(slice.chain->base.radial_n);
+		std::iota(vertices.begin(), vertices.end(), slice.chain->base.vertex_index);
+	}
+	return vertices;
+}
+
+// First slice of every chunk, followed by the slice count. Chunks hold whole stems when they fit,
+// larger stems are split between their slices.
+std::vector<size_t> get_chunk_bounds(std::span<const LayoutSlice> slices, const MeshCursor& size,
+                                     const int chunk_vertices)
+{
+	auto end_vertex = [&](const size_t slice)
+	{ return slice < slices.size() ? slices[slice].cursor.vertex : size.vertex; };
+	std::vector<size_t> bounds{0};
+	size_t stem_start = 0;
+	while (stem_start < slices.size())
+	{
+		size_t stem_end = stem_start + 1;
+		while (stem_end < slices.size() &&
+		       (slices[stem_end].chain == nullptr || !slices[stem_end].chain->add_start_circle))
+			stem_end++;
+		int chunk_start = slices[bounds.back()].cursor.vertex;
+		if (end_vertex(stem_end) - chunk_start > chunk_vertices)
+		{
+			if (stem_start > bounds.back())
+				bounds.push_back(stem_start);
+			for (size_t i = stem_start + 1; i < stem_end; i++)
+				if (end_vertex(i + 1) - slices[bounds.back()].cursor.vertex > chunk_vertices)
+					bounds.push_back(i);
+		}
+		stem_start = stem_end;
+	}
+	bounds.push_back(slices.size());
+	return bounds;
+}
+
+// Chains and junctions of the slices [first, last)
+MeshLayout get_layout_part(std::span<const LayoutSlice> slices, const size_t first,
+                           const size_t last, const MeshCursor& size)
+{
+	MeshLayout part;
+	part.origin = slices[first].cursor;
+	part.size = last < slices.size() ? slices[last].cursor : size;
+	for (size_t i = first; i < last; i++)
+	{
+		if (slices[i].chain != nullptr)
+		{
+			part.chains.push_back(*slices[i].chain);
+			continue;
+		}
+		if ((int)part.junction_levels.size() <= slices[i].level)
+			part.junction_levels.resize(slices[i].level + 1);
+		part.junction_levels[slices[i].level].push_back(*slices[i].junction);
+	}
+	return part;
+}
+
+// Vertices every chunk adds to the halo, and the ones it removes once written
+struct HaloPlan
+{
+	std::vector<std::vector<int>> kept;
+	std::vector<std::vector<int>> released;
+
+	size_t get_memory_size() const
+	{
+		size_t bytes = get_capacity_bytes(kept) + get_capacity_bytes(released);
+		for (size_t i = 0; i < kept.size(); i++)
+			bytes += get_capacity_bytes(kept[i]) + get_capacity_bytes(released[i]);
+		return bytes;
+	}
+};
+
+// Keeps every vertex used by a later chunk from the chunk writing it to the last one using it
+HaloPlan plan_halo(std::span<const LayoutSlice> slices, std::span<const size_t> bounds,
+                   ScratchArena* arena)
+{
+	ScratchArena::Lease scratch = ScratchArena::lease(arena);
+	std::unordered_map<int, int> last_chunk;
+	for (int chunk = 0; chunk + 1 < (int)bounds.size(); chunk++)
+	{
+		int origin = slices[bounds[chunk]].cursor.vertex;
+		for (size_t i = bounds[chunk]; i < bounds[chunk + 1]; i++)
+		{
+			for (int vertex : get_earlier_vertices(slices[i], scratch.get()))
+				if (vertex < origin)
+					last_chunk[vertex] = chunk;
+			scratch.rewind();
 		}
 	}
+
+	int chunk_count = (int)bounds.size() - 1;
+	HaloPlan plan{std::vector<std::vector<int>>(chunk_count),
+	              std::vector<std::vector<int>>(chunk_count)};
+	for (auto [vertex, chunk] : last_chunk)
+	{
+		auto first_after = std::upper_bound(bounds.begin(), bounds.end() - 1, vertex,
+		                                    [&](const int value, const size_t bound)
+		                                    { return value < slices[bound].cursor.vertex; });
+		plan.kept[first_after - bounds.begin() - 1].push_back(vertex);
+		plan.released[chunk].push_back(vertex);
+	}
+	return plan;
 }
 } // namespace
 
@@ -446,41 +1285,130 @@ namespace Mtree
 
 Mesh ManifoldMesher::mesh_tree(Tree& tree)
 {
-	Mesh mesh;
-	auto& smooth_attr = mesh.add_attribute<float>(AttributeNames::smooth_amount);
-	auto& radius_attr = mesh.add_attribute<float>(AttributeNames::radius);
-	auto& direction_attr = mesh.add_attribute<Vector3>(AttributeNames::direction);
-	// Pivot Painter 2.0 attributes
-	auto& stem_id_attr = mesh.add_attribute<float>(AttributeNames::stem_id);
-	auto& hierarchy_depth_attr = mesh.add_attribute<float>(AttributeNames::hierarchy_depth);
-	auto& pivot_position_attr = mesh.add_attribute<Vector3>(AttributeNames::pivot_position);
-	auto& branch_extent_attr = mesh.add_attribute<float>(AttributeNames::branch_extent);
-	// Phyllotaxis attribute
-	auto& phyllotaxis_attr = mesh.add_attribute<float>(AttributeNames::phyllotaxis_angle);
+	ProfilerBinding profiling{tree.get_active_profiler()};
+	ProfileScope scope{"ManifoldMesher"};
+	RingResolution resolution = get_ring_resolution(*this);
+	int stem_id_counter = 0;
+	MeshLayout layout;
+	{
+		ProfileScope plan_scope{"plan"};
+		layout = plan_mesh_layout(tree.get_stems(), radial_resolution, resolution, stem_id_counter,
+		                          &tree.get_scratch_arena());
+	}
+	Mesh mesh = build_mesh(*this, layout, resolution, &tree.get_scratch_arena(),
+	                       tree.get_active_meshing_memory());
+	scope.add_counter("vertices", (double)mesh.vertices.size());
+	scope.add_counter("polygons", (double)mesh.polygons.size());
+	return mesh;
+}
 
+void ManifoldMesher::stream_tree(Tree& tree, MeshSink& sink)
+{
+	// The tree is planned once, then every chunk is written, smoothed and handed to the sink before
+	// the next one is built. The vertices a chunk uses from the earlier ones wait in a halo.
+	ProfilerBinding profiling{tree.get_active_profiler()};
+	ProfileScope scope{"ManifoldMesher.stream"};
+	RingResolution resolution = get_ring_resolution(*this);
+	MemoryPeak* memory_peak = tree.get_active_meshing_memory();
 	int stem_id_counter = 0;
-	for (auto& stem : tree.get_stems())
+	MeshLayout layout;
 	{
-		//__debugbreak();
+		ProfileScope plan_scope{"plan"};
+		layout = plan_mesh_layout(tree.get_stems(), radial_resolution, resolution, stem_id_counter,
+		                          &tree.get_scratch_arena());
+	}
+	sink.begin(MeshCounts{layout.size.vertex, layout.size.uv, layout.size.polygon});
+	std::vector<LayoutSlice> slices = get_slices(layout);
+	std::vector<size_t> bounds = get_chunk_bounds(slices, layout.size, chunk_vertices);
+	HaloPlan halo_plan = plan_halo(slices, bounds, &tree.get_scratch_arena());
+	std::unordered_map<int, Vector3> halo;
+	size_t plan_bytes =
+	    layout.get_memory_size() + get_capacity_bytes(slices) + get_capacity_bytes(bounds) +
+	    halo_plan.get_memory_size();
 
-		if (stem.node.children.size() == 0)
+	for (size_t chunk = 0; chunk + 1 < bounds.size(); chunk++)
+	{
+		if (bounds[chunk] == bounds[chunk + 1])
 			continue;
+		check_cancelled(control);
+		MeshLayout part = get_layout_part(slices, bounds[chunk], bounds[chunk + 1], layout.size);
+		size_t halo_bytes = (halo.size() + halo_plan.kept[chunk].size()) *
+		                        (sizeof(std::pair<const int, Vector3>) + sizeof(void*)) +
+		                    halo.bucket_count() * sizeof(void*);
+		StreamedPart streamed{&halo, halo_plan.kept[chunk], plan_bytes + halo_bytes};
+		Mesh mesh = build_mesh(*this, part, resolution, &tree.get_scratch_arena(), memory_peak,
+		                       (float)part.origin.vertex / layout.size.vertex,
+		                       (float)part.size.vertex / layout.size.vertex, &streamed);
+		for (int vertex : halo_plan.released[chunk])
+			halo.erase(vertex);
 
-		// Initialize Pivot Painter context for this stem
-		PivotPainterContext pp_ctx;
-		pp_ctx.stem_id = stem_id_counter++;
-		pp_ctx.hierarchy_depth = 0;
-		pp_ctx.pivot_position = stem.position;
-		pp_ctx.branch_extent = calculate_branch_extent(stem.node);
+		ProfileScope write_scope{"write"};
+		sink.write(MeshChunk{mesh, part.origin.vertex, part.origin.uv, part.origin.polygon});
+		scope.add_counter("chunks", 1);
+		scope.add_counter("vertices", (double)mesh.vertices.size());
+	}
+	sink.end();
+}
 
-		CircleDesignator start_circle{(int)mesh.vertices.size(), (int)mesh.uvs.size(),
-		                              radial_resolution};
-		add_circle(stem.position, stem.node, 0, radial_resolution, mesh, 0, pp_ctx, 0);
-		mesh_node_rec(stem.node, stem.position, start_circle, mesh, 0, pp_ctx, stem_id_counter, 1);
+std::vector<Mesh> ManifoldMesher::mesh_tree_lods(Tree& tree, const std::vector<float>& tolerances)
+{
+	ProfilerBinding profiling{tree.get_active_profiler()};
+	ProfileScope scope{"ManifoldMesher.lods"};
+	std::vector<RingResolution> resolutions;
+	for (float tolerance : tolerances)
+	{
+		RingResolution resolution = get_ring_resolution(*this);
+		resolution.adaptive = true;
+		resolution.tolerance = tolerance;
+		resolutions.push_back(resolution);
 	}
-	if (smooth_iterations > 0)
-		MeshProcessing::Smoothing::smooth_mesh(mesh, smooth_iterations, 1, &smooth_attr.data);
-	return mesh;
+	int stem_id_counter = 0;
+	std::vector<MeshLayout> layouts;
+	{
+		ProfileScope plan_scope{"plan"};
+		layouts = plan_mesh_layouts(tree.get_stems(), radial_resolution, resolutions,
+		                            stem_id_counter, &tree.get_scratch_arena());
+	}
+
+	// levels are built in parallel, each on a single thread
+	ManifoldMesher level_mesher = *this;
+	level_mesher.threads = 1;
+	std::vector<Mesh> meshes(tolerances.size());
+	Parallel::parallel_for(
+	    (int)tolerances.size(),
+	    [&](int i)
+	    {
+		    meshes[i] = build_mesh(level_mesher, layouts[i], resolutions[i],
+		                           &tree.get_scratch_arena(), tree.get_active_meshing_memory());
+	    },
+	    threads);
+	return meshes;
+}
+
+AttributeFormats ManifoldMesher::get_compact_attribute_formats()
+{
+	return {{AttributeNames::smooth_amount, PackedFormat::Float16},
+	        {AttributeNames::radius, PackedFormat::Float16},
+	        {AttributeNames::direction, PackedFormat::Snorm16},
+	        {AttributeNames::stem_id, PackedFormat::UInt16},
+	        {AttributeNames::hierarchy_depth, PackedFormat::UInt16},
+	        {AttributeNames::pivot_position, PackedFormat::Float16},
+	        {AttributeNames::branch_extent, PackedFormat::Float16},
+	        {AttributeNames::phyllotaxis_angle, PackedFormat::Float16},
+	        {AttributeNames::wind_stiffness, PackedFormat::Float16},
+	        {AttributeNames::wind_phase, PackedFormat::Float16},
+	        {AttributeNames::wind_parent_id, PackedFormat::UInt16},
+	        {AttributeNames::wind_grandparent_id, PackedFormat::UInt16}};
+}
+
+MeshCounts ManifoldMesher::predict_counts(Tree& tree)
+{
+	int stem_id_counter = 0;
+	MeshCursor size = plan_mesh_layout(tree.get_stems(), radial_resolution,
+	                                   get_ring_resolution(*this), stem_id_counter,
+	                                   &tree.get_scratch_arena())
+	                      .size;
+	return MeshCounts{size.vertex, size.uv, size.polygon};
 }
 
 } // namespace Mtree
@@ -1,7 +1,9 @@
 #pragma once
 #include "../base_types/TreeMesher.hpp"
+#include "source/mesh/AttributePacking.hpp"
 #include <string>
 #include <tuple>
+#include <vector>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -25,11 +27,52 @@ class ManifoldMesher : public TreeMesher
 		inline static std::string branch_extent = "branch_extent";
 		// Phyllotaxis attribute
 		inline static std::string phyllotaxis_angle = "phyllotaxis_angle";
+		// Wind attributes, baked with the mesh when requested. The stiffness of a branch, in
+		// [0, 1), grows with its radius over its extent (see wind_stiffness_scale). Its phase, in
+		// [0, 1), is the one of its parent offset by its phyllotaxis angle. The parent and
+		// grandparent ids are the stem ids of the two branches above it, stems being their own
+		// parent: a vertex gives the first two levels of its pivot chain, deeper levels are
+		// found from the ids of the grandparent vertices.
+		inline static std::string wind_stiffness = "wind_stiffness";
+		inline static std::string wind_phase = "wind_phase";
+		inline static std::string wind_parent_id = "wind_parent_id";
+		inline static std::string wind_grandparent_id = "wind_grandparent_id";
 	};
 
+	// Compact export of the attributes: half floats, snorm16 directions, uint16 stem ids, parent
+	// and grandparent ids and hierarchy depths
+	static AttributeFormats get_compact_attribute_formats();
+
 	int radial_resolution = 8;
 	int smooth_iterations = 4;
+	int threads = 1; // 0 uses every hardware thread
+	// Radius driven resolution: the circles of a branch drop to the fewest vertices (down to
+	// min_radial_resolution) keeping them within resolution_tolerance of the true surface
+	bool adaptive_resolution = false;
+	float resolution_tolerance = .005f;
+	int min_radial_resolution = 4;
+	// Stiffness of a branch of radius r and extent e: x / (1 + x), for x = scale * r / e
+	float wind_stiffness_scale = 10;
+	// Fills Mesh::normals: analytic normals of the branch tubes and area weighted normals of the
+	// junction vertices, or area weighted normals of every vertex once the mesh is smoothed
+	bool compute_normals = false;
+	// Vertices per chunk streamed by stream_tree, only a single branch larger than the bound makes
+	// a larger chunk. Stems fitting in a chunk are meshed whole, as mesh_tree does. Larger ones are
+	// split between their branches and each piece is smoothed and shaded on its own, the vertices
+	// of the earlier pieces staying in place: the mesh only differs along the splits.
+	int chunk_vertices = 1 << 16;
+	// Attributes written to the mesh, the others are not computed
+	std::vector<std::string> attributes = {
+	    AttributeNames::smooth_amount,   AttributeNames::radius,
+	    AttributeNames::direction,       AttributeNames::stem_id,
+	    AttributeNames::hierarchy_depth, AttributeNames::pivot_position,
+	    AttributeNames::branch_extent,   AttributeNames::phyllotaxis_angle};
 	Mesh mesh_tree(Tree& tree) override;
+	void stream_tree(Tree& tree, MeshSink& sink) override;
+	// One adaptive mesh per tolerance, coarser for larger tolerances. The tree is walked once for
+	// every level, whose meshes are then built in parallel, each on a single thread.
+	std::vector<Mesh> mesh_tree_lods(Tree& tree, const std::vector<float>& tolerances);
+	MeshCounts predict_counts(Tree& tree) override;
 };
 
 } // namespace Mtree
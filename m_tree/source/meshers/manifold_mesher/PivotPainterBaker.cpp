@@ -0,0 +1,243 @@
+#include "PivotPainterBaker.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace Mtree
+{
+
+namespace
+{
+// Number of vertices handled by a single parallel task
+constexpr int vertex_block_size = 4096;
+
+// Golden ratio conjugate, spreads consecutive stem ids over [0, 1)
+constexpr double golden_ratio_conjugate = 0.61803398875;
+
+Vector3 get_x_vector(const Vector3& direction)
+{
+	float length = direction.norm();
+	if (length <= 1e-6f)
+		return Vector3::UnitZ();
+	return (direction / length).cwiseMax(-1).cwiseMin(1);
+}
+
+// Stem id of a vertex, -1 when the attribute doesn't hold one
+int to_stem_id(const float value)
+{
+	return value >= 0 && value < 1 << 24 ? (int)std::lround(value) : -1;
+}
+
+// Index of the branch of every stem id, -1 for ids without a branch
+std::vector<int> get_branch_indices(std::span<const PivotPainterBranch> branches)
+{
+	int max_id = -1;
+	for (const auto& branch : branches)
+		max_id = std::max(max_id, branch.stem_id);
+	std::vector<int> indices((size_t)max_id + 1, -1);
+	for (size_t i = 0; i < branches.size(); i++)
+		if (branches[i].stem_id >= 0)
+			indices[branches[i].stem_id] = (int)i;
+	return indices;
+}
+
+template <typename F>
+void for_each_vertex_block(const size_t vertex_count, const int threads, F&& f)
+{
+	int block_count = (int)((vertex_count + vertex_block_size - 1) / vertex_block_size);
+	Parallel::parallel_for(
+	    block_count,
+	    [&](int block)
+	    {
+		    size_t end = std::min(vertex_count, (size_t)(block + 1) * vertex_block_size);
+		    for (size_t i = (size_t)block * vertex_block_size; i < end; i++)
+			    f(i);
+	    },
+	    threads);
+}
+} // namespace
+
+std::vector<PivotPainterBranch> PivotPainterBaker::collect_branches(std::span<Stem> stems) const
+{
+	struct PendingBranch
+	{
+		const Node* node;
+		Vector3 pivot_position;
+		int hierarchy_depth;
+	};
+
+	// Same order as the layout of ManifoldMesher: side branches are stacked while walking the
+	// main continuation of a branch, the ones of a same node in reverse order
+	std::vector<PendingBranch> branches;
+	std::vector<PendingBranch> pending;
+	auto add_branch = [&](const PendingBranch& branch)
+	{
+		branches.push_back(branch);
+		const Node* node = branch.node;
+		Vector3 position = branch.pivot_position;
+		while (true)
+		{
+			for (int i = (int)node->children.size() - 1; node->children.size() > 1 && i > 0; i--)
+			{
+				const NodeChild& child = *node->children[i];
+				pending.push_back(PendingBranch{
+				    &child.node, NodeUtilities::get_side_branch_pivot(*node, child, position),
+				    branch.hierarchy_depth + 1});
+			}
+			if (node->is_leaf())
+				break;
+			position = NodeUtilities::get_position_in_node(position, *node, 1);
+			node = &node->children[0]->node;
+		}
+	};
+	for (auto& stem : stems)
+	{
+		if (stem.node.children.size() == 0)
+			continue; // not meshed
+		add_branch(PendingBranch{&stem.node, stem.position, 0});
+		while (!pending.empty())
+		{
+			PendingBranch branch = pending.back();
+			pending.pop_back();
+			add_branch(branch);
+		}
+	}
+
+	std::vector<PivotPainterBranch> result(branches.size());
+	Parallel::parallel_for(
+	    (int)branches.size(),
+	    [&](int i)
+	    {
+		    const PendingBranch& branch = branches[i];
+		    result[i] = PivotPainterBranch{i, branch.hierarchy_depth, branch.pivot_position,
+		                                   get_x_vector(branch.node->direction),
+		                                   NodeUtilities::get_branch_extent(*branch.node)};
+	    },
+	    threads);
+	return result;
+}
+
+std::vector<PivotPainterBranch> PivotPainterBaker::collect_branches(
+    std::span<const float> stem_ids, std::span<const float> hierarchy_depths,
+    std::span<const Vector3> pivot_positions, std::span<const Vector3> directions,
+    std::span<const float> extents) const
+{
+	size_t vertex_count = stem_ids.size();
+	if (hierarchy_depths.size() != vertex_count || pivot_positions.size() != vertex_count ||
+	    directions.size() != vertex_count || extents.size() != vertex_count)
+		throw std::invalid_argument("Pivot Painter attributes must have one element per vertex");
+
+	std::vector<int> first_vertices;
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		int id = to_stem_id(stem_ids[i]);
+		if (id < 0)
+			continue;
+		if (id >= (int)first_vertices.size())
+			first_vertices.resize((size_t)id + 1, -1);
+		if (first_vertices[id] < 0)
+			first_vertices[id] = (int)i;
+	}
+
+	std::vector<PivotPainterBranch> branches;
+	for (size_t id = 0; id < first_vertices.size(); id++)
+	{
+		int i = first_vertices[id];
+		if (i < 0)
+			continue;
+		branches.push_back(PivotPainterBranch{(int)id, (int)std::lround(hierarchy_depths[i]),
+		                                      pivot_positions[i], get_x_vector(directions[i]),
+		                                      extents[i]});
+	}
+	return branches;
+}
+
+void PivotPainterBaker::bake_textures(std::span<const PivotPainterBranch> branches,
+                                      const PackedFormat format, void* pivot_index,
+                                      void* xvector_extent) const
+{
+	if (format != PackedFormat::Float32 && format != PackedFormat::Float16)
+		throw std::invalid_argument("Pivot Painter textures are Float32 or Float16");
+	if (texture_size <= 0)
+		throw std::invalid_argument("Pivot Painter texture size must be positive");
+	size_t texel_count = (size_t)texture_size * texture_size;
+	size_t texel_size = 4 * get_packed_scalar_size(format);
+	std::memset(pivot_index, 0, texel_count * texel_size);
+	std::memset(xvector_extent, 0, texel_count * texel_size);
+
+	auto write_texel = [&](void* texture, const int texel, const Vector3& rgb, const float alpha)
+	{
+		float values[4] = {rgb.x(), rgb.y(), rgb.z(), alpha};
+		char* destination = static_cast<char*>(texture) + (size_t)texel * texel_size;
+		if (format == PackedFormat::Float32)
+		{
+			std::memcpy(destination, values, sizeof(values));
+			return;
+		}
+		uint16_t halves[4];
+		for (int i = 0; i < 4; i++)
+			halves[i] = float_to_half(values[i]);
+		std::memcpy(destination, halves, sizeof(halves));
+	};
+	Parallel::parallel_for(
+	    (int)branches.size(),
+	    [&](int i)
+	    {
+		    const PivotPainterBranch& branch = branches[i];
+		    if (branch.stem_id < 0 || (size_t)branch.stem_id >= texel_count)
+			    return;
+		    write_texel(pivot_index, branch.stem_id, branch.pivot_position,
+		                (float)branch.hierarchy_depth);
+		    write_texel(xvector_extent, branch.stem_id, branch.x_vector, branch.extent);
+	    },
+	    threads);
+}
+
+void PivotPainterBaker::bake_vertex_colors(std::span<const PivotPainterBranch> branches,
+                                           std::span<const float> stem_ids, uint8_t* colors) const
+{
+	float max_depth = 1;
+	float max_extent = 1;
+	for (const auto& branch : branches)
+	{
+		max_depth = std::max(max_depth, (float)branch.hierarchy_depth);
+		max_extent = std::max(max_extent, branch.extent);
+	}
+	std::vector<int> branch_indices = get_branch_indices(branches);
+	auto to_unorm8 = [](const double value)
+	{ return (uint8_t)std::lround(std::clamp(value, 0., 1.) * 255); };
+
+	for_each_vertex_block(
+	    stem_ids.size(), threads,
+	    [&](size_t i)
+	    {
+		    uint8_t* color = colors + i * 4;
+		    int id = to_stem_id(stem_ids[i]);
+		    int branch = id >= 0 && id < (int)branch_indices.size() ? branch_indices[id] : -1;
+		    float depth = branch < 0 ? 0 : (float)branches[branch].hierarchy_depth;
+		    float extent = branch < 0 ? 0 : branches[branch].extent;
+		    double hash = std::fmod(std::max(id, 0) * golden_ratio_conjugate, 1.);
+		    color[0] = to_unorm8(depth / max_depth);
+		    color[1] = to_unorm8(extent / max_extent);
+		    color[2] = to_unorm8(hash);
+		    color[3] = 255;
+	    });
+}
+
+void PivotPainterBaker::bake_lookup_uvs(std::span<const float> stem_ids, float* uvs) const
+{
+	if (texture_size <= 0)
+		throw std::invalid_argument("Pivot Painter texture size must be positive");
+	for_each_vertex_block(stem_ids.size(), threads,
+	                      [&](size_t i)
+	                      {
+		                      int id = std::max(to_stem_id(stem_ids[i]), 0);
+		                      uvs[i * 2] = (id % texture_size + .5f) / texture_size;
+		                      uvs[i * 2 + 1] = (id / texture_size + .5f) / texture_size;
+	                      });
+}
+
+} // namespace Mtree
@@ -0,0 +1,54 @@
+#pragma once
+#include "source/mesh/AttributePacking.hpp"
+#include "source/tree/Node.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Mtree
+{
+
+// Pivot Painter 2.0 data of one branch, keyed by the stem id ManifoldMesher gives its vertices
+struct PivotPainterBranch
+{
+	int stem_id = 0;
+	int hierarchy_depth = 0;
+	Vector3 pivot_position = Vector3::Zero();
+	Vector3 x_vector = Vector3::UnitZ(); // normalized direction of the branch
+	float extent = 0;
+};
+
+// Bakes Pivot Painter 2.0 textures and vertex colors into preallocated buffers. The texel of a
+// branch is at column stem_id % texture_size of row stem_id / texture_size, branches beyond the
+// last row are skipped.
+class PivotPainterBaker
+{
+  public:
+	int texture_size = 1024;
+	int threads = 1; // 0 uses every hardware thread
+
+	// Every branch of the stems in stem id order, walking the tree once in the order of
+	// ManifoldMesher
+	std::vector<PivotPainterBranch> collect_branches(std::span<Stem> stems) const;
+	// Branches of a mesh of ManifoldMesher from its per-vertex attributes, each taken from the
+	// first vertex of its stem id. Sorted by stem id.
+	std::vector<PivotPainterBranch> collect_branches(std::span<const float> stem_ids,
+	                                                 std::span<const float> hierarchy_depths,
+	                                                 std::span<const Vector3> pivot_positions,
+	                                                 std::span<const Vector3> directions,
+	                                                 std::span<const float> extents) const;
+
+	// Unreal textures of texture_size * texture_size RGBA texels: PivotPos_Index (pivot
+	// position, hierarchy depth) and XVector_Extent (x vector, extent). format is Float32 or
+	// Float16 (RGBA16F), texels without a branch are zero.
+	void bake_textures(std::span<const PivotPainterBranch> branches, const PackedFormat format,
+	                   void* pivot_index, void* xvector_extent) const;
+	// Unity RGBA8 vertex colors: hierarchy depth and extent normalized by their maximum (at
+	// least 1), golden ratio hash of the stem id, 255
+	void bake_vertex_colors(std::span<const PivotPainterBranch> branches,
+	                        std::span<const float> stem_ids, uint8_t* colors) const;
+	// Per-vertex uv of the texel of its branch, two floats per vertex
+	void bake_lookup_uvs(std::span<const float> stem_ids, float* uvs) const;
+};
+
+} // namespace Mtree
@@ -1,77 +1,149 @@
 #include "smoothing.hpp"
 #include "source/utilities/GeometryUtilities.hpp"
+#include "source/utilities/Parallel.hpp"
+#include "source/utilities/Profiler.hpp"
+#include <algorithm>
 
 namespace Mtree::MeshProcessing::Smoothing
 {
-void add_index_no_duplicates(std::vector<int>& indices, const int index)
+namespace
 {
-	for (auto i : indices)
+// Number of vertices smoothed by a single parallel task
+constexpr int smoothing_block_size = 4096;
+
+// Adds index to the end of a neighbourhood if it is not already part of it.
+// Neighbourhoods hold a handful of vertices, a linear scan over contiguous ints is the fastest.
+void add_index_no_duplicates(int* indices, int& count, const int index)
+{
+	for (int i = 0; i < count; i++)
 	{
-		if (index == i)
+		if (indices[i] == index)
 		{
 			return;
 		}
 	}
-	indices.push_back(index);
+	indices[count++] = index;
 }
 
-std::vector<std::vector<int>> get_neighbourhoods(Mtree::Mesh& mesh)
+template <typename F> void for_each_edge(const Mesh& mesh, F&& f)
 {
-	std::vector<std::vector<int>> vertex_neighbourhood;
-	vertex_neighbourhood.resize(mesh.vertices.size());
 	for (auto& polygon : mesh.polygons)
 	{
-		for (int i = 1; i < polygon.size(); i += 1)
+		for (size_t i = 1; i < polygon.size(); i += 1)
 		{
-			int i1 = polygon[i];
-			int i2 = polygon[(i + 1) % polygon.size()];
-			add_index_no_duplicates(vertex_neighbourhood[i1], i2);
-			add_index_no_duplicates(vertex_neighbourhood[i2], i1);
+			// triangles repeat their last vertex
+			if (polygon[i] != polygon[(i + 1) % polygon.size()])
+				f(polygon[i], polygon[(i + 1) % polygon.size()]);
 		}
 	}
-	return vertex_neighbourhood;
 }
 
-void smooth_mesh_once(std::vector<Vector3>* result, const std::vector<Vector3>* previous_iteration,
-                      const std::vector<std::vector<int>>& neighbourhoods, float factor,
-                      std::vector<float>* weights = nullptr)
+void smooth_mesh_once(Vector3* result, const Vector3* previous_iteration, const int vertex_count,
+                      const Adjacency& adjacency, const float factor, const float* weights,
+                      const int threads)
+{
+	const int* offsets = adjacency.offsets.data();
+	const int* neighbours = adjacency.neighbours.data();
+	int block_count = (vertex_count + smoothing_block_size - 1) / smoothing_block_size;
+
+	Parallel::parallel_for(
+	    block_count,
+	    [&](int block)
+	    {
+		    int end = std::min(vertex_count, (block + 1) * smoothing_block_size);
+		    for (int i = block * smoothing_block_size; i < end; i++)
+		    {
+			    int start = offsets[i];
+			    int count = offsets[i + 1] - start;
+			    if (count <= 1)
+			    {
+				    continue;
+			    }
+			    Vector3 barycenter{0, 0, 0};
+			    for (int j = start; j < start + count; j++)
+			    {
+				    barycenter += previous_iteration[neighbours[j]];
+			    }
+			    barycenter /= (size_t)count;
+			    float true_factor = factor;
+			    if (weights != nullptr)
+			    {
+				    true_factor *= weights[i];
+			    }
+			    result[i] = Geometry::lerp(previous_iteration[i], barycenter, true_factor);
+		    }
+	    },
+	    threads);
+}
+} // namespace
+
+void Adjacency::build(const Mesh& mesh)
 {
-	for (size_t i = 0; i < result->size(); i++)
+	int vertex_count = (int)mesh.vertices.size();
+
+	// every edge adds at most one neighbour to each of its vertices
+	std::vector<int> capacity_offsets(vertex_count + 1, 0);
+	for_each_edge(mesh,
+	              [&](int i1, int i2)
+	              {
+		              capacity_offsets[i1 + 1]++;
+		              capacity_offsets[i2 + 1]++;
+	              });
+	for (int i = 0; i < vertex_count; i++)
+		capacity_offsets[i + 1] += capacity_offsets[i];
+
+	std::vector<int> slots(capacity_offsets.back());
+	std::vector<int> counts(vertex_count, 0);
+	for_each_edge(mesh,
+	              [&](int i1, int i2)
+	              {
+		              add_index_no_duplicates(&slots[capacity_offsets[i1]], counts[i1], i2);
+		              add_index_no_duplicates(&slots[capacity_offsets[i2]], counts[i2], i1);
+	              });
+
+	offsets.resize(vertex_count + 1);
+	offsets[0] = 0;
+	for (int i = 0; i < vertex_count; i++)
+		offsets[i + 1] = offsets[i] + counts[i];
+	neighbours.resize(offsets.back());
+	for (int i = 0; i < vertex_count; i++)
 	{
-		if (neighbourhoods[i].size() <= 1)
-		{
-			continue;
-		}
-		Vector3 barycenter{0, 0, 0};
-		for (auto neighbour : neighbourhoods[i])
-		{
-			barycenter += previous_iteration->at(neighbour);
-		}
-		barycenter /= neighbourhoods[i].size();
-		float true_factor = factor;
-		if (weights != nullptr)
-		{
-			true_factor *= (*weights)[i];
-		}
-		result->at(i) = Geometry::lerp(previous_iteration->at(i), barycenter, true_factor);
+		std::copy_n(slots.begin() + capacity_offsets[i], counts[i],
+		            neighbours.begin() + offsets[i]);
+	}
+}
+
+void smooth_mesh(Mesh& mesh, const int iterations, const float factor, std::vector<float>* weights,
+                 const int threads)
+{
+	ProfileScope scope{"smooth_mesh"};
+	Adjacency adjacency;
+	{
+		ProfileScope adjacency_scope{"adjacency"};
+		adjacency.build(mesh);
 	}
+	smooth_mesh(mesh, adjacency, iterations, factor, weights, threads);
 }
 
-void smooth_mesh(Mesh& mesh, const int iterations, const float factor, std::vector<float>* weights)
+void smooth_mesh(Mesh& mesh, const Adjacency& adjacency, const int iterations, const float factor,
+                 std::vector<float>* weights, const int threads)
 {
-	auto neighbourhoods = get_neighbourhoods(mesh);
+	ProfileScope scope{"iterations"};
+	scope.add_counter("vertices", (double)mesh.vertices.size());
+	scope.add_counter("iterations", iterations);
 	std::vector<Vector3>* previous_iteration = &mesh.vertices;
 	std::vector<Vector3> buffer = mesh.vertices;
 	std::vector<Vector3>* result = &buffer;
+	const float* weights_data = weights != nullptr ? weights->data() : nullptr;
 
-	for (size_t i = 0; i < iterations; i++)
+	for (int i = 0; i < iterations; i++)
 	{
-		smooth_mesh_once(result, previous_iteration, neighbourhoods, factor, weights);
-		auto tmp = result;
-		result = previous_iteration;
-		previous_iteration = tmp;
+		smooth_mesh_once(result->data(), previous_iteration->data(), (int)result->size(),
+		                 adjacency, factor, weights_data, threads);
+		std::swap(result, previous_iteration);
 	}
-	if (result != &mesh.vertices)
+	// once swapped, previous_iteration holds the last iteration: the copy after an odd count
+	if (previous_iteration != &mesh.vertices)
 	{
 		mesh.vertices = std::move(buffer);
 	}
@@ -3,6 +3,24 @@
 
 namespace Mtree::MeshProcessing::Smoothing
 {
+// Vertex adjacency in compressed sparse row layout: the neighbours of vertex i are
+// neighbours[offsets[i]] to neighbours[offsets[i + 1] - 1], in the order they are met in the
+// polygons.
+struct Adjacency
+{
+	std::vector<int> offsets;
+	std::vector<int> neighbours;
+
+	void build(const Mesh& mesh);
+	int degree(const int vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+	size_t get_memory_size() const
+	{
+		return get_capacity_bytes(offsets) + get_capacity_bytes(neighbours);
+	}
+};
+
 void smooth_mesh(Mesh& mesh, const int iterations, const float factor,
-                 std::vector<float>* weights = nullptr);
-}
+                 std::vector<float>* weights = nullptr, const int threads = 1);
+void smooth_mesh(Mesh& mesh, const Adjacency& adjacency, const int iterations, const float factor,
+                 std::vector<float>* weights = nullptr, const int threads = 1);
+} // namespace Mtree::MeshProcessing::Smoothing
@@ -1,5 +1,8 @@
 #include "BasicMesher.hpp"
+#include "source/tree/NodeArena.hpp"
 #include "source/utilities/GeometryUtilities.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Profiler.hpp"
 #include <iostream>
 #include <queue>
 
@@ -8,42 +11,41 @@ namespace Mtree
 std::vector<std::vector<BasicMesher::SplinePoint>>
 BasicMesher::get_splines(std::vector<Stem>& stems)
 {
+	struct Visit
+	{
+		Vector3 position;
+		bool starts_spline; // every child but the first starts a new spline
+	};
+
 	std::vector<std::vector<SplinePoint>> splines;
+	auto add_node = [&](Node& node, const Visit& visit, auto&& visit_child)
+	{
+		if (visit.starts_spline)
+			splines.push_back(std::vector<SplinePoint>{});
+		splines.back().push_back(SplinePoint{visit.position, node.direction, node.radius});
+		if (node.children.size() == 0)
+		{
+			splines.back().push_back(SplinePoint{visit.position + node.direction * node.length,
+			                                     node.direction, node.radius});
+			return;
+		}
+		for (size_t i = 0; i < node.children.size(); i++)
+		{
+			NodeChild& child = *node.children[i];
+			Vector3 child_position =
+			    visit.position + node.direction * node.length * child.position_in_parent;
+			visit_child(child.node, Visit{child_position, i > 0});
+		}
+	};
 
 	for (Stem& stem : stems)
 	{
-		Node* stem_node = &stem.node;
-		Vector3 stem_position = stem.position;
 		splines.push_back(std::vector<SplinePoint>{});
-		get_splines_rec(splines, stem_node, stem_position);
+		NodeUtilities::visit_pre_order(stem.node, Visit{stem.position, false}, add_node);
 	}
 	return splines;
 }
 
-void BasicMesher::get_splines_rec(std::vector<std::vector<SplinePoint>>& splines,
-                                  Node* current_node, Vector3 current_position)
-{
-	splines.back().push_back(
-	    SplinePoint{current_position, current_node->direction, current_node->radius});
-	if (current_node->children.size() == 0)
-	{
-		splines.back().push_back(
-		    SplinePoint{current_position + current_node->direction * current_node->length,
-		                current_node->direction, current_node->radius});
-		return;
-	}
-	for (size_t i = 0; i < current_node->children.size(); i++)
-	{
-		NodeChild& child = *current_node->children[i];
-		Vector3 child_position = current_position + current_node->direction * current_node->length *
-		                                                child.position_in_parent;
-		Node* child_node = &child.node;
-		if (i > 0)
-			splines.push_back(std::vector<SplinePoint>{});
-		get_splines_rec(splines, child_node, child_position);
-	}
-}
-
 void BasicMesher::mesh_spline(Mesh& mesh, std::vector<SplinePoint>& spline)
 {
 	for (SplinePoint& spline_point : spline)
@@ -65,16 +67,49 @@ void BasicMesher::mesh_spline(Mesh& mesh, std::vector<SplinePoint>& spline)
 
 Mesh BasicMesher::mesh_tree(Tree& tree)
 {
+	ProfilerBinding profiling{tree.get_active_profiler()};
+	ProfileScope scope{"BasicMesher"};
 	std::vector<Stem>& tree_stems = tree.get_stems();
 
 	std::vector<std::vector<SplinePoint>> splines = get_splines(tree_stems);
 
 	Mesh mesh;
+	MeshCounts counts = predict_counts(tree);
+	mesh.reserve(counts.vertices, counts.polygons);
 	for (std::vector<SplinePoint>& spline : splines)
 	{
+		check_cancelled(control);
 		mesh_spline(mesh, spline);
 	}
+	if (MemoryPeak* memory_peak = tree.get_active_meshing_memory())
+	{
+		size_t bytes = mesh.memory_footprint().total() + get_capacity_bytes(splines);
+		for (const std::vector<SplinePoint>& spline : splines)
+			bytes += get_capacity_bytes(spline);
+		memory_peak->record(bytes);
+	}
 
+	scope.add_counter("vertices", (double)mesh.vertices.size());
+	scope.add_counter("polygons", (double)mesh.polygons.size());
 	return mesh;
 }
+
+MeshCounts BasicMesher::predict_counts(Tree& tree)
+{
+	// Every node adds a spline point and leaves add a closing one. Each stem and each side child
+	// starts a spline, and the last point of a spline is not bridged.
+	NodeArena arena;
+	arena.build(tree.get_stems());
+	int points = arena.size();
+	int splines = (int)tree.get_stems().size();
+	for (int i = 0; i < arena.size(); i++)
+	{
+		if (arena.is_leaf(i))
+			points++;
+		else
+			splines += (int)arena[i].children.size() - 1;
+	}
+	return MeshCounts{points * radial_resolution, 0,
+	                  (points - splines) * radial_resolution};
+}
 } // namespace Mtree
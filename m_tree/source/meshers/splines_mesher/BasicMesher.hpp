@@ -14,13 +14,12 @@ class BasicMesher : public TreeMesher
 		float radius;
 	};
 	std::vector<std::vector<SplinePoint>> get_splines(std::vector<Stem>& stems);
-	void get_splines_rec(std::vector<std::vector<SplinePoint>>& splines, Node* current_node,
-	                     Vector3 current_position);
 	void mesh_spline(Mesh& mesh, std::vector<SplinePoint>& spline);
 
   public:
 	int radial_resolution = 8;
 	Mesh mesh_tree(Tree& tree) override;
+	MeshCounts predict_counts(Tree& tree) override;
 };
 
 } // namespace Mtree
@@ -0,0 +1,121 @@
+#include "CreatorIndex.hpp"
+#include <algorithm>
+#include <numeric>
+
+namespace Mtree
+{
+
+void CreatorIndex::invalidate()
+{
+	entries.clear();
+	valid = false;
+}
+
+const NodeUtilities::BranchSelection& CreatorIndex::select(std::vector<Stem>& stems,
+                                                           const int creator_id)
+{
+	if (!valid)
+	{
+		entries.clear();
+		for (int i = 0; i < (int)stems.size(); i++)
+			add_subtree(stems[i].node, NodePath{i}, stems[i].position);
+		valid = true;
+	}
+	static const NodeUtilities::BranchSelection empty;
+	auto it = entries.find(creator_id);
+	if (it == entries.end())
+		return empty;
+	sort(it->second);
+	return it->second.branches;
+}
+
+void CreatorIndex::add_child_subtree(const int creator_id, const int branch_index,
+                                     const int offset, const int child_index)
+{
+	if (!valid)
+		return;
+	// copied out, adding the subtree may grow the branches of the entry
+	const Entry& entry = entries.at(creator_id);
+	const NodeUtilities::NodeSelectionElement& parent = entry.branches[branch_index][offset];
+	NodeChild& child = *parent.node->children[child_index];
+	NodePath path = entry.paths[branch_index];
+	path.insert(path.end(), offset, 0);
+	path.push_back(child_index);
+	Vector3 position = parent.node_position +
+	                   child.node.direction * child.position_in_parent * child.node.length;
+	add_subtree(child.node, std::move(path), position);
+}
+
+// Same walk as select_from_tree: a branch is a run of nodes of one creator along first children
+void CreatorIndex::add_subtree(Node& root, NodePath path, const Vector3& position)
+{
+	struct Visit
+	{
+		Node* node;
+		Vector3 position;
+		Entry* entry;
+		int branch;
+		int offset; // of the node in its branch
+	};
+	auto add_branch = [&](const int creator_id, NodePath branch_path)
+	{
+		Entry& entry = entries[creator_id];
+		entry.branches.emplace_back();
+		entry.paths.push_back(std::move(branch_path));
+		entry.sorted = false;
+		return std::make_pair(&entry, (int)entry.branches.size() - 1);
+	};
+
+	auto [root_entry, root_branch] = add_branch(root.creator_id, std::move(path));
+	std::vector<Visit> stack{{&root, position, root_entry, root_branch, 0}};
+	while (!stack.empty())
+	{
+		Visit visit = stack.back();
+		stack.pop_back();
+		Node& node = *visit.node;
+		visit.entry->branches[visit.branch].emplace_back(node, visit.position);
+		// children are pushed in reverse, the first child is visited next
+		for (int i = (int)node.children.size() - 1; i >= 0; i--)
+		{
+			NodeChild& child = *node.children[i];
+			Vector3 child_position =
+			    visit.position +
+			    child.node.direction * child.position_in_parent * child.node.length;
+			if (i == 0 && child.node.creator_id == node.creator_id)
+			{
+				stack.push_back(
+				    {&child.node, child_position, visit.entry, visit.branch, visit.offset + 1});
+				continue;
+			}
+			NodePath child_path = visit.entry->paths[visit.branch];
+			child_path.insert(child_path.end(), visit.offset, 0);
+			child_path.push_back(i);
+			auto [entry, branch] = add_branch(child.node.creator_id, std::move(child_path));
+			stack.push_back({&child.node, child_position, entry, branch, 0});
+		}
+	}
+}
+
+void CreatorIndex::sort(Entry& entry)
+{
+	if (entry.sorted)
+		return;
+	std::vector<int> order(entry.paths.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(),
+	          [&](const int a, const int b) { return entry.paths[a] < entry.paths[b]; });
+	NodeUtilities::BranchSelection branches;
+	std::vector<NodePath> paths;
+	branches.reserve(order.size());
+	paths.reserve(order.size());
+	for (int i : order)
+	{
+		branches.push_back(std::move(entry.branches[i]));
+		paths.push_back(std::move(entry.paths[i]));
+	}
+	entry.branches = std::move(branches);
+	entry.paths = std::move(paths);
+	entry.sorted = true;
+}
+
+} // namespace Mtree
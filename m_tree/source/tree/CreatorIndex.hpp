@@ -0,0 +1,45 @@
+#pragma once
+#include "Node.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+#include <unordered_map>
+#include <vector>
+
+namespace Mtree
+{
+
+// Nodes of the stems grouped by the id of the function that created them, with their positions,
+// so that a function selecting the nodes of its parent doesn't walk the whole tree.
+// Functions that only add nodes register the subtrees they grow. Any other change to the stems
+// invalidates the index, the next selection then rebuilds it with a single walk of the stems.
+class CreatorIndex
+{
+  public:
+	// Child indices from the root of the stem to a node, the index of the stem first. Sorting
+	// paths sorts the nodes in the order of a depth-first walk of the stems.
+	using NodePath = std::vector<int>;
+
+	void invalidate();
+	bool is_valid() const { return valid; }
+	// Same result as NodeUtilities::select_from_tree(stems, creator_id)
+	const NodeUtilities::BranchSelection& select(std::vector<Stem>& stems, const int creator_id);
+	// Registers the subtree of the child_index-th (side) child of the node at offset in the
+	// branch_index-th branch of the last selection of creator_id. Does nothing while the index
+	// is invalid, the rebuild will find the subtree.
+	void add_child_subtree(const int creator_id, const int branch_index, const int offset,
+	                       const int child_index);
+
+  private:
+	struct Entry
+	{
+		NodeUtilities::BranchSelection branches;
+		std::vector<NodePath> paths; // path of the first node of each branch
+		bool sorted = true;
+	};
+	std::unordered_map<int, Entry> entries;
+	bool valid = false;
+
+	void add_subtree(Node& root, NodePath path, const Vector3& position);
+	void sort(Entry& entry);
+};
+
+} // namespace Mtree
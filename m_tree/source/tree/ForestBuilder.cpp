@@ -0,0 +1,44 @@
+#include "ForestBuilder.hpp"
+#include <Eigen/Geometry>
+#include <stdexcept>
+
+namespace Mtree
+{
+namespace
+{
+// Rotates and scales the stems in place, so that the mesher emits the placed tree directly
+void place_stems(Tree& tree, const ForestItem& item)
+{
+	Eigen::Matrix3f rotation;
+	rotation = Eigen::AngleAxisf(item.rotation, Vector3{0, 0, 1});
+	for (Stem& stem : tree.get_stems())
+		stem.position = item.position + rotation * stem.position * item.scale;
+
+	NodeArena& arena = tree.get_arena();
+	for (int i = 0; i < arena.size(); i++)
+	{
+		Node& node = arena[i];
+		node.direction = rotation * node.direction;
+		node.tangent = rotation * node.tangent;
+		node.length *= item.scale;
+		node.radius *= item.scale;
+	}
+	tree.update_arena();
+}
+} // namespace
+
+ForestBuilder::ForestBuilder(std::shared_ptr<TreeFunction> trunk_function)
+    : trunk_function(trunk_function)
+{
+	if (!trunk_function)
+		throw std::runtime_error("Cannot build forest: no trunk function set");
+}
+
+void ForestBuilder::build_tree(Tree& tree, const ForestItem& item) const
+{
+	tree.set_first_function(trunk_function);
+	tree.execute_functions(nullptr, item.seed, 1);
+	place_stems(tree, item);
+}
+
+} // namespace Mtree
@@ -0,0 +1,95 @@
+#pragma once
+#include "Tree.hpp"
+#include "source/meshers/base_types/TreeMesher.hpp"
+#include "source/utilities/Parallel.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace Mtree
+{
+
+// Variation and placement of one tree of a forest
+struct ForestItem
+{
+	int seed = 0; // added to the seed of every function of the graph
+	Vector3 position{0, 0, 0};
+	float rotation = 0; // around the z axis, in radians
+	float scale = 1;
+};
+
+// Grows and meshes many variations of one function graph in parallel, one tree per task. Tasks are
+// handed out dynamically to the threads, so that large trees don't hold back the others, and each
+// tree is grown and meshed on a single thread.
+// The trees share the graph, each executing it with its own context, so each mesh only depends
+// on the graph and on its item, whatever the number of threads. The graph must not be edited
+// while a build is running.
+class ForestBuilder
+{
+  private:
+	std::shared_ptr<TreeFunction> trunk_function;
+
+	// Grows the tree of an item and meshes it with a single threaded copy of mesher
+	template <Mesher T> Mesh build_mesh(const ForestItem& item, const T& mesher) const
+	{
+		Tree tree;
+		build_tree(tree, item);
+		T tree_mesher = mesher;
+		if constexpr (requires { tree_mesher.threads; })
+			tree_mesher.threads = 1;
+		return tree_mesher.mesh_tree(tree);
+	}
+
+  public:
+	int threads = 0; // 0 uses every hardware thread
+
+	ForestBuilder(std::shared_ptr<TreeFunction> trunk_function);
+
+	// Grows the tree of one item on the calling thread, the functions running single threaded
+	void build_tree(Tree& tree, const ForestItem& item) const;
+
+	// Builds one mesh per item, in the order of the items. Each tree is meshed with its own copy
+	// of the mesher.
+	template <Mesher T>
+	std::vector<Mesh> build(const std::vector<ForestItem>& items, const T& mesher) const
+	{
+		std::vector<Mesh> meshes(items.size());
+		Parallel::parallel_for(
+		    (int)items.size(), [&](const int i) { meshes[i] = build_mesh(items[i], mesher); },
+		    threads);
+		return meshes;
+	}
+
+	// Streams the meshes of the items to a sink as one mesh, one chunk per tree in the order of
+	// the items. Trees are built in batches of one tree per thread, so only a batch is held in
+	// memory at once. The total counts are not known in advance.
+	template <Mesher T>
+	void stream(const std::vector<ForestItem>& items, const T& mesher, MeshSink& sink) const
+	{
+		sink.begin(MeshCounts{});
+		MeshCounts offset;
+		int batch_size = Parallel::resolve_thread_count(threads);
+		for (int first = 0; first < (int)items.size(); first += batch_size)
+		{
+			int count = std::min(batch_size, (int)items.size() - first);
+			std::vector<Mesh> meshes(count);
+			Parallel::parallel_for(
+			    count, [&](const int i) { meshes[i] = build_mesh(items[first + i], mesher); },
+			    threads);
+			for (Mesh& mesh : meshes)
+			{
+				offset_indices(mesh, offset.vertices, offset.uvs);
+				sink.write(MeshChunk{mesh, offset.vertices, offset.uvs, offset.polygons,
+				                     offset.triangles});
+				offset.vertices += (int)mesh.vertices.size();
+				offset.uvs += (int)mesh.uvs.size();
+				offset.polygons += (int)mesh.polygons.size();
+				offset.triangles += (int)mesh.triangles.size();
+				mesh = Mesh{};
+			}
+		}
+		sink.end();
+	}
+};
+
+} // namespace Mtree
@@ -1,10 +1,11 @@
 #pragma once
+#include "Node.hpp"
+#include "source/utilities/RandomGenerator.hpp"
 #include <Eigen/Core>
-#include <variant>
+#include <deque>
 
 namespace Mtree
 {
-using Vector3 = Eigen::Vector3f;
 
 struct BranchGrowthInfo
 {
@@ -16,6 +17,7 @@ struct BranchGrowthInfo
 	float cumulated_weight = 0;
 	float age = 0;
 	bool inactive = false;
+	RandomGenerator rand_gen; // stream of the node, its children derive theirs from it
 };
 
 struct BioNodeInfo
@@ -37,6 +39,7 @@ struct BioNodeInfo
 	int age = 0;
 	float philotaxis_angle = 0;
 	bool is_lateral = false;
+	RandomGenerator rand_gen; // stream of the node, its children derive theirs from it
 
 	BioNodeInfo(NodeType type = NodeType::Ignored, int age = 0, float philotaxis_angle = 0,
 	            bool is_lateral = false)
@@ -45,6 +48,27 @@ struct BioNodeInfo
 	}
 };
 
-using GrowthInfo = std::variant<std::monostate, BranchGrowthInfo, BioNodeInfo>;
+// Growth state of the nodes a function is growing, kept on the side of the nodes for the
+// duration of the function's execute rather than in every node of the tree. A node finds its
+// entry through Node::growth_index. Entries don't move when others are added, references to them
+// stay valid while children are created.
+template <typename Info> class GrowthTable
+{
+  private:
+	std::deque<Info> entries;
+
+  public:
+	Info& add(Node& node, Info info)
+	{
+		node.growth_index = (int)entries.size();
+		entries.push_back(std::move(info));
+		return entries.back();
+	}
+	Info& operator[](const Node& node) { return entries[node.growth_index]; }
+	const Info& operator[](const Node& node) const { return entries[node.growth_index]; }
+	int size() const { return (int)entries.size(); }
+	size_t get_memory_size() const { return entries.size() * sizeof(Info); }
+	void clear() { entries = {}; }
+};
 
 } // namespace Mtree
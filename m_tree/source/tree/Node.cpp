@@ -12,3 +12,19 @@ Mtree::Node::Node(Vector3 direction, Vector3 parent_tangent, float length, float
 	this->radius = radius;
 	this->creator_id = creator_id;
 }
+
+Mtree::Node::~Node()
+{
+	std::vector<std::shared_ptr<NodeChild>> released = std::move(children);
+	while (!released.empty())
+	{
+		std::shared_ptr<NodeChild> child = std::move(released.back());
+		released.pop_back();
+		// children still owned elsewhere are left to their other owners
+		if (child.use_count() != 1)
+			continue;
+		for (auto& grand_child : child->node.children)
+			released.push_back(std::move(grand_child));
+		child->node.children.clear();
+	}
+}
@@ -1,5 +1,4 @@
 #pragma once
-#include "GrowthInfo.hpp"
 #include <Eigen/Core>
 #include <memory>
 #include <vector>
@@ -19,11 +18,20 @@ class Node
 	float length;
 	float radius;
 	int creator_id = 0;
-	GrowthInfo growthInfo;
+	// entry of the node in the GrowthTable of the function growing it, only meaningful while that
+	// function executes
+	int growth_index = -1;
 
 	bool is_leaf() const;
 
 	Node(Vector3 direction, Vector3 parent_tangent, float length, float radius, int creator_id);
+	Node(const Node&) = default;
+	Node(Node&&) = default;
+	Node& operator=(const Node&) = default;
+	Node& operator=(Node&&) = default;
+	// Releases the descendants iteratively, long chains of segments would overflow the stack
+	// when released recursively
+	~Node();
 };
 
 struct NodeChild
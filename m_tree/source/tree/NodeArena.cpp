@@ -0,0 +1,127 @@
+#include "NodeArena.hpp"
+#include <algorithm>
+
+namespace Mtree
+{
+void NodeArena::clear()
+{
+	nodes.clear();
+	parent.clear();
+	first_child.clear();
+	next_sibling.clear();
+	subtree_end.clear();
+	child_rank.clear();
+	stem_index.clear();
+	position_in_parent.clear();
+	position.clear();
+	roots.clear();
+}
+
+size_t NodeArena::get_memory_size() const
+{
+	return get_capacity_bytes(nodes) + get_capacity_bytes(parent) +
+	       get_capacity_bytes(first_child) + get_capacity_bytes(next_sibling) +
+	       get_capacity_bytes(subtree_end) + get_capacity_bytes(child_rank) +
+	       get_capacity_bytes(stem_index) + get_capacity_bytes(position_in_parent) +
+	       get_capacity_bytes(position) + get_capacity_bytes(roots);
+}
+
+void NodeArena::build(std::span<Stem> stems)
+{
+	clear();
+	for (size_t i = 0; i < stems.size(); i++)
+	{
+		append_root(stems[i].node, stems[i].position, (int)i);
+	}
+}
+
+void NodeArena::build(Node& root, const Vector3& root_position)
+{
+	clear();
+	append_root(root, root_position, 0);
+}
+
+NodeArena::Split NodeArena::split(const int grain) const
+{
+	Split result;
+	// in pre-order the top part is closed under ancestors, a subtree is skipped in one jump
+	for (int i = 0; i < size();)
+	{
+		if (subtree_size(i) > grain)
+		{
+			result.top.push_back(i);
+			i++;
+		}
+		else
+		{
+			result.subtrees.push_back(i);
+			i = subtree_end[i];
+		}
+	}
+	return result;
+}
+
+void NodeArena::append_root(Node& root, const Vector3& root_position, const int root_stem_index)
+{
+	struct PendingNode
+	{
+		Node* node;
+		int parent;
+		int rank;
+		float position_in_parent;
+	};
+
+	roots.push_back(size());
+	std::vector<PendingNode> stack{{&root, none, 0, 0}};
+	std::vector<int> last_child; // last child appended to each node, used to link siblings
+	last_child.resize(nodes.size(), none);
+
+	while (!stack.empty())
+	{
+		PendingNode pending = stack.back();
+		stack.pop_back();
+
+		int index = size();
+		nodes.push_back(pending.node);
+		parent.push_back(pending.parent);
+		first_child.push_back(none);
+		next_sibling.push_back(none);
+		subtree_end.push_back(index + 1);
+		child_rank.push_back(pending.rank);
+		stem_index.push_back(root_stem_index);
+		position_in_parent.push_back(pending.position_in_parent);
+		last_child.push_back(none);
+
+		if (pending.parent == none)
+		{
+			position.push_back(root_position);
+		}
+		else
+		{
+			const Node& parent_node = *nodes[pending.parent];
+			position.push_back(position[pending.parent] + parent_node.direction *
+			                                                  parent_node.length *
+			                                                  pending.position_in_parent);
+			if (last_child[pending.parent] == none)
+				first_child[pending.parent] = index;
+			else
+				next_sibling[last_child[pending.parent]] = index;
+			last_child[pending.parent] = index;
+		}
+
+		// push in reverse so that the first child is visited first
+		auto& children = pending.node->children;
+		for (int i = (int)children.size() - 1; i >= 0; i--)
+		{
+			stack.push_back({&children[i]->node, index, i, children[i]->position_in_parent});
+		}
+	}
+
+	// in pre-order a parent always precedes its descendants, so subtree ends can be folded back
+	for (int i = size() - 1; i >= roots.back(); i--)
+	{
+		if (parent[i] != none)
+			subtree_end[parent[i]] = std::max(subtree_end[parent[i]], subtree_end[i]);
+	}
+}
+} // namespace Mtree
@@ -0,0 +1,131 @@
+#pragma once
+#include "Node.hpp"
+#include "source/utilities/MemoryFootprint.hpp"
+#include "source/utilities/Parallel.hpp"
+#include <span>
+#include <vector>
+
+namespace Mtree
+{
+
+// Flat, index-based view over the nodes of a tree.
+// Nodes are laid out contiguously in depth-first pre-order (first child before its siblings), so
+// the subtree of node i occupies the index range [i, subtree_end[i]) and every parent comes before
+// its children. Hierarchy links are indices into the same arrays, NodeArena::none meaning no link.
+// The stems stay the owners of the nodes: the arena is rebuilt from them whenever the topology
+// changes and passes work on the arrays instead of chasing child pointers.
+class NodeArena
+{
+  public:
+	static constexpr int none = -1;
+
+	std::vector<Node*> nodes;
+	std::vector<int> parent;
+	std::vector<int> first_child;
+	std::vector<int> next_sibling;
+	std::vector<int> subtree_end;
+	std::vector<int> child_rank; // index of the node in its parent's children, 0 for roots
+	std::vector<int> stem_index; // index of the stem (or root) the node belongs to
+	std::vector<float> position_in_parent;
+	std::vector<Vector3> position; // absolute position of the node origin
+	std::vector<int> roots;        // index of the first node of each stem
+
+	void build(std::span<Stem> stems);
+	void build(Node& root, const Vector3& root_position);
+	void clear();
+	size_t get_memory_size() const; // bytes of the arrays
+
+	int size() const { return (int)nodes.size(); }
+	bool empty() const { return nodes.empty(); }
+	bool is_leaf(const int index) const { return first_child[index] == none; }
+	int subtree_size(const int index) const { return subtree_end[index] - index; }
+	Node& operator[](const int index) const { return *nodes[index]; }
+
+	template <typename F> void for_each_child(const int index, F&& f) const
+	{
+		for (int child = first_child[index]; child != none; child = next_sibling[child])
+			f(child);
+	}
+
+	// Bottom-up sweep: calls f(i) on every node after all of its descendants
+	template <typename F> void sweep_up(F&& f) const
+	{
+		for (int i = size() - 1; i >= 0; i--)
+			f(i);
+	}
+
+	// Top-down sweep propagating a rotation and the node positions. position[i] is first updated
+	// from the (already processed) parent, then f(i, parent_rotation) can bend node i and returns
+	// the rotation handed to its children. Roots receive root_rotation and keep their position.
+	template <typename Rotation, typename F> void sweep_down(const Rotation& root_rotation, F&& f)
+	{
+		std::vector<Rotation> rotations(size());
+		for (int i = 0; i < size(); i++)
+		{
+			int p = parent[i];
+			if (p == none)
+			{
+				rotations[i] = f(i, root_rotation);
+				continue;
+			}
+			const Node& parent_node = *nodes[p];
+			position[i] =
+			    position[p] + parent_node.direction * parent_node.length * position_in_parent[i];
+			rotations[i] = f(i, rotations[p]);
+		}
+	}
+
+	// Partition of the arena for parallel passes. The top part holds the nodes with more than grain
+	// nodes in their subtree, the remaining nodes form disjoint subtrees of at most grain nodes
+	// hanging from the top part or from no parent. Both lists are in ascending order.
+	struct Split
+	{
+		std::vector<int> top;
+		std::vector<int> subtrees; // root of each subtree
+		// pieces handed to the sweep callbacks: 0 is the top part, s + 1 the subtree s
+		int part_count() const { return (int)subtrees.size() + 1; }
+	};
+	Split split(const int grain) const;
+
+	// Bottom-up sweep over several threads: calls f(i, part) on every node after all of its
+	// descendants, the subtrees of the split concurrently, then the top part on the calling thread.
+	// part lets f keep scratch data per piece without locking.
+	template <typename F>
+	void parallel_sweep_up(const Split& split, F&& f, const int threads = 0) const
+	{
+		Parallel::parallel_for(
+		    (int)split.subtrees.size(),
+		    [&](const int s)
+		    {
+			    int root = split.subtrees[s];
+			    for (int i = subtree_end[root] - 1; i >= root; i--)
+				    f(i, s + 1);
+		    },
+		    threads);
+		for (auto i = split.top.rbegin(); i != split.top.rend(); ++i)
+			f(*i, 0);
+	}
+
+	// Top-down counterpart: f(i, part) is called on every node after its parent, the top part on
+	// the calling thread, then the subtrees concurrently
+	template <typename F>
+	void parallel_sweep_down(const Split& split, F&& f, const int threads = 0) const
+	{
+		for (int i : split.top)
+			f(i, 0);
+		Parallel::parallel_for(
+		    (int)split.subtrees.size(),
+		    [&](const int s)
+		    {
+			    int root = split.subtrees[s];
+			    for (int i = root; i < subtree_end[root]; i++)
+				    f(i, s + 1);
+		    },
+		    threads);
+	}
+
+  private:
+	void append_root(Node& root, const Vector3& root_position, const int root_stem_index);
+};
+
+} // namespace Mtree
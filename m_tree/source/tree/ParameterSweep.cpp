@@ -0,0 +1,88 @@
+#include "ParameterSweep.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Mtree
+{
+namespace
+{
+Vector3 get_node_end(const NodeArena& arena, const int index)
+{
+	const Node& node = arena[index];
+	return arena.position[index] + node.direction * node.length;
+}
+
+// Mean gap between the widest node of each height bin of the crown and the envelope of shape,
+// both scaled to a widest point of 1, subtracted from 1. Bins are measured from the crown base
+// up, their envelope ratio from 1 at the base to 0 at the top as in BranchFunction.
+float get_crown_fit(const NodeArena& arena, const CrownShape shape, const float crown_base,
+                    const int bin_count, const float min_z, const float max_z)
+{
+	float crown_start = min_z + (max_z - min_z) * std::clamp(crown_base, 0.f, 1.f);
+	float crown_height = max_z - crown_start;
+	if (arena.empty() || bin_count <= 0 || crown_height <= 0)
+		return 0;
+
+	std::vector<float> extents(bin_count, 0.f);
+	for (int i = 0; i < arena.size(); i++)
+	{
+		Vector3 end = get_node_end(arena, i);
+		if (end.z() < crown_start)
+			continue;
+		Vector3 axis = arena.position[arena.roots[arena.stem_index[i]]];
+		float distance = (end - axis).head<2>().norm();
+		int bin = (int)((end.z() - crown_start) / crown_height * bin_count);
+		bin = std::min(bin, bin_count - 1);
+		extents[bin] = std::max(extents[bin], distance);
+	}
+
+	std::vector<float> envelope(bin_count);
+	for (int bin = 0; bin < bin_count; bin++)
+		envelope[bin] = CrownShapeUtils::get_shape_ratio(shape, 1 - (bin + .5f) / bin_count);
+	float max_extent = *std::max_element(extents.begin(), extents.end());
+	float max_envelope = *std::max_element(envelope.begin(), envelope.end());
+	if (max_extent <= 0 || max_envelope <= 0)
+		return 0;
+
+	float error = 0;
+	for (int bin = 0; bin < bin_count; bin++)
+		error += std::abs(extents[bin] / max_extent - envelope[bin] / max_envelope);
+	return std::clamp(1 - error / bin_count, 0.f, 1.f);
+}
+} // namespace
+
+void SweepTable::resize(const size_t size)
+{
+	node_counts.resize(size);
+	bounds_min.resize(size, Vector3::Zero());
+	bounds_max.resize(size, Vector3::Zero());
+	crown_fits.resize(size);
+	vertex_counts.resize(size);
+	polygon_counts.resize(size);
+}
+
+void ParameterSweep::measure(Tree& tree, SweepTable& table, const int index) const
+{
+	const NodeArena& arena = tree.get_arena();
+	table.node_counts[index] = arena.size();
+	if (arena.empty())
+	{
+		table.bounds_min[index] = table.bounds_max[index] = Vector3::Zero();
+		table.crown_fits[index] = 0;
+		return;
+	}
+	Vector3 min = arena.position[0];
+	Vector3 max = arena.position[0];
+	for (int i = 0; i < arena.size(); i++)
+	{
+		Vector3 end = get_node_end(arena, i);
+		min = min.cwiseMin(arena.position[i]).cwiseMin(end);
+		max = max.cwiseMax(arena.position[i]).cwiseMax(end);
+	}
+	table.bounds_min[index] = min;
+	table.bounds_max[index] = max;
+	table.crown_fits[index] =
+	    get_crown_fit(arena, crown_shape, crown_base, crown_bins, min.z(), max.z());
+}
+
+} // namespace Mtree
@@ -0,0 +1,83 @@
+#pragma once
+#include "Tree.hpp"
+#include "source/meshers/base_types/TreeMesher.hpp"
+#include "source/tree_functions/CrownShape.hpp"
+#include "source/utilities/Parallel.hpp"
+#include <memory>
+#include <vector>
+
+namespace Mtree
+{
+
+// Statistics of the variants of a sweep, one entry per variant in every column
+struct SweepTable
+{
+	std::vector<int> node_counts;
+	std::vector<Vector3> bounds_min; // bounding box of the nodes
+	std::vector<Vector3> bounds_max;
+	std::vector<float> crown_fits; // see ParameterSweep::crown_shape
+	std::vector<int> vertex_counts;
+	std::vector<int> polygon_counts;
+	std::vector<Mesh> meshes; // only filled when the sweep builds meshes
+
+	size_t size() const { return node_counts.size(); }
+	void resize(const size_t size);
+};
+
+// Grows many variants of a function graph in parallel and measures each of them, so that grids
+// of parameter values can be compared without meshing every candidate. Variants are usually
+// clones of one graph with a few parameters changed. Unless meshes are requested, the counts are
+// predicted by the mesher and no mesh is built.
+class ParameterSweep
+{
+  public:
+	int threads = 0; // 0 uses every hardware thread
+	bool build_meshes = false;
+	// The crown fit compares the horizontal extent of the nodes, measured at several heights
+	// above crown_base (a fraction of the height of the tree), with the envelope of crown_shape.
+	// Both profiles are normalized by their widest point, the fit goes from 0 to 1 for a crown
+	// following the envelope exactly.
+	CrownShape crown_shape = CrownShape::Cylindrical;
+	float crown_base = 0;
+	int crown_bins = 16;
+
+	// Executes every variant, in the order of the variants. Each tree is meshed or measured with
+	// its own copy of the mesher, which should then be single threaded.
+	template <Mesher T>
+	SweepTable run(const std::vector<std::shared_ptr<TreeFunction>>& variants,
+	               const T& mesher) const
+	{
+		SweepTable table;
+		table.resize(variants.size());
+		if (build_meshes)
+			table.meshes.resize(variants.size());
+		Parallel::parallel_for(
+		    (int)variants.size(),
+		    [&](const int i)
+		    {
+			    Tree tree{variants[i]};
+			    tree.execute_functions();
+			    measure(tree, table, i);
+			    T tree_mesher = mesher;
+			    if (build_meshes)
+			    {
+				    table.meshes[i] = tree_mesher.mesh_tree(tree);
+				    table.vertex_counts[i] = (int)table.meshes[i].vertices.size();
+				    table.polygon_counts[i] = (int)table.meshes[i].polygons.size();
+			    }
+			    else
+			    {
+				    MeshCounts counts = tree_mesher.predict_counts(tree);
+				    table.vertex_counts[i] = counts.vertices;
+				    table.polygon_counts[i] = counts.polygons;
+			    }
+		    },
+		    threads);
+		return table;
+	}
+
+	// Fills the node count, bounds and crown fit of entry index of the table
+	void measure(Tree& tree, SweepTable& table, const int index) const;
+};
+
+} // namespace Mtree
@@ -0,0 +1,292 @@
+#include "SegmentIndex.hpp"
+
+namespace Mtree
+{
+
+namespace
+{
+float intersect_capsule_from(const Vector3& origin, const Vector3& direction,
+                             const SegmentIndex::Segment& segment)
+{
+	float radius_sq = segment.radius * segment.radius;
+	auto intersect_sphere = [&](const Vector3& center)
+	{
+		Vector3 offset = origin - center;
+		float b = direction.dot(offset);
+		float c = offset.squaredNorm() - radius_sq;
+		if (c <= 0)
+			return 0.f;
+		float h = b * b - c;
+		if (h < 0 || b > 0)
+			return -1.f;
+		return -b - std::sqrt(h);
+	};
+
+	Vector3 axis = segment.end - segment.start;
+	float axis_sq = axis.squaredNorm();
+	if (axis_sq < 1e-12f)
+		return intersect_sphere(segment.start);
+	if (SegmentIndex::distance_to_segment(origin, segment) <= 0)
+		return 0;
+
+	Vector3 offset = origin - segment.start;
+	float axis_direction = axis.dot(direction);
+	float axis_offset = axis.dot(offset);
+	float a = axis_sq - axis_direction * axis_direction;
+	float b = axis_sq * direction.dot(offset) - axis_offset * axis_direction;
+	float c = axis_sq * offset.squaredNorm() - axis_offset * axis_offset - radius_sq * axis_sq;
+	if (a > 1e-8f * axis_sq)
+	{
+		float h = b * b - a * c;
+		if (h < 0)
+			return -1;
+		float t = (-b - std::sqrt(h)) / a;
+		float y = axis_offset + t * axis_direction;
+		if (y > 0 && y < axis_sq)
+			return t;
+	}
+	// the ray enters through a cap, or runs parallel to the segment
+	float t_start = intersect_sphere(segment.start);
+	float t_end = intersect_sphere(segment.end);
+	if (t_start < 0)
+		return t_end;
+	if (t_end < 0)
+		return t_start;
+	return std::min(t_start, t_end);
+}
+
+// Distance along the normalized ray to the surface of the capsule, negative when it is missed.
+// A ray starting inside the capsule returns 0.
+float intersect_capsule(const Vector3& origin, const Vector3& direction,
+                        const SegmentIndex::Segment& segment)
+{
+	// start from the bounding sphere of the capsule to keep the quadratic well conditioned
+	Vector3 center = (segment.start + segment.end) / 2;
+	float bounding_radius = (segment.end - segment.start).norm() / 2 + segment.radius;
+	float skipped = std::max((center - origin).norm() - bounding_radius, 0.f);
+	float t = intersect_capsule_from(origin + direction * skipped, direction, segment);
+	return t < 0 ? t : t + skipped;
+}
+} // namespace
+
+Vector3 SegmentIndex::closest_axis_point(const Vector3& point, const Segment& segment)
+{
+	Vector3 axis = segment.end - segment.start;
+	float axis_sq = axis.squaredNorm();
+	float t = axis_sq > 0 ? std::clamp((point - segment.start).dot(axis) / axis_sq, 0.f, 1.f) : 0;
+	return segment.start + axis * t;
+}
+
+float SegmentIndex::distance_to_segment(const Vector3& point, const Segment& segment)
+{
+	float distance = (closest_axis_point(point, segment) - point).norm() - segment.radius;
+	return std::max(distance, 0.f);
+}
+
+void SegmentIndex::clear()
+{
+	segments.clear();
+	segment_first_cell.clear();
+	cell_offsets.clear();
+	cell_segments.clear();
+	dimensions = {1, 1, 1};
+}
+
+void SegmentIndex::build(const NodeArena& arena)
+{
+	std::vector<Segment> arena_segments;
+	arena_segments.reserve(arena.size());
+	for (int i = 0; i < arena.size(); i++)
+	{
+		const Node& node = arena[i];
+		arena_segments.push_back(Segment{arena.position[i],
+		                                 arena.position[i] + node.direction * node.length,
+		                                 node.radius, i});
+	}
+	build(std::move(arena_segments));
+}
+
+void SegmentIndex::build(std::vector<Segment> new_segments)
+{
+	clear();
+	segments = std::move(new_segments);
+	if (segments.empty())
+		return;
+
+	Vector3 grid_max = Vector3::Constant(std::numeric_limits<float>::lowest());
+	grid_min = Vector3::Constant(std::numeric_limits<float>::max());
+	float total_length = 0;
+	for (const Segment& segment : segments)
+	{
+		Vector3 extent = Vector3::Constant(segment.radius);
+		grid_min = grid_min.cwiseMin(segment.start.cwiseMin(segment.end) - extent);
+		grid_max = grid_max.cwiseMax(segment.start.cwiseMax(segment.end) + extent);
+		total_length += (segment.end - segment.start).norm() + 2 * segment.radius;
+	}
+
+	// cells about twice as large as the average segment, with roughly as many cells as segments
+	// at most so that sparse trees don't allocate huge grids
+	Vector3 extent = (grid_max - grid_min).cwiseMax(1e-6f);
+	cell_size = requested_cell_size > 0 ? requested_cell_size
+	                                    : std::max(2 * total_length / segments.size(), 1e-6f);
+	const double max_cells = 4.0 * segments.size() + 64;
+	auto cell_count = [&]()
+	{
+		double count = 1;
+		for (int axis = 0; axis < 3; axis++)
+			count *= std::floor(extent[axis] / cell_size) + 1;
+		return count;
+	};
+	while (cell_count() > max_cells)
+		cell_size *= 1.26f;
+	for (int axis = 0; axis < 3; axis++)
+		dimensions[axis] = (int)std::floor(extent[axis] / cell_size) + 1;
+
+	// counting sort of the segments into their overlapped cells
+	int cells = dimensions[0] * dimensions[1] * dimensions[2];
+	cell_offsets.assign(cells + 1, 0);
+	segment_first_cell.resize(segments.size());
+	auto for_each_cell = [&](const int segment, auto&& f)
+	{
+		const Segment& s = segments[segment];
+		Vector3 extent = Vector3::Constant(s.radius);
+		std::array<int, 3> low = to_cell(s.start.cwiseMin(s.end) - extent);
+		std::array<int, 3> high = to_cell(s.start.cwiseMax(s.end) + extent);
+		segment_first_cell[segment] = low;
+		for (int z = low[2]; z <= high[2]; z++)
+			for (int y = low[1]; y <= high[1]; y++)
+				for (int x = low[0]; x <= high[0]; x++)
+					f((z * dimensions[1] + y) * dimensions[0] + x);
+	};
+	for (int i = 0; i < size(); i++)
+		for_each_cell(i, [&](const int cell) { cell_offsets[cell + 1]++; });
+	for (int cell = 0; cell < cells; cell++)
+		cell_offsets[cell + 1] += cell_offsets[cell];
+	cell_segments.resize(cell_offsets.back());
+	std::vector<int> fill(cell_offsets.begin(), cell_offsets.end() - 1);
+	for (int i = 0; i < size(); i++)
+		for_each_cell(i, [&](const int cell) { cell_segments[fill[cell]++] = i; });
+}
+
+std::array<int, 3> SegmentIndex::to_cell(const Vector3& point) const
+{
+	std::array<int, 3> cell;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// clamp before the conversion, queries can reach far outside the grid
+		float coordinate = std::floor((point[axis] - grid_min[axis]) / cell_size);
+		coordinate = std::clamp(coordinate, 0.f, (float)(dimensions[axis] - 1));
+		cell[axis] = (int)coordinate;
+	}
+	return cell;
+}
+
+std::vector<int> SegmentIndex::query_radius(const Vector3& point, const float radius) const
+{
+	std::vector<int> result;
+	for_each_in_radius(point, radius, [&](const int segment) { result.push_back(segment); });
+	return result;
+}
+
+SegmentIndex::Hit SegmentIndex::nearest(const Vector3& point, const float max_distance) const
+{
+	Hit hit;
+	if (segments.empty())
+		return hit;
+
+	// grow the search radius until a segment is found, any closer segment lies inside the radius
+	Vector3 grid_max = grid_min + Vector3(dimensions[0], dimensions[1], dimensions[2]) * cell_size;
+	float outside = (grid_min - point).cwiseMax(point - grid_max).cwiseMax(0).norm();
+	float reach = outside + (grid_max - grid_min).norm();
+	float radius = std::min(outside + cell_size, max_distance);
+	while (true)
+	{
+		for_each_in_radius(point, radius,
+		                   [&](const int segment)
+		                   {
+			                   float distance = distance_to_segment(point, segments[segment]);
+			                   if (distance < hit.distance)
+				                   hit = Hit{segment, distance};
+		                   });
+		if (hit.is_valid() || radius >= max_distance || radius >= reach)
+			return hit;
+		radius = std::min(radius * 2, max_distance);
+	}
+}
+
+SegmentIndex::Hit SegmentIndex::raycast(const Vector3& origin, const Vector3& direction,
+                                        const float max_distance, const int ignored_node) const
+{
+	Hit hit;
+	if (segments.empty())
+		return hit;
+
+	// clip the ray against the grid bounds
+	Vector3 grid_max = grid_min + Vector3(dimensions[0], dimensions[1], dimensions[2]) * cell_size;
+	float t_enter = 0;
+	float t_exit = max_distance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (std::abs(direction[axis]) < 1e-12f)
+		{
+			if (origin[axis] < grid_min[axis] || origin[axis] > grid_max[axis])
+				return hit;
+			continue;
+		}
+		float t0 = (grid_min[axis] - origin[axis]) / direction[axis];
+		float t1 = (grid_max[axis] - origin[axis]) / direction[axis];
+		t_enter = std::max(t_enter, std::min(t0, t1));
+		t_exit = std::min(t_exit, std::max(t0, t1));
+	}
+	if (t_enter > t_exit)
+		return hit;
+
+	// walk the cells along the ray (Amanatides & Woo), stopping once the closest hit found so far
+	// is before the exit of the current cell
+	std::array<int, 3> cell = to_cell(origin + direction * t_enter);
+	std::array<int, 3> step;
+	Vector3 t_next;
+	Vector3 t_delta;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (std::abs(direction[axis]) < 1e-12f)
+		{
+			step[axis] = 0;
+			t_next[axis] = std::numeric_limits<float>::infinity();
+			t_delta[axis] = std::numeric_limits<float>::infinity();
+			continue;
+		}
+		step[axis] = direction[axis] > 0 ? 1 : -1;
+		float boundary = grid_min[axis] + (cell[axis] + (step[axis] > 0 ? 1 : 0)) * cell_size;
+		t_next[axis] = (boundary - origin[axis]) / direction[axis];
+		t_delta[axis] = cell_size / std::abs(direction[axis]);
+	}
+
+	while (true)
+	{
+		int cell_index = (cell[2] * dimensions[1] + cell[1]) * dimensions[0] + cell[0];
+		for (int i = cell_offsets[cell_index]; i < cell_offsets[cell_index + 1]; i++)
+		{
+			int segment = cell_segments[i];
+			if (segments[segment].node == ignored_node)
+				continue;
+			float t = intersect_capsule(origin, direction, segments[segment]);
+			if (t >= 0 && t <= max_distance && t < hit.distance)
+				hit = Hit{segment, t};
+		}
+
+		int axis = 0;
+		if (t_next[1] < t_next[axis])
+			axis = 1;
+		if (t_next[2] < t_next[axis])
+			axis = 2;
+		if (hit.distance <= t_next[axis] || t_next[axis] > t_exit)
+			return hit;
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] >= dimensions[axis])
+			return hit;
+		t_next[axis] += t_delta[axis];
+	}
+}
+
+} // namespace Mtree
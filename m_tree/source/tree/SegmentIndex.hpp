@@ -0,0 +1,103 @@
+#pragma once
+#include "NodeArena.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace Mtree
+{
+
+// Uniform grid over the segments of a tree, each segment being the capsule of a node (from its
+// origin to its end, with the node radius). Distances are measured to the capsule surfaces, so a
+// point inside a branch is at distance 0.
+// The cells are stored as one flat list of segment indices per cell (CSR layout), queries don't
+// allocate and can run concurrently once the index is built.
+class SegmentIndex
+{
+  public:
+	struct Segment
+	{
+		Vector3 start;
+		Vector3 end;
+		float radius;
+		int node; // index of the node in the arena the index was built from
+	};
+
+	struct Hit
+	{
+		int segment = -1; // -1 when nothing was found
+		float distance = std::numeric_limits<float>::infinity();
+		bool is_valid() const { return segment >= 0; }
+	};
+
+	// cell_size of 0 derives it from the segment lengths
+	SegmentIndex(const float cell_size = 0) : requested_cell_size(cell_size) {};
+
+	void build(const NodeArena& arena);
+	void build(std::vector<Segment> segments);
+	void clear();
+
+	int size() const { return (int)segments.size(); }
+	const Segment& get_segment(const int index) const { return segments[index]; }
+	float get_cell_size() const { return cell_size; }
+	static float distance_to_segment(const Vector3& point, const Segment& segment);
+	// Point of the axis of the segment closest to point
+	static Vector3 closest_axis_point(const Vector3& point, const Segment& segment);
+
+	// Calls f(segment_index) once for every segment closer than radius to the point
+	template <typename F>
+	void for_each_in_radius(const Vector3& point, const float radius, F&& f) const
+	{
+		if (segments.empty())
+			return;
+		Vector3 extent = Vector3::Constant(radius);
+		std::array<int, 3> low = to_cell(point - extent);
+		std::array<int, 3> high = to_cell(point + extent);
+		for (int z = low[2]; z <= high[2]; z++)
+			for (int y = low[1]; y <= high[1]; y++)
+				for (int x = low[0]; x <= high[0]; x++)
+				{
+					int cell = (z * dimensions[1] + y) * dimensions[0] + x;
+					for (int i = cell_offsets[cell]; i < cell_offsets[cell + 1]; i++)
+					{
+						int segment = cell_segments[i];
+						// a segment spanning several cells is only reported from the first cell
+						// shared by the segment and the query
+						const std::array<int, 3>& first = segment_first_cell[segment];
+						if (std::max(first[0], low[0]) != x || std::max(first[1], low[1]) != y ||
+						    std::max(first[2], low[2]) != z)
+							continue;
+						if (distance_to_segment(point, segments[segment]) <= radius)
+							f(segment);
+					}
+				}
+	}
+
+	std::vector<int> query_radius(const Vector3& point, const float radius) const;
+	// Closest segment to the point, searched up to max_distance
+	Hit nearest(const Vector3& point,
+	            const float max_distance = std::numeric_limits<float>::infinity()) const;
+	// First segment hit by the ray, direction must be normalized. Segments of ignored_node are
+	// skipped (typically the node the ray is cast from), a ray starting inside a segment hits it
+	// at distance 0.
+	Hit raycast(const Vector3& origin, const Vector3& direction,
+	            const float max_distance = std::numeric_limits<float>::infinity(),
+	            const int ignored_node = -1) const;
+
+  private:
+	float requested_cell_size;
+	float cell_size = 1;
+	Vector3 grid_min = Vector3::Zero();
+	std::array<int, 3> dimensions{1, 1, 1};
+	std::vector<Segment> segments;
+	std::vector<std::array<int, 3>> segment_first_cell;
+	// the segments overlapping cell c are cell_segments[cell_offsets[c], cell_offsets[c + 1])
+	std::vector<int> cell_offsets;
+	std::vector<int> cell_segments;
+
+	std::array<int, 3> to_cell(const Vector3& point) const;
+};
+
+} // namespace Mtree
@@ -1,5 +1,6 @@
 #include "Tree.hpp"
 #include "Node.hpp"
+#include "source/utilities/NodeUtilities.hpp"
 #include <iostream>
 #include <stdexcept>
 #include <vector>
@@ -8,11 +9,54 @@ namespace Mtree
 {
 Tree::Tree(std::shared_ptr<TreeFunction> trunkFunction) { firstFunction = trunkFunction; }
 void Tree::set_first_function(std::shared_ptr<TreeFunction> function) { firstFunction = function; }
-void Tree::execute_functions()
+void Tree::execute_functions(const BuildControl* control, const int seed_offset,
+                             const int max_threads)
 {
 	if (!firstFunction)
 		throw std::runtime_error("Cannot execute tree: no trunk function set");
-	firstFunction->execute(stems);
+	stems.clear();
+	if (profile)
+		profiler.clear();
+	execution_memory.reset();
+	meshing_memory.reset();
+	ProfilerBinding profiling{get_active_profiler()};
+	ProfileScope scope{"execute_functions"};
+	creator_index.invalidate();
+	ExecutionContext context;
+	context.control = control;
+	context.cache = cache_functions ? &function_cache : nullptr;
+	context.creator_index = &creator_index;
+	context.scratch = &scratch_arena;
+	context.seed_offset = seed_offset;
+	context.max_threads = max_threads;
+	context.memory_peak = track_memory ? &execution_memory : nullptr;
+	try
+	{
+		ProfileScope function_scope{firstFunction->get_name()};
+		if (cache_functions)
+		{
+			function_cache.begin_run();
+			firstFunction->execute_cached(stems, context, FunctionCache::root_key);
+			function_cache.end_run();
+		}
+		else
+		{
+			function_cache.clear();
+			firstFunction->execute(stems, context);
+		}
+		if (function_scope.is_active())
+			function_scope.add_counter("nodes", NodeUtilities::count_nodes(stems));
+	}
+	catch (...)
+	{
+		creator_index.invalidate();
+		throw;
+	}
+	creator_index.invalidate();
+	update_arena();
+	scope.add_counter("nodes", arena.size());
+	if (track_memory)
+		execution_memory.record(memory_footprint().total());
 }
 
 void Tree::print_tree()
@@ -31,4 +75,32 @@ void Tree::print_tree()
 TreeFunction& Tree::get_first_function() { return *firstFunction; }
 
 std::vector<Stem>& Tree::get_stems() { return stems; }
+
+NodeArena& Tree::get_arena() { return arena; }
+
+void Tree::update_arena() { arena.build(stems); }
+
+int Tree::get_node_count() const { return arena.size(); }
+
+int Tree::get_cached_state_count() const { return function_cache.size(); }
+
+void Tree::clear_function_cache() { function_cache.clear(); }
+
+ScratchArena& Tree::get_scratch_arena() { return scratch_arena; }
+
+MemoryFootprint Tree::memory_footprint() const
+{
+	MemoryFootprint footprint;
+	NodeUtilities::add_to_footprint(stems, footprint);
+	footprint.add("arena", arena.get_memory_size());
+	footprint.add("function_cache", function_cache.get_memory_size());
+	footprint.add("scratch", scratch_arena.get_capacity());
+	return footprint;
+}
+
+MemoryPeak* Tree::get_active_meshing_memory() { return track_memory ? &meshing_memory : nullptr; }
+
+Profiler& Tree::get_profiler() { return profiler; }
+
+Profiler* Tree::get_active_profiler() { return profile ? &profiler : nullptr; }
 } // namespace Mtree
@@ -1,6 +1,9 @@
 #pragma once
 #include "Node.hpp"
+#include "NodeArena.hpp"
 #include "source/tree_functions/base_types/TreeFunction.hpp"
+#include "source/utilities/MemoryFootprint.hpp"
+#include "source/utilities/Profiler.hpp"
 #include <vector>
 
 namespace Mtree
@@ -9,15 +12,60 @@ class Tree
 {
   private:
 	std::vector<Stem> stems;
+	NodeArena arena;
+	FunctionCache function_cache;
+	CreatorIndex creator_index;
+	ScratchArena scratch_arena; // kept between executions, so that warm builds reuse its memory
+	Profiler profiler;
+	MemoryPeak execution_memory;
+	MemoryPeak meshing_memory;
 	std::shared_ptr<TreeFunction> firstFunction;
 
   public:
+	// Keep snapshots of the stems between executions, so that functions whose parameters and
+	// inputs did not change are restored instead of executed again
+	bool cache_functions = false;
+	// Record the timings of the functions, and of the meshers run on the tree, into the profiler.
+	// Each execution clears the previous profile.
+	bool profile = false;
+	// Record the high water marks of the memory used by the executions and by the meshers run on
+	// the tree. Each execution resets both.
+	bool track_memory = false;
+
 	Tree(std::shared_ptr<TreeFunction> trunkFunction);
 	Tree() { firstFunction = nullptr; };
 	void set_first_function(std::shared_ptr<TreeFunction> function);
-	void execute_functions();
+	// Runs the function graph. When a control is given the functions report progress to it and
+	// stop by throwing BuildCancelled once it is cancelled. seed_offset is added to the seed of
+	// every function, as TreeFunction::offset_seeds would, and max_threads (when positive) caps
+	// their threads. The graph is left unchanged, trees may share one and execute it concurrently.
+	void execute_functions(const BuildControl* control = nullptr, const int seed_offset = 0,
+	                       const int max_threads = 0);
 	void print_tree();
 	TreeFunction& get_first_function();
+	bool has_first_function() const { return firstFunction != nullptr; }
 	std::vector<Stem>& get_stems();
+	// flat view of the stems, rebuilt after each execution. Call update_arena after editing the
+	// stems directly.
+	NodeArena& get_arena();
+	void update_arena();
+	int get_node_count() const;
+	int get_cached_state_count() const;
+	void clear_function_cache();
+	// Memory of the temporaries of the functions and meshers run on the tree
+	ScratchArena& get_scratch_arena();
+	// Memory held by the tree: its stems (see NodeUtilities::add_to_footprint), the arena, the
+	// function cache and the scratch arena
+	MemoryFootprint memory_footprint() const;
+	// Peak of the last execution: stems, scratch arena and working state of the functions (growth
+	// tables, shadow grids), then the footprint of the finished tree. 0 when not tracked.
+	size_t get_execution_memory_peak() const { return execution_memory.get(); }
+	// Peak of the meshers run since the last execution: meshes, layouts and their temporaries
+	size_t get_meshing_memory_peak() const { return meshing_memory.get(); }
+	// Peak the meshers record to when memory is tracked, null otherwise
+	MemoryPeak* get_active_meshing_memory();
+	Profiler& get_profiler();
+	// The profiler when profiling is enabled, null otherwise
+	Profiler* get_active_profiler();
 };
 } // namespace Mtree
@@ -0,0 +1,107 @@
+#include "TreeBuild.hpp"
+#include "source/meshers/splines_mesher/BasicMesher.hpp"
+#include <stdexcept>
+
+namespace Mtree
+{
+TreeBuild::TreeBuild(Tree& tree, std::unique_ptr<TreeMesher> mesher,
+                     std::optional<PreviewSettings> preview)
+    : tree{tree}, mesher{std::move(mesher)}, preview_settings{preview}
+{
+	control.progress_callback = [this](const std::string& stage, float fraction)
+	{
+		std::lock_guard<std::mutex> lock{progress_mutex};
+		progress_stage = stage;
+		progress_fraction = fraction;
+	};
+	preview_control.progress_callback = [this](const std::string& stage, float fraction)
+	{
+		std::lock_guard<std::mutex> lock{progress_mutex};
+		progress_stage = "preview " + stage;
+		progress_fraction = fraction;
+	};
+	if (this->mesher != nullptr)
+		this->mesher->control = &control;
+	worker = std::thread{&TreeBuild::run, this};
+}
+
+TreeBuild::~TreeBuild()
+{
+	cancel();
+	wait();
+}
+
+void TreeBuild::run()
+{
+	try
+	{
+		if (preview_settings && mesher != nullptr && tree.has_first_function())
+			build_preview();
+		tree.execute_functions(&control);
+		if (mesher != nullptr)
+			mesh = mesher->mesh_tree(tree);
+	}
+	catch (const BuildCancelled&)
+	{
+		// is_cancelled already reports it
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	done = true;
+}
+
+void TreeBuild::build_preview()
+{
+	std::shared_ptr<TreeFunction> function = tree.get_first_function().clone();
+	function->reduce_resolution(preview_settings->resolution_factor);
+	Tree preview_tree{function};
+	BasicMesher preview_mesher;
+	preview_mesher.radial_resolution = preview_settings->radial_resolution;
+	preview_mesher.control = &preview_control;
+	preview_control.set_deadline(BuildControl::Clock::now() +
+	                             std::chrono::milliseconds{preview_settings->time_budget_ms});
+	try
+	{
+		preview_tree.execute_functions(&preview_control);
+		preview_mesh = preview_mesher.mesh_tree(preview_tree);
+		preview_ready = true;
+	}
+	catch (const BuildCancelled&)
+	{
+		// over budget, or the whole build is cancelled and stops at its next check
+	}
+}
+
+void TreeBuild::wait()
+{
+	if (worker.joinable())
+		worker.join();
+}
+
+std::pair<std::string, float> TreeBuild::get_progress() const
+{
+	std::lock_guard<std::mutex> lock{progress_mutex};
+	return {progress_stage, progress_fraction};
+}
+
+Mesh& TreeBuild::get_mesh()
+{
+	wait();
+	if (error)
+		std::rethrow_exception(error);
+	if (is_cancelled())
+		throw std::runtime_error("Tree build was cancelled");
+	if (mesher == nullptr)
+		throw std::runtime_error("Tree build has no mesher");
+	return mesh;
+}
+
+const Mesh& TreeBuild::get_preview() const
+{
+	if (!preview_ready)
+		throw std::runtime_error("Tree build has no preview");
+	return preview_mesh;
+}
+} // namespace Mtree
@@ -0,0 +1,79 @@
+#pragma once
+#include "Tree.hpp"
+#include "source/meshers/base_types/TreeMesher.hpp"
+#include "source/utilities/BuildControl.hpp"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace Mtree
+{
+
+// Cheap first result of a progressive build
+struct PreviewSettings
+{
+	float resolution_factor = .25f; // see TreeFunction::reduce_resolution
+	int radial_resolution = 6;      // of the BasicMesher splines of the preview
+	int time_budget_ms = 200;       // the preview is dropped when it takes longer
+};
+
+// Executes the functions of a tree, and optionally meshes it, on a background thread.
+// The tree must outlive the build and must not be used until the build is done.
+// With preview settings, a build with a mesher first meshes a reduced copy of the function graph
+// with BasicMesher without smoothing, available from get_preview while the full build runs.
+class TreeBuild
+{
+  private:
+	Tree& tree;
+	std::unique_ptr<TreeMesher> mesher;
+	Mesh mesh;
+	std::exception_ptr error;
+	BuildControl control;
+	std::atomic<bool> done{false};
+	std::optional<PreviewSettings> preview_settings;
+	BuildControl preview_control;
+	Mesh preview_mesh;
+	std::atomic<bool> preview_ready{false};
+	mutable std::mutex progress_mutex;
+	std::string progress_stage;
+	float progress_fraction = 0;
+	std::thread worker;
+
+	void run();
+	void build_preview();
+
+  public:
+	TreeBuild(Tree& tree, std::unique_ptr<TreeMesher> mesher = nullptr,
+	          std::optional<PreviewSettings> preview = std::nullopt);
+	TreeBuild(const TreeBuild&) = delete;
+	TreeBuild& operator=(const TreeBuild&) = delete;
+	// Cancels the build and waits for the worker to stop
+	~TreeBuild();
+
+	bool is_done() const { return done; }
+	bool is_cancelled() const { return control.is_cancelled(); }
+	// Asks the build to stop, it stops at the next cancellation check of the running stage
+	void cancel()
+	{
+		control.cancel();
+		preview_control.cancel();
+	}
+	// Last reported stage ("growth", "mesh", ...) and fraction of that stage already done
+	std::pair<std::string, float> get_progress() const;
+	// Blocks until the build is done
+	void wait();
+	// Waits for the build and returns its mesh. Rethrows the error the build failed with.
+	Mesh& get_mesh();
+	// Whether the preview is ready. It isn't when the build has no preview settings, and when
+	// the preview didn't fit in its time budget.
+	bool has_preview() const { return preview_ready; }
+	// The preview mesh, not modified once it is ready
+	const Mesh& get_preview() const;
+};
+
+} // namespace Mtree
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <numbers>
 #include <queue>
@@ -6,6 +7,7 @@
 #include "BranchFunction.hpp"
 #include "source/utilities/GeometryUtilities.hpp"
 #include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Parallel.hpp"
 
 using namespace Mtree;
 
@@ -13,19 +15,6 @@ namespace
 {
 constexpr float EPSILON = 0.001f;
 
-void update_positions_rec(Node& node, const Vector3& position)
-{
-	auto& info = std::get<BranchGrowthInfo>(node.growthInfo);
-	info.position = position;
-
-	for (auto& child : node.children)
-	{
-		Vector3 child_position =
-		    position + node.direction * node.length * child->position_in_parent;
-		update_positions_rec(child->node, child_position);
-	}
-}
-
 bool avoid_floor(const Vector3& node_position, Vector3& node_direction,
                  float parent_length) // return true if branch should be terminated
 {
@@ -37,24 +26,45 @@ bool avoid_floor(const Vector3& node_position, Vector3& node_direction,
 	       0; // is node heading to floor too fast
 }
 
-Vector3 get_main_child_direction(Node& parent, const Vector3& parent_position,
-                                 const float up_attraction, const float flatness,
-                                 const float randomness, const float resolution,
-                                 bool& should_terminate)
+Vector3 get_main_child_direction(RandomGenerator& rand_gen, Node& parent,
+                                 const Vector3& parent_position, const float up_attraction,
+                                 const float flatness, const float randomness,
+                                 const float resolution, bool& should_terminate)
 {
 	Vector3 random_dir =
-	    Geometry::random_vec(flatness).normalized() + Vector3{0, 0, 1} * up_attraction;
+	    Geometry::random_vec(rand_gen, flatness).normalized() + Vector3{0, 0, 1} * up_attraction;
 	Vector3 child_direction = parent.direction + random_dir * randomness / resolution;
 	should_terminate = avoid_floor(parent_position, child_direction, parent.length);
 	child_direction.normalize();
 	return child_direction;
 }
 
-Vector3 get_split_direction(const Node& parent, const Vector3& parent_position,
-                            const float up_attraction, const float flatness, const float resolution,
-                            const float angle)
+// Turns a normalized direction away from the obstacles within length of the end of a node of that
+// length, each pushing along the normal to its axis with a weight fading out at length. Obstacles
+// containing the end, like the parent of a branch around its base, don't push.
+void avoid_obstacles(const SegmentIndex& obstacles, const Vector3& node_position,
+                     Vector3& direction, const float length, const float strength)
+{
+	Vector3 end = node_position + direction * length;
+	Vector3 push = Vector3::Zero();
+	auto push_away = [&](const int i)
+	{
+		const SegmentIndex::Segment& segment = obstacles.get_segment(i);
+		float distance = SegmentIndex::distance_to_segment(end, segment);
+		if (distance <= 0)
+			return;
+		Vector3 away = end - SegmentIndex::closest_axis_point(end, segment);
+		push += away.normalized() * (1 - distance / length);
+	};
+	obstacles.for_each_in_radius(end, length, push_away);
+	direction = (direction + push * strength).normalized();
+}
+
+Vector3 get_split_direction(RandomGenerator& rand_gen, const Node& parent,
+                            const Vector3& parent_position, const float up_attraction,
+                            const float flatness, const float angle)
 {
-	Vector3 child_direction = Geometry::random_vec();
+	Vector3 child_direction = Geometry::random_vec(rand_gen);
 	child_direction =
 	    child_direction.cross(parent.direction) + Vector3{0, 0, 1} * up_attraction * flatness;
 	Vector3 flat_normal =
@@ -66,90 +76,76 @@ Vector3 get_split_direction(const Node& parent, const Vector3& parent_position,
 	child_direction.normalize();
 	return child_direction;
 }
-
-void mark_inactive(Node& node)
-{
-	auto& info = std::get<BranchGrowthInfo>(node.growthInfo);
-	info.inactive = true;
-}
-
-bool propagate_inactive_rec(Node& node)
-{
-	auto* info = std::get_if<BranchGrowthInfo>(&node.growthInfo);
-
-	if (node.children.size() == 0 || info->inactive)
-		return info->inactive;
-
-	bool inactive = std::ranges::any_of(node.children, [](const auto& child)
-	                                    { return propagate_inactive_rec(child->node); });
-	info->inactive = inactive;
-	return inactive;
-}
 } // namespace
 
 namespace Mtree
 {
-void BranchFunction::apply_gravity_to_branch(Node& branch_origin)
+// bend the branch under its weight: one bottom-up sweep for the weights and inactive flags, then
+// one top-down sweep for the rotations and positions, over the flattened branch
+void BranchFunction::apply_gravity_to_branch(Node& branch_origin, BranchGrowthTable& table,
+                                             NodeArena& branch) const
 {
-	propagate_inactive_rec(branch_origin);
-	update_weight_rec(branch_origin);
-	apply_gravity_rec(branch_origin, Eigen::AngleAxisf::Identity());
-	auto& info = std::get<BranchGrowthInfo>(branch_origin.growthInfo);
-	update_positions_rec(branch_origin, info.position);
-}
-
-void BranchFunction::apply_gravity_rec(Node& node, Eigen::AngleAxisf curent_rotation)
-{
-	auto& info = std::get<BranchGrowthInfo>(node.growthInfo);
-	if (!info.inactive || true)
-	{
-		float horizontality = 1 - std::abs(node.direction.z());
-		info.age += 1 / resolution;
-		float displacement = horizontality * std::pow(info.cumulated_weight, .5f) *
-		                     gravity->strength / resolution / resolution / 1000 / (1 + info.age);
-		displacement *=
-		    std::exp(-std::abs(info.deviation_from_rest_pose / resolution * gravity->stiffness));
-		info.deviation_from_rest_pose += displacement;
-
-		Vector3 tangent = node.direction.cross(Vector3{0, 0, -1}).normalized();
-		Eigen::AngleAxisf rot{displacement, tangent};
-		curent_rotation = rot * curent_rotation;
-
-		node.direction = curent_rotation * node.direction;
-	}
-
-	for (auto& child : node.children)
-	{
-		apply_gravity_rec(child->node, curent_rotation);
-	}
-}
-
-void BranchFunction::update_weight_rec(Node& node)
-{
-	float node_weight = node.length;
-	for (auto& child : node.children)
-	{
-		update_weight_rec(child->node);
-		auto& child_info = std::get<BranchGrowthInfo>(child->node.growthInfo);
-		node_weight += child_info.cumulated_weight;
-	}
-
-	auto* info = std::get_if<BranchGrowthInfo>(&node.growthInfo);
-	info->cumulated_weight = node_weight;
+	auto& origin_info = table[branch_origin];
+	branch.build(branch_origin, origin_info.position);
+
+	branch.sweep_up(
+	    [&](const int i)
+	    {
+		    Node& node = branch[i];
+		    auto& info = table[node];
+		    float node_weight = node.length;
+		    bool any_child_inactive = false;
+		    for (auto& child : node.children)
+		    {
+			    auto& child_info = table[child->node];
+			    node_weight += child_info.cumulated_weight;
+			    any_child_inactive |= child_info.inactive;
+		    }
+		    info.cumulated_weight = node_weight;
+		    // a node is inactive when one of its children is
+		    if (node.children.size() > 0 && !info.inactive)
+			    info.inactive = any_child_inactive;
+	    });
+
+	branch.sweep_down(
+	    Eigen::AngleAxisf::Identity(),
+	    [&](const int i, Eigen::AngleAxisf curent_rotation)
+	    {
+		    Node& node = branch[i];
+		    auto& info = table[node];
+		    info.position = branch.position[i];
+
+		    float horizontality = 1 - std::abs(node.direction.z());
+		    info.age += 1 / resolution;
+		    float displacement = horizontality * std::pow(info.cumulated_weight, .5f) *
+		                         gravity->strength / resolution / resolution / 1000 /
+		                         (1 + info.age);
+		    displacement *= std::exp(
+		        -std::abs(info.deviation_from_rest_pose / resolution * gravity->stiffness));
+		    info.deviation_from_rest_pose += displacement;
+
+		    Vector3 tangent = node.direction.cross(Vector3{0, 0, -1}).normalized();
+		    Eigen::AngleAxisf rot{displacement, tangent};
+		    curent_rotation = rot * curent_rotation;
+
+		    node.direction = curent_rotation * node.direction;
+		    return curent_rotation;
+	    });
 }
 
 // grow extremity by one level (add one or more children)
-void BranchFunction::grow_node_once(Node& node, const int id,
-                                    std::queue<std::reference_wrapper<Node>>& results)
+void BranchFunction::grow_node_once(Node& node, const int id, BranchGrowthTable& table,
+                                    NodeQueue& results, const SegmentIndex* obstacles) const
 {
-	bool break_branch = rand_gen.get_0_1() * resolution < break_chance;
+	auto& info = table[node];
+	RandomGenerator& node_rand_gen = info.rand_gen;
+	bool break_branch = node_rand_gen.get_0_1() * resolution < break_chance;
 	if (break_branch)
 	{
-		mark_inactive(node);
+		info.inactive = true;
 		return;
 	}
 
-	auto& info = std::get<BranchGrowthInfo>(node.growthInfo);
 	float factor_in_branch = info.current_length / info.desired_length;
 
 	float child_radius =
@@ -157,14 +153,17 @@ void BranchFunction::grow_node_once(Node& node, const int id,
 	float child_length = std::min(1 / resolution, info.desired_length - info.current_length);
 	bool should_terminate;
 	Vector3 child_direction = get_main_child_direction(
-	    node, info.position, gravity->up_attraction, flatness, randomness.execute(factor_in_branch),
-	    resolution, should_terminate);
+	    node_rand_gen, node, info.position, gravity->up_attraction, flatness,
+	    randomness.execute(factor_in_branch, node_rand_gen), resolution, should_terminate);
 
 	if (should_terminate)
 	{
-		mark_inactive(node);
+		info.inactive = true;
 		return;
 	}
+	if (obstacles != nullptr)
+		avoid_obstacles(*obstacles, info.position, child_direction, child_length,
+		                collision_avoidance);
 
 	NodeChild child{.node = Node{child_direction, node.tangent, child_length, child_radius, id},
 	                .position_in_parent = 1};
@@ -173,35 +172,40 @@ void BranchFunction::grow_node_once(Node& node, const int id,
 
 	float current_length = info.current_length + child_length;
 	Vector3 child_position = info.position + child_direction * child_length;
-	child_node.growthInfo = BranchGrowthInfo{.desired_length = info.desired_length,
-	                                         .origin_radius = info.origin_radius,
-	                                         .position = child_position,
-	                                         .current_length = current_length};
+	table.add(child_node, BranchGrowthInfo{.desired_length = info.desired_length,
+	                                       .origin_radius = info.origin_radius,
+	                                       .position = child_position,
+	                                       .current_length = current_length,
+	                                       .rand_gen = node_rand_gen.derive(0)});
 	if (current_length < info.desired_length)
 	{
 		results.push(std::ref<Node>(child_node));
 	}
 
-	bool do_split = rand_gen.get_0_1() * resolution <
+	bool do_split = node_rand_gen.get_0_1() * resolution <
 	                split->probability; // should the node split into two children
 	if (do_split)
 	{
-		Vector3 split_child_direction = get_split_direction(
-		    node, info.position, gravity->up_attraction, flatness, resolution, split->angle);
+		Vector3 split_child_direction =
+		    get_split_direction(node_rand_gen, node, info.position, gravity->up_attraction,
+		                        flatness, split->angle);
+		if (obstacles != nullptr)
+			avoid_obstacles(*obstacles, info.position, split_child_direction, child_length,
+			                collision_avoidance);
 		float split_child_radius = node.radius * split->radius;
 
 		NodeChild child{
 		    .node = Node{split_child_direction, node.tangent, child_length, split_child_radius, id},
-		    .position_in_parent = rand_gen.get_0_1()};
+		    .position_in_parent = node_rand_gen.get_0_1()};
 		node.children.push_back(std::make_shared<NodeChild>(std::move(child)));
 		auto& child_node = node.children.back()->node;
 
 		Vector3 split_child_position = info.position + split_child_direction * child_length;
-		child_node.growthInfo =
-		    BranchGrowthInfo{.desired_length = info.desired_length,
-		                     .origin_radius = info.origin_radius * split->radius,
-		                     .position = split_child_position,
-		                     .current_length = current_length};
+		table.add(child_node, BranchGrowthInfo{.desired_length = info.desired_length,
+		                                       .origin_radius = info.origin_radius * split->radius,
+		                                       .position = split_child_position,
+		                                       .current_length = current_length,
+		                                       .rand_gen = node_rand_gen.derive(1)});
 		if (current_length < info.desired_length)
 		{
 			results.push(std::ref<Node>(child_node));
@@ -209,38 +213,84 @@ void BranchFunction::grow_node_once(Node& node, const int id,
 	}
 }
 
-void BranchFunction::grow_origins(std::vector<std::reference_wrapper<Node>>& origins, const int id)
+// grow the branch of one origin level by level, bending it under its weight between two levels.
+// returns the number of levels grown
+int BranchFunction::grow_origin(Node& origin, BranchGrowthTable& table, const int id,
+                                const BuildControl* control, std::pmr::memory_resource* scratch,
+                                const SegmentIndex* obstacles) const
 {
-	std::queue<std::reference_wrapper<Node>> extremities;
-	for (auto& node_ref : origins)
-	{
-		extremities.push(node_ref);
-	}
-	int batch_size = extremities.size();
-	while (!extremities.empty())
+	NodeQueue extremities{std::pmr::deque<std::reference_wrapper<Node>>{scratch}};
+	extremities.push(std::ref(origin));
+	NodeArena branch; // reused between levels
+	int levels = 0;
+	while (true)
 	{
-		if (batch_size == 0)
+		levels++;
+		int batch_size = extremities.size();
+		for (int i = 0; i < batch_size; i++)
 		{
-			batch_size = extremities.size();
-			for (auto& node_ref : origins)
-			{
-				apply_gravity_to_branch(node_ref.get());
-			}
+			auto& node = extremities.front().get();
+			extremities.pop();
+			grow_node_once(node, id, table, extremities, obstacles);
 		}
-		auto& node = extremities.front().get();
-		extremities.pop();
-		grow_node_once(node, id, extremities);
-		batch_size--;
+		if (extremities.empty())
+			return levels;
+		check_cancelled(control);
+		apply_gravity_to_branch(origin, table, branch);
 	}
 }
 
+void BranchFunction::grow_origins(std::vector<std::reference_wrapper<Node>>& origins,
+                                  std::vector<BranchGrowthInfo>& origin_infos, const int id,
+                                  const ExecutionContext& context,
+                                  const SegmentIndex* obstacles) const
+{
+	// branches never interact while growing, each origin is an independent task drawing from the
+	// random streams of its own nodes and writing the growth state of its nodes to its own table.
+	// The obstacles are the branches that existed before, they are only read.
+	std::vector<BranchGrowthTable> tables(origins.size());
+	std::vector<int> levels(origins.size());
+	Parallel::parallel_for(
+	    (int)origins.size(),
+	    [&](const int i)
+	    {
+		    ScratchArena::Lease scratch = ScratchArena::lease(context.scratch);
+		    tables[i].add(origins[i].get(), origin_infos[i]);
+		    levels[i] = grow_origin(origins[i].get(), tables[i], id, context.control, scratch.get(),
+		                            obstacles);
+	    },
+	    context.get_threads(threads));
+
+	// branches that finished early keep bending until the deepest one is grown, as if all
+	// branches grew in lockstep
+	int max_levels = levels.empty() ? 0 : *std::max_element(levels.begin(), levels.end());
+	Parallel::parallel_for(
+	    (int)origins.size(),
+	    [&](const int i)
+	    {
+		    NodeArena branch;
+		    for (int level = levels[i]; level < max_levels; level++)
+			    apply_gravity_to_branch(origins[i].get(), tables[i], branch);
+		    tables[i].clear();
+	    },
+	    context.get_threads(threads));
+}
+
 // get the origins of the branches that will be created.
 // origins are created from the nodes made by the parent TreeFunction
 std::vector<std::reference_wrapper<Node>>
-BranchFunction::get_origins(std::vector<Stem>& stems, const int id, const int parent_id)
+BranchFunction::get_origins(std::vector<Stem>& stems, ExecutionContext& context,
+                            const RandomGenerator& rand_gen, const int id, const int parent_id,
+                            std::vector<BranchGrowthInfo>& origin_infos,
+                            std::vector<AddedChild>& added_children) const
 {
 	// get all nodes created by the parent TreeFunction, organised by branch
-	NodeUtilities::BranchSelection selection = NodeUtilities::select_from_tree(stems, parent_id);
+	CreatorIndex* creator_index = context.creator_index;
+	NodeUtilities::BranchSelection tree_selection;
+	if (creator_index == nullptr)
+		tree_selection = NodeUtilities::select_from_tree(stems, parent_id);
+	const NodeUtilities::BranchSelection& selection =
+	    creator_index != nullptr ? creator_index->select(stems, parent_id) : tree_selection;
 	std::vector<std::reference_wrapper<Node>> origins;
 
 	// Calculate effective crown height for shape envelope
@@ -254,9 +304,17 @@ BranchFunction::get_origins(std::vector<Stem>& stems, const int id, const int pa
 
 	float origins_dist =
 	    1 / (distribution->density + .001); // distance between two consecutive origins
-
-	for (auto& branch : selection) // parent branches
+	// properties of the origins of a node, evaluated in batches (reused between nodes)
+	std::vector<float> origin_factors;
+	std::vector<RandomGenerator> origin_rand_gens;
+	std::vector<float> origin_radii;
+	std::vector<float> origin_lengths;
+	std::vector<float> origin_angles;
+
+	for (size_t branch_index = 0; branch_index < selection.size(); branch_index++)
 	{
+		const auto& branch = selection[branch_index]; // parent branch
+		RandomGenerator branch_rand_gen = rand_gen.derive(branch_index);
 		if (branch.size() == 0)
 		{
 			continue;
@@ -281,8 +339,9 @@ BranchFunction::get_origins(std::vector<Stem>& stems, const int id, const int pa
 			{
 				continue;
 			}
+			RandomGenerator node_rand_gen = branch_rand_gen.derive(node_index);
 			auto rot =
-			    Eigen::AngleAxisf((distribution->phillotaxis + (rand_gen.get_0_1() - .5) * 2) /
+			    Eigen::AngleAxisf((distribution->phillotaxis + (node_rand_gen.get_0_1() - .5) * 2) /
 			                          180 * std::numbers::pi_v<float>,
 			                      node.direction);
 			if (dist_to_next_origin > node.length)
@@ -302,20 +361,39 @@ BranchFunction::get_origins(std::vector<Stem>& stems, const int id, const int pa
 				float position_in_parent_step =
 				    origins_dist / node.length; // relative distance between origins within the node
 
+				// each origin draws its properties from its own stream, in the same order as a
+				// per origin evaluation would
+				origin_factors.clear();
+				origin_rand_gens.clear();
+				float origin_length = current_length;
+				for (int i = 0; i < origins_to_create && origin_length <= absolute_end; i++)
+				{
+					origin_factors.push_back((origin_length - absolute_start) /
+					                         std::max(0.001f, absolute_end - absolute_start));
+					origin_rand_gens.push_back(node_rand_gen.derive(i));
+					if (i > 0)
+						origin_length += origins_dist;
+				}
+				origin_radii.resize(origin_factors.size());
+				origin_lengths.resize(origin_factors.size());
+				origin_angles.resize(origin_factors.size());
+				start_radius.execute_batch(origin_factors, origin_radii, origin_rand_gens);
+				length.execute_batch(origin_factors, origin_lengths, origin_rand_gens);
+				start_angle.execute_batch(origin_factors, origin_angles, origin_rand_gens);
+
 				for (int i = 0; i < origins_to_create; i++)
 				{
 					if (current_length > absolute_end)
 					{
 						break;
 					}
-					float factor = (current_length - absolute_start) /
-					               std::max(0.001f, absolute_end - absolute_start);
+					RandomGenerator origin_rand_gen = origin_rand_gens[i];
 					tangent = rot * tangent;
 					Geometry::project_on_plane(tangent, node.direction);
 					tangent.normalize();
-					float child_radius = node.radius * start_radius.execute(factor);
-					float branch_length = length.execute(factor);
-					float effective_start_angle = start_angle.execute(factor);
+					float child_radius = node.radius * origin_radii[i];
+					float branch_length = origin_lengths[i];
+					float effective_start_angle = origin_angles[i];
 
 					// Calculate height-based modifications for crown shape and angle
 					bool needs_height_calc =
@@ -364,16 +442,20 @@ BranchFunction::get_origins(std::vector<Stem>& stems, const int id, const int pa
 					    position_in_parent};
 					node.children.push_back(std::make_shared<NodeChild>(std::move(child)));
 					auto& child_node = node.children.back()->node;
+					added_children.push_back({(int)branch_index, (int)node_index,
+					                          (int)node.children.size() - 1});
 					Vector3 child_position =
 					    node_position + node.direction * node.length * position_in_parent;
-					child_node.growthInfo =
-					    BranchGrowthInfo{.desired_length = branch_length - node_length,
-					                     .origin_radius = child_radius,
-					                     .position = child_position,
-					                     .current_length = child_node.length};
-
 					if (branch_length - node_length > 1e-3)
+					{
 						origins.push_back(std::ref(child_node));
+						origin_infos.push_back(
+						    BranchGrowthInfo{.desired_length = branch_length - node_length,
+						                     .origin_radius = child_radius,
+						                     .position = child_position,
+						                     .current_length = child_node.length,
+						                     .rand_gen = origin_rand_gen});
+					}
 					position_in_parent += position_in_parent_step;
 					if (i > 0)
 					{
@@ -389,11 +471,81 @@ BranchFunction::get_origins(std::vector<Stem>& stems, const int id, const int pa
 	return origins;
 }
 
-void BranchFunction::execute(std::vector<Stem>& stems, int id, int parent_id)
+void BranchFunction::execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+                             int parent_id) const
+{
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(get_seed(context));
+	rand_gen = rand_gen.derive(id);
+	std::vector<BranchGrowthInfo> origin_infos;
+	std::vector<AddedChild> added_children;
+	// indexed before the origins are added, so that branches only avoid the older ones
+	std::unique_ptr<SegmentIndex> obstacles;
+	if (collision_avoidance > 0)
+	{
+		NodeArena arena;
+		arena.build(stems);
+		obstacles = std::make_unique<SegmentIndex>();
+		obstacles->build(arena);
+	}
+	auto origins = get_origins(stems, context, rand_gen, id, parent_id, origin_infos,
+	                           added_children);
+	grow_origins(origins, origin_infos, id, context, obstacles.get());
+	if (context.creator_index != nullptr)
+	{
+		for (const AddedChild& added : added_children)
+			context.creator_index->add_child_subtree(parent_id, added.branch_index,
+			                                         added.node_index, added.child_index);
+	}
+	execute_children(stems, context, id);
+}
+
+bool BranchFunction::hash_parameters(Fingerprint& fingerprint) const
 {
-	rand_gen.set_seed(seed);
-	auto origins = get_origins(stems, id, parent_id);
-	grow_origins(origins, id);
-	execute_children(stems, id);
+	length.hash(fingerprint);
+	start_radius.hash(fingerprint);
+	fingerprint.add(end_radius);
+	fingerprint.add(break_chance);
+	fingerprint.add(resolution);
+	randomness.hash(fingerprint);
+	fingerprint.add(flatness);
+	start_angle.hash(fingerprint);
+	fingerprint.add(collision_avoidance);
+
+	fingerprint.add(split->radius);
+	fingerprint.add(split->angle);
+	fingerprint.add(split->probability);
+	fingerprint.add(gravity->strength);
+	fingerprint.add(gravity->stiffness);
+	fingerprint.add(gravity->up_attraction);
+	fingerprint.add(distribution->start);
+	fingerprint.add(distribution->end);
+	fingerprint.add(distribution->density);
+	fingerprint.add(distribution->phillotaxis);
+	fingerprint.add(crown->shape);
+	fingerprint.add(crown->base_size);
+	fingerprint.add(crown->height);
+	fingerprint.add(crown->angle_variation);
+	return true;
 }
+
+std::shared_ptr<TreeFunction> BranchFunction::clone_function() const
+{
+	auto copy = std::make_shared<BranchFunction>(*this);
+	copy->length = length.clone();
+	copy->start_radius = start_radius.clone();
+	copy->randomness = randomness.clone();
+	copy->start_angle = start_angle.clone();
+	copy->split = std::make_shared<SplitParams>(*split);
+	copy->gravity = std::make_shared<GravityParams>(*gravity);
+	copy->distribution = std::make_shared<DistributionParams>(*distribution);
+	copy->crown = std::make_shared<CrownParams>(*crown);
+	return copy;
+}
+
+void BranchFunction::reduce_own_resolution(const float factor)
+{
+	resolution = std::max(resolution * factor, .1f);
+}
+
 } // namespace Mtree
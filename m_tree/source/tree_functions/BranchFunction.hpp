@@ -1,10 +1,15 @@
 #pragma once
 #include "./base_types/TreeFunction.hpp"
 #include "CrownShape.hpp"
+#include "source/tree/GrowthInfo.hpp"
+#include "source/tree/NodeArena.hpp"
+#include "source/tree/SegmentIndex.hpp"
 #include "source/tree_functions/base_types/Property.hpp"
 #include "source/utilities/GeometryUtilities.hpp"
 #include "source/utilities/NodeUtilities.hpp"
+#include <deque>
 #include <memory>
+#include <memory_resource>
 #include <queue>
 #include <vector>
 
@@ -49,6 +54,10 @@ class BranchFunction : public TreeFunction
 	PropertyWrapper randomness{ConstantProperty(.4)};
 	float flatness = .5;                               // 0 < x  < 1
 	PropertyWrapper start_angle{ConstantProperty(45)}; // -180 < x < 180
+	// How strongly growing branches turn away from the branches that existed before this function
+	// ran, looked up in a SegmentIndex (0 < x, 0 disables it)
+	float collision_avoidance = 0;
+	int threads = 1; // threads growing the branches, 0 uses every hardware thread
 
 	// Parameter groupings
 	std::shared_ptr<SplitParams> split = std::make_shared<SplitParams>();
@@ -56,22 +65,53 @@ class BranchFunction : public TreeFunction
 	std::shared_ptr<DistributionParams> distribution = std::make_shared<DistributionParams>();
 	std::shared_ptr<CrownParams> crown = std::make_shared<CrownParams>();
 
-	void execute(std::vector<Stem>& stems, int id, int parent_id) override;
+	void execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+	             int parent_id) const override;
+	const char* get_name() const override { return "BranchFunction"; }
+
+  protected:
+	bool hash_parameters(Fingerprint& fingerprint) const override;
+	std::shared_ptr<TreeFunction> clone_function() const override;
+	void reduce_own_resolution(const float factor) override;
+	bool updates_creator_index() const override { return true; }
 
   private:
-	std::vector<std::reference_wrapper<Node>> get_origins(std::vector<Stem>& stems, const int id,
-	                                                      const int parent_id);
+	using BranchGrowthTable = GrowthTable<BranchGrowthInfo>;
+	using NodeQueue =
+	    std::queue<std::reference_wrapper<Node>, std::pmr::deque<std::reference_wrapper<Node>>>;
+
+	// Side child added by get_origins to the node_index-th node of the branch_index-th branch of
+	// the selection, registered in the creator index once grown
+	struct AddedChild
+	{
+		int branch_index;
+		int node_index;
+		int child_index;
+	};
 
-	void grow_origins(std::vector<std::reference_wrapper<Node>>&, const int id);
+	// origin_infos receives the initial growth state of each origin, added_children every child
+	// created (origins and the children too short to grow)
+	std::vector<std::reference_wrapper<Node>>
+	get_origins(std::vector<Stem>& stems, ExecutionContext& context,
+	            const RandomGenerator& rand_gen, const int id, const int parent_id,
+	            std::vector<BranchGrowthInfo>& origin_infos,
+	            std::vector<AddedChild>& added_children) const;
 
-	void grow_node_once(Node& node, const int id,
-	                    std::queue<std::reference_wrapper<Node>>& results);
+	// obstacles is null unless collision_avoidance is set
+	void grow_origins(std::vector<std::reference_wrapper<Node>>&,
+	                  std::vector<BranchGrowthInfo>& origin_infos, const int id,
+	                  const ExecutionContext& context, const SegmentIndex* obstacles) const;
 
-	void apply_gravity_to_branch(Node& node);
+	// scratch holds the temporaries of the growth
+	int grow_origin(Node& origin, BranchGrowthTable& table, const int id,
+	                const BuildControl* control, std::pmr::memory_resource* scratch,
+	                const SegmentIndex* obstacles) const;
 
-	void apply_gravity_rec(Node& node, Eigen::AngleAxisf previous_rotations);
+	void grow_node_once(Node& node, const int id, BranchGrowthTable& table, NodeQueue& results,
+	                    const SegmentIndex* obstacles) const;
 
-	void update_weight_rec(Node& node);
+	void apply_gravity_to_branch(Node& branch_origin, BranchGrowthTable& table,
+	                             NodeArena& branch) const;
 };
 
 } // namespace Mtree
@@ -1,63 +1,81 @@
 #include "GrowthFunction.hpp"
+#include "GrowthSnapshotCache.hpp"
 #include "./base_types/TreeFunction.hpp"
 #include "source/utilities/GeometryUtilities.hpp"
 #include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Profiler.hpp"
 #include <Eigen/Geometry>
+#include <algorithm>
 #include <iostream>
 #include <math.h>
+#include <optional>
 #include <vector>
 
 namespace Mtree
 {
-void setup_growth_information_rec(Node& node, bool suppress_tip_growth)
+void setup_growth_information(Node& stem_node, bool suppress_tip_growth,
+                              const RandomGenerator& rand_gen, GrowthTable<BioNodeInfo>& table)
 {
 	// When lateral branching is enabled, don't mark tips as Meristem - mark them as Ignored
 	// This prevents the bushy tip growth and lets lateral buds be the primary branch source
 	BioNodeInfo::NodeType tip_type =
 	    suppress_tip_growth ? BioNodeInfo::NodeType::Ignored : BioNodeInfo::NodeType::Meristem;
 
-	node.growthInfo =
-	    BioNodeInfo(node.children.size() == 0 ? tip_type : BioNodeInfo::NodeType::Ignored);
-	for (auto& child : node.children)
-		setup_growth_information_rec(child->node, suppress_tip_growth);
+	NodeUtilities::visit_pre_order(
+	    stem_node, rand_gen,
+	    [&](Node& node, const RandomGenerator& node_rand_gen, auto&& visit_child)
+	    {
+		    BioNodeInfo info(node.children.size() == 0 ? tip_type
+		                                               : BioNodeInfo::NodeType::Ignored);
+		    info.rand_gen = node_rand_gen;
+		    table.add(node, info);
+		    for (size_t i = 0; i < node.children.size(); i++)
+			    visit_child(node.children[i]->node, node_rand_gen.derive(i));
+	    });
 }
 
-// get total amount of energy from the node and its descendance, and assign for each node the
-// realtive amount of energy it receive
-float GrowthFunction::update_vigor_ratio_rec(Node& node)
+// get the amount of energy requested by the node and its descendance from the fluxes of its
+// children, and assign for each child the realtive amount of energy it receives
+float GrowthFunction::update_vigor_ratio(RunState& state, const NodeArena& arena, const int index,
+                                         const std::vector<float>& fluxes) const
 {
-	auto& info = std::get<BioNodeInfo>(node.growthInfo);
+	// meristems, dormant buds, cut nodes and flowers are always tips, the fluxes of their (empty)
+	// children are ignored
+	Node& node = arena[index];
+	auto& info = state.growth_table[node];
 	if (info.type == BioNodeInfo::NodeType::Meristem)
 	{
-		return 1;
+		return get_exposure(state, node);
 	}
 	else if (info.type == BioNodeInfo::NodeType::Dormant)
 	{
 		// Dormant buds request less energy (suppressed by apical dominance)
 		info.vigor_ratio = GrowthConstants::kDormantBudEnergyRequest;
-		return GrowthConstants::kDormantBudEnergyRequest;
+		return GrowthConstants::kDormantBudEnergyRequest * get_exposure(state, node);
 	}
 	else if (info.type == BioNodeInfo::NodeType::Branch ||
 	         info.type == BioNodeInfo::NodeType::Ignored)
 	{
 		// Handle tip nodes marked as Ignored (no children) - they don't contribute energy
-		if (node.children.size() == 0)
+		int first_child = arena.first_child[index];
+		if (first_child == NodeArena::none)
 		{
 			info.vigor_ratio = 0;
 			return 0;
 		}
-		float light_flux = update_vigor_ratio_rec(node.children[0]->node);
+		float light_flux = fluxes[first_child];
 		float vigor_ratio = 1;
-		for (size_t i = 1; i < node.children.size(); i++)
+		for (int child = arena.next_sibling[first_child]; child != NodeArena::none;
+		     child = arena.next_sibling[child])
 		{
-			float child_flux = update_vigor_ratio_rec(node.children[i]->node);
+			float child_flux = fluxes[child];
 			float t = apical_dominance;
 			vigor_ratio = (t * light_flux) /
 			              (t * light_flux + (1 - t) * child_flux + GrowthConstants::kEpsilon);
-			std::get<BioNodeInfo>(node.children[i]->node.growthInfo).vigor_ratio = 1 - vigor_ratio;
+			state.growth_table[arena[child]].vigor_ratio = 1 - vigor_ratio;
 			light_flux += child_flux;
 		}
-		std::get<BioNodeInfo>(node.children[0]->node.growthInfo).vigor_ratio = vigor_ratio;
+		state.growth_table[arena[first_child]].vigor_ratio = vigor_ratio;
 		return light_flux;
 	}
 	else
@@ -67,32 +85,76 @@ float GrowthFunction::update_vigor_ratio_rec(Node& node)
 	}
 }
 
-// update the amount of energy available to a node
-void GrowthFunction::update_vigor_rec(Node& node, float vigor)
+// light received by the tip of a node, 1 when the light model is disabled
+float GrowthFunction::get_exposure(const RunState& state, const Node& node) const
+{
+	if (!enable_shadows)
+		return 1;
+	const auto& info = state.growth_table[node];
+	return state.shadow_grid.get_exposure(info.absolute_position + node.direction * node.length);
+}
+
+// every node present before the first iteration casts its shadow, nodes grown afterwards are
+// added as they are created
+void GrowthFunction::setup_shadows(RunState& state, std::vector<Stem>& stems,
+                                   NodeArena& flat_stem) const
 {
-	auto& info = std::get<BioNodeInfo>(node.growthInfo);
-	info.vigor = vigor;
-	for (auto& child : node.children)
+	state.shadow_grid =
+	    ShadowGrid{shadow_voxel_size, shadow_strength, shadow_decay, shadow_depth};
+	if (!enable_shadows)
+		return;
+	flat_stem.build(stems);
+	for (int i = 0; i < flat_stem.size(); i++)
 	{
-		auto& child_info = std::get<BioNodeInfo>(child->node.growthInfo);
-		float child_vigor = child_info.vigor_ratio * vigor;
+		Node& node = flat_stem[i];
+		state.growth_table[node].absolute_position = flat_stem.position[i];
+		state.shadow_grid.add_shadow(flat_stem.position[i] + node.direction * node.length);
+	}
+}
 
-		// Give dormant buds a fixed proportion of parent vigor (bypasses competitive apical
-		// dominance)
-		if (child_info.type == BioNodeInfo::NodeType::Dormant)
-		{
-			child_vigor =
-			    vigor * (1.0f - apical_dominance) * GrowthConstants::kDormantBudVigorFactor;
-		}
+// hand the energy available to a node over to its children
+void GrowthFunction::update_vigor(RunState& state, const NodeArena& arena, const int index) const
+{
+	float vigor = state.growth_table[arena[index]].vigor;
+	arena.for_each_child(
+	    index,
+	    [&](const int child)
+	    {
+		    auto& child_info = state.growth_table[arena[child]];
+		    float child_vigor = child_info.vigor_ratio * vigor;
+
+		    // Give dormant buds a fixed proportion of parent vigor (bypasses competitive apical
+		    // dominance)
+		    if (child_info.type == BioNodeInfo::NodeType::Dormant)
+		    {
+			    child_vigor =
+			        vigor * (1.0f - apical_dominance) * GrowthConstants::kDormantBudVigorFactor;
+		    }
+		    child_info.vigor = child_vigor;
+	    });
+}
 
-		update_vigor_rec(child->node, child_vigor);
+// the child grows from the tip of node, its position is known until the next gravity pass
+void GrowthFunction::attach_child(RunState& state, Node& node, const int index,
+                                  NodeChild&& child, BioNodeInfo& child_info,
+                                  std::vector<NewChild>& new_children) const
+{
+	if (enable_shadows)
+	{
+		child_info.absolute_position = state.growth_table[node].absolute_position +
+		                               node.direction * node.length * child.position_in_parent;
 	}
+	node.children.push_back(std::make_shared<NodeChild>(std::move(child)));
+	new_children.push_back(NewChild{index, &node.children.back()->node, child_info});
 }
 
-// apply rules on the node based on the energy available to it
-void GrowthFunction::simulate_growth_rec(Node& node, int id)
+// apply rules on the node based on the energy available to it, returns false when the node
+// stopped growing. index is the arena index of the node, recorded in its new children.
+bool GrowthFunction::simulate_node_growth(RunState& state, Node& node, const int index,
+                                          const int id, const float cut_threshold,
+                                          std::vector<NewChild>& new_children) const
 {
-	auto& info = std::get<BioNodeInfo>(node.growthInfo);
+	auto& info = state.growth_table[node];
 
 	// Check for dormant bud activation
 	bool activate_dormant =
@@ -111,24 +173,23 @@ void GrowthFunction::simulate_growth_rec(Node& node, int id)
 	    info.vigor > grow_threshold && info.type != BioNodeInfo::NodeType::Ignored &&
 	    info.type != BioNodeInfo::NodeType::Dormant; // Dormant buds don't get secondary growth
 	bool split = info.type == BioNodeInfo::NodeType::Meristem && info.vigor > split_threshold;
-	bool cut = info.type == BioNodeInfo::NodeType::Meristem && info.vigor < current_cut_threshold_;
+	bool cut = info.type == BioNodeInfo::NodeType::Meristem && info.vigor < cut_threshold;
 
 	// Flower check - vigor low but above cut threshold
 	bool become_flower = enable_flowering && info.type == BioNodeInfo::NodeType::Meristem &&
-	                     info.vigor < flower_threshold && info.vigor >= current_cut_threshold_;
+	                     info.vigor < flower_threshold && info.vigor >= cut_threshold;
 
-	int child_count = node.children.size();
 	if (cut)
 	{
 		info.type = BioNodeInfo::NodeType::Cut;
-		return;
+		return false;
 	}
 
 	// Mark as flower point - flowers don't grow further
 	if (become_flower)
 	{
 		info.type = BioNodeInfo::NodeType::Flower;
-		return;
+		return false;
 	}
 	info.age++;
 	if (secondary_growth)
@@ -137,8 +198,8 @@ void GrowthFunction::simulate_growth_rec(Node& node, int id)
 	}
 	if (primary_growth)
 	{
-		Vector3 child_direction =
-		    node.direction + Vector3{0, 0, 1} * gravitropism + Geometry::random_vec() * randomness;
+		Vector3 child_direction = node.direction + Vector3{0, 0, 1} * gravitropism +
+		                          Geometry::random_vec(info.rand_gen) * randomness;
 		child_direction.normalize();
 		float child_radius = node.radius * GrowthConstants::kExtensionTaper;
 		float child_length = branch_length * (info.vigor + .1f);
@@ -146,8 +207,9 @@ void GrowthFunction::simulate_growth_rec(Node& node, int id)
 		    NodeChild{Node{child_direction, node.tangent, branch_length, child_radius, id}, 1};
 		float child_angle =
 		    split ? info.philotaxis_angle + philotaxis_angle : info.philotaxis_angle;
-		child.node.growthInfo = BioNodeInfo(BioNodeInfo::NodeType::Meristem, 0, child_angle);
-		node.children.push_back(std::make_shared<NodeChild>(std::move(child)));
+		BioNodeInfo child_info(BioNodeInfo::NodeType::Meristem, 0, child_angle);
+		child_info.rand_gen = info.rand_gen.derive(node.children.size());
+		attach_child(state, node, index, std::move(child), child_info, new_children);
 		info.type = BioNodeInfo::NodeType::Branch;
 	}
 	if (split)
@@ -161,211 +223,403 @@ void GrowthFunction::simulate_growth_rec(Node& node, int id)
 		float child_length = branch_length * (info.vigor + .1f);
 		NodeChild child =
 		    NodeChild{Node{child_direction, node.tangent, branch_length, child_radius, id}, 1};
-		child.node.growthInfo = BioNodeInfo(BioNodeInfo::NodeType::Meristem);
-		node.children.push_back(std::make_shared<NodeChild>(std::move(child)));
+		BioNodeInfo child_info(BioNodeInfo::NodeType::Meristem);
+		child_info.rand_gen = info.rand_gen.derive(node.children.size());
+		attach_child(state, node, index, std::move(child), child_info, new_children);
 		info.type = BioNodeInfo::NodeType::Branch;
 	}
-	for (size_t i = 0; i < child_count; i++)
-	{
-		simulate_growth_rec(node.children[i]->node, id);
-	}
+	return true;
 }
 
-void GrowthFunction::get_weight_rec(Node& node)
+void GrowthFunction::simulate_growth(RunState& state, const NodeArena& arena,
+                                     const NodeArena::Split& split, const int id,
+                                     const std::vector<float>& cut_thresholds) const
 {
-	auto& info = std::get<BioNodeInfo>(node.growthInfo);
-	for (auto& child : node.children)
-	{
-		get_weight_rec(child->node);
-	}
-	float segment_weight = node.length * node.radius * node.radius;
-	Vector3 center_of_mass =
-	    (info.absolute_position + node.direction * node.length / 2) * segment_weight;
-	float total_weight = segment_weight;
-	for (auto& child : node.children)
+	// the arena predates the pass: children created during this iteration only grow during the
+	// next one. The descendants of a node that stopped growing are left untouched.
+	std::vector<char> growing(arena.size());
+	std::vector<std::vector<NewChild>> new_children(split.part_count());
+	arena.parallel_sweep_down(
+	    split,
+	    [&](const int i, const int part)
+	    {
+		    int parent = arena.parent[i];
+		    growing[i] = (parent == NodeArena::none || growing[parent]) &&
+		                 simulate_node_growth(state, arena[i], i, id,
+		                                      cut_thresholds[arena.stem_index[i]],
+		                                      new_children[part]);
+	    },
+	    state.threads);
+
+	// the new children are recorded in the order of a serial walk, whatever the split, so that the
+	// shadows accumulate in the same order
+	std::vector<NewChild> merged;
+	for (auto& part_children : new_children)
+		merged.insert(merged.end(), part_children.begin(), part_children.end());
+	std::stable_sort(merged.begin(), merged.end(),
+	                 [](const NewChild& a, const NewChild& b) { return a.parent < b.parent; });
+	for (NewChild& child : merged)
 	{
-		auto& child_info = std::get<BioNodeInfo>(child->node.growthInfo);
-		center_of_mass += child_info.center_of_mass * child_info.branch_weight;
-		total_weight += child_info.branch_weight;
+		state.growth_table.add(*child.node, child.info);
+		if (enable_shadows)
+		{
+			state.shadow_grid.add_shadow(child.info.absolute_position +
+			                        child.node->direction * child.node->length);
+		}
 	}
-	center_of_mass /= total_weight;
-	info.center_of_mass = center_of_mass;
-	info.branch_weight = total_weight;
 }
 
-void GrowthFunction::apply_gravity_rec(Node& node, Eigen::Matrix3f curent_rotation)
+// bend the stems under their weight: one bottom-up sweep for the weights and centers of mass, then
+// one top-down sweep for the rotations and positions
+void GrowthFunction::apply_gravity(RunState& state, NodeArena& arena,
+                                   const NodeArena::Split& split) const
 {
-	auto& info = std::get<BioNodeInfo>(node.growthInfo);
-
-	// Only apply gravity bending to growth nodes, not the original trunk
-	if (info.type != BioNodeInfo::NodeType::Ignored)
-	{
-		Vector3 offset = (info.center_of_mass - info.absolute_position);
-		offset[2] = 0;
-		float lever_arm = offset.norm();
-		float torque = info.branch_weight * lever_arm;
-		float bendiness = std::exp(-(info.age / 2 + info.vigor));
-		float angle =
-		    torque * bendiness * gravity_strength * GrowthConstants::kGravityAngleMultiplier;
-		Vector3 tangent = node.direction.cross(Vector3{0, 0, -1});
-		Eigen::Matrix3f rot;
-		rot = Eigen::AngleAxis<float>(angle, tangent);
-		curent_rotation = curent_rotation * rot;
-		node.direction = curent_rotation * node.direction;
-	}
-
-	for (auto& child : node.children)
-	{
-		apply_gravity_rec(child->node, curent_rotation);
-	}
+	arena.parallel_sweep_up(
+	    split,
+	    [&](const int i, const int)
+	    {
+		    Node& node = arena[i];
+		    auto& info = state.growth_table[node];
+		    info.absolute_position = arena.position[i];
+		    float segment_weight = node.length * node.radius * node.radius;
+		    Vector3 center_of_mass =
+		        (info.absolute_position + node.direction * node.length / 2) * segment_weight;
+		    float total_weight = segment_weight;
+		    for (auto& child : node.children)
+		    {
+			    auto& child_info = state.growth_table[child->node];
+			    center_of_mass += child_info.center_of_mass * child_info.branch_weight;
+			    total_weight += child_info.branch_weight;
+		    }
+		    center_of_mass /= total_weight;
+		    info.center_of_mass = center_of_mass;
+		    info.branch_weight = total_weight;
+	    },
+	    state.threads);
+
+	std::vector<Eigen::Matrix3f> rotations(arena.size());
+	arena.parallel_sweep_down(
+	    split,
+	    [&](const int i, const int)
+	    {
+		    Node& node = arena[i];
+		    auto& info = state.growth_table[node];
+		    Eigen::Matrix3f curent_rotation = Eigen::Matrix3f::Identity();
+		    int parent = arena.parent[i];
+		    if (parent != NodeArena::none)
+		    {
+			    const Node& parent_node = arena[parent];
+			    arena.position[i] = arena.position[parent] + parent_node.direction *
+			                                                     parent_node.length *
+			                                                     arena.position_in_parent[i];
+			    curent_rotation = rotations[parent];
+		    }
+
+		    // Only apply gravity bending to growth nodes, not the original trunk
+		    if (info.type != BioNodeInfo::NodeType::Ignored)
+		    {
+			    Vector3 offset = (info.center_of_mass - info.absolute_position);
+			    offset[2] = 0;
+			    float lever_arm = offset.norm();
+			    float torque = info.branch_weight * lever_arm;
+			    float bendiness = std::exp(-(info.age / 2 + info.vigor));
+			    float angle = torque * bendiness * gravity_strength *
+			                  GrowthConstants::kGravityAngleMultiplier;
+			    Vector3 tangent = node.direction.cross(Vector3{0, 0, -1});
+			    Eigen::Matrix3f rot;
+			    rot = Eigen::AngleAxis<float>(angle, tangent);
+			    curent_rotation = curent_rotation * rot;
+			    node.direction = curent_rotation * node.direction;
+		    }
+		    // the center of mass was measured from the position before bending
+		    info.absolute_position = arena.position[i];
+		    rotations[i] = curent_rotation;
+	    },
+	    state.threads);
 }
 
-void GrowthFunction::update_absolute_position_rec(Node& node, const Vector3& node_position)
+// one iteration of growth over stems that are independent of each other. The subtrees of the
+// stems are swept in parallel, every node only reading the state of its parent or children.
+void GrowthFunction::grow_stems(RunState& state, std::span<Stem> stems,
+                                const float target_light_flux, const int id,
+                                NodeArena& flat_stems) const
 {
-	std::get<BioNodeInfo>(node.growthInfo).absolute_position = node_position;
-	for (auto& child : node.children)
+	flat_stems.build(stems);
+	NodeArena::Split split = flat_stems.split(GrowthConstants::kSubtreeGrain);
+
+	// get total available energy
+	std::vector<float> fluxes(flat_stems.size());
+	flat_stems.parallel_sweep_up(
+	    split,
+	    [&](const int i, const int)
+	    { fluxes[i] = update_vigor_ratio(state, flat_stems, i, fluxes); },
+	    state.threads);
+
+	// Adapt working threshold based on light flux ratio, from one stem to the next
+	std::vector<float> cut_thresholds(stems.size());
+	for (size_t i = 0; i < stems.size(); i++)
 	{
-		Vector3 child_position =
-		    node_position + node.direction * child->position_in_parent * node.length;
-		update_absolute_position_rec(child->node, child_position);
+		float light_flux = fluxes[flat_stems.roots[i]];
+		if (target_light_flux > light_flux)
+		{
+			state.cut_threshold -= GrowthConstants::kThresholdAdjustmentStep;
+		}
+		else if (target_light_flux < light_flux)
+		{
+			state.cut_threshold += GrowthConstants::kThresholdAdjustmentStep;
+		}
+		cut_thresholds[i] = state.cut_threshold;
+		state.growth_table[stems[i].node].vigor = target_light_flux;
 	}
+
+	// distribute the energy in each node
+	flat_stems.parallel_sweep_down(
+	    split, [&](const int i, const int) { update_vigor(state, flat_stems, i); }, state.threads);
+	simulate_growth(state, flat_stems, split, id, cut_thresholds); // apply rules to the tree
+
+	flat_stems.build(stems); // with the nodes grown during the iteration
+	apply_gravity(state, flat_stems, flat_stems.split(GrowthConstants::kSubtreeGrain));
 }
 
 // Create dormant lateral buds along Ignored nodes
-void GrowthFunction::create_lateral_buds_rec(Node& node, int id, Vector3 pos, float& dist_to_next,
-                                             float& current_length, float total_length,
-                                             float& philo)
+void GrowthFunction::create_lateral_buds(RunState& state, Node& stem_node, int id,
+                                         float total_length) const
 {
-	auto& info = std::get<BioNodeInfo>(node.growthInfo);
-
-	// Only create buds on Ignored nodes (part of the original trunk structure)
-	if (info.type == BioNodeInfo::NodeType::Ignored && node.children.size() > 0)
+	float dist_to_next = lateral_start * total_length;
+	float current_length = 0;
+	float philo = 0;
+	// walk the main continuation (first child only for trunk)
+	for (Node* current = &stem_node; current != nullptr;
+	     current = current->children.empty() ? nullptr : &current->children[0]->node)
 	{
-		float absolute_start = lateral_start * total_length;
-		float absolute_end = lateral_end * total_length;
-		float bud_spacing = 1.0f / (lateral_density + GrowthConstants::kEpsilon);
+		Node& node = *current;
+		auto& info = state.growth_table[node];
 
-		// Process this node segment
-		if (current_length + node.length >= absolute_start && current_length < absolute_end)
+		// Only create buds on Ignored nodes (part of the original trunk structure)
+		if (info.type == BioNodeInfo::NodeType::Ignored && node.children.size() > 0)
 		{
-			float remaining = node.length;
-			float pos_in_node = 0;
+			float absolute_start = lateral_start * total_length;
+			float absolute_end = lateral_end * total_length;
+			float bud_spacing = 1.0f / (lateral_density + GrowthConstants::kEpsilon);
 
-			// Skip to start zone if needed
-			if (current_length < absolute_start)
+			// Process this node segment
+			if (current_length + node.length >= absolute_start && current_length < absolute_end)
 			{
-				float skip = absolute_start - current_length;
-				remaining -= skip;
-				pos_in_node = skip;
-				dist_to_next = 0;
+				float remaining = node.length;
+				float pos_in_node = 0;
+
+				// Skip to start zone if needed
+				if (current_length < absolute_start)
+				{
+					float skip = absolute_start - current_length;
+					remaining -= skip;
+					pos_in_node = skip;
+					dist_to_next = 0;
+				}
+
+				// Create buds along this node
+				while (remaining > dist_to_next && current_length + pos_in_node < absolute_end)
+				{
+					pos_in_node += dist_to_next;
+					remaining -= dist_to_next;
+
+					// Create dormant bud
+					philo += philotaxis_angle;
+					Vector3 tangent{std::cos(philo), std::sin(philo), 0};
+					tangent = Geometry::get_look_at_rot(node.direction) * tangent;
+					Vector3 bud_direction =
+					    Geometry::lerp(node.direction, tangent, lateral_angle / 90.0f);
+					bud_direction.normalize();
+
+					float position_in_parent = pos_in_node / node.length;
+					float child_radius = node.radius * GrowthConstants::kLateralRadiusRatio;
+					float child_length = branch_length * 0.5f;
+
+					NodeChild child{
+					    Node{bud_direction, node.tangent, child_length, child_radius, id},
+					    position_in_parent};
+					BioNodeInfo& child_info = state.growth_table.add(
+					    child.node, BioNodeInfo(BioNodeInfo::NodeType::Dormant, 0, philo));
+					child_info.rand_gen = info.rand_gen.derive(node.children.size());
+					node.children.push_back(std::make_shared<NodeChild>(std::move(child)));
+
+					dist_to_next = bud_spacing;
+				}
+
+				dist_to_next -= remaining;
 			}
-
-			// Create buds along this node
-			while (remaining > dist_to_next && current_length + pos_in_node < absolute_end)
+			else if (current_length + node.length < absolute_start)
 			{
-				pos_in_node += dist_to_next;
-				remaining -= dist_to_next;
-
-				// Create dormant bud
-				philo += philotaxis_angle;
-				Vector3 tangent{std::cos(philo), std::sin(philo), 0};
-				tangent = Geometry::get_look_at_rot(node.direction) * tangent;
-				Vector3 bud_direction =
-				    Geometry::lerp(node.direction, tangent, lateral_angle / 90.0f);
-				bud_direction.normalize();
-
-				float position_in_parent = pos_in_node / node.length;
-				float child_radius = node.radius * GrowthConstants::kLateralRadiusRatio;
-				float child_length = branch_length * 0.5f;
-
-				NodeChild child{Node{bud_direction, node.tangent, child_length, child_radius, id},
-				                position_in_parent};
-				child.node.growthInfo = BioNodeInfo(BioNodeInfo::NodeType::Dormant, 0, philo);
-				node.children.push_back(std::make_shared<NodeChild>(std::move(child)));
-
-				dist_to_next = bud_spacing;
+				// Before start zone, just track distance
+				dist_to_next = std::max(0.0f, absolute_start - (current_length + node.length));
 			}
-
-			dist_to_next -= remaining;
-		}
-		else if (current_length + node.length < absolute_start)
-		{
-			// Before start zone, just track distance
-			dist_to_next = std::max(0.0f, absolute_start - (current_length + node.length));
 		}
-	}
-
-	current_length += node.length;
-	Vector3 child_pos = pos + node.direction * node.length;
 
-	// Recurse into the main continuation (first child only for trunk)
-	if (node.children.size() > 0)
-	{
-		create_lateral_buds_rec(node.children[0]->node, id, child_pos, dist_to_next, current_length,
-		                        total_length, philo);
+		current_length += node.length;
 	}
 }
 
-void GrowthFunction::execute(std::vector<Stem>& stems, int id, int parent_id)
+void GrowthFunction::execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+                             int parent_id) const
 {
-	rand_gen.set_seed(seed);
-
-	for (Stem& stem : stems)
-	{
-		setup_growth_information_rec(stem.node, enable_lateral_branching);
-	}
-
-	// Create dormant lateral buds before growth iterations
-	if (enable_lateral_branching)
-	{
-		for (Stem& stem : stems)
-		{
-			float total_length = NodeUtilities::get_branch_length(stem.node);
-			float dist_to_next = lateral_start * total_length;
-			float current_length = 0;
-			float philo = 0;
-			create_lateral_buds_rec(stem.node, id, stem.position, dist_to_next, current_length,
-			                        total_length, philo);
-		}
-	}
+	int run_seed = get_seed(context);
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(run_seed);
+	rand_gen = rand_gen.derive(id);
 
 	// Determine effective iterations - use preview_iteration if valid, otherwise run all
 	size_t effective_iterations = (preview_iteration >= 0 && preview_iteration < iterations)
 	                                  ? static_cast<size_t>(preview_iteration)
 	                                  : static_cast<size_t>(iterations);
 
-	// Reset working threshold at start of execution to ensure reproducibility
-	// Same parameters will always produce same results
-	current_cut_threshold_ = cut_threshold;
+	GrowthSnapshotCache* snapshots =
+	    cache_iterations ? &GrowthSnapshotCache::get_global() : nullptr;
+	uint64_t run_key = 0;
+	if (snapshots != nullptr)
+	{
+		Fingerprint fingerprint{(uint64_t)run_seed};
+		fingerprint.add(id);
+		hash_growth_parameters(fingerprint);
+		NodeUtilities::add_to_fingerprint(stems, fingerprint);
+		run_key = fingerprint.get();
+		if (snapshots->restore(run_key, (int)effective_iterations, stems))
+		{
+			execute_children(stems, context, id);
+			return;
+		}
+	}
 
-	for (size_t i = 0; i < effective_iterations;
-	     i++) // an iteration can be seen as a year of growth
+	RunState state;
+	state.threads = context.get_threads(threads);
+	NodeArena flat_stem; // reused between iterations
+	size_t first_iteration = 0;
+	std::optional<GrowthResumeState> resume_state;
+	if (snapshots != nullptr)
+		resume_state = snapshots->take_resume_state(run_key, (int)effective_iterations);
+	if (resume_state)
+	{
+		// the input stems are the same, the state carries on from where the last run stopped
+		first_iteration = resume_state->iteration;
+		stems = std::move(resume_state->stems);
+		state.growth_table = std::move(resume_state->table);
+		state.shadow_grid = std::move(resume_state->shadow_grid);
+		state.cut_threshold = resume_state->cut_threshold;
+	}
+	else
 	{
-		for (Stem& stem : stems) // the energy is not shared between stems
+		for (size_t i = 0; i < stems.size(); i++)
 		{
-			float target_light_flux = 1 + std::pow((float)i, 1.5);
-			float light_flux = update_vigor_ratio_rec(stem.node); // get total available energy
+			setup_growth_information(stems[i].node, enable_lateral_branching,
+			                         rand_gen.derive(i), state.growth_table);
+		}
 
-			// Adapt working threshold based on light flux ratio
-			if (target_light_flux > light_flux)
-			{
-				current_cut_threshold_ -= GrowthConstants::kThresholdAdjustmentStep;
-			}
-			else if (target_light_flux < light_flux)
+		// Create dormant lateral buds before growth iterations
+		if (enable_lateral_branching)
+		{
+			for (Stem& stem : stems)
 			{
-				current_cut_threshold_ += GrowthConstants::kThresholdAdjustmentStep;
+				float total_length = NodeUtilities::get_branch_length(stem.node);
+				create_lateral_buds(state, stem.node, id, total_length);
 			}
+		}
 
-			update_vigor_rec(stem.node, target_light_flux); // distribute the energy in each node
-			simulate_growth_rec(stem.node, id);             // apply rules to the tree
-			update_absolute_position_rec(stem.node, stem.position);
-			get_weight_rec(stem.node);
-			Eigen::Matrix3f rot;
-			rot = rot.Identity();
-			apply_gravity_rec(stem.node, rot);
+		// Reset working threshold at start of execution to ensure reproducibility
+		// Same parameters will always produce same results
+		state.cut_threshold = cut_threshold;
+
+		setup_shadows(state, stems, flat_stem);
+		if (snapshots != nullptr)
+			snapshots->store(run_key, 0, stems);
+	}
+
+	for (size_t i = first_iteration; i < effective_iterations;
+	     i++) // an iteration can be seen as a year of growth
+	{
+		report_progress(context.control, "growth", (float)i / effective_iterations);
+		ProfileScope scope{"iteration"};
+		float target_light_flux = 1 + std::pow((float)i, 1.5);
+		if (enable_shadows)
+		{
+			// a stem is shaded by the nodes grown on the stems before it during the iteration
+			for (Stem& stem : stems)
+				grow_stems(state, {&stem, 1}, target_light_flux, id, flat_stem);
+		}
+		else
+		{
+			// the energy is not shared
+			grow_stems(state, stems, target_light_flux, id, flat_stem);
 		}
+		if (scope.is_active())
+			scope.add_counter("nodes", NodeUtilities::count_nodes(stems));
+		record_memory(stems, context,
+		              state.growth_table.get_memory_size() + state.shadow_grid.get_memory_size() +
+		                  flat_stem.get_memory_size());
+		if (snapshots != nullptr)
+			snapshots->store(run_key, (int)i + 1, stems);
 	}
 
-	execute_children(stems, id);
+	if (snapshots != nullptr)
+	{
+		snapshots->store_resume_state(
+		    run_key, GrowthResumeState{(int)effective_iterations, NodeUtilities::copy_stems(stems),
+		                               std::move(state.growth_table), std::move(state.shadow_grid),
+		                               state.cut_threshold});
+	}
+	state.growth_table.clear(); // freed before the children run
+
+	execute_children(stems, context, id);
+}
+
+bool GrowthFunction::hash_parameters(Fingerprint& fingerprint) const
+{
+	fingerprint.add(iterations);
+	fingerprint.add(preview_iteration);
+	hash_growth_parameters(fingerprint);
+	return true;
+}
+
+void GrowthFunction::hash_growth_parameters(Fingerprint& fingerprint) const
+{
+	fingerprint.add(apical_dominance);
+	fingerprint.add(grow_threshold);
+	fingerprint.add(split_angle);
+	fingerprint.add(branch_length);
+	fingerprint.add(gravitropism);
+	fingerprint.add(randomness);
+	fingerprint.add(cut_threshold);
+	fingerprint.add(split_threshold);
+	fingerprint.add(gravity_strength);
+	fingerprint.add(apical_control);
+	fingerprint.add(codominant_proba);
+	fingerprint.add(codominant_count);
+	fingerprint.add(branch_angle);
+	fingerprint.add(philotaxis_angle);
+	fingerprint.add(flower_threshold);
+	fingerprint.add(enable_flowering);
+	fingerprint.add(root_flux);
+	fingerprint.add(enable_lateral_branching);
+	fingerprint.add(lateral_start);
+	fingerprint.add(lateral_end);
+	fingerprint.add(lateral_density);
+	fingerprint.add(lateral_activation);
+	fingerprint.add(lateral_angle);
+	fingerprint.add(enable_shadows);
+	fingerprint.add(shadow_voxel_size);
+	fingerprint.add(shadow_strength);
+	fingerprint.add(shadow_decay);
+	fingerprint.add(shadow_depth);
+}
+
+std::shared_ptr<TreeFunction> GrowthFunction::clone_function() const
+{
+	return std::make_shared<GrowthFunction>(*this);
+}
+
+void GrowthFunction::reduce_own_resolution(const float factor)
+{
+	iterations = std::max(1, (int)std::ceil(iterations * factor));
+	if (preview_iteration >= 0)
+		preview_iteration = std::min(preview_iteration, iterations);
+	cache_iterations = false; // reduced runs would evict the snapshots of the full ones
 }
 } // namespace Mtree
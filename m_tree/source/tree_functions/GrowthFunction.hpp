@@ -1,5 +1,9 @@
 #pragma once
+#include "ShadowGrid.hpp"
+#include "source/tree/GrowthInfo.hpp"
+#include "source/tree/NodeArena.hpp"
 #include "source/tree_functions/base_types/TreeFunction.hpp"
+#include <span>
 #include <vector>
 
 namespace Mtree
@@ -24,20 +28,46 @@ constexpr float kThresholdAdjustmentStep = 0.1f; // Step size for cut threshold
 
 // Physical simulation
 constexpr float kGravityAngleMultiplier = 50.0f; // Converts torque to bend angle
+
+// Parallel passes
+constexpr int kSubtreeGrain = 256; // Subtrees of at most this many nodes are swept by a single task
 } // namespace GrowthConstants
 
 class GrowthFunction : public TreeFunction
 {
   private:
-	float update_vigor_ratio_rec(Node& node);
-	void update_vigor_rec(Node& node, float vigor);
-	void simulate_growth_rec(Node& node, int id);
-	void get_weight_rec(Node& node);
-	void apply_gravity_rec(Node& node, Eigen::Matrix3f curent_rotation);
-	void update_absolute_position_rec(Node& node, const Vector3& node_position);
+	// Child created during a growth pass, added to the growth table and the shadow grid once the
+	// pass is over
+	struct NewChild
+	{
+		int parent; // arena index of the node it grew from
+		Node* node;
+		BioNodeInfo info;
+	};
+
+	// State of one execution, kept out of the function so that executions don't modify it
+	struct RunState
+	{
+		float cut_threshold = 0;               // Working cut threshold, adapted every iteration
+		ShadowGrid shadow_grid;                // Shadows cast by the nodes grown so far
+		GrowthTable<BioNodeInfo> growth_table; // State of the nodes, freed once they are grown
+		int threads = 1;                       // Threads of the run, capped by its context
+	};
 
-	// Runtime state (reset at start of execute())
-	float current_cut_threshold_ = 0.0f; // Working cut threshold for current execution
+	void grow_stems(RunState& state, std::span<Stem> stems, float target_light_flux, int id,
+	                NodeArena& flat_stems) const;
+	float update_vigor_ratio(RunState& state, const NodeArena& arena, int index,
+	                         const std::vector<float>& fluxes) const;
+	void update_vigor(RunState& state, const NodeArena& arena, int index) const;
+	bool simulate_node_growth(RunState& state, Node& node, int index, int id, float cut_threshold,
+	                          std::vector<NewChild>& new_children) const;
+	void attach_child(RunState& state, Node& node, int index, NodeChild&& child,
+	                  BioNodeInfo& child_info, std::vector<NewChild>& new_children) const;
+	void simulate_growth(RunState& state, const NodeArena& arena, const NodeArena::Split& split,
+	                     int id, const std::vector<float>& cut_thresholds) const;
+	void apply_gravity(RunState& state, NodeArena& arena, const NodeArena::Split& split) const;
+	void setup_shadows(RunState& state, std::vector<Stem>& stems, NodeArena& flat_stem) const;
+	float get_exposure(const RunState& state, const Node& node) const;
 
   public:
 	int iterations = 5;
@@ -70,11 +100,34 @@ class GrowthFunction : public TreeFunction
 	float lateral_activation = 0.4f; // Vigor threshold to activate dormant buds
 	float lateral_angle = 45.0f;     // Initial angle from parent direction
 
-	void execute(std::vector<Stem>& stems, int id, int parent_id) override;
+	// Light model: when enabled, meristems and buds request energy in proportion to the light
+	// reaching them through the voxel shadow grid instead of all requesting the same amount
+	bool enable_shadows = false;
+	float shadow_voxel_size = 1; // Size of the shadow voxels
+	float shadow_strength = .3f; // Shadow cast by a node on the voxels right below it
+	float shadow_decay = 2;      // Shadow attenuation per voxel further down
+	int shadow_depth = 4;        // Number of voxel layers shaded by a node
+
+	int threads = 1; // threads growing the tree, 0 uses every hardware thread
+
+	// Keeps the stems after every iteration in GrowthSnapshotCache::get_global(), so that runs
+	// that only change preview_iteration or iterations restore a snapshot or carry on growing from
+	// the last run instead of starting over
+	bool cache_iterations = false;
+
+	void execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+	             int parent_id) const override;
+	const char* get_name() const override { return "GrowthFunction"; }
+
+  protected:
+	bool hash_parameters(Fingerprint& fingerprint) const override;
+	// Parameters every iteration depends on, the iteration counts excepted
+	void hash_growth_parameters(Fingerprint& fingerprint) const;
+	std::shared_ptr<TreeFunction> clone_function() const override;
+	void reduce_own_resolution(const float factor) override;
 
   private:
-	void create_lateral_buds_rec(Node& node, int id, Vector3 pos, float& dist_to_next,
-	                             float& current_length, float total_length, float& philo);
+	void create_lateral_buds(RunState& state, Node& stem_node, int id, float total_length) const;
 };
 
 } // namespace Mtree
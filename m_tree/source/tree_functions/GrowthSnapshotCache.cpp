@@ -0,0 +1,156 @@
+#include "GrowthSnapshotCache.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+
+namespace Mtree
+{
+namespace
+{
+// a node, the control block sharing it and the pointer its parent holds
+constexpr size_t kNodeMemory =
+    sizeof(NodeChild) + sizeof(std::shared_ptr<NodeChild>) + 2 * sizeof(void*);
+
+size_t estimate_memory(std::vector<Stem>& stems)
+{
+	return NodeUtilities::count_nodes(stems) * kNodeMemory;
+}
+} // namespace
+
+GrowthSnapshotCache& GrowthSnapshotCache::get_global()
+{
+	static GrowthSnapshotCache cache;
+	return cache;
+}
+
+bool GrowthSnapshotCache::restore(const uint64_t key, const int iteration,
+                                  std::vector<Stem>& stems)
+{
+	std::shared_ptr<const std::vector<Stem>> snapshot;
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		auto it = index.find(EntryKey{key, iteration});
+		if (it == index.end())
+		{
+			misses++;
+			return false;
+		}
+		hits++;
+		entries.splice(entries.begin(), entries, it->second);
+		snapshot = it->second->stems;
+	}
+	// copied without holding the lock, the snapshot itself is never modified
+	stems = NodeUtilities::copy_stems(*snapshot);
+	return true;
+}
+
+void GrowthSnapshotCache::store(const uint64_t key, const int iteration,
+                                const std::vector<Stem>& stems)
+{
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		if (memory_cap == 0 || index.contains(EntryKey{key, iteration}))
+			return;
+	}
+	auto snapshot = std::make_shared<std::vector<Stem>>(NodeUtilities::copy_stems(stems));
+	size_t memory = estimate_memory(*snapshot);
+
+	std::lock_guard<std::mutex> lock{mutex};
+	if (index.contains(EntryKey{key, iteration}))
+		return;
+	insert(Entry{key, iteration, memory, std::move(snapshot), nullptr});
+}
+
+std::optional<GrowthResumeState> GrowthSnapshotCache::take_resume_state(const uint64_t key,
+                                                                        const int iteration)
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	auto it = index.find(EntryKey{key, resume_iteration});
+	if (it == index.end() || it->second->resume_state->iteration > iteration)
+		return std::nullopt;
+	std::optional<GrowthResumeState> state{std::move(*it->second->resume_state)};
+	erase(it->second);
+	return state;
+}
+
+void GrowthSnapshotCache::store_resume_state(const uint64_t key, GrowthResumeState state)
+{
+	size_t memory = estimate_memory(state.stems) + state.table.get_memory_size() +
+	                state.shadow_grid.get_memory_size();
+	auto resume_state = std::make_unique<GrowthResumeState>(std::move(state));
+
+	std::lock_guard<std::mutex> lock{mutex};
+	auto it = index.find(EntryKey{key, resume_iteration});
+	if (it != index.end())
+		erase(it->second);
+	if (memory_cap > 0)
+		insert(Entry{key, resume_iteration, memory, nullptr, std::move(resume_state)});
+}
+
+void GrowthSnapshotCache::insert(Entry entry)
+{
+	memory_usage += entry.memory;
+	EntryKey entry_key{entry.key, entry.iteration};
+	entries.push_front(std::move(entry));
+	index[entry_key] = entries.begin();
+	evict();
+}
+
+void GrowthSnapshotCache::erase(std::list<Entry>::iterator entry)
+{
+	memory_usage -= entry->memory;
+	index.erase(EntryKey{entry->key, entry->iteration});
+	entries.erase(entry);
+}
+
+void GrowthSnapshotCache::evict()
+{
+	while (memory_usage > memory_cap)
+		erase(std::prev(entries.end()));
+}
+
+void GrowthSnapshotCache::clear()
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	entries.clear();
+	index.clear();
+	memory_usage = 0;
+	hits = 0;
+	misses = 0;
+}
+
+void GrowthSnapshotCache::set_memory_cap(const size_t cap)
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	memory_cap = cap;
+	evict();
+}
+
+size_t GrowthSnapshotCache::get_memory_cap() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return memory_cap;
+}
+
+size_t GrowthSnapshotCache::get_memory_usage() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return memory_usage;
+}
+
+int GrowthSnapshotCache::size() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return (int)entries.size();
+}
+
+int GrowthSnapshotCache::get_hit_count() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return hits;
+}
+
+int GrowthSnapshotCache::get_miss_count() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return misses;
+}
+} // namespace Mtree
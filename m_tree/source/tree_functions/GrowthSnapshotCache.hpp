@@ -0,0 +1,95 @@
+#pragma once
+#include "ShadowGrid.hpp"
+#include "source/tree/GrowthInfo.hpp"
+#include "source/tree/Node.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace Mtree
+{
+
+// Everything a GrowthFunction needs to carry on growing from the end of an iteration
+struct GrowthResumeState
+{
+	int iteration;
+	std::vector<Stem> stems;
+	GrowthTable<BioNodeInfo> table;
+	ShadowGrid shadow_grid;
+	float cut_threshold;
+};
+
+// Least recently used cache of the stems of growth runs after each iteration, keyed by a
+// fingerprint of the input stems and of every parameter but the iteration counts, so that
+// scrubbing GrowthFunction::preview_iteration or iterations restores a snapshot or carries on from
+// the last resume state instead of growing from scratch. Entries are evicted once their estimated
+// memory exceeds the cap, the earliest iterations (the cheapest to grow again) first when a run
+// is stored in order. Safe to use from several threads.
+class GrowthSnapshotCache
+{
+  public:
+	explicit GrowthSnapshotCache(size_t memory_cap = 256 << 20) : memory_cap(memory_cap) {};
+
+	// Process wide cache used by GrowthFunction::cache_iterations
+	static GrowthSnapshotCache& get_global();
+
+	// Replaces the stems with a deep copy of run key after `iteration` iterations, if cached
+	bool restore(const uint64_t key, const int iteration, std::vector<Stem>& stems);
+	// Keeps a deep copy of the stems of run key after `iteration` iterations
+	void store(const uint64_t key, const int iteration, const std::vector<Stem>& stems);
+	// Resume state of run key, removed from the cache, when it stopped after at most `iteration`
+	// iterations
+	std::optional<GrowthResumeState> take_resume_state(const uint64_t key, const int iteration);
+	// Replaces the resume state of run key
+	void store_resume_state(const uint64_t key, GrowthResumeState state);
+	void clear();
+
+	void set_memory_cap(const size_t cap);
+	size_t get_memory_cap() const;
+	// Estimated bytes held by the snapshots and resume states
+	size_t get_memory_usage() const;
+	int size() const;
+	int get_hit_count() const;
+	int get_miss_count() const;
+
+  private:
+	static constexpr int resume_iteration = -1; // iteration of the resume state entries
+
+	struct Entry
+	{
+		uint64_t key;
+		int iteration;
+		size_t memory;
+		std::shared_ptr<const std::vector<Stem>> stems;
+		std::unique_ptr<GrowthResumeState> resume_state;
+	};
+	struct EntryKey
+	{
+		uint64_t key;
+		int iteration;
+		bool operator==(const EntryKey&) const = default;
+	};
+	struct EntryKeyHash
+	{
+		size_t operator()(const EntryKey& key) const { return key.key ^ (size_t)key.iteration; }
+	};
+
+	mutable std::mutex mutex;
+	size_t memory_cap;
+	size_t memory_usage = 0;
+	int hits = 0;
+	int misses = 0;
+	std::list<Entry> entries; // most recently used first
+	std::unordered_map<EntryKey, std::list<Entry>::iterator, EntryKeyHash> index;
+
+	void insert(Entry entry);
+	void erase(std::list<Entry>::iterator entry);
+	void evict();
+};
+
+} // namespace Mtree
@@ -0,0 +1,95 @@
+#include "LeavesFunction.hpp"
+#include "source/utilities/GeometryUtilities.hpp"
+#include "source/utilities/Parallel.hpp"
+#include "source/utilities/Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace Mtree
+{
+int LeavesFunction::count_leaves(const Node& node, RandomGenerator& rand_gen) const
+{
+	if (node.radius > max_radius || density <= 0)
+		return 0;
+	// the fractional part of the expected count is drawn, so that short nodes still get leaves
+	float expected = node.length * density;
+	int count = (int)expected;
+	if (rand_gen.get_0_1() < expected - count)
+		count++;
+	return count;
+}
+
+std::vector<LeafInstance> LeavesFunction::execute(Tree& tree) const
+{
+	ProfilerBinding profiling{tree.get_active_profiler()};
+	ProfileScope scope{"LeavesFunction"};
+	NodeArena& arena = tree.get_arena();
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(seed);
+
+	// leaf counts first, so that every node writes its leaves at a known offset
+	std::vector<int> offsets(arena.size() + 1, 0);
+	Parallel::parallel_for(
+	    arena.size(),
+	    [&](const int i)
+	    {
+		    RandomGenerator node_rand_gen = rand_gen.derive(i);
+		    offsets[i + 1] = count_leaves(arena[i], node_rand_gen);
+	    },
+	    threads);
+	for (int i = 0; i < arena.size(); i++)
+		offsets[i + 1] += offsets[i];
+
+	std::vector<LeafInstance> leaves(offsets.back());
+	float angle = leaf_angle * std::numbers::pi_v<float> / 180;
+	float phyllotaxis = phyllotaxis_angle * std::numbers::pi_v<float> / 180;
+	int templates = std::max(template_count, 1);
+	Parallel::parallel_for(
+	    arena.size(),
+	    [&](const int i)
+	    {
+		    const Node& node = arena[i];
+		    RandomGenerator node_rand_gen = rand_gen.derive(i);
+		    int count = count_leaves(node, node_rand_gen);
+		    Vector3 radial = Geometry::projected_on_plane(node.tangent, node.direction);
+		    if (radial.squaredNorm() < 1e-8f)
+			    radial = Geometry::get_orthogonal_vector(node.direction);
+		    radial.normalize();
+		    float start_angle = node_rand_gen.get_0_1() * 2 * std::numbers::pi_v<float>;
+
+		    for (int leaf = 0; leaf < count; leaf++)
+		    {
+			    float position = (leaf + node_rand_gen.get_0_1()) / count;
+			    Vector3 side =
+			        Eigen::AngleAxisf(start_angle + leaf * phyllotaxis, node.direction) * radial;
+			    Vector3 blade = std::cos(angle) * node.direction + std::sin(angle) * side;
+			    blade.normalize();
+			    // leaf normal: away from the branch, bent towards the sky
+			    Vector3 outward = Geometry::projected_on_plane(side, blade);
+			    Vector3 normal = Geometry::projected_on_plane(
+			        Geometry::lerp(outward, Vector3{0, 0, 1}, up_alignment), blade);
+			    if (normal.squaredNorm() < 1e-8f)
+				    normal = Geometry::get_orthogonal_vector(blade);
+			    normal.normalize();
+
+			    Eigen::Matrix3f basis;
+			    basis.col(0) = blade.cross(normal);
+			    basis.col(1) = blade;
+			    basis.col(2) = normal;
+
+			    LeafInstance& instance = leaves[offsets[i] + leaf];
+			    instance.position = arena.position[i] + node.direction * node.length * position +
+			                        side * node.radius;
+			    instance.rotation = Eigen::Quaternionf{basis};
+			    instance.scale = size * (1 + size_randomness * node_rand_gen.get_minus_1_1());
+			    instance.template_id =
+			        std::min((int)(node_rand_gen.get_0_1() * templates), templates - 1);
+			    instance.node = i;
+		    }
+	    },
+	    threads);
+	scope.add_counter("leaves", (double)leaves.size());
+	return leaves;
+}
+} // namespace Mtree
@@ -0,0 +1,45 @@
+#pragma once
+#include "source/tree/Tree.hpp"
+#include <Eigen/Geometry>
+#include <cstdint>
+#include <vector>
+
+namespace Mtree
+{
+
+// Placement of one leaf, packed so that a tree's leaves can be uploaded as a single instance
+// buffer. The leaf template is expected with its blade along +Y and its normal along +Z.
+struct LeafInstance
+{
+	Vector3 position;
+	Eigen::Quaternion<float, Eigen::DontAlign> rotation; // stored as x, y, z, w
+	float scale;
+	int32_t template_id; // index of the leaf mesh to instance, in [0, template_count)
+	int32_t node;        // index in the tree arena of the node carrying the leaf
+};
+static_assert(sizeof(LeafInstance) == 40, "LeafInstance must stay a packed 40 bytes record");
+
+// Distributes leaves along the thin nodes of a grown tree and returns their placements instead of
+// merged geometry. Each node draws from its own random stream, so the result doesn't depend on
+// the number of threads.
+class LeavesFunction
+{
+  public:
+	float density = 10;      // leaves per unit length of carrying nodes
+	float max_radius = .02f; // only nodes thinner than this carry leaves
+	float size = .1f;        // scale of the leaf template
+	float size_randomness = .2f;
+	float leaf_angle = 45;            // angle between the branch and the leaf, in degrees
+	float phyllotaxis_angle = 137.5f; // rotation around the branch between leaves, in degrees
+	float up_alignment = .5f; // 0 keeps the leaf normal facing away from the branch, 1 faces up
+	int template_count = 1;
+	int seed = 42;
+	int threads = 1; // 0 uses every hardware thread
+
+	std::vector<LeafInstance> execute(Tree& tree) const;
+
+  private:
+	int count_leaves(const Node& node, RandomGenerator& rand_gen) const;
+};
+
+} // namespace Mtree
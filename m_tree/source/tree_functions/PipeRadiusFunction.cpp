@@ -2,31 +2,45 @@
 #include "source/utilities/GeometryUtilities.hpp"
 namespace Mtree
 {
-void PipeRadiusFunction::update_radius_rec(Node& node)
+void PipeRadiusFunction::update_radius(const NodeArena& arena) const
 {
-	if (node.children.size() == 0)
+	// children always come after their parent in the arena, so a reverse sweep sees every child
+	// radius before the parent radius is computed
+	for (int i = arena.size() - 1; i >= 0; i--)
 	{
-		node.radius = end_radius;
-		return;
-	}
+		Node& node = arena[i];
+		if (arena.is_leaf(i))
+		{
+			node.radius = end_radius;
+			continue;
+		}
 
-	float total_children_radius = 0;
-	for (auto& child : node.children)
-	{
-		update_radius_rec(child->node);
-		total_children_radius += pow(child->node.radius, power);
+		float total_children_radius = 0;
+		arena.for_each_child(
+		    i, [&](int child) { total_children_radius += pow(arena[child].radius, power); });
+		node.radius = pow(total_children_radius, 1 / power) + constant_growth * node.length / 100;
 	}
-	node.radius = pow(total_children_radius, 1 / power) + constant_growth * node.length / 100;
 }
-void PipeRadiusFunction::execute(std::vector<Stem>& stems, int id, int parent_id)
+void PipeRadiusFunction::execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+                                 int parent_id) const
 {
-	rand_gen.set_seed(seed);
+	NodeArena arena;
+	arena.build(stems);
+	update_radius(arena);
+	execute_children(stems, context, id);
+}
 
-	for (auto& stem : stems)
-	{
-		update_radius_rec(stem.node);
-	}
-	execute_children(stems, id);
+bool PipeRadiusFunction::hash_parameters(Fingerprint& fingerprint) const
+{
+	fingerprint.add(power);
+	fingerprint.add(end_radius);
+	fingerprint.add(constant_growth);
+	return true;
+}
+
+std::shared_ptr<TreeFunction> PipeRadiusFunction::clone_function() const
+{
+	return std::make_shared<PipeRadiusFunction>(*this);
 }
 
 } // namespace Mtree
@@ -4,6 +4,7 @@
 #include "./base_types/TreeFunction.hpp"
 // #include "source/utilities/NodeUtilities.hpp"
 // #include "source/utilities/GeometryUtilities.hpp"
+#include "source/tree/NodeArena.hpp"
 #include "source/tree_functions/base_types/Property.hpp"
 
 namespace Mtree
@@ -11,13 +12,19 @@ namespace Mtree
 class PipeRadiusFunction : public TreeFunction
 {
   private:
-	void update_radius_rec(Node& node);
+	void update_radius(const NodeArena& arena) const;
 
   public:
 	float power = 2.f;
 	float end_radius = .01f;
 	float constant_growth = .01f;
-	void execute(std::vector<Stem>& stems, int id, int parent_id) override;
+	void execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+	             int parent_id) const override;
+	const char* get_name() const override { return "PipeRadiusFunction"; }
+
+  protected:
+	bool hash_parameters(Fingerprint& fingerprint) const override;
+	std::shared_ptr<TreeFunction> clone_function() const override;
 };
 
 } // namespace Mtree
@@ -0,0 +1,48 @@
+#include "ShadowGrid.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Mtree
+{
+ShadowGrid::ShadowGrid(float voxel_size, float strength, float decay, int depth)
+    : voxel_size(std::max(voxel_size, 1e-4f)), depth(std::max(depth, 0))
+{
+	layer_shadow.resize(this->depth + 1);
+	for (int q = 1; q <= this->depth; q++)
+		layer_shadow[q] = strength * std::pow(std::max(decay, 1.f), -(float)(q - 1));
+}
+
+std::array<int, 3> ShadowGrid::to_voxel(const Vector3& position) const
+{
+	return {(int)std::floor(position.x() / voxel_size), (int)std::floor(position.y() / voxel_size),
+	        (int)std::floor(position.z() / voxel_size)};
+}
+
+uint64_t ShadowGrid::to_key(int x, int y, int z)
+{
+	// 21 bits per axis, offset so that negative coordinates pack as well
+	constexpr int offset = 1 << 20;
+	constexpr uint64_t mask = (1 << 21) - 1;
+	return ((uint64_t)(x + offset) & mask) | (((uint64_t)(y + offset) & mask) << 21) |
+	       (((uint64_t)(z + offset) & mask) << 42);
+}
+
+void ShadowGrid::add_shadow(const Vector3& position)
+{
+	auto [x, y, z] = to_voxel(position);
+	// the node's own voxel is left untouched, a bud doesn't shade itself
+	for (int q = 1; q <= depth; q++)
+		for (int dy = -q; dy <= q; dy++)
+			for (int dx = -q; dx <= q; dx++)
+				shadows[to_key(x + dx, y + dy, z - q)] += layer_shadow[q];
+}
+
+float ShadowGrid::get_exposure(const Vector3& position) const
+{
+	auto [x, y, z] = to_voxel(position);
+	auto it = shadows.find(to_key(x, y, z));
+	float shadow = it == shadows.end() ? 0 : it->second;
+	return std::max(0.f, 1 - shadow);
+}
+
+} // namespace Mtree
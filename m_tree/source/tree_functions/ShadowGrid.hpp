@@ -0,0 +1,42 @@
+#pragma once
+#include <Eigen/Core>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Mtree
+{
+using Vector3 = Eigen::Vector3f;
+
+// Sparse voxel grid of shadow values (shadow propagation light model). Every node casts a
+// pyramid of shadow over the voxels below it, fading with the depth, so that the light reaching
+// a bud is a single voxel lookup and inserting a node costs O(depth^3) whatever the tree size.
+class ShadowGrid
+{
+  public:
+	ShadowGrid(float voxel_size = 1, float strength = .3f, float decay = 2, int depth = 4);
+
+	void clear() { shadows.clear(); };
+	// casts the shadow of a node ending at position on the voxels below it
+	void add_shadow(const Vector3& position);
+	// light reaching position, from 1 in full light to 0 in full shade
+	float get_exposure(const Vector3& position) const;
+	int get_voxel_count() const { return (int)shadows.size(); };
+	// bytes of the voxels, a hash map node each
+	size_t get_memory_size() const
+	{
+		return shadows.size() * (sizeof(uint64_t) + sizeof(float) + 2 * sizeof(void*));
+	};
+
+  private:
+	float voxel_size;
+	int depth;
+	std::vector<float> layer_shadow; // shadow cast on the layer q voxels below the node
+	std::unordered_map<uint64_t, float> shadows;
+
+	std::array<int, 3> to_voxel(const Vector3& position) const;
+	static uint64_t to_key(int x, int y, int z);
+};
+
+} // namespace Mtree
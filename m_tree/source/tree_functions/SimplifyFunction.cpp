@@ -0,0 +1,145 @@
+#include "SimplifyFunction.hpp"
+#include "source/utilities/GeometryUtilities.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Mtree
+{
+
+namespace
+{
+// Next node of the branch when it is a straight continuation of node, null otherwise
+Node* get_continuation(Node& node)
+{
+	if (node.children.empty())
+		return nullptr;
+	NodeChild& child = *node.children[0];
+	if (child.position_in_parent != 1 || child.node.creator_id != node.creator_id)
+		return nullptr;
+	return &child.node;
+}
+} // namespace
+
+int SimplifyFunction::get_run_length(Node& start) const
+{
+	float min_cos = std::cos(angle_tolerance * (float)M_PI / 180);
+	std::vector<Node*> run{&start};
+	while (true)
+	{
+		// the end of a tip is not interpolated by the mesher, tips stay on their own
+		Node* next = get_continuation(*run.back());
+		if (next == nullptr || next->is_leaf())
+			break;
+		run.push_back(next);
+
+		Vector3 span = Vector3::Zero();
+		for (Node* node : run)
+			span += node->direction * node->length;
+		float total_length = span.norm();
+		if (total_length < 1e-6f)
+			break;
+		Vector3 direction = span / total_length;
+		float end_radius = next->children[0]->node.radius;
+
+		bool mergeable = true;
+		float distance = 0;
+		for (Node* node : run)
+		{
+			float expected_radius =
+			    Geometry::lerp(start.radius, end_radius, distance / total_length);
+			if (node->direction.dot(direction) < min_cos ||
+			    std::abs(node->radius - expected_radius) > radius_tolerance * node->radius)
+			{
+				mergeable = false;
+				break;
+			}
+			distance += node->length * node->direction.dot(direction);
+		}
+		if (!mergeable)
+		{
+			run.pop_back();
+			break;
+		}
+	}
+	return (int)run.size();
+}
+
+void SimplifyFunction::simplify(Node& root) const
+{
+	std::vector<Node*> stack{&root};
+	while (!stack.empty())
+	{
+		Node& node = *stack.back();
+		stack.pop_back();
+
+		int run_length = get_run_length(node);
+		if (run_length > 1)
+		{
+			std::vector<Node*> run{&node};
+			for (int i = 1; i < run_length; i++)
+				run.push_back(get_continuation(*run.back()));
+			Vector3 span = Vector3::Zero();
+			for (Node* merged : run)
+				span += merged->direction * merged->length;
+			float total_length = span.norm();
+			Vector3 direction = span / total_length;
+
+			// children of the last node first so that the continuation stays the first child,
+			// then the side branches of the run, at the same distance from the run start
+			std::vector<float> offsets;
+			float distance = 0;
+			for (Node* merged : run)
+			{
+				offsets.push_back(distance);
+				distance += merged->length * merged->direction.dot(direction);
+			}
+			std::vector<std::shared_ptr<NodeChild>> children;
+			auto reattach = [&](const int run_index, std::shared_ptr<NodeChild>& child)
+			{
+				Node& parent = *run[run_index];
+				// children at the end of the run stay exactly at the end
+				bool at_end = run_index == run_length - 1 && child->position_in_parent == 1;
+				float along = offsets[run_index] + child->position_in_parent * parent.length *
+				                                       parent.direction.dot(direction);
+				child->position_in_parent =
+				    at_end ? 1 : std::clamp(along / total_length, 0.f, 1.f);
+				children.push_back(std::move(child));
+			};
+			for (auto& child : run.back()->children)
+				reattach(run_length - 1, child);
+			for (int i = 0; i < run_length - 1; i++)
+				for (size_t c = 1; c < run[i]->children.size(); c++)
+					reattach(i, run[i]->children[c]);
+
+			node.direction = direction;
+			node.length = total_length;
+			node.tangent = Geometry::projected_on_plane(node.tangent, direction).normalized();
+			node.children = std::move(children); // releases the merged nodes
+		}
+
+		for (auto& child : node.children)
+			stack.push_back(&child->node);
+	}
+}
+
+void SimplifyFunction::execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+                               int) const
+{
+	for (Stem& stem : stems)
+		simplify(stem.node);
+	execute_children(stems, context, id);
+}
+
+bool SimplifyFunction::hash_parameters(Fingerprint& fingerprint) const
+{
+	fingerprint.add(angle_tolerance);
+	fingerprint.add(radius_tolerance);
+	return true;
+}
+
+std::shared_ptr<TreeFunction> SimplifyFunction::clone_function() const
+{
+	return std::make_shared<SimplifyFunction>(*this);
+}
+
+} // namespace Mtree
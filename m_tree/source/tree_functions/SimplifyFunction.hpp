@@ -0,0 +1,30 @@
+#pragma once
+#include "./base_types/TreeFunction.hpp"
+#include <vector>
+
+namespace Mtree
+{
+// Merges runs of consecutive continuation nodes (first children at the end of their parent) that
+// are nearly straight into single nodes, so that uniformly subdivided straight sections don't
+// cost one mesh ring per node. Side branches are reattached to the merged node at the same
+// distance along it, tips are never merged.
+class SimplifyFunction : public TreeFunction
+{
+  private:
+	void simplify(Node& root) const;
+	// Number of nodes of the run starting at start that can be merged, start included
+	int get_run_length(Node& start) const;
+
+  public:
+	float angle_tolerance = 2;    // max angle between a merged node and the run (degrees)
+	float radius_tolerance = .05; // max relative deviation from the interpolated radius
+	void execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+	             int parent_id) const override;
+	const char* get_name() const override { return "SimplifyFunction"; }
+
+  protected:
+	bool hash_parameters(Fingerprint& fingerprint) const override;
+	std::shared_ptr<TreeFunction> clone_function() const override;
+};
+
+} // namespace Mtree
@@ -2,9 +2,11 @@
 #include "source/utilities/GeometryUtilities.hpp"
 namespace Mtree
 {
-void TrunkFunction::execute(std::vector<Stem>& stems, int id, int parent_id)
+void TrunkFunction::execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+                            int parent_id) const
 {
-	rand_gen.set_seed(seed);
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(get_seed(context));
 
 	float segment_length = 1 / (resolution + .001);
 	Vector3 stem_direction = Vector3{0, 0, 1};
@@ -19,8 +21,8 @@ void TrunkFunction::execute(std::vector<Stem>& stems, int id, int parent_id)
 
 		float factor = std::pow((float)i / (node_count), shape);
 		float radius = Geometry::lerp(start_radius, end_radius, factor);
-		Vector3 direction =
-		    current_node->direction + Geometry::random_vec() * (randomness / (resolution + .001f));
+		Vector3 direction = current_node->direction +
+		                    Geometry::random_vec(rand_gen) * (randomness / (resolution + .001f));
 		direction += Vector3(0, 0, up_attraction / (resolution + .001f));
 		direction.normalize();
 		float position_in_parent = 1;
@@ -33,7 +35,29 @@ void TrunkFunction::execute(std::vector<Stem>& stems, int id, int parent_id)
 	Vector3 position{0, 0, 0};
 	Stem stem{std::move(firstNode), position};
 	stems.push_back(std::move(stem));
-	execute_children(stems, id);
+	execute_children(stems, context, id);
+}
+
+bool TrunkFunction::hash_parameters(Fingerprint& fingerprint) const
+{
+	fingerprint.add(length);
+	fingerprint.add(start_radius);
+	fingerprint.add(end_radius);
+	fingerprint.add(shape);
+	fingerprint.add(resolution);
+	fingerprint.add(randomness);
+	fingerprint.add(up_attraction);
+	return true;
+}
+
+std::shared_ptr<TreeFunction> TrunkFunction::clone_function() const
+{
+	return std::make_shared<TrunkFunction>(*this);
+}
+
+void TrunkFunction::reduce_own_resolution(const float factor)
+{
+	resolution = std::max(resolution * factor, .1f);
 }
 
 } // namespace Mtree
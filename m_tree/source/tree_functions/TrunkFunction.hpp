@@ -15,7 +15,14 @@ class TrunkFunction : public TreeFunction
 	float randomness = .1f;
 	float up_attraction = .6f;
 
-	void execute(std::vector<Stem>& stems, int id, int parent_id) override;
+	void execute(std::vector<Stem>& stems, ExecutionContext& context, int id,
+	             int parent_id) const override;
+	const char* get_name() const override { return "TrunkFunction"; }
+
+  protected:
+	bool hash_parameters(Fingerprint& fingerprint) const override;
+	std::shared_ptr<TreeFunction> clone_function() const override;
+	void reduce_own_resolution(const float factor) override;
 };
 
 } // namespace Mtree
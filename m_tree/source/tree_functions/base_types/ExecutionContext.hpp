@@ -0,0 +1,38 @@
+#pragma once
+#include "FunctionCache.hpp"
+#include "source/tree/CreatorIndex.hpp"
+#include "source/utilities/BuildControl.hpp"
+#include "source/utilities/MemoryFootprint.hpp"
+#include "source/utilities/Parallel.hpp"
+#include "source/utilities/ScratchArena.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace Mtree
+{
+
+// State of one execution of a function graph. The functions only read their own parameters and
+// keep the rest of their run state (random streams, growth tables) on the stack, so that a graph
+// is left unchanged by an execution and can build several trees at once, one context per tree.
+struct ExecutionContext
+{
+	const BuildControl* control = nullptr; // cancellation and progress of the running build
+	FunctionCache* cache = nullptr;        // snapshots of the stems of previous runs
+	CreatorIndex* creator_index = nullptr; // nodes of the stems by creator
+	ScratchArena* scratch = nullptr;       // temporaries of the tasks, on the heap when null
+	MemoryPeak* memory_peak = nullptr;     // high water mark of the execution, untracked when null
+	int seed_offset = 0;                   // added to the seed of every function
+	int max_threads = 0;                   // caps the threads of every function, 0 doesn't
+	// State key of the stems produced by the function being executed, set by execute_cached
+	uint64_t output_key = FunctionCache::no_key;
+
+	// Threads a function set to use `threads` runs with
+	int get_threads(const int threads) const
+	{
+		if (max_threads <= 0)
+			return threads;
+		return std::min(Parallel::resolve_thread_count(threads), max_threads);
+	}
+};
+
+} // namespace Mtree
@@ -0,0 +1,53 @@
+#include "FunctionCache.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+
+namespace Mtree
+{
+void FunctionCache::begin_run()
+{
+	for (auto& entry : entries)
+		entry.second.used = false;
+}
+
+void FunctionCache::end_run()
+{
+	std::erase_if(entries, [](const auto& entry) { return !entry.second.used; });
+}
+
+size_t FunctionCache::get_memory_size() const
+{
+	MemoryFootprint footprint;
+	for (const auto& [key, entry] : entries)
+		NodeUtilities::add_to_footprint(entry.stems, footprint);
+	return footprint.total();
+}
+
+void FunctionCache::store(const uint64_t key, const std::vector<Stem>& stems)
+{
+	if (key == no_key)
+		return;
+	auto [it, inserted] = entries.try_emplace(key);
+	if (inserted)
+		it->second.stems = NodeUtilities::copy_stems(stems);
+	it->second.used = true;
+}
+
+void FunctionCache::touch(const uint64_t key)
+{
+	auto it = entries.find(key);
+	if (it != entries.end())
+		it->second.used = true;
+}
+
+bool FunctionCache::restore(const uint64_t key, std::vector<Stem>& stems)
+{
+	if (key == no_key)
+		return false;
+	auto it = entries.find(key);
+	if (it == entries.end())
+		return false;
+	stems = NodeUtilities::copy_stems(it->second.stems);
+	it->second.used = true;
+	return true;
+}
+} // namespace Mtree
@@ -0,0 +1,42 @@
+#pragma once
+#include "source/tree/Node.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Mtree
+{
+
+// Snapshots of the stems produced while executing a function graph, keyed by the state key of the
+// stems (a hash of every function and parameter that produced them).
+// Only the snapshots used or created by the last run are kept.
+class FunctionCache
+{
+  private:
+	struct Entry
+	{
+		std::vector<Stem> stems;
+		bool used = false;
+	};
+	std::unordered_map<uint64_t, Entry> entries;
+
+  public:
+	static constexpr uint64_t no_key = 0; // state that can't be cached
+	static constexpr uint64_t root_key = 1;
+
+	void begin_run();
+	// Drops the snapshots that were not used since begin_run
+	void end_run();
+	void clear() { entries.clear(); }
+	int size() const { return (int)entries.size(); }
+	size_t get_memory_size() const; // bytes of the snapshots
+
+	// Stores a deep copy of the stems unless a snapshot of that state already exists
+	void store(const uint64_t key, const std::vector<Stem>& stems);
+	// Replaces the stems with a deep copy of the snapshot of that state, if there is one
+	bool restore(const uint64_t key, std::vector<Stem>& stems);
+	// Keeps the snapshot of that state, if there is one, without restoring it
+	void touch(const uint64_t key);
+};
+
+} // namespace Mtree
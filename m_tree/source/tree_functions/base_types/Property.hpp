@@ -1,46 +1,98 @@
 #pragma once
+#include "source/utilities/Fingerprint.hpp"
 #include "source/utilities/GeometryUtilities.hpp"
 #include "source/utilities/RandomGenerator.hpp"
+#include <algorithm>
+#include <cmath>
 #include <concepts>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
 namespace Mtree
 {
 
 template <typename T>
-concept PropertyFunction = requires(T& prop, float x) {
-	{ prop.execute(x) } -> std::convertible_to<float>;
+concept PropertyFunction = requires(const T& prop, float x, RandomGenerator& rand_gen) {
+	{ prop.execute(x, rand_gen) } -> std::convertible_to<float>;
 };
 
+// Value of a parameter along a branch. Evaluations draw their random values from the given
+// streams and leave the property unchanged, so that concurrent executions of a function can share
+// it.
 struct Property
 {
-	virtual float execute(float x) = 0;
+	virtual ~Property() = default;
+	virtual float execute(float x, RandomGenerator& rand_gen) const = 0;
+	// Batched evaluations: out[i] is the value at xs[i], its random values drawn from
+	// rand_gens[i] like execute(xs[i], rand_gens[i]) would
+	virtual void execute_batch(std::span<const float> xs, std::span<float> out,
+	                           std::span<RandomGenerator> rand_gens) const
+	{
+		for (size_t i = 0; i < xs.size(); i++)
+			out[i] = execute(xs[i], rand_gens[i]);
+	}
+	// Adds the type and parameters of the property to a fingerprint
+	virtual void hash(Fingerprint& fingerprint) const = 0;
+	virtual std::shared_ptr<Property> clone() const = 0;
 };
 
-struct ConstantProperty : Property
+// The built-in properties are final, so that calls through their own type are not virtual
+struct ConstantProperty final : Property
 {
 	float value;
 
 	ConstantProperty(float value = 1) : value(value) {};
 
-	float execute(float x) override { return value; }
+	float execute(float, RandomGenerator&) const override { return value; }
+	void execute_batch(std::span<const float> xs, std::span<float> out,
+	                   std::span<RandomGenerator>) const override
+	{
+		std::fill_n(out.begin(), xs.size(), value);
+	}
+	void hash(Fingerprint& fingerprint) const override
+	{
+		fingerprint.add(0);
+		fingerprint.add(value);
+	}
+	std::shared_ptr<Property> clone() const override
+	{
+		return std::make_shared<ConstantProperty>(*this);
+	}
 };
 
-struct RandomProperty : Property
+struct RandomProperty final : Property
 {
-	RandomGenerator rand_gen;
 	float min_value;
 	float max_value;
 
 	RandomProperty(float min = 0, float max = 1) : min_value(min), max_value(max) {};
 
-	float execute(float x) override
+	float execute(float, RandomGenerator& rand_gen) const override
 	{
 		return Geometry::lerp(min_value, max_value, rand_gen.get_0_1());
 	}
+	void execute_batch(std::span<const float> xs, std::span<float> out,
+	                   std::span<RandomGenerator> rand_gens) const override
+	{
+		for (size_t i = 0; i < xs.size(); i++)
+			out[i] = execute(xs[i], rand_gens[i]);
+	}
+	void hash(Fingerprint& fingerprint) const override
+	{
+		fingerprint.add(1);
+		fingerprint.add(min_value);
+		fingerprint.add(max_value);
+	}
+	std::shared_ptr<Property> clone() const override
+	{
+		return std::make_shared<RandomProperty>(*this);
+	}
 };
 
-struct SimpleCurveProperty : Property
+struct SimpleCurveProperty final : Property
 {
 	float x_min;
 	float x_max;
@@ -52,7 +104,13 @@ struct SimpleCurveProperty : Property
 	                    float power = 1)
 	    : x_min(x_min), x_max(x_max), y_min(y_min), y_max(y_max), power(power) {};
 
-	float execute(float x) override
+	float execute(float x, RandomGenerator&) const override { return evaluate(x); }
+	void execute_batch(std::span<const float> xs, std::span<float> out,
+	                   std::span<RandomGenerator>) const override
+	{
+		evaluate_batch(xs, out);
+	}
+	float evaluate(float x) const
 	{
 		float factor = std::clamp((x - x_min) / std::max(0.001f, (x_max - x_min)), 0.f, 1.f);
 		if (power > 0 && power != 1)
@@ -61,29 +119,94 @@ struct SimpleCurveProperty : Property
 		}
 		return Geometry::lerp(y_min, y_max, factor);
 	}
+	// The clamped factors are computed in a first loop the compiler can vectorize, the power
+	// (skipped at the ends of the curve, where it changes nothing) in a second one
+	void evaluate_batch(std::span<const float> xs, std::span<float> out) const
+	{
+		float range = std::max(0.001f, (x_max - x_min));
+		for (size_t i = 0; i < xs.size(); i++)
+			out[i] = std::clamp((xs[i] - x_min) / range, 0.f, 1.f);
+		if (power > 0 && power != 1)
+			for (size_t i = 0; i < xs.size(); i++)
+				if (out[i] > 0 && out[i] < 1)
+					out[i] = std::pow(out[i], power);
+		for (size_t i = 0; i < xs.size(); i++)
+			out[i] = Geometry::lerp(y_min, y_max, out[i]);
+	}
+	void hash(Fingerprint& fingerprint) const override
+	{
+		fingerprint.add(2);
+		fingerprint.add(x_min);
+		fingerprint.add(x_max);
+		fingerprint.add(y_min);
+		fingerprint.add(y_max);
+		fingerprint.add(power);
+	}
+	std::shared_ptr<Property> clone() const override
+	{
+		return std::make_shared<SimpleCurveProperty>(*this);
+	}
 };
 
+template <typename T>
+concept BuiltinProperty =
+    std::same_as<T, ConstantProperty> || std::same_as<T, RandomProperty> ||
+    std::same_as<T, SimpleCurveProperty>;
+
+// Holds one property. The built-in kinds are stored by value and dispatched through a variant, so
+// that their evaluation can be inlined in the growth loops; other properties go through the
+// Property interface. Copies of a wrapper are independent.
 struct PropertyWrapper
 {
-	std::shared_ptr<Property> property;
+	using Variant = std::variant<ConstantProperty, RandomProperty, SimpleCurveProperty,
+	                             std::shared_ptr<Property>>;
+	Variant property;
 
-	PropertyWrapper() { property = std::make_shared<ConstantProperty>(1); };
+	PropertyWrapper() : property(ConstantProperty{1}) {};
 
-	template <PropertyFunction T> PropertyWrapper(T& prop)
+	template <PropertyFunction T>
+	    requires(!std::same_as<std::remove_cvref_t<T>, PropertyWrapper>)
+	PropertyWrapper(T&& prop)
 	{
-		this->property = std::make_shared<T>(prop);
+		set_property(prop);
 	};
 
-	template <PropertyFunction T> PropertyWrapper(T&& prop)
+	template <PropertyFunction T> void set_property(const T& prop)
+	{
+		if constexpr (BuiltinProperty<T>)
+			property = prop;
+		else
+			property = std::make_shared<T>(prop);
+	}
+
+	// Wrapper around a copy of the property, sharing no state with this one
+	PropertyWrapper clone() const
 	{
-		this->property = std::make_shared<T>(prop);
+		PropertyWrapper copy = *this;
+		if (auto* shared = std::get_if<std::shared_ptr<Property>>(&copy.property))
+			*shared = (*shared)->clone();
+		return copy;
 	};
 
-	template <PropertyFunction T> void set_property(T& prop)
+	float execute(float x, RandomGenerator& rand_gen) const
 	{
-		this->property = std::make_shared<T>(prop);
+		return std::visit([&](const auto& prop) { return resolve(prop).execute(x, rand_gen); },
+		                  property);
+	};
+	// See Property::execute_batch
+	void execute_batch(std::span<const float> xs, std::span<float> out,
+	                   std::span<RandomGenerator> rand_gens) const
+	{
+		std::visit([&](const auto& prop) { resolve(prop).execute_batch(xs, out, rand_gens); },
+		           property);
 	}
+	void hash(Fingerprint& fingerprint) const
+	{
+		std::visit([&](const auto& prop) { resolve(prop).hash(fingerprint); }, property);
+	};
 
-	float execute(float x) { return property->execute(x); };
+  private:
+	template <typename T> static const T& resolve(const T& prop) { return prop; }
+	static const Property& resolve(const std::shared_ptr<Property>& prop) { return *prop; }
 };
 } // namespace Mtree
@@ -1,16 +1,143 @@
 #include "TreeFunction.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Profiler.hpp"
+#include <typeinfo>
 
 namespace Mtree
 {
-void TreeFunction::execute_children(std::vector<Stem>& stems, int id)
+void TreeFunction::record_memory(const std::vector<Stem>& stems, const ExecutionContext& context,
+                                 const size_t working_bytes) const
 {
+	if (context.memory_peak == nullptr)
+		return;
+	MemoryFootprint footprint;
+	NodeUtilities::add_to_footprint(stems, footprint);
+	size_t scratch_bytes = context.scratch != nullptr ? context.scratch->get_capacity() : 0;
+	context.memory_peak->record(footprint.total() + scratch_bytes + working_bytes);
+}
+
+void TreeFunction::execute_children(std::vector<Stem>& stems, ExecutionContext& context,
+                                    int id) const
+{
+	if (context.creator_index != nullptr && !updates_creator_index())
+		context.creator_index->invalidate();
+	if (context.cache != nullptr)
+		context.cache->store(context.output_key, stems);
+	record_memory(stems, context);
+
+	uint64_t key = context.output_key;
 	int child_id = id;
-	for (std::shared_ptr<TreeFunction>& child : children)
+	for (const std::shared_ptr<TreeFunction>& child : children)
 	{
+		check_cancelled(context.control);
 		child_id++;
-		child->execute(stems, child_id, id);
+		ProfileScope scope{child->get_name()};
+		if (context.cache == nullptr)
+			child->execute(stems, context, child_id, id);
+		else
+		{
+			child->execute_cached(stems, context, key, child_id, id);
+			key = child->get_subtree_key(context, key, child_id, id);
+			context.cache->store(key, stems);
+		}
+		if (scope.is_active())
+			scope.add_counter("nodes", NodeUtilities::count_nodes(stems));
 	}
 }
 void TreeFunction::add_child(std::shared_ptr<TreeFunction> child) { children.push_back(child); }
 
+void TreeFunction::clear_children() { children.clear(); }
+
+std::shared_ptr<TreeFunction> TreeFunction::clone() const
+{
+	std::shared_ptr<TreeFunction> copy = clone_function();
+	copy->children.clear();
+	for (const auto& child : children)
+		copy->children.push_back(child->clone());
+	return copy;
+}
+
+void TreeFunction::offset_seeds(const int offset)
+{
+	seed += offset;
+	for (auto& child : children)
+		child->offset_seeds(offset);
+}
+
+void TreeFunction::reduce_resolution(const float factor)
+{
+	reduce_own_resolution(factor);
+	for (auto& child : children)
+		child->reduce_resolution(factor);
+}
+
+uint64_t TreeFunction::get_output_key(const ExecutionContext& context, const uint64_t input_key,
+                                      const int id, const int parent_id) const
+{
+	if (input_key == FunctionCache::no_key)
+		return FunctionCache::no_key;
+	Fingerprint fingerprint{input_key};
+	fingerprint.add(typeid(*this).hash_code());
+	fingerprint.add(id);
+	fingerprint.add(parent_id);
+	fingerprint.add(get_seed(context));
+	if (!hash_parameters(fingerprint))
+		return FunctionCache::no_key;
+	uint64_t key = fingerprint.get();
+	return key == FunctionCache::no_key ? FunctionCache::root_key + 1 : key;
+}
+
+uint64_t TreeFunction::get_subtree_key(const ExecutionContext& context, const uint64_t input_key,
+                                       const int id, const int parent_id) const
+{
+	uint64_t key = get_output_key(context, input_key, id, parent_id);
+	int child_id = id;
+	for (auto& child : children)
+	{
+		child_id++;
+		key = child->get_subtree_key(context, key, child_id, id);
+	}
+	return key;
+}
+
+void TreeFunction::touch_subtree(const ExecutionContext& context, const uint64_t input_key,
+                                 const int id, const int parent_id) const
+{
+	uint64_t key = get_output_key(context, input_key, id, parent_id);
+	context.cache->touch(key);
+	int child_id = id;
+	for (auto& child : children)
+	{
+		child_id++;
+		child->touch_subtree(context, key, child_id, id);
+		key = child->get_subtree_key(context, key, child_id, id);
+		context.cache->touch(key);
+	}
+}
+
+void TreeFunction::execute_cached(std::vector<Stem>& stems, ExecutionContext& context,
+                                  const uint64_t input_key, int id, int parent_id) const
+{
+	context.output_key = get_output_key(context, input_key, id, parent_id);
+	FunctionCache* cache = context.cache;
+	if (cache != nullptr)
+	{
+		if (cache->restore(get_subtree_key(context, input_key, id, parent_id), stems))
+		{
+			if (context.creator_index != nullptr)
+				context.creator_index->invalidate();
+			touch_subtree(context, input_key, id, parent_id);
+			return;
+		}
+		if (cache->restore(context.output_key, stems))
+		{
+			if (context.creator_index != nullptr)
+				context.creator_index->invalidate();
+			execute_children(stems, context, id);
+			return;
+		}
+	}
+	execute(stems, context, id, parent_id);
+}
+
 } // namespace Mtree
@@ -1,30 +1,84 @@
 #pragma once
+#include "ExecutionContext.hpp"
+#include "FunctionCache.hpp"
 #include "source/tree/Node.hpp"
+#include "source/utilities/Fingerprint.hpp"
 #include "source/utilities/RandomGenerator.hpp"
 #include <concepts>
+#include <memory>
 #include <vector>
 
 namespace Mtree
 {
 
 template <typename T>
-concept TreeFunctionType = requires(T& func, std::vector<Stem>& stems, int id, int parent_id) {
-	{ func.execute(stems, id, parent_id) } -> std::same_as<void>;
+concept TreeFunctionType = requires(const T& func, std::vector<Stem>& stems,
+                                    ExecutionContext& context, int id, int parent_id) {
+	{ func.execute(stems, context, id, parent_id) } -> std::same_as<void>;
 };
 
 class TreeFunction
 {
   protected:
-	RandomGenerator rand_gen;
 	std::vector<std::shared_ptr<TreeFunction>> children;
-	void execute_children(std::vector<Stem>& stems, int id);
+	void execute_children(std::vector<Stem>& stems, ExecutionContext& context, int id) const;
+	// Seed of the function in the execution of context
+	int get_seed(const ExecutionContext& context) const { return seed + context.seed_offset; }
+	// Records the memory of the stems, of the scratch arena and working_bytes of state held by the
+	// function to the memory peak of context, if it has one
+	void record_memory(const std::vector<Stem>& stems, const ExecutionContext& context,
+	                   const size_t working_bytes = 0) const;
+
+	// Adds the parameters the output of the function depends on (seed excepted) to a fingerprint.
+	// Functions that don't override it are never cached.
+	virtual bool hash_parameters(Fingerprint&) const { return false; }
+	// Copy of this function without its children. State held through pointers (properties,
+	// parameter groups) is copied too, so that the copy can be edited without changing the
+	// original.
+	virtual std::shared_ptr<TreeFunction> clone_function() const = 0;
+	// Scales the parameters controlling the amount of work of this function, see reduce_resolution
+	virtual void reduce_own_resolution(const float) {}
+	// True when the function only adds nodes and registers them in the creator index. The
+	// index is invalidated after the other functions.
+	virtual bool updates_creator_index() const { return false; }
+
+  private:
+	// Keeps the snapshots of a subtree restored as a whole, so that later edits inside it can
+	// still start from them
+	void touch_subtree(const ExecutionContext& context, const uint64_t input_key, const int id,
+	                   const int parent_id) const;
 
   public:
 	virtual ~TreeFunction() = default;
 
 	int seed = 42;
 
-	virtual void execute(std::vector<Stem>& stems, int id = 0, int parent_id = 0) = 0;
+	// Runs the function then its children. Executions only modify stems and context, so that
+	// concurrent ones can share the function.
+	virtual void execute(std::vector<Stem>& stems, ExecutionContext& context, int id = 0,
+	                     int parent_id = 0) const = 0;
+	// Name of the function in profiles
+	virtual const char* get_name() const { return "TreeFunction"; }
 	void add_child(std::shared_ptr<TreeFunction> child);
+	// Removes the children, so that a function can be reused with another set of children
+	void clear_children();
+	// Independent copy of the function and of all its descendants
+	std::shared_ptr<TreeFunction> clone() const;
+	// Adds offset to the seed of this function and of all its descendants
+	void offset_seeds(const int offset);
+	// Scales the resolution (and growth iterations) of this function and of all its descendants
+	// by factor in (0, 1], for previews
+	void reduce_resolution(const float factor);
+
+	// State key of the stems once this function ran on stems of state input_key, and once all
+	// of its descendants ran as well
+	uint64_t get_output_key(const ExecutionContext& context, const uint64_t input_key,
+	                        const int id, const int parent_id) const;
+	uint64_t get_subtree_key(const ExecutionContext& context, const uint64_t input_key,
+	                         const int id, const int parent_id) const;
+	// Executes the function, or restores its output (or the output of its whole subtree) from
+	// the cache of context when the same state was already produced
+	void execute_cached(std::vector<Stem>& stems, ExecutionContext& context,
+	                    const uint64_t input_key, int id = 0, int parent_id = 0) const;
 };
 } // namespace Mtree
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace Mtree
+{
+
+// Thrown from a cancellation check when the build it belongs to was cancelled
+class BuildCancelled : public std::runtime_error
+{
+  public:
+	BuildCancelled() : std::runtime_error{"Tree build was cancelled"} {};
+};
+
+// Shared between a running build and the code driving it.
+// cancel may be called from any thread: long running loops call check, which throws
+// BuildCancelled once the build is cancelled, so that superseded builds stop early.
+// The progress callback is called from the building threads with a stage name and the fraction
+// of that stage already done, it must be thread safe.
+class BuildControl
+{
+  public:
+	using Clock = std::chrono::steady_clock;
+
+  private:
+	std::atomic<bool> cancelled{false};
+	Clock::time_point deadline = Clock::time_point::max();
+
+  public:
+	using ProgressCallback = std::function<void(const std::string& stage, float fraction)>;
+	ProgressCallback progress_callback;
+
+	void cancel() { cancelled = true; }
+	bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+	// Checks also throw once the deadline passed. Set before the build starts.
+	void set_deadline(const Clock::time_point time) { deadline = time; }
+	bool is_past_deadline() const
+	{
+		return deadline != Clock::time_point::max() && Clock::now() > deadline;
+	}
+	void check() const
+	{
+		if (is_cancelled() || is_past_deadline())
+			throw BuildCancelled{};
+	}
+	// Checks for cancellation and reports progress
+	void report_progress(const std::string& stage, const float fraction) const
+	{
+		check();
+		if (progress_callback)
+			progress_callback(stage, fraction);
+	}
+};
+
+// Helpers for code that runs with or without a control
+inline void check_cancelled(const BuildControl* control)
+{
+	if (control != nullptr)
+		control->check();
+}
+
+inline void report_progress(const BuildControl* control, const std::string& stage,
+                            const float fraction)
+{
+	if (control != nullptr)
+		control->report_progress(stage, fraction);
+}
+
+} // namespace Mtree
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace Mtree
+{
+
+// Incremental 64 bit FNV-1a hash of parameter values, used to key cached results.
+// Only identifies values within a process: it is not meant to be saved.
+class Fingerprint
+{
+  private:
+	uint64_t value = 14695981039346656037ull;
+
+  public:
+	Fingerprint() = default;
+	explicit Fingerprint(const uint64_t seed) { add(seed); };
+
+	void add_bytes(const void* data, const size_t size)
+	{
+		auto* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			value ^= bytes[i];
+			value *= 1099511628211ull;
+		}
+	}
+
+	template <typename T>
+	    requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+	void add(const T data)
+	{
+		add_bytes(&data, sizeof(T));
+	}
+
+	uint64_t get() const { return value; }
+};
+
+} // namespace Mtree
@@ -41,20 +41,19 @@ Eigen::Matrix3f get_look_at_rot(Vector3 direction)
 	return rot;
 }
 
-Vector3 random_vec_on_unit_sphere()
+Vector3 random_vec_on_unit_sphere(RandomGenerator& rand_gen)
 {
-	auto vec = Vector3{};
-	vec.setRandom();
+	auto vec = random_vec(rand_gen);
 	vec.normalize();
 	return vec;
 }
 
-Vector3 random_vec(float flatness)
+Vector3 random_vec(RandomGenerator& rand_gen, float flatness)
 {
-	auto vec = Vector3{};
-	vec.setRandom();
-	vec.z() *= (1 - flatness);
-	return vec;
+	float x = rand_gen.get_minus_1_1();
+	float y = rand_gen.get_minus_1_1();
+	float z = rand_gen.get_minus_1_1();
+	return Vector3{x, y, z * (1 - flatness)};
 }
 
 Vector3 lerp(Vector3 a, Vector3 b, float t) { return t * b + (1 - t) * a; }
@@ -1,4 +1,5 @@
 #pragma once
+#include "RandomGenerator.hpp"
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <cmath>
@@ -16,9 +17,11 @@ void add_circle(std::vector<Vector3>& points, Vector3 position, Vector3 directio
 
 Eigen::Matrix3f get_look_at_rot(Vector3 direction);
 
-Vector3 random_vec_on_unit_sphere();
+// Random vectors are drawn from the given generator rather than from the global rand() state, so
+// that independent trees can be grown concurrently and reproducibly
+Vector3 random_vec_on_unit_sphere(RandomGenerator& rand_gen);
 
-Vector3 random_vec(float flatness = 0);
+Vector3 random_vec(RandomGenerator& rand_gen, float flatness = 0);
 
 Vector3 get_orthogonal_vector(const Vector3& v);
 
@@ -0,0 +1,37 @@
+#include "MemoryFootprint.hpp"
+
+namespace Mtree
+{
+
+void MemoryFootprint::add(const std::string_view name, const size_t bytes)
+{
+	for (auto& [part_name, part_bytes] : parts)
+	{
+		if (part_name == name)
+		{
+			part_bytes += bytes;
+			return;
+		}
+	}
+	parts.emplace_back(name, bytes);
+}
+
+size_t MemoryFootprint::get(const std::string_view name) const
+{
+	for (const auto& [part_name, part_bytes] : parts)
+	{
+		if (part_name == name)
+			return part_bytes;
+	}
+	return 0;
+}
+
+size_t MemoryFootprint::total() const
+{
+	size_t bytes = 0;
+	for (const auto& part : parts)
+		bytes += part.second;
+	return bytes;
+}
+
+} // namespace Mtree
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Mtree
+{
+
+// Bytes held by an object, split into named parts. Containers count the elements they have room
+// for rather than the ones they hold, allocator bookkeeping is left out.
+struct MemoryFootprint
+{
+	std::vector<std::pair<std::string, size_t>> parts;
+
+	// Adds bytes to the part of that name, appended when missing
+	void add(const std::string_view name, const size_t bytes);
+	// Bytes of the part of that name, 0 when missing
+	size_t get(const std::string_view name) const;
+	size_t total() const;
+};
+
+template <typename T> size_t get_capacity_bytes(const std::vector<T>& values)
+{
+	return values.capacity() * sizeof(T);
+}
+
+// Largest amount of memory recorded since the last reset. Records may come from several threads.
+class MemoryPeak
+{
+  private:
+	std::atomic<size_t> peak = 0;
+
+  public:
+	MemoryPeak() = default;
+	MemoryPeak(const MemoryPeak& other) : peak(other.get()) {};
+	MemoryPeak& operator=(const MemoryPeak& other)
+	{
+		peak = other.get();
+		return *this;
+	}
+
+	void record(const size_t bytes)
+	{
+		size_t current = peak.load(std::memory_order_relaxed);
+		while (bytes > current && !peak.compare_exchange_weak(current, bytes))
+		{
+		}
+	}
+	void reset() { peak = 0; }
+	size_t get() const { return peak.load(std::memory_order_relaxed); }
+};
+
+} // namespace Mtree
@@ -1,4 +1,5 @@
 #include "NodeUtilities.hpp"
+#include "GeometryUtilities.hpp"
 #include <iostream>
 #include <queue>
 
@@ -19,41 +20,148 @@ float get_branch_length(Node& branch_origin)
 	return length;
 }
 
-void select_from_tree_rec(BranchSelection& selection, Node& node, const Vector3& node_position,
-                          int id)
+BranchSelection select_from_tree(std::vector<Stem>& stems, int id)
+{
+	struct Visit
+	{
+		Vector3 position;
+		bool continues_branch; // first child made by the creator of its parent
+	};
+
+	BranchSelection selection;
+	auto select_node = [&](Node& node, const Visit& visit, auto&& visit_child)
+	{
+		if (node.creator_id == id)
+		{
+			if (!visit.continues_branch)
+				selection.emplace_back();
+			selection.back().push_back(NodeSelectionElement{node, visit.position});
+		}
+		for (size_t i = 0; i < node.children.size(); i++)
+		{
+			NodeChild& child = *node.children[i];
+			Vector3 offset = child.node.direction * child.position_in_parent * child.node.length;
+			bool continues_branch = i == 0 && child.node.creator_id == node.creator_id;
+			visit_child(child.node, Visit{visit.position + offset, continues_branch});
+		}
+	};
+	for (Stem& stem : stems)
+		visit_pre_order(stem.node, Visit{stem.position, false}, select_node);
+	return selection;
+}
+
+Vector3 get_position_in_node(const Vector3& node_position, const Node& node, const float factor)
 {
-	if (node.creator_id == id)
+	return node_position + node.direction * node.length;
+};
+
+float get_branch_extent(const Node& node)
+{
+	std::vector<float> lengths{node.length};
+	const Node* current = &node;
+	while (!current->is_leaf())
 	{
-		selection[selection.size() - 1].push_back(NodeSelectionElement{node, node_position});
+		current = &current->children[0]->node;
+		lengths.push_back(current->length);
 	}
-	bool first_child = true;
-	for (auto& child : node.children)
+	float extent = lengths.back();
+	for (int i = (int)lengths.size() - 2; i >= 0; i--)
+		extent = lengths[i] + extent;
+	return extent;
+}
+
+Vector3 get_side_branch_pivot(const Node& parent, const NodeChild& child,
+                              const Vector3& node_position)
+{
+	Vector3 tangent =
+	    Geometry::projected_on_plane(child.node.direction, parent.direction).normalized();
+	return node_position + parent.direction * parent.length * child.position_in_parent +
+	       tangent * parent.radius;
+}
+
+std::vector<Stem> copy_stems(const std::vector<Stem>& stems)
+{
+	std::vector<Stem> copies = stems;
+	std::vector<Node*> to_copy;
+	for (auto& stem : copies)
+		to_copy.push_back(&stem.node);
+
+	// copied nodes still share their children with the original ones until they are visited
+	while (!to_copy.empty())
 	{
-		if (!first_child)
+		Node* node = to_copy.back();
+		to_copy.pop_back();
+		for (auto& child : node->children)
 		{
-			selection.emplace_back();
+			child = std::make_shared<NodeChild>(*child);
+			to_copy.push_back(&child->node);
 		}
-		first_child = false;
-		Vector3 child_position =
-		    node_position + child->node.direction * child->position_in_parent * child->node.length;
-		select_from_tree_rec(selection, child->node, child_position, id);
 	}
+	return copies;
 }
 
-BranchSelection select_from_tree(std::vector<Stem>& stems, int id)
+int count_nodes(std::vector<Stem>& stems)
 {
-	BranchSelection selection;
-	selection.emplace_back();
+	int count = 0;
 	for (Stem& stem : stems)
+		visit_pre_order(stem.node, [&](Node&) { count++; });
+	return count;
+}
+
+void add_to_fingerprint(const std::vector<Stem>& stems, Fingerprint& fingerprint)
+{
+	auto add_vector = [&](const Vector3& v)
 	{
-		select_from_tree_rec(selection, stem.node, stem.position, id);
+		for (int i = 0; i < 3; i++)
+			fingerprint.add(v[i]);
+	};
+	fingerprint.add(stems.size());
+	for (const Stem& stem : stems)
+	{
+		add_vector(stem.position);
+		std::vector<std::pair<const Node*, float>> stack{{&stem.node, 0.f}};
+		while (!stack.empty())
+		{
+			auto [node_pointer, position_in_parent] = stack.back();
+			stack.pop_back();
+			const Node& node = *node_pointer;
+			fingerprint.add(position_in_parent);
+			add_vector(node.direction);
+			add_vector(node.tangent);
+			fingerprint.add(node.length);
+			fingerprint.add(node.radius);
+			fingerprint.add(node.creator_id);
+			fingerprint.add(node.children.size()); // with pre-order, enough to tell the hierarchy
+			for (int i = (int)node.children.size() - 1; i >= 0; i--)
+				stack.emplace_back(&node.children[i]->node, node.children[i]->position_in_parent);
+		}
 	}
-	return selection;
 }
 
-Vector3 get_position_in_node(const Vector3& node_position, const Node& node, const float factor)
+void add_to_footprint(const std::vector<Stem>& stems, MemoryFootprint& footprint)
 {
-	return node_position + node.direction * node.length;
-};
+	// a child node lives in the block std::make_shared allocates with its two reference counts
+	constexpr size_t child_bytes = sizeof(NodeChild) + 2 * sizeof(int) + sizeof(void*);
+	size_t child_count = 0;
+	size_t children_bytes = 0;
+	std::vector<const Node*> stack;
+	for (const Stem& stem : stems)
+	{
+		stack.push_back(&stem.node);
+		while (!stack.empty())
+		{
+			const Node* node = stack.back();
+			stack.pop_back();
+			child_count += node->children.size();
+			children_bytes += get_capacity_bytes(node->children);
+			for (const auto& child : node->children)
+				stack.push_back(&child->node);
+		}
+	}
+	footprint.add("stems", get_capacity_bytes(stems));
+	footprint.add("nodes", child_count * child_bytes);
+	footprint.add("children", children_bytes);
+}
+
 } // namespace NodeUtilities
 } // namespace Mtree
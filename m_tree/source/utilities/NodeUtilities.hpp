@@ -1,5 +1,11 @@
 #pragma once
 #include "../tree/Node.hpp"
+#include "Fingerprint.hpp"
+#include "MemoryFootprint.hpp"
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace Mtree
 {
@@ -18,8 +24,113 @@ using NodeSelection = std::vector<NodeSelectionElement>;
 using BranchSelection = std::vector<NodeSelection>;
 
 float get_branch_length(Node& branch_origin);
+// Nodes made by the function id grouped by branch, a branch being a run of its nodes along first
+// children. Branches are in the order of a depth-first walk of the stems.
 BranchSelection select_from_tree(std::vector<Stem>& stems, int id);
 Vector3 get_position_in_node(const Vector3& node_position, const Node& node, const float factor);
+// Total length of a branch following the main continuation (first child). Lengths are summed from
+// the tip down so the result matches the former recursive sum.
+float get_branch_extent(const Node& node);
+// Point on the surface of parent where the side branch child starts, parent being at
+// node_position. Pivot of the side branch in Pivot Painter exports.
+Vector3 get_side_branch_pivot(const Node& parent, const NodeChild& child,
+                              const Vector3& node_position);
+// Deep copy of the stems: nodes are shared through pointers, so copying a Stem only copies its root
+std::vector<Stem> copy_stems(const std::vector<Stem>& stems);
+int count_nodes(std::vector<Stem>& stems);
+// Adds the geometry, the creators and the hierarchy of the nodes of the stems to a fingerprint
+void add_to_fingerprint(const std::vector<Stem>& stems, Fingerprint& fingerprint);
+// Adds the memory of the stems to a footprint: the stems vector ("stems"), the child nodes along
+// with the blocks sharing them ("nodes") and the children vectors of every node ("children")
+void add_to_footprint(const std::vector<Stem>& stems, MemoryFootprint& footprint);
+
+// Iterative depth-first traversals. Nodes are visited in the order of the equivalent recursive
+// walk (a node before or after all of its children, children in order) using an explicit stack,
+// so that long chains of segments cannot overflow the call stack.
+
+// Calls f(node) on every node of the subtree, parents before their children
+template <typename F> void visit_pre_order(Node& root, F&& f)
+{
+	std::vector<Node*> stack{&root};
+	while (!stack.empty())
+	{
+		Node* node = stack.back();
+		stack.pop_back();
+		f(*node);
+		for (int i = (int)node->children.size() - 1; i >= 0; i--)
+			stack.push_back(&node->children[i]->node);
+	}
+}
+
+// Calls f(node, value, visit_child) on every node of the subtree, parents before their children.
+// value is the one handed to the node by its parent (root_value for the root) and f calls
+// visit_child(child, child_value) for each child to visit, in order. Used to propagate positions
+// and rotations down the hierarchy.
+template <typename T, typename F> void visit_pre_order(Node& root, const T& root_value, F&& f)
+{
+	std::vector<std::pair<Node*, T>> stack;
+	stack.emplace_back(&root, root_value);
+	while (!stack.empty())
+	{
+		auto [node, value] = std::move(stack.back());
+		stack.pop_back();
+		size_t first_child = stack.size();
+		f(*node, value, [&](Node& child, T child_value)
+		  { stack.emplace_back(&child, std::move(child_value)); });
+		// children are popped in reverse order of their push
+		std::reverse(stack.begin() + first_child, stack.end());
+	}
+}
+
+// Computes f(node, child_results) on every node of the subtree, children before their parent.
+// child_results holds the values returned for the children of the node, in order. Returns the
+// value of the root. R cannot be bool (std::vector<bool> has no contiguous storage).
+template <typename R, typename F> R fold_post_order(Node& root, F&& f)
+{
+	struct Frame
+	{
+		Node* node;
+		size_t next_child;
+		size_t first_result;
+	};
+	std::vector<Frame> stack{{&root, 0, 0}};
+	std::vector<R> results;
+	while (true)
+	{
+		Frame& frame = stack.back();
+		if (frame.next_child < frame.node->children.size())
+		{
+			Node* child = &frame.node->children[frame.next_child++]->node;
+			stack.push_back({child, 0, results.size()});
+			continue;
+		}
+		R result = f(*frame.node, std::span<const R>{results.data() + frame.first_result,
+		                                             results.size() - frame.first_result});
+		results.resize(frame.first_result);
+		stack.pop_back();
+		if (stack.empty())
+			return result;
+		results.push_back(std::move(result));
+	}
+}
+
+// Calls f(node) on every node of the subtree, children before their parent
+template <typename F> void visit_post_order(Node& root, F&& f)
+{
+	std::vector<std::pair<Node*, size_t>> stack{{&root, 0}}; // node and next child to visit
+	while (!stack.empty())
+	{
+		auto& [node, next_child] = stack.back();
+		if (next_child < node->children.size())
+		{
+			Node* child = &node->children[next_child++]->node;
+			stack.emplace_back(child, 0);
+			continue;
+		}
+		f(*node);
+		stack.pop_back();
+	}
+}
 
 } // namespace NodeUtilities
 } // namespace Mtree
@@ -0,0 +1,88 @@
+#pragma once
+#include "Profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Mtree
+{
+namespace Parallel
+{
+
+inline int get_hardware_thread_count()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	return count == 0 ? 1 : (int)count;
+}
+
+// 0 or negative thread counts mean "use every hardware thread"
+inline int resolve_thread_count(const int threads)
+{
+	return threads > 0 ? threads : get_hardware_thread_count();
+}
+
+// Calls f(i) for every i in [0, count) on up to `threads` threads, the calling thread included.
+// Indices are handed out dynamically, so f must not depend on the order of the calls.
+// The first exception thrown by f is rethrown on the calling thread once every worker stopped.
+// Workers inherit the profiler binding of the calling thread.
+template <typename F> void parallel_for(const int count, F&& f, const int threads = 0)
+{
+	int thread_count = std::min(resolve_thread_count(threads), count);
+	if (thread_count <= 1)
+	{
+		for (int i = 0; i < count; i++)
+			f(i);
+		return;
+	}
+
+	std::atomic<int> next_index{0};
+	std::atomic<bool> failed{false};
+	std::exception_ptr error;
+	std::mutex error_mutex;
+
+	auto worker = [&]()
+	{
+		while (!failed.load(std::memory_order_relaxed))
+		{
+			int i = next_index.fetch_add(1, std::memory_order_relaxed);
+			if (i >= count)
+				return;
+			try
+			{
+				f(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock{error_mutex};
+				if (!error)
+					error = std::current_exception();
+				failed = true;
+			}
+		}
+	};
+
+	Profiler* profiler = Profiler::get_current();
+	// copied: the calling thread changes its path while the workers start
+	std::string profile_path = profiler != nullptr ? Profiler::get_current_path() : std::string{};
+	std::vector<std::thread> workers;
+	workers.reserve(thread_count - 1);
+	for (int i = 1; i < thread_count; i++)
+		workers.emplace_back(
+		    [&]()
+		    {
+			    ProfilerBinding binding{profiler, profile_path};
+			    worker();
+		    });
+	worker();
+	for (auto& thread : workers)
+		thread.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+} // namespace Parallel
+} // namespace Mtree
@@ -0,0 +1,203 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+// Escapes a string for a JSON string literal
+std::string escape_json(const std::string& text)
+{
+	std::string escaped;
+	escaped.reserve(text.size());
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		if ((unsigned char)c < 0x20)
+			continue;
+		escaped += c;
+	}
+	return escaped;
+}
+} // namespace
+
+namespace Mtree
+{
+
+Profiler::Profiler(const Profiler& other)
+{
+	std::lock_guard<std::mutex> lock{other.mutex};
+	epoch = other.epoch;
+	events = other.events;
+	threads = other.threads;
+}
+
+Profiler& Profiler::operator=(const Profiler& other)
+{
+	if (this == &other)
+		return *this;
+	std::scoped_lock lock{mutex, other.mutex};
+	epoch = other.epoch;
+	events = other.events;
+	threads = other.threads;
+	return *this;
+}
+
+void Profiler::clear()
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	events.clear();
+	threads.clear();
+	epoch = std::chrono::steady_clock::now();
+}
+
+void Profiler::record(Event event)
+{
+	std::thread::id id = std::this_thread::get_id();
+	std::lock_guard<std::mutex> lock{mutex};
+	auto thread = std::find(threads.begin(), threads.end(), id);
+	event.thread = (int)(thread - threads.begin());
+	if (thread == threads.end())
+		threads.push_back(id);
+	events.push_back(std::move(event));
+}
+
+std::vector<Profiler::Event> Profiler::get_events() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return events;
+}
+
+double Profiler::get_time_us() const
+{
+	auto elapsed = std::chrono::steady_clock::now() - epoch;
+	return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+std::vector<Profiler::ReportEntry> Profiler::get_report() const
+{
+	std::vector<Event> events = get_events();
+	// events are recorded when their scope ends, entering order is the order of the starts
+	std::stable_sort(events.begin(), events.end(),
+	                 [](const Event& a, const Event& b) { return a.start_us < b.start_us; });
+
+	std::vector<ReportEntry> report;
+	std::map<std::string, size_t> entry_index;
+	for (const Event& event : events)
+	{
+		auto [position, inserted] = entry_index.emplace(event.path, report.size());
+		if (inserted)
+		{
+			report.emplace_back();
+			report.back().path = event.path;
+		}
+		ReportEntry& entry = report[position->second];
+		entry.calls++;
+		entry.total_ms += event.duration_us / 1000;
+		entry.self_ms += event.self_us / 1000;
+		for (auto& [name, value] : event.counters)
+		{
+			auto counter = std::find_if(entry.counters.begin(), entry.counters.end(),
+			                            [&](auto& c) { return c.first == name; });
+			if (counter == entry.counters.end())
+				entry.counters.emplace_back(name, value);
+			else
+				counter->second += value;
+		}
+	}
+
+	return report;
+}
+
+std::string Profiler::to_chrome_trace() const
+{
+	std::vector<Event> events = get_events();
+	std::ostringstream json;
+	json.precision(15);
+	json << "{\"traceEvents\":[";
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const Event& event = events[i];
+		size_t separator = event.path.rfind('/');
+		std::string name = separator == std::string::npos ? event.path
+		                                                   : event.path.substr(separator + 1);
+		json << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << escape_json(name)
+		     << "\",\"cat\":\"m_tree\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+		     << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us
+		     << ",\"args\":{\"path\":\"" << escape_json(event.path) << "\"";
+		for (auto& [counter, value] : event.counters)
+			json << ",\"" << escape_json(counter) << "\":" << value;
+		json << "}}";
+	}
+	json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return json.str();
+}
+
+void Profiler::write_chrome_trace(const std::string& path) const
+{
+	std::ofstream file{path};
+	file << to_chrome_trace();
+	if (!file)
+		throw std::runtime_error("Cannot write profile trace to " + path);
+}
+
+ProfilerBinding::ProfilerBinding(Profiler* profiler, const std::string& path)
+    : bound(profiler != nullptr), previous(Profiler::current),
+      previous_scope(Profiler::current_scope)
+{
+	if (!bound)
+		return;
+	previous_path = Profiler::current_path;
+	Profiler::current = profiler;
+	Profiler::current_path = path;
+	Profiler::current_scope = nullptr;
+}
+
+ProfilerBinding::~ProfilerBinding()
+{
+	if (!bound)
+		return;
+	Profiler::current = previous;
+	Profiler::current_path = std::move(previous_path);
+	Profiler::current_scope = previous_scope;
+}
+
+void ProfileScope::begin(const std::string_view name)
+{
+	std::string& path = Profiler::current_path;
+	parent_path_size = path.size();
+	if (!path.empty())
+		path += '/';
+	path += name;
+	parent = Profiler::current_scope;
+	Profiler::current_scope = this;
+	start_us = profiler->get_time_us();
+}
+
+void ProfileScope::end()
+{
+	double duration_us = profiler->get_time_us() - start_us;
+	std::string& path = Profiler::current_path;
+	profiler->record(Profiler::Event{path, 0, start_us, duration_us,
+	                                 std::max(duration_us - children_us, 0.), std::move(counters)});
+	path.resize(parent_path_size);
+	Profiler::current_scope = parent;
+	if (parent != nullptr)
+		parent->children_us += duration_us;
+}
+
+void ProfileScope::accumulate(const std::string_view name, const double value)
+{
+	for (auto& [counter, total] : counters)
+		if (counter == name)
+		{
+			total += value;
+			return;
+		}
+	counters.emplace_back(std::string{name}, value);
+}
+
+} // namespace Mtree
@@ -0,0 +1,137 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Mtree
+{
+
+class ProfileScope;
+
+// Collects the timings of the profiling scopes run while it is bound to a thread (see
+// ProfilerBinding). Scopes nest: an event is identified by its path, the names of its enclosing
+// scopes and its own name separated by '/'. Threads spawned by Parallel::parallel_for inherit the
+// profiler and the path of the thread that spawned them.
+// When no profiler is bound, a scope costs a thread local load and records nothing.
+class Profiler
+{
+  public:
+	using Counters = std::vector<std::pair<std::string, double>>;
+
+	struct Event
+	{
+		std::string path;
+		int thread; // threads are numbered in the order of their first event
+		double start_us;
+		double duration_us;
+		double self_us; // duration without the child scopes run on the same thread
+		Counters counters;
+	};
+
+	// Events of the same path aggregated, counters are summed over the calls
+	struct ReportEntry
+	{
+		std::string path;
+		int calls = 0;
+		double total_ms = 0;
+		double self_ms = 0;
+		Counters counters;
+	};
+
+	Profiler() : epoch(std::chrono::steady_clock::now()) {};
+	Profiler(const Profiler& other);
+	Profiler& operator=(const Profiler& other);
+
+	void clear();
+	void record(Event event);
+	std::vector<Event> get_events() const;
+	// Entries in the order their paths were first entered
+	std::vector<ReportEntry> get_report() const;
+	// Events in the Chrome trace event format, to be opened in chrome://tracing or Perfetto
+	std::string to_chrome_trace() const;
+	// Throws when the file can't be written
+	void write_chrome_trace(const std::string& path) const;
+	// Microseconds since the profiler was created or cleared
+	double get_time_us() const;
+
+	// Profiler of the calling thread, null when none is bound
+	static Profiler* get_current() { return current; }
+	// Path of the innermost scope running on the calling thread
+	static const std::string& get_current_path() { return current_path; }
+
+  private:
+	mutable std::mutex mutex;
+	std::chrono::steady_clock::time_point epoch;
+	std::vector<Event> events;
+	std::vector<std::thread::id> threads;
+
+	static inline thread_local Profiler* current = nullptr;
+	static inline thread_local std::string current_path;
+	static inline thread_local ProfileScope* current_scope = nullptr;
+
+	friend class ProfilerBinding;
+	friend class ProfileScope;
+};
+
+// Binds a profiler to the calling thread for its lifetime, scopes nest under path. A null
+// profiler leaves the current binding untouched.
+class ProfilerBinding
+{
+  private:
+	bool bound;
+	Profiler* previous;
+	std::string previous_path;
+	ProfileScope* previous_scope;
+
+  public:
+	ProfilerBinding(Profiler* profiler, const std::string& path = {});
+	~ProfilerBinding();
+	ProfilerBinding(const ProfilerBinding&) = delete;
+	ProfilerBinding& operator=(const ProfilerBinding&) = delete;
+};
+
+// Times the enclosing block and records it, with its counters, to the profiler of the thread
+class ProfileScope
+{
+  private:
+	Profiler* profiler;
+	ProfileScope* parent = nullptr;
+	size_t parent_path_size = 0;
+	double start_us = 0;
+	double children_us = 0;
+	Profiler::Counters counters;
+
+  public:
+	ProfileScope(const std::string_view name) : profiler(Profiler::current)
+	{
+		if (profiler != nullptr)
+			begin(name);
+	}
+	~ProfileScope()
+	{
+		if (profiler != nullptr)
+			end();
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	// False when nothing is recorded, to skip computing counters
+	bool is_active() const { return profiler != nullptr; }
+	// Adds value to the counter of that name
+	void add_counter(const std::string_view name, const double value)
+	{
+		if (profiler != nullptr)
+			accumulate(name, value);
+	}
+
+  private:
+	void begin(const std::string_view name);
+	void end();
+	void accumulate(const std::string_view name, const double value);
+};
+
+} // namespace Mtree
@@ -1,20 +1,42 @@
 #pragma once
-#include <random>
+#include <cstdint>
+
 namespace Mtree
 {
+// Counter-based generator: the n-th draw is a pure function of (key, n), here the SplitMix64
+// output function. Its state is 16 bytes, and independent streams for branches or nodes are
+// derived from a key instead of being consumed in sequence, so results do not depend on the
+// order in which concurrent work draws its numbers.
 class RandomGenerator
 {
   private:
-	std::mt19937 engine;
-	std::uniform_real_distribution<float> uniform;
+	static constexpr uint64_t gamma = 0x9E3779B97F4A7C15ull;
+	uint64_t key = 0;
+	uint64_t counter = 0;
 
   public:
-	RandomGenerator() { uniform = std::uniform_real_distribution<float>{0.0f, 1.0f}; };
+	static constexpr uint64_t mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	};
+
+	RandomGenerator() = default;
+	explicit RandomGenerator(uint64_t key) : key(key) {};
 	void set_seed(int seed)
 	{
-		engine = std::mt19937{(unsigned int)seed};
-		srand(seed);
+		key = mix((uint32_t)seed + gamma);
+		counter = 0;
+	};
+	// Generator of the sub stream `index` (child rank, branch number, ...), independent of this
+	// stream and of the numbers already drawn from it
+	RandomGenerator derive(uint64_t index) const
+	{
+		return RandomGenerator{mix(key ^ mix(index + gamma))};
 	};
-	float get_0_1() { return uniform(engine); };
+	uint64_t next_u64() { return mix(key + ++counter * gamma); };
+	float get_0_1() { return (next_u64() >> 40) * 0x1.0p-24f; };
+	float get_minus_1_1() { return get_0_1() * 2 - 1; };
 };
 } // namespace Mtree
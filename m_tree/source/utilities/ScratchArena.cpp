@@ -0,0 +1,98 @@
+#include "ScratchArena.hpp"
+
+namespace Mtree
+{
+
+ScratchArena::Region::Region(const size_t size) : buffer(size)
+{
+	resource.emplace(buffer.data(), buffer.size(), std::pmr::new_delete_resource());
+}
+
+void ScratchArena::Region::rewind()
+{
+	if (used == 0)
+		return;
+	if (used > buffer.size())
+	{
+		resource.reset(); // frees the blocks taken from the upstream resource
+		buffer = std::vector<std::byte>(used);
+	}
+	resource.emplace(buffer.data(), buffer.size(), std::pmr::new_delete_resource());
+	used = 0;
+}
+
+void* ScratchArena::Region::do_allocate(size_t bytes, size_t alignment)
+{
+	used += bytes + alignment - 1; // room for the padding of the worst case
+	return resource->allocate(bytes, alignment);
+}
+
+void ScratchArena::Lease::rewind()
+{
+	if (region != nullptr)
+		region->rewind();
+}
+
+ScratchArena::Lease::~Lease()
+{
+	if (region == nullptr)
+		return;
+	region->rewind();
+	std::lock_guard<std::mutex> lock{arena->mutex};
+	arena->free_regions.push_back(region);
+}
+
+ScratchArena::Lease ScratchArena::lease(ScratchArena* arena)
+{
+	if (arena == nullptr)
+		return Lease{nullptr, nullptr, std::pmr::get_default_resource()};
+	Region* region = nullptr;
+	{
+		std::lock_guard<std::mutex> lock{arena->mutex};
+		if (!arena->free_regions.empty())
+		{
+			region = arena->free_regions.back();
+			arena->free_regions.pop_back();
+		}
+		else
+		{
+			arena->regions.push_back(std::make_unique<Region>(arena->region_size));
+			region = arena->regions.back().get();
+		}
+	}
+	return Lease{arena, region, region};
+}
+
+ScratchArena& ScratchArena::operator=(const ScratchArena& other)
+{
+	if (this != &other)
+	{
+		clear();
+		region_size = other.region_size;
+	}
+	return *this;
+}
+
+void ScratchArena::clear()
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	regions.clear();
+	free_regions.clear();
+}
+
+int ScratchArena::get_region_count() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return (int)regions.size();
+}
+
+size_t ScratchArena::get_capacity() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	size_t capacity = 0;
+	for (const auto& region : regions)
+		capacity += region->get_capacity();
+	return capacity;
+}
+
+} // namespace Mtree
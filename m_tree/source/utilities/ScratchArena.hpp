@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace Mtree
+{
+
+// Memory for the short lived containers of a build (work queues, per junction index lists...).
+// Each task leases a region for its duration: allocations are then pointer bumps that take no
+// lock, and everything is released at once when the lease ends. A region keeps its buffer, grown
+// to the largest amount a task used, so that once warmed up builds stop calling the allocator.
+// Leases may be taken concurrently, regions are never shared by two tasks.
+class ScratchArena
+{
+  private:
+	class Region : public std::pmr::memory_resource
+	{
+	  public:
+		explicit Region(const size_t size);
+		// Releases everything allocated from the region, growing the buffer to the amount used
+		void rewind();
+		size_t get_capacity() const { return buffer.size(); }
+
+	  private:
+		std::vector<std::byte> buffer;
+		std::optional<std::pmr::monotonic_buffer_resource> resource;
+		size_t used = 0;
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	size_t region_size;
+	mutable std::mutex mutex;
+	std::vector<std::unique_ptr<Region>> regions;
+	std::vector<Region*> free_regions;
+
+  public:
+	// Region of one task, returned to the arena on destruction
+	class Lease
+	{
+	  public:
+		~Lease();
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		std::pmr::memory_resource* get() const { return resource; }
+		// Releases what was allocated so far, for tasks going through several items
+		void rewind();
+
+	  private:
+		friend class ScratchArena;
+		ScratchArena* arena = nullptr;
+		Region* region = nullptr;
+		std::pmr::memory_resource* resource = nullptr;
+		Lease(ScratchArena* arena, Region* region, std::pmr::memory_resource* resource)
+		    : arena(arena), region(region), resource(resource) {};
+	};
+
+	explicit ScratchArena(const size_t region_size = 16 * 1024) : region_size(region_size) {};
+	// Copies start without regions, they only hold memory
+	ScratchArena(const ScratchArena& other) : region_size(other.region_size) {};
+	ScratchArena& operator=(const ScratchArena& other);
+
+	// Lease of a region of arena, or of the default resource when arena is null
+	static Lease lease(ScratchArena* arena);
+	// Frees the regions, which must all be returned
+	void clear();
+	int get_region_count() const;
+	size_t get_capacity() const; // bytes held by the regions
+};
+
+} // namespace Mtree
@@ -1,20 +1,50 @@
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <numbers>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 
 #include "source/mesh/Mesh.hpp"
+#include "source/mesh/MeshSink.hpp"
+#include "source/mesh/InterleavedMesh.hpp"
+#include "source/io/AssetFile.hpp"
 #include "source/tree/Tree.hpp"
+#include "source/tree/NodeArena.hpp"
+#include "source/tree/TreeBuild.hpp"
+#include "source/tree/ForestBuilder.hpp"
+#include "source/tree/ParameterSweep.hpp"
+#include "source/tree/SegmentIndex.hpp"
 #include "source/tree_functions/TrunkFunction.hpp"
 #include "source/tree_functions/BranchFunction.hpp"
 #include "source/tree_functions/GrowthFunction.hpp"
+#include "source/tree_functions/GrowthSnapshotCache.hpp"
+#include "source/tree_functions/LeavesFunction.hpp"
+#include "source/tree_functions/ShadowGrid.hpp"
+#include "source/tree_functions/SimplifyFunction.hpp"
 #include "source/meshers/splines_mesher/BasicMesher.hpp"
+#include "source/meshers/manifold_mesher/BranchInstancer.hpp"
 #include "source/meshers/manifold_mesher/ManifoldMesher.hpp"
+#include "source/meshers/manifold_mesher/PivotPainterBaker.hpp"
+#include "source/meshers/manifold_mesher/smoothing.hpp"
+#include "source/leaf/ConstrainedDelaunay.hpp"
+#include "source/leaf/ImpostorBaker.hpp"
 #include "source/leaf/LeafShapeGenerator.hpp"
 #include "source/leaf/LeafPresets.hpp"
+#include "source/leaf/LeafMeshCache.hpp"
 #include "source/leaf/VenationGenerator.hpp"
 #include "source/leaf/LeafLODGenerator.hpp"
+#include "source/utilities/NodeUtilities.hpp"
+#include "source/utilities/Parallel.hpp"
+#include "source/utilities/Profiler.hpp"
+#include "source/utilities/RandomGenerator.hpp"
+#include "source/utilities/ScratchArena.hpp"
 
 
 using namespace Mtree;
@@ -82,7 +112,7 @@ TEST(leaf_generate_returns_valid_mesh)
 	Mesh mesh = gen.generate();
 
 	ASSERT_GT(static_cast<int>(mesh.vertices.size()), 3);
-	ASSERT_GT(static_cast<int>(mesh.polygons.size()), 0);
+	ASSERT_GT(static_cast<int>(mesh.triangles.size()), 0);
 }
 
 TEST(leaf_superformula_contour_valid_closed_polygon)
@@ -94,12 +124,12 @@ TEST(leaf_superformula_contour_valid_closed_polygon)
 
 	// Contour should produce a closed polygon that triangulates to >0 faces
 	ASSERT_GT(static_cast<int>(mesh.vertices.size()), 3);
-	ASSERT_GT(static_cast<int>(mesh.polygons.size()), 1);
+	ASSERT_GT(static_cast<int>(mesh.triangles.size()), 1);
 
 	// All vertex indices in polygons should be valid
-	for (const auto& poly : mesh.polygons)
+	for (const auto& poly : mesh.triangles)
 	{
-		for (int j = 0; j < 4; ++j)
+		for (int j = 0; j < 3; ++j)
 		{
 			ASSERT_GE(poly[j], 0);
 			ASSERT_TRUE(poly[j] < static_cast<int>(mesh.vertices.size()));
@@ -143,7 +173,7 @@ TEST(leaf_margin_dentate_modifies_contour)
 	Mesh mesh = gen.generate();
 
 	ASSERT_GT(static_cast<int>(mesh.vertices.size()), 3);
-	ASSERT_GT(static_cast<int>(mesh.polygons.size()), 0);
+	ASSERT_GT(static_cast<int>(mesh.triangles.size()), 0);
 }
 
 TEST(leaf_margin_crenate_modifies_contour)
@@ -155,7 +185,7 @@ TEST(leaf_margin_crenate_modifies_contour)
 	Mesh mesh = gen.generate();
 
 	ASSERT_GT(static_cast<int>(mesh.vertices.size()), 3);
-	ASSERT_GT(static_cast<int>(mesh.polygons.size()), 0);
+	ASSERT_GT(static_cast<int>(mesh.triangles.size()), 0);
 }
 
 TEST(leaf_margin_lobed_modifies_contour)
@@ -167,7 +197,7 @@ TEST(leaf_margin_lobed_modifies_contour)
 	Mesh mesh = gen.generate();
 
 	ASSERT_GT(static_cast<int>(mesh.vertices.size()), 3);
-	ASSERT_GT(static_cast<int>(mesh.polygons.size()), 0);
+	ASSERT_GT(static_cast<int>(mesh.triangles.size()), 0);
 }
 
 TEST(leaf_valid_triangulation)
@@ -176,18 +206,107 @@ TEST(leaf_valid_triangulation)
 	gen.contour_resolution = 32;
 	Mesh mesh = gen.generate();
 
-	// All polygons should be triangles stored as degenerate quads
-	for (const auto& poly : mesh.polygons)
+	// All faces should be triangles, without padding them to quads
+	ASSERT_EQ(static_cast<int>(mesh.polygons.size()), 0);
+	ASSERT_EQ(mesh.uv_triangles.size(), mesh.triangles.size());
+	for (const auto& poly : mesh.triangles)
 	{
-		// 4th index equals 3rd (degenerate quad = triangle)
-		ASSERT_EQ(poly[2], poly[3]);
-		// All 3 unique indices must be different
+		// All 3 indices must be different
 		ASSERT_TRUE(poly[0] != poly[1]);
 		ASSERT_TRUE(poly[1] != poly[2]);
 		ASSERT_TRUE(poly[0] != poly[2]);
 	}
 }
 
+// Smallest angle of the mesh triangles in degrees, and their total area
+static std::pair<float, float> triangle_quality(const Mesh& mesh)
+{
+	float smallest = 180.0f;
+	float area = 0.0f;
+	for (const auto& poly : mesh.triangles)
+	{
+		Vector2 p[3];
+		for (int k = 0; k < 3; k++)
+			p[k] = mesh.vertices[poly[k]].head<2>();
+		Vector2 e1 = p[1] - p[0], e2 = p[2] - p[0];
+		area += (e1.x() * e2.y() - e1.y() * e2.x()) / 2;
+		for (int k = 0; k < 3; k++)
+		{
+			Vector2 u = (p[(k + 1) % 3] - p[k]).normalized();
+			Vector2 v = (p[(k + 2) % 3] - p[k]).normalized();
+			float angle = std::acos(std::clamp(u.dot(v), -1.0f, 1.0f)) * 180.0f / 3.14159265f;
+			smallest = std::min(smallest, angle);
+		}
+	}
+	return {smallest, area};
+}
+
+TEST(constrained_delaunay_triangulates_concave_polygon)
+{
+	// comb with three teeth, clockwise, with a duplicate and a collinear point
+	std::vector<Vector2> polygon{{0, 0}, {0, 2}, {1, 2}, {1, 1}, {2, 1}, {2, 2}, {3, 2},
+	                             {3, 1}, {4, 1}, {4, 2}, {5, 2}, {5, 0}, {5, 0}, {2.5f, 0}};
+	ConstrainedDelaunay delaunay;
+	delaunay.target_triangles = 60;
+	ASSERT_TRUE(delaunay.triangulate(polygon, {{0.5f, 1.5f}, {1.5f, 1.5f}}));
+	ASSERT_EQ(delaunay.get_boundary_count(), 12);
+
+	Mesh mesh;
+	for (const auto& p : delaunay.get_vertices())
+		mesh.vertices.push_back(Vector3(p.x(), p.y(), 0));
+	for (const auto& triangle : delaunay.get_triangles())
+	{
+		mesh.triangles.push_back(triangle);
+		Vector2 e1 = delaunay.get_vertices()[triangle[1]] - delaunay.get_vertices()[triangle[0]];
+		Vector2 e2 = delaunay.get_vertices()[triangle[2]] - delaunay.get_vertices()[triangle[0]];
+		ASSERT_GT(e1.x() * e2.y() - e1.y() * e2.x(), 0.0f);
+	}
+	ASSERT_GT(static_cast<int>(mesh.triangles.size()), 10);
+	ASSERT_LE(static_cast<int>(mesh.triangles.size()), 61);
+	// the Steiner point outside of the polygon is skipped, the triangles cover it exactly
+	for (const auto& p : delaunay.get_vertices())
+		ASSERT_TRUE(p != Vector2(1.5f, 1.5f));
+	auto [smallest, area] = triangle_quality(mesh);
+	ASSERT_TRUE(std::abs(area - 8.0f) < 1e-4f);
+	ASSERT_GT(smallest, 10.0f);
+
+	ASSERT_TRUE(!delaunay.triangulate({{0, 0}, {1, 1}, {2, 2}}));
+}
+
+TEST(leaf_delaunay_triangulation_beats_rings)
+{
+	LeafShapeGenerator gen;
+	gen.margin_type = MarginType::Lobed;
+	gen.tooth_count = 5;
+	gen.tooth_depth = 0.4f;
+	gen.aspect_ratio = 0.7f;
+	Mesh rings = gen.generate();
+
+	gen.triangulation = LeafTriangulation::Delaunay;
+	Mesh delaunay = gen.generate();
+	ASSERT_TRUE(gen.get_fingerprint() != LeafShapeGenerator().get_fingerprint());
+	ASSERT_EQ(delaunay.uvs.size(), delaunay.vertices.size());
+	ASSERT_GT(static_cast<int>(rings.vertices.size()) / 2,
+	          static_cast<int>(delaunay.vertices.size()));
+
+	auto [rings_angle, rings_area] = triangle_quality(rings);
+	auto [delaunay_angle, delaunay_area] = triangle_quality(delaunay);
+	ASSERT_GT(delaunay_angle, rings_angle);
+	ASSERT_TRUE(std::abs(delaunay_area - rings_area) < 1e-3f * rings_area);
+
+	gen.target_triangles = 100;
+	ASSERT_LE(static_cast<int>(gen.generate().triangles.size()), 101);
+
+	// inner vertices follow the veins
+	gen.target_triangles = 0;
+	gen.enable_venation = true;
+	Mesh veined = gen.generate();
+	gen.vein_steiner_points = false;
+	ASSERT_TRUE(veined.vertices != gen.generate().vertices);
+	ASSERT_GT(triangle_quality(veined).first, rings_angle);
+	ASSERT_TRUE(veined.attributes.contains("vein_distance"));
+}
+
 TEST(leaf_uv_coordinates_in_range)
 {
 	LeafShapeGenerator gen;
@@ -237,6 +356,80 @@ TEST(leaf_surface_deformation_modifies_z)
 	ASSERT_TRUE(has_nonzero_z);
 }
 
+TEST(leaf_edge_curl_follows_contour_distance)
+{
+	LeafShapeGenerator gen;
+	gen.margin_type = MarginType::Serrate;
+	gen.tooth_count = 24;
+	gen.contour_resolution = 256;
+	gen.edge_curl = 0.5f;
+	Mesh mesh = gen.generate();
+
+	// contour vertices get the full curl, the middle of the blade none
+	float max_z = 0.0f;
+	float min_z = 1.0f;
+	for (const auto& v : mesh.vertices)
+	{
+		ASSERT_GE(v.z(), 0.0f);
+		ASSERT_LE(v.z(), 0.5f * 0.2f + 1e-6f);
+		max_z = std::max(max_z, v.z());
+		min_z = std::min(min_z, v.z());
+	}
+	ASSERT_TRUE(std::abs(max_z - 0.5f * 0.2f) < 1e-6f);
+	ASSERT_EQ(min_z, 0.0f);
+
+	gen.threads = 4;
+	ASSERT_TRUE(gen.generate().vertices == mesh.vertices);
+}
+
+TEST(leaf_edge_distances_match_full_scan)
+{
+	// a serrated contour with jittered points and degenerate segments, fixed seed
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(7);
+	std::vector<Vector2> contour;
+	for (int i = 0; i < 96; i++)
+	{
+		float angle = i * 2.0f * std::numbers::pi_v<float> / 96;
+		float radius = 0.5f + (i % 2 == 0 ? 0.05f : 0.0f) + 0.02f * rand_gen.get_minus_1_1();
+		contour.push_back(radius * Vector2(std::cos(angle), 0.6f * std::sin(angle)));
+		if (i % 17 == 0)
+			contour.push_back(contour.back());
+	}
+
+	// vertices inside, on and far outside the leaf
+	std::vector<Vector3> vertices;
+	for (int y = -12; y <= 12; y++)
+		for (int x = -12; x <= 12; x++)
+			vertices.push_back(Vector3(x * 0.05f, y * 0.03f, 0.0f));
+	for (size_t i = 0; i < contour.size(); i += 5)
+		vertices.push_back(Vector3(contour[i].x(), contour[i].y(), 0.0f));
+	vertices.push_back(Vector3(5.0f, -3.0f, 0.0f));
+
+	LeafShapeGenerator gen;
+	gen.threads = 4;
+	auto bb = gen.compute_contour_bbox(contour);
+	float max_distance = bb.width * 0.15f;
+	std::vector<float> distances =
+	    gen.compute_edge_distances(vertices, contour, bb, max_distance);
+	ASSERT_EQ(distances.size(), vertices.size());
+	for (size_t vi = 0; vi < vertices.size(); vi++)
+	{
+		Vector2 p(vertices[vi].x(), vertices[vi].y());
+		float min_dist = std::numeric_limits<float>::max();
+		for (size_t ci = 0; ci < contour.size(); ci++)
+		{
+			Vector2 a = contour[ci];
+			Vector2 ab = contour[(ci + 1) % contour.size()] - a;
+			float t = ab.squaredNorm() < 1e-20f
+			              ? 0.0f
+			              : std::clamp((p - a).dot(ab) / ab.squaredNorm(), 0.0f, 1.0f);
+			min_dist = std::min(min_dist, (p - (a + t * ab)).norm());
+		}
+		ASSERT_TRUE(std::abs(distances[vi] - std::min(min_dist, max_distance)) < 1e-6f);
+	}
+}
+
 TEST(leaf_degenerate_parameter_clamping)
 {
 	// n1=0 should be clamped, not crash
@@ -244,7 +437,7 @@ TEST(leaf_degenerate_parameter_clamping)
 	gen.n1 = 0.0f;
 	Mesh mesh = gen.generate();
 	ASSERT_GT(static_cast<int>(mesh.vertices.size()), 3);
-	ASSERT_GT(static_cast<int>(mesh.polygons.size()), 0);
+	ASSERT_GT(static_cast<int>(mesh.triangles.size()), 0);
 }
 
 TEST(leaf_min_contour_resolution)
@@ -302,7 +495,7 @@ TEST(leaf_preset_apply_generates_valid_mesh)
 
 		Mesh mesh = gen.generate();
 		ASSERT_GT(static_cast<int>(mesh.vertices.size()), 3);
-		ASSERT_GT(static_cast<int>(mesh.polygons.size()), 0);
+		ASSERT_GT(static_cast<int>(mesh.triangles.size()), 0);
 	}
 }
 
@@ -440,6 +633,44 @@ TEST(venation_spatial_hash_empty_query)
 	ASSERT_EQ(static_cast<int>(neighbors.size()), 0);
 }
 
+TEST(venation_spatial_hash_nearest_matches_scan)
+{
+	SpatialHash2D hash(0.25f, Vector2(-1.0f, -1.0f), Vector2(1.0f, 1.0f));
+	std::vector<Vector2> points;
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(3);
+	for (int i = 0; i < 200; i++)
+	{
+		points.push_back(Vector2(rand_gen.get_minus_1_1(), rand_gen.get_minus_1_1()));
+		hash.insert(i, points.back());
+	}
+	points.push_back(points[10]); // a tie resolves to the first inserted point
+	hash.insert(200, points.back());
+
+	std::vector<int> buffer{-1, -1};
+	for (int q = 0; q < 50; q++)
+	{
+		Vector2 center(rand_gen.get_minus_1_1(), rand_gen.get_minus_1_1());
+		float radius = 0.3f * rand_gen.get_0_1();
+		int expected = -1;
+		float best = radius * radius;
+		for (int i = 0; i < (int)points.size(); i++)
+		{
+			float d = (points[i] - center).squaredNorm();
+			if (d < best || (expected < 0 && d <= best))
+			{
+				best = d;
+				expected = i;
+			}
+		}
+		ASSERT_EQ(hash.query_nearest(center, radius), expected);
+
+		hash.query_radius(center, radius, buffer);
+		ASSERT_TRUE(buffer == hash.query_radius(center, radius));
+	}
+	ASSERT_EQ(hash.query_nearest(points[10], 0.0f), 10);
+}
+
 TEST(venation_runions_connected_tree)
 {
 	// Create a simple diamond contour
@@ -628,6 +859,54 @@ TEST(venation_vein_distance_all_vertices)
 	ASSERT_TRUE(has_close);
 }
 
+TEST(venation_vein_distance_matches_full_scan)
+{
+	std::vector<Vector2> contour = {
+	    Vector2(0.0f, -0.5f), Vector2(0.5f, 0.0f),
+	    Vector2(0.0f, 0.5f),  Vector2(-0.5f, 0.0f),
+	};
+	VenationGenerator gen;
+	gen.type = VenationType::Closed;
+	gen.vein_density = 2000.0f;
+	gen.threads = 4;
+	auto veins = gen.generate_veins(contour);
+
+	// vertices inside, on and far outside the leaf
+	Mesh mesh;
+	for (int y = -12; y <= 12; y++)
+		for (int x = -12; x <= 12; x++)
+			mesh.vertices.push_back(Vector3(x * 0.05f, y * 0.05f, 0.0f));
+	mesh.vertices.push_back(Vector3(5.0f, -3.0f, 0.0f));
+	gen.compute_vein_distances(mesh, veins);
+	auto& distances = static_cast<Attribute<float>&>(*mesh.attributes["vein_distance"]).data;
+	auto& influences = static_cast<Attribute<float>&>(*mesh.attributes["vein_influence"]).data;
+
+	float max_width = 1.0f;
+	for (const auto& node : veins)
+		max_width = std::max(max_width, node.width);
+	for (size_t vi = 0; vi < mesh.vertices.size(); vi++)
+	{
+		Vector2 p(mesh.vertices[vi].x(), mesh.vertices[vi].y());
+		float min_dist = std::numeric_limits<float>::max();
+		float max_influence = 0.0f;
+		for (const auto& node : veins)
+		{
+			Vector2 a = node.parent < 0 ? node.position : veins[node.parent].position;
+			Vector2 ab = node.position - a;
+			float t = ab.squaredNorm() < 1e-10f
+			              ? 0.0f
+			              : std::clamp((p - a).dot(ab) / ab.squaredNorm(), 0.0f, 1.0f);
+			float d = (p - (a + t * ab)).norm();
+			float w = node.parent < 0 ? node.width / max_width
+			                          : (node.width + veins[node.parent].width) * 0.5f / max_width;
+			min_dist = std::min(min_dist, d);
+			max_influence = std::max(max_influence, w * std::exp(-d / (w * 0.06f + 0.005f)));
+		}
+		ASSERT_TRUE(std::abs(distances[vi] - min_dist) < 1e-6f);
+		ASSERT_TRUE(std::abs(influences[vi] - max_influence) < 1e-6f);
+	}
+}
+
 TEST(venation_zero_auxins_graceful)
 {
 	std::vector<Vector2> contour = {
@@ -662,6 +941,46 @@ TEST(venation_no_crash_small_contour)
 	ASSERT_EQ(static_cast<int>(veins.size()), 0);
 }
 
+TEST(leaf_mesh_cache_hits_and_evicts)
+{
+	LeafMeshCache cache{2};
+	LeafShapeGenerator gen;
+	gen.contour_resolution = 16;
+	Mesh first = cache.get(gen);
+	Mesh second = cache.get(gen);
+	ASSERT_EQ(cache.get_miss_count(), 1);
+	ASSERT_EQ(cache.get_hit_count(), 1);
+	ASSERT_TRUE(first.vertices == second.vertices);
+	ASSERT_TRUE(gen.generate().vertices == first.vertices);
+
+	// returned meshes are independent copies
+	first.vertices.clear();
+	ASSERT_TRUE(cache.get(gen).vertices == second.vertices);
+
+	// threads doesn't change the mesh, every other parameter does
+	LeafShapeGenerator threaded = gen;
+	threaded.threads = 4;
+	ASSERT_EQ(threaded.get_fingerprint(), gen.get_fingerprint());
+	LeafShapeGenerator other = gen;
+	other.seed++;
+	ASSERT_TRUE(other.get_fingerprint() != gen.get_fingerprint());
+
+	// least recently used entries are evicted first
+	LeafShapeGenerator third = gen;
+	third.aspect_ratio = 0.3f;
+	cache.get(other);
+	cache.get(gen);
+	cache.get(third); // evicts other
+	ASSERT_EQ(cache.size(), 2);
+	int misses = cache.get_miss_count();
+	cache.get(gen);
+	ASSERT_EQ(cache.get_miss_count(), misses);
+	ASSERT_TRUE(cache.invalidate(gen));
+	ASSERT_TRUE(!cache.invalidate(other));
+	cache.get(gen);
+	ASSERT_EQ(cache.get_miss_count(), misses + 1);
+}
+
 // =====================================================================
 // LeafLODGenerator tests
 // =====================================================================
@@ -675,14 +994,14 @@ TEST(lod_generate_card_empty_source)
 	// 0 vertices
 	Mesh card0 = lod.generate_card(empty_source);
 	ASSERT_EQ(static_cast<int>(card0.vertices.size()), 0);
-	ASSERT_EQ(static_cast<int>(card0.polygons.size()), 0);
+	ASSERT_EQ(static_cast<int>(card0.triangles.size()), 0);
 
 	// 1 vertex
 	Mesh one_vert;
 	one_vert.vertices.push_back(Vector3(0.0f, 0.0f, 0.0f));
 	Mesh card1 = lod.generate_card(one_vert);
 	ASSERT_EQ(static_cast<int>(card1.vertices.size()), 0);
-	ASSERT_EQ(static_cast<int>(card1.polygons.size()), 0);
+	ASSERT_EQ(static_cast<int>(card1.triangles.size()), 0);
 
 	// 2 vertices
 	Mesh two_vert;
@@ -690,7 +1009,7 @@ TEST(lod_generate_card_empty_source)
 	two_vert.vertices.push_back(Vector3(1.0f, 0.0f, 0.0f));
 	Mesh card2 = lod.generate_card(two_vert);
 	ASSERT_EQ(static_cast<int>(card2.vertices.size()), 0);
-	ASSERT_EQ(static_cast<int>(card2.polygons.size()), 0);
+	ASSERT_EQ(static_cast<int>(card2.triangles.size()), 0);
 }
 
 TEST(lod_generate_card_4_vertices_2_triangles)
@@ -707,13 +1026,13 @@ TEST(lod_generate_card_4_vertices_2_triangles)
 	// Card must be exactly 4 vertices
 	ASSERT_EQ(static_cast<int>(card.vertices.size()), 4);
 
-	// Card must have exactly 2 triangles (stored as degenerate quads)
-	ASSERT_EQ(static_cast<int>(card.polygons.size()), 2);
+	// Card must have exactly 2 triangles
+	ASSERT_EQ(static_cast<int>(card.triangles.size()), 2);
 
 	// All polygon indices must be valid
-	for (const auto& poly : card.polygons)
+	for (const auto& poly : card.triangles)
 	{
-		for (int j = 0; j < 4; ++j)
+		for (int j = 0; j < 3; ++j)
 		{
 			ASSERT_GE(poly[j], 0);
 			ASSERT_TRUE(poly[j] < 4);
@@ -805,12 +1124,12 @@ TEST(lod_generate_billboard_cloud_num_planes)
 	// 3 planes
 	Mesh cloud3 = lod.generate_billboard_cloud(positions, 3);
 	ASSERT_EQ(static_cast<int>(cloud3.vertices.size()), 3 * 4); // 4 verts per plane
-	ASSERT_EQ(static_cast<int>(cloud3.polygons.size()), 3 * 2); // 2 tris per plane
+	ASSERT_EQ(static_cast<int>(cloud3.triangles.size()), 3 * 2); // 2 tris per plane
 
 	// 5 planes
 	Mesh cloud5 = lod.generate_billboard_cloud(positions, 5);
 	ASSERT_EQ(static_cast<int>(cloud5.vertices.size()), 5 * 4);
-	ASSERT_EQ(static_cast<int>(cloud5.polygons.size()), 5 * 2);
+	ASSERT_EQ(static_cast<int>(cloud5.triangles.size()), 5 * 2);
 }
 
 TEST(lod_billboard_cloud_empty_positions)
@@ -820,7 +1139,7 @@ TEST(lod_billboard_cloud_empty_positions)
 
 	Mesh cloud = lod.generate_billboard_cloud(positions, 3);
 	ASSERT_EQ(static_cast<int>(cloud.vertices.size()), 0);
-	ASSERT_EQ(static_cast<int>(cloud.polygons.size()), 0);
+	ASSERT_EQ(static_cast<int>(cloud.triangles.size()), 0);
 }
 
 TEST(lod_billboard_cloud_zero_planes)
@@ -833,7 +1152,87 @@ TEST(lod_billboard_cloud_zero_planes)
 
 	Mesh cloud = lod.generate_billboard_cloud(positions, 0);
 	ASSERT_EQ(static_cast<int>(cloud.vertices.size()), 0);
-	ASSERT_EQ(static_cast<int>(cloud.polygons.size()), 0);
+	ASSERT_EQ(static_cast<int>(cloud.triangles.size()), 0);
+}
+
+// Two flat clumps of leaves in z = 0 and z = 5, far apart in x
+std::vector<Vector3> make_leaf_clumps()
+{
+	std::vector<Vector3> positions;
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(3);
+	for (int i = 0; i < 3000; i++)
+	{
+		bool second = i % 2 == 1;
+		positions.push_back(Vector3(rand_gen.get_minus_1_1() + (second ? 10 : 0),
+		                            rand_gen.get_minus_1_1() * 0.5f, second ? 5.0f : 0.0f));
+	}
+	return positions;
+}
+
+TEST(lod_clustered_billboard_cloud_fits_clusters)
+{
+	std::vector<Vector3> positions = make_leaf_clumps();
+	LeafLODGenerator lod;
+	BillboardClustering clustering;
+	clustering.card_budget = 2;
+	clustering.cards_per_cluster = 1;
+
+	Mesh cloud = lod.generate_billboard_cloud(positions, clustering);
+	ASSERT_EQ(static_cast<int>(cloud.vertices.size()), 2 * 4);
+	ASSERT_EQ(static_cast<int>(cloud.triangles.size()), 2 * 2);
+	for (int card = 0; card < 2; card++)
+	{
+		const Vector3* corners = &cloud.vertices[card * 4];
+		Vector3 center = (corners[0] + corners[1] + corners[2] + corners[3]) / 4;
+		Vector3 normal = (corners[1] - corners[0]).cross(corners[2] - corners[0]).normalized();
+		// the card lies in the plane of its clump and spans it, plus the margin
+		ASSERT_GT(std::abs(normal.z()), 0.99f);
+		ASSERT_TRUE(std::abs(center.z() - 0) < 0.01f || std::abs(center.z() - 5) < 0.01f);
+		ASSERT_TRUE(std::abs(center.x() - (center.z() > 1 ? 10 : 0)) < 0.1f);
+		float width = std::max((corners[1] - corners[0]).norm(), (corners[3] - corners[0]).norm());
+		ASSERT_GT(width, 1.9f);
+		ASSERT_LE(width, 2.2f);
+	}
+}
+
+TEST(lod_clustered_billboard_cloud_respects_budget)
+{
+	std::vector<Vector3> positions = make_leaf_clumps();
+	LeafLODGenerator lod;
+	BillboardClustering clustering;
+	clustering.card_budget = 13;
+	clustering.cards_per_cluster = 3;
+
+	Mesh cloud = lod.generate_billboard_cloud(positions, clustering);
+	ASSERT_EQ(static_cast<int>(cloud.vertices.size()), 4 * 3 * 4); // 4 clusters of 3 cards
+	ASSERT_EQ(static_cast<int>(cloud.uvs.size()), 4 * 3 * 4);
+
+	clustering.card_budget = 100;
+	Mesh few = lod.generate_billboard_cloud({Vector3(0, 0, 0), Vector3(1, 0, 0)}, clustering);
+	ASSERT_EQ(static_cast<int>(few.vertices.size()), 2 * 3 * 4); // one cluster per position
+
+	clustering.card_budget = 2;
+	Mesh none = lod.generate_billboard_cloud(positions, clustering);
+	ASSERT_EQ(static_cast<int>(none.vertices.size()), 0);
+	Mesh empty = lod.generate_billboard_cloud(std::vector<Vector3>{}, BillboardClustering{});
+	ASSERT_EQ(static_cast<int>(empty.vertices.size()), 0);
+}
+
+TEST(lod_clustered_billboard_cloud_is_thread_independent)
+{
+	std::vector<Vector3> positions = make_leaf_clumps();
+	LeafLODGenerator lod;
+	BillboardClustering clustering;
+	clustering.card_budget = 24;
+	Mesh serial = lod.generate_billboard_cloud(positions, clustering);
+	clustering.threads = 4;
+	Mesh parallel = lod.generate_billboard_cloud(positions, clustering);
+
+	ASSERT_EQ(serial.vertices.size(), parallel.vertices.size());
+	ASSERT_GT(static_cast<int>(serial.vertices.size()), 0);
+	for (size_t i = 0; i < serial.vertices.size(); i++)
+		ASSERT_TRUE(serial.vertices[i] == parallel.vertices[i]);
 }
 
 TEST(lod_impostor_view_directions_count)
@@ -863,6 +1262,2273 @@ TEST(lod_impostor_view_directions_upper_hemisphere)
 	}
 }
 
+TEST(lod_impostor_view_directions_are_hemi_octahedral)
+{
+	LeafLODGenerator lod;
+	const int resolution = 6;
+	auto dirs = lod.get_impostor_view_directions(resolution);
+	for (int j = 0; j < resolution; j++)
+		for (int i = 0; i < resolution; i++)
+		{
+			Vector2 coordinates = LeafLODGenerator::get_hemi_octahedral_coordinates(
+			    dirs[(size_t)j * resolution + i]);
+			Vector2 expected{(i + 0.5f) / resolution * 2 - 1, (j + 0.5f) / resolution * 2 - 1};
+			ASSERT_LE((coordinates - expected).norm(), 1e-5f);
+		}
+}
+
+TEST(impostor_baker_rasterizes_views)
+{
+	// 2 x 2 square facing up, its bounding sphere has a radius of sqrt(2)
+	Mesh quad;
+	quad.vertices = {Vector3{-1, -1, 0}, Vector3{1, -1, 0}, Vector3{1, 1, 0}, Vector3{-1, 1, 0}};
+	quad.polygons.push_back({0, 1, 2, 3});
+	std::vector<ImpostorMesh> meshes{{&quad, Vector3{1, .5f, 0}}};
+	ImpostorBaker baker;
+	baker.resolution = 3;
+	baker.tile_size = 32;
+	ImpostorAtlas atlas = baker.bake(meshes);
+	ASSERT_EQ(atlas.get_size(), 96);
+	ASSERT_LE(std::abs(atlas.radius - std::sqrt(2.0f)), 1e-5f);
+
+	// the center tile looks straight down and sees half of its area covered
+	auto tile_coverage = [](const ImpostorAtlas& atlas, const int tile_x, const int tile_y)
+	{
+		int covered = 0;
+		for (int y = 0; y < atlas.tile_size; y++)
+			for (int x = 0; x < atlas.tile_size; x++)
+			{
+				size_t index = (size_t)(tile_y * atlas.tile_size + y) * atlas.get_size() +
+				               tile_x * atlas.tile_size + x;
+				covered += atlas.albedo[index][3] == 255;
+			}
+		return (float)covered / (atlas.tile_size * atlas.tile_size);
+	};
+	ASSERT_LE(std::abs(tile_coverage(atlas, 1, 1) - 0.5f), 0.05f);
+	ASSERT_GT(tile_coverage(atlas, 1, 1), tile_coverage(atlas, 0, 0));
+	size_t center = (size_t)(48 * atlas.get_size() + 48);
+	ASSERT_TRUE(atlas.albedo[center][0] == 255 && atlas.albedo[center][1] == 128);
+	ASSERT_TRUE(atlas.normals[center][2] == 255 && atlas.normals[center][3] == 255);
+	ASSERT_LE(std::abs(atlas.depth[center] - 0.5f), 1e-4f);
+	ASSERT_TRUE(atlas.depth[0] == 1.0f && atlas.albedo[0][3] == 0);
+
+	// every view of a tree sees it, whatever the thread count
+	auto trunk = std::make_shared<TrunkFunction>();
+	trunk->add_child(std::make_shared<BranchFunction>());
+	Tree tree(trunk);
+	tree.execute_functions();
+	Mesh mesh = ManifoldMesher{}.mesh_tree(tree);
+	meshes = {{&mesh, Vector3{.4f, .3f, .2f}}};
+	ImpostorAtlas serial = baker.bake(meshes);
+	baker.threads = 4;
+	ImpostorAtlas parallel = baker.bake(meshes);
+	ASSERT_TRUE(serial.depth == parallel.depth && serial.normals == parallel.normals);
+	for (int j = 0; j < baker.resolution; j++)
+		for (int i = 0; i < baker.resolution; i++)
+			ASSERT_GT(tile_coverage(serial, i, j), 0.0f);
+}
+
+// =====================================================================
+// NodeArena tests
+// =====================================================================
+
+static int count_nodes_rec(const Node& node)
+{
+	int count = 1;
+	for (const auto& child : node.children)
+		count += count_nodes_rec(child->node);
+	return count;
+}
+
+static Tree make_branching_tree()
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	trunk->add_child(branch);
+	Tree tree(trunk);
+	tree.execute_functions();
+	return tree;
+}
+
+TEST(arena_matches_stems)
+{
+	Tree tree = make_branching_tree();
+	NodeArena& arena = tree.get_arena();
+
+	int expected = 0;
+	for (auto& stem : tree.get_stems())
+		expected += count_nodes_rec(stem.node);
+	ASSERT_EQ(arena.size(), expected);
+	ASSERT_EQ(tree.get_node_count(), expected);
+	ASSERT_EQ(static_cast<int>(arena.roots.size()), static_cast<int>(tree.get_stems().size()));
+	ASSERT_TRUE(&arena[arena.roots[0]] == &tree.get_stems()[0].node);
+}
+
+TEST(arena_pre_order_links)
+{
+	Tree tree = make_branching_tree();
+	NodeArena& arena = tree.get_arena();
+
+	for (int i = 0; i < arena.size(); i++)
+	{
+		int parent = arena.parent[i];
+		if (parent == NodeArena::none)
+			continue;
+		// parents precede children and children lie inside the parent's subtree range
+		ASSERT_TRUE(parent < i);
+		ASSERT_TRUE(i < arena.subtree_end[parent]);
+		ASSERT_TRUE(&arena[parent].children[arena.child_rank[i]]->node == arena.nodes[i]);
+
+		Vector3 expected = arena.position[parent] + arena[parent].direction *
+		                                                arena[parent].length *
+		                                                arena.position_in_parent[i];
+		ASSERT_TRUE((arena.position[i] - expected).norm() < 1e-5f);
+	}
+
+	for (int i = 0; i < arena.size(); i++)
+	{
+		int child_count = 0;
+		arena.for_each_child(i,
+		                     [&](int child)
+		                     {
+			                     ASSERT_EQ(arena.child_rank[child], child_count);
+			                     child_count++;
+		                     });
+		ASSERT_EQ(child_count, static_cast<int>(arena[i].children.size()));
+		ASSERT_EQ(arena.subtree_size(i), count_nodes_rec(arena[i]));
+	}
+}
+
+// =====================================================================
+// Parallel ManifoldMesher tests
+// =====================================================================
+
+TEST(mesher_parallel_matches_serial)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	auto sub_branch = std::make_shared<BranchFunction>();
+	trunk->add_child(branch);
+	branch->add_child(sub_branch);
+	Tree tree(trunk);
+	tree.execute_functions();
+
+	ManifoldMesher mesher;
+	Mesh serial = mesher.mesh_tree(tree);
+	mesher.threads = 4;
+	Mesh parallel = mesher.mesh_tree(tree);
+
+	ASSERT_GT(serial.vertices.size(), 0u);
+	ASSERT_EQ(serial.vertices.size(), parallel.vertices.size());
+	ASSERT_EQ(serial.uvs.size(), parallel.uvs.size());
+	ASSERT_EQ(serial.polygons.size(), parallel.polygons.size());
+	for (size_t i = 0; i < serial.vertices.size(); i++)
+		ASSERT_TRUE(serial.vertices[i] == parallel.vertices[i]);
+	for (size_t i = 0; i < serial.uvs.size(); i++)
+		ASSERT_TRUE(serial.uvs[i] == parallel.uvs[i]);
+	ASSERT_TRUE(serial.polygons == parallel.polygons);
+	ASSERT_TRUE(serial.uv_loops == parallel.uv_loops);
+	for (auto& [name, attribute] : serial.attributes)
+	{
+		if (auto* data = dynamic_cast<Attribute<float>*>(attribute.get()))
+			ASSERT_TRUE(data->data ==
+			            static_cast<Attribute<float>*>(parallel.attributes.at(name).get())->data);
+	}
+}
+
+TEST(smoothing_adjacency_csr_no_duplicates)
+{
+	// two quads sharing the edge 1-2
+	Mesh mesh;
+	for (int i = 0; i < 6; i++)
+		mesh.add_vertex(Vector3{(float)(i / 2), (float)(i % 2), 0});
+	mesh.polygons.push_back({0, 1, 3, 2});
+	mesh.polygons.push_back({2, 3, 5, 4});
+
+	MeshProcessing::Smoothing::Adjacency adjacency;
+	adjacency.build(mesh);
+	ASSERT_EQ(static_cast<int>(adjacency.offsets.size()), 7);
+	for (int i = 0; i < 6; i++)
+	{
+		for (int j = adjacency.offsets[i]; j < adjacency.offsets[i + 1]; j++)
+		{
+			ASSERT_TRUE(adjacency.neighbours[j] != i);
+			for (int k = j + 1; k < adjacency.offsets[i + 1]; k++)
+				ASSERT_TRUE(adjacency.neighbours[j] != adjacency.neighbours[k]);
+		}
+	}
+	ASSERT_EQ(adjacency.degree(3), 3);
+	ASSERT_EQ(adjacency.degree(2), 3);
+}
+
+TEST(smoothing_keeps_the_last_iteration)
+{
+	// a strip of quads with bumps, smoothed against a naive Jacobi iteration
+	Mesh mesh;
+	for (int i = 0; i < 12; i++)
+		mesh.add_vertex(Vector3{(float)(i / 2), (float)(i % 2), (i % 3) * .5f});
+	for (int i = 0; i + 3 < 12; i += 2)
+		mesh.polygons.push_back({i, i + 1, i + 3, i + 2});
+	MeshProcessing::Smoothing::Adjacency adjacency;
+	adjacency.build(mesh);
+
+	std::vector<Vector3> expected = mesh.vertices;
+	for (int iterations = 1; iterations <= 3; iterations++)
+	{
+		std::vector<Vector3> previous = expected;
+		for (int i = 0; i < (int)expected.size(); i++)
+		{
+			if (adjacency.degree(i) <= 1)
+				continue;
+			Vector3 barycenter{0, 0, 0};
+			for (int j = adjacency.offsets[i]; j < adjacency.offsets[i + 1]; j++)
+				barycenter += previous[adjacency.neighbours[j]];
+			barycenter /= (float)adjacency.degree(i);
+			expected[i] = Geometry::lerp(previous[i], barycenter, .5f);
+		}
+		Mesh smoothed = mesh;
+		MeshProcessing::Smoothing::smooth_mesh(smoothed, adjacency, iterations, .5f);
+		ASSERT_TRUE(smoothed.vertices != mesh.vertices);
+		for (size_t i = 0; i < expected.size(); i++)
+			ASSERT_TRUE((smoothed.vertices[i] - expected[i]).norm() < 1e-5f);
+	}
+}
+
+TEST(mesher_computes_outward_normals)
+{
+	Tree tree = make_branching_tree();
+	ManifoldMesher mesher;
+	mesher.compute_normals = true;
+	for (int smooth_iterations : {0, 4})
+	{
+		mesher.smooth_iterations = smooth_iterations;
+		mesher.threads = 4;
+		Mesh mesh = mesher.mesh_tree(tree);
+		ASSERT_EQ(mesh.normals.size(), mesh.vertices.size());
+
+		// area weighted normals of the faces, polygons being wound clockwise from outside
+		std::vector<Vector3> reference(mesh.vertices.size(), Vector3::Zero());
+		for (const auto& polygon : mesh.polygons)
+		{
+			Vector3 first = mesh.vertices[polygon[2]] - mesh.vertices[polygon[0]];
+			Vector3 second = mesh.vertices[polygon[3]] - mesh.vertices[polygon[1]];
+			for (int k = 0; k < (polygon[3] == polygon[2] ? 3 : 4); k++)
+				reference[polygon[k]] += second.cross(first);
+		}
+		// faces collapsing at the branch tips are too small to have a meaningful normal
+		float total = 0;
+		int count = 0;
+		int disagreeing = 0;
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			ASSERT_TRUE(std::abs(mesh.normals[i].norm() - 1) < 1e-4f);
+			if (reference[i].norm() < 1e-4f)
+				continue;
+			float agreement = mesh.normals[i].dot(reference[i].normalized());
+			ASSERT_GT(agreement, 0.f);
+			// smoothed meshes get the face normals everywhere, not the normals of the tubes
+			if (smooth_iterations > 0)
+				ASSERT_GT(agreement, 0.999f);
+			disagreeing += agreement < 0.5f;
+			total += agreement;
+			count++;
+		}
+		ASSERT_GT(count, (int)mesh.vertices.size() / 2);
+		ASSERT_LE(disagreeing, count / 1000);
+		ASSERT_GT(total / count, 0.97f);
+
+		mesher.threads = 1;
+		ASSERT_TRUE(mesher.mesh_tree(tree).normals == mesh.normals);
+	}
+	mesher.compute_normals = false;
+	ASSERT_TRUE(mesher.mesh_tree(tree).normals.empty());
+}
+
+// Trunk carrying two copies of the same twig on opposite sides
+static Tree make_mirrored_twigs_tree()
+{
+	auto make_chain = [](const Vector3& direction, const Vector3& tangent, const int count,
+	                     const float radius)
+	{
+		Node root{direction, tangent, .5f, radius, 0};
+		Node* last = &root;
+		for (int i = 1; i < count; i++)
+		{
+			Vector3 bent = (direction + Vector3{0, 0, .2f * i}).normalized();
+			Node child{bent, tangent, .5f, radius * (1 - .1f * i), 0};
+			last->children.push_back(std::make_shared<NodeChild>(NodeChild{child, 1}));
+			last = &last->children.back()->node;
+		}
+		return root;
+	};
+	Node trunk = make_chain(Vector3::UnitZ(), Vector3::UnitX(), 4, .2f);
+	Node& carrier = trunk.children[0]->node;
+	for (float side : {1.f, -1.f})
+	{
+		Node twig = make_chain(Vector3{side, 0, .5f}.normalized(), Vector3{0, side, 0}, 4, .05f);
+		carrier.children.push_back(std::make_shared<NodeChild>(NodeChild{twig, .5f}));
+	}
+	Tree tree;
+	tree.get_stems().push_back(Stem{std::move(trunk), Vector3::Zero()});
+	return tree;
+}
+
+TEST(branch_instancer_instances_repeated_twigs)
+{
+	Tree tree = make_mirrored_twigs_tree();
+	ManifoldMesher mesher;
+	mesher.smooth_iterations = 0;
+	BranchInstancer instancer;
+	instancer.max_error = 1e-4f;
+	InstancedTreeMesh instanced = instancer.mesh_tree(tree, mesher);
+	ASSERT_EQ(instanced.prototypes.size(), 1);
+	ASSERT_EQ(instanced.instances.size(), 2);
+	ASSERT_LE(instanced.max_error, instancer.max_error);
+
+	// the second twig is the first one turned half way around the trunk
+	const Mesh& prototype = instanced.prototypes[0];
+	ASSERT_GT(prototype.vertices.size(), 0);
+	auto place = [&](const BranchInstance& instance, const Vector3& vertex) -> Vector3
+	{ return instance.position + instance.rotation * (vertex * instance.scale); };
+	Eigen::Matrix3f half_turn = Eigen::AngleAxisf(std::numbers::pi_v<float>, Vector3::UnitZ())
+	                                .toRotationMatrix();
+	for (const Vector3& vertex : prototype.vertices)
+	{
+		Vector3 first = place(instanced.instances[0], vertex);
+		Vector3 second = place(instanced.instances[1], vertex);
+		ASSERT_TRUE((half_turn * first - second).norm() < 1e-4f);
+	}
+	// the tree mesh is the trunk alone
+	Tree trunk = make_mirrored_twigs_tree();
+	trunk.get_stems()[0].node.children[0]->node.children.resize(1);
+	ASSERT_TRUE(instanced.mesh.vertices == mesher.mesh_tree(trunk).vertices);
+}
+
+TEST(branch_instancer_skips_chains_with_side_children)
+{
+	// the twigs end with a lone child starting half way along their second node
+	Tree tree = make_mirrored_twigs_tree();
+	Node& carrier = tree.get_stems()[0].node.children[0]->node;
+	for (size_t i = 1; i < carrier.children.size(); i++)
+		carrier.children[i]->node.children[0]->node.children[0]->position_in_parent = .5f;
+	ManifoldMesher mesher;
+	mesher.smooth_iterations = 0;
+	BranchInstancer instancer;
+	instancer.max_error = 1e-4f;
+	InstancedTreeMesh instanced = instancer.mesh_tree(tree, mesher);
+	ASSERT_EQ(instanced.instances.size(), 0);
+	ASSERT_TRUE(instanced.mesh.vertices == mesher.mesh_tree(tree).vertices);
+}
+
+TEST(branch_instancer_keeps_unique_branches_in_the_mesh)
+{
+	Tree tree = make_branching_tree();
+	ManifoldMesher mesher;
+	BranchInstancer instancer;
+	instancer.max_error = 0;
+	InstancedTreeMesh exact = instancer.mesh_tree(tree, mesher);
+	ASSERT_EQ(exact.instances.size(), 0);
+	ASSERT_TRUE(exact.mesh.vertices == mesher.mesh_tree(tree).vertices);
+
+	// a loose bound instances most twigs, prototypes and instances being fewer vertices
+	instancer.max_error = 10;
+	instancer.threads = 4;
+	InstancedTreeMesh loose = instancer.mesh_tree(tree, mesher);
+	ASSERT_GT(loose.instances.size(), 0);
+	ASSERT_GT(loose.instances.size(), loose.prototypes.size());
+	ASSERT_LE(loose.max_error, instancer.max_error);
+	size_t vertex_count = loose.mesh.vertices.size();
+	for (const Mesh& prototype : loose.prototypes)
+		vertex_count += prototype.vertices.size();
+	ASSERT_GT(exact.mesh.vertices.size(), vertex_count);
+	for (const BranchInstance& instance : loose.instances)
+	{
+		ASSERT_GT(instance.scale, 0);
+		ASSERT_TRUE(std::abs(instance.rotation.norm() - 1) < 1e-4f);
+		ASSERT_TRUE(instance.prototype >= 0 && instance.prototype < (int)loose.prototypes.size());
+	}
+}
+
+TEST(mesher_predict_counts_exact)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	auto sub_branch = std::make_shared<BranchFunction>();
+	trunk->add_child(branch);
+	branch->add_child(sub_branch);
+	Tree tree(trunk);
+	tree.execute_functions();
+
+	for (int resolution : {5, 8, 32})
+	{
+		ManifoldMesher manifold;
+		manifold.radial_resolution = resolution;
+		MeshCounts predicted = manifold.predict_counts(tree);
+		Mesh mesh = manifold.mesh_tree(tree);
+		ASSERT_EQ(predicted.vertices, static_cast<int>(mesh.vertices.size()));
+		ASSERT_EQ(predicted.uvs, static_cast<int>(mesh.uvs.size()));
+		ASSERT_EQ(predicted.polygons, static_cast<int>(mesh.polygons.size()));
+
+		BasicMesher basic;
+		basic.radial_resolution = resolution;
+		predicted = basic.predict_counts(tree);
+		mesh = basic.mesh_tree(tree);
+		ASSERT_EQ(predicted.vertices, static_cast<int>(mesh.vertices.size()));
+		ASSERT_EQ(predicted.polygons, static_cast<int>(mesh.polygons.size()));
+	}
+}
+
+TEST(mesh_attribute_handle_lookup)
+{
+	Mesh mesh;
+	AttributeHandle<float> handle = mesh.add_attribute<float>("weight");
+	mesh.add_vertex(Vector3{0, 0, 0});
+	mesh.resize(16, 0);
+	handle[15] = 2.f;
+
+	AttributeHandle<float> found = mesh.get_attribute<float>("weight");
+	ASSERT_TRUE(found.is_valid());
+	ASSERT_EQ(found.data().size(), 16u);
+	ASSERT_TRUE(found[15] == 2.f);
+	ASSERT_TRUE(!mesh.get_attribute<float>("missing").is_valid());
+	ASSERT_TRUE(!mesh.get_attribute<Vector3>("weight").is_valid());
+}
+
+// =====================================================================
+// TreeBuild tests
+// =====================================================================
+
+TEST(tree_build_async_matches_sync)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	trunk->add_child(std::make_shared<BranchFunction>());
+	Tree sync_tree(trunk);
+	sync_tree.execute_functions();
+	ManifoldMesher mesher;
+	Mesh expected = mesher.mesh_tree(sync_tree);
+
+	Tree async_tree(trunk);
+	TreeBuild build{async_tree, std::make_unique<ManifoldMesher>(mesher)};
+	Mesh& mesh = build.get_mesh();
+	ASSERT_TRUE(build.is_done());
+	ASSERT_TRUE(!build.is_cancelled());
+	ASSERT_EQ(mesh.vertices.size(), expected.vertices.size());
+	ASSERT_TRUE(mesh.polygons == expected.polygons);
+}
+
+TEST(tree_build_progressive_preview)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto growth = std::make_shared<GrowthFunction>();
+	growth->iterations = 4;
+	trunk->add_child(growth);
+	Tree sync_tree(trunk);
+	sync_tree.execute_functions();
+	ManifoldMesher mesher;
+	Mesh expected = mesher.mesh_tree(sync_tree);
+
+	Tree async_tree(trunk);
+	PreviewSettings preview;
+	preview.time_budget_ms = 10000;
+	TreeBuild build{async_tree, std::make_unique<ManifoldMesher>(mesher), preview};
+	Mesh& mesh = build.get_mesh();
+	ASSERT_TRUE(build.has_preview());
+	ASSERT_GT(static_cast<int>(build.get_preview().vertices.size()), 0);
+	ASSERT_GT(mesh.vertices.size(), build.get_preview().vertices.size());
+	ASSERT_TRUE(mesh.polygons == expected.polygons);
+	// the preview runs on a reduced copy, the graph of the tree keeps its parameters
+	ASSERT_EQ(growth->iterations, 4);
+	ASSERT_TRUE(trunk->resolution == 3.f);
+
+	// a preview over its budget is dropped, the full build still completes
+	preview.time_budget_ms = -1;
+	TreeBuild late{async_tree, std::make_unique<ManifoldMesher>(mesher), preview};
+	ASSERT_TRUE(late.get_mesh().polygons == expected.polygons);
+	ASSERT_TRUE(!late.has_preview());
+}
+
+TEST(tree_build_reports_errors_and_cancellation)
+{
+	Tree empty_tree;
+	TreeBuild failing{empty_tree, std::make_unique<ManifoldMesher>()};
+	bool threw = false;
+	try
+	{
+		failing.get_mesh();
+	}
+	catch (const std::runtime_error&)
+	{
+		threw = true;
+	}
+	ASSERT_TRUE(threw);
+
+	auto trunk = std::make_shared<TrunkFunction>();
+	Tree tree(trunk);
+	TreeBuild cancelled{tree, std::make_unique<ManifoldMesher>()};
+	cancelled.cancel();
+	cancelled.wait();
+	ASSERT_TRUE(cancelled.is_done());
+	ASSERT_TRUE(cancelled.is_cancelled());
+}
+
+TEST(scratch_arena_reuses_regions)
+{
+	ScratchArena arena{256};
+	{
+		ScratchArena::Lease first = ScratchArena::lease(&arena);
+		ScratchArena::Lease second = ScratchArena::lease(&arena);
+		ASSERT_TRUE(first.get() != second.get());
+		std::pmr::vector<int> values(1000, 1, first.get()); // more than a region holds
+		ASSERT_EQ(values.back(), 1);
+	}
+	ASSERT_EQ(arena.get_region_count(), 2);
+	size_t capacity = arena.get_capacity();
+	ASSERT_GE(capacity, 256 + 1000 * sizeof(int));
+
+	// the region grew to what the lease used, the same work no longer goes past it
+	{
+		ScratchArena::Lease lease = ScratchArena::lease(&arena);
+		std::pmr::vector<int> values(1000, 2, lease.get());
+		lease.rewind();
+		std::pmr::vector<int> more_values(1000, 3, lease.get());
+	}
+	ASSERT_EQ(arena.get_region_count(), 2);
+	ASSERT_EQ(arena.get_capacity(), capacity);
+	ASSERT_TRUE(ScratchArena::lease(nullptr).get() == std::pmr::get_default_resource());
+
+	// warm builds of a tree reuse the scratch memory of the first one
+	Tree tree = make_branching_tree();
+	ManifoldMesher mesher;
+	Mesh first_mesh = mesher.mesh_tree(tree);
+	capacity = tree.get_scratch_arena().get_capacity();
+	ASSERT_GT(capacity, 0);
+	ASSERT_TRUE(mesher.mesh_tree(tree).vertices == first_mesh.vertices);
+	ASSERT_EQ(tree.get_scratch_arena().get_capacity(), capacity);
+}
+
+TEST(memory_footprint_and_peaks)
+{
+	Tree tree = make_branching_tree();
+	MemoryFootprint footprint = tree.memory_footprint();
+	size_t child_count = tree.get_node_count() - tree.get_stems().size();
+	ASSERT_GE(footprint.get("nodes"), child_count * sizeof(NodeChild));
+	ASSERT_GE(footprint.get("children"), child_count * sizeof(std::shared_ptr<NodeChild>));
+	ASSERT_GE(footprint.get("arena"), tree.get_node_count() * sizeof(Node*));
+	ASSERT_EQ(footprint.get("function_cache"), 0);
+	ASSERT_EQ(footprint.get("missing"), 0);
+	ASSERT_EQ(tree.get_execution_memory_peak(), 0); // not tracked
+
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto growth = std::make_shared<GrowthFunction>();
+	growth->iterations = 4;
+	trunk->add_child(growth);
+	Tree grown(trunk);
+	grown.track_memory = true;
+	grown.execute_functions();
+	size_t execution_peak = grown.get_execution_memory_peak();
+	ASSERT_GE(execution_peak, grown.memory_footprint().total());
+
+	ManifoldMesher mesher;
+	mesher.smooth_iterations = 1;
+	Mesh mesh = mesher.mesh_tree(grown);
+	MemoryFootprint mesh_footprint = mesh.memory_footprint();
+	ASSERT_EQ(mesh_footprint.get("vertices"), mesh.vertices.capacity() * sizeof(Vector3));
+	ASSERT_GE(mesh_footprint.get("polygons"), mesh.polygons.size() * sizeof(std::array<int, 4>));
+	ASSERT_GT(mesh.attributes.size(), 0);
+	for (const auto& [name, attribute] : mesh.attributes)
+		ASSERT_GE(mesh_footprint.get("attributes/" + name),
+		          attribute->size() * attribute->get_element_size());
+	// smoothing holds a copy of the vertices on top of the mesh
+	ASSERT_GE(grown.get_meshing_memory_peak(),
+	          mesh_footprint.total() + mesh.vertices.size() * sizeof(Vector3));
+	ASSERT_EQ(grown.get_execution_memory_peak(), execution_peak);
+	grown.execute_functions();
+	ASSERT_EQ(grown.get_meshing_memory_peak(), 0);
+}
+
+TEST(parameter_sweep_measures_variants)
+{
+	std::vector<std::shared_ptr<TreeFunction>> variants;
+	for (float density : {0.f, 1.f, 3.f})
+	{
+		auto trunk = std::make_shared<TrunkFunction>();
+		auto branch = std::make_shared<BranchFunction>();
+		branch->distribution->density = density;
+		trunk->add_child(branch);
+		variants.push_back(trunk);
+	}
+	ParameterSweep sweep;
+	sweep.threads = 2;
+	sweep.crown_shape = CrownShape::Conical;
+	ManifoldMesher mesher;
+	SweepTable table = sweep.run(variants, mesher);
+	ASSERT_EQ(table.size(), variants.size());
+	ASSERT_TRUE(table.meshes.empty());
+	for (size_t i = 0; i < variants.size(); i++)
+	{
+		Tree tree{variants[i]};
+		tree.execute_functions();
+		ASSERT_EQ(table.node_counts[i], tree.get_node_count());
+		ASSERT_EQ(table.vertex_counts[i], mesher.predict_counts(tree).vertices);
+		ASSERT_GE(table.crown_fits[i], 0.f);
+		ASSERT_LE(table.crown_fits[i], 1.f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			ASSERT_LE(table.bounds_min[i][axis], tree.get_stems()[0].position[axis]);
+			ASSERT_LE(table.bounds_min[i][axis], table.bounds_max[i][axis]);
+		}
+	}
+	ASSERT_GT(table.node_counts[2], table.node_counts[1]);
+	ASSERT_GT(table.crown_fits[2], 0.f);
+
+	sweep.build_meshes = true;
+	SweepTable meshed = sweep.run(variants, mesher);
+	ASSERT_EQ(meshed.meshes.size(), variants.size());
+	for (size_t i = 0; i < variants.size(); i++)
+	{
+		ASSERT_EQ(meshed.vertex_counts[i], table.vertex_counts[i]);
+		ASSERT_EQ((int)meshed.meshes[i].vertices.size(), table.vertex_counts[i]);
+		ASSERT_EQ(meshed.crown_fits[i], table.crown_fits[i]);
+	}
+}
+
+TEST(manifold_mesher_bakes_wind_attributes)
+{
+	using Names = ManifoldMesher::AttributeNames;
+	Tree tree = make_branching_tree();
+	ManifoldMesher mesher;
+	Mesh plain = mesher.mesh_tree(tree);
+	ASSERT_TRUE(!plain.get_attribute<float>(Names::wind_stiffness).is_valid());
+
+	mesher.attributes.push_back(Names::wind_stiffness);
+	mesher.attributes.push_back(Names::wind_phase);
+	mesher.attributes.push_back(Names::wind_parent_id);
+	mesher.attributes.push_back(Names::wind_grandparent_id);
+	Mesh mesh = mesher.mesh_tree(tree);
+	ASSERT_TRUE(mesh.vertices == plain.vertices);
+	auto stiffness = mesh.get_attribute<float>(Names::wind_stiffness);
+	auto phase = mesh.get_attribute<float>(Names::wind_phase);
+	auto parent_id = mesh.get_attribute<float>(Names::wind_parent_id);
+	auto grandparent_id = mesh.get_attribute<float>(Names::wind_grandparent_id);
+	auto stem_id = mesh.get_attribute<float>(Names::stem_id);
+	auto depth = mesh.get_attribute<float>(Names::hierarchy_depth);
+	ASSERT_TRUE(stiffness.is_valid() && phase.is_valid() && parent_id.is_valid() &&
+	            grandparent_id.is_valid());
+
+	// every branch carries one set of values, its parent is a branch one level up and its
+	// grandparent the parent of that branch
+	std::unordered_map<int, int> first_vertex;
+	for (int i = 0; i < (int)mesh.vertices.size(); i++)
+		first_vertex.try_emplace((int)stem_id[i], i);
+	ASSERT_GT(first_vertex.size(), 1);
+	int deepest = 0;
+	for (int i = 0; i < (int)mesh.vertices.size(); i++)
+	{
+		int first = first_vertex[(int)stem_id[i]];
+		ASSERT_EQ(stiffness[i], stiffness[first]);
+		ASSERT_EQ(phase[i], phase[first]);
+		ASSERT_EQ(parent_id[i], parent_id[first]);
+		ASSERT_EQ(grandparent_id[i], grandparent_id[first]);
+		ASSERT_GT(stiffness[i], 0.f);
+		ASSERT_TRUE(stiffness[i] < 1 && phase[i] >= 0 && phase[i] < 1);
+		if (depth[i] == 0)
+		{
+			ASSERT_EQ(parent_id[i], stem_id[i]);
+			ASSERT_EQ(grandparent_id[i], stem_id[i]);
+			continue;
+		}
+		ASSERT_TRUE(parent_id[i] < stem_id[i]);
+		int parent = first_vertex.at((int)parent_id[i]);
+		ASSERT_EQ(depth[parent], depth[i] - 1);
+		ASSERT_EQ(grandparent_id[i], parent_id[parent]);
+		deepest = std::max(deepest, (int)depth[i]);
+	}
+	// splits carry branches of branches, whose grandparents are not stems
+	ASSERT_GT(deepest, 1);
+
+	// a larger scale makes every branch stiffer
+	mesher.wind_stiffness_scale = 20;
+	Mesh stiffer = mesher.mesh_tree(tree);
+	ASSERT_GT(stiffer.get_attribute<float>(Names::wind_stiffness)[0], stiffness[0]);
+	PackedAttribute packed = pack_attribute(*mesh.attributes.at(Names::wind_parent_id),
+	                                        PackedFormat::UInt16);
+	ASSERT_EQ(packed.count, mesh.vertices.size());
+}
+
+TEST(build_control_cancels_and_reports_progress)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto growth = std::make_shared<GrowthFunction>();
+	growth->iterations = 3;
+	trunk->add_child(growth);
+	Tree tree(trunk);
+
+	BuildControl control;
+	std::vector<float> fractions;
+	control.progress_callback = [&](const std::string& stage, float fraction)
+	{
+		if (stage == "growth")
+			fractions.push_back(fraction);
+	};
+	tree.execute_functions(&control);
+	ASSERT_EQ(static_cast<int>(fractions.size()), 3);
+	ASSERT_TRUE(fractions[0] == 0.f);
+
+	control.cancel();
+	bool cancelled = false;
+	try
+	{
+		tree.execute_functions(&control);
+	}
+	catch (const BuildCancelled&)
+	{
+		cancelled = true;
+	}
+	ASSERT_TRUE(cancelled);
+
+	// the control is released once the execution stopped
+	tree.execute_functions();
+	ASSERT_GT(tree.get_node_count(), 0);
+}
+
+// =====================================================================
+// Function cache tests
+// =====================================================================
+
+static std::vector<Vector3> mesh_vertices(Tree& tree)
+{
+	ManifoldMesher mesher;
+	mesher.smooth_iterations = 0;
+	return mesher.mesh_tree(tree).vertices;
+}
+
+TEST(function_cache_matches_full_execution)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	auto sub_branch = std::make_shared<BranchFunction>();
+	trunk->add_child(branch);
+	branch->add_child(sub_branch);
+
+	Tree cached(trunk);
+	cached.cache_functions = true;
+	cached.execute_functions();
+	ASSERT_GT(cached.get_cached_state_count(), 0);
+
+	// only the last function changed: its input is restored from the cache
+	sub_branch->start_radius = ConstantProperty{0.6f};
+	cached.execute_functions();
+	Tree fresh(trunk);
+	fresh.execute_functions();
+	ASSERT_TRUE(mesh_vertices(cached) == mesh_vertices(fresh));
+
+	// nothing changed: the whole graph is restored
+	int state_count = cached.get_cached_state_count();
+	cached.execute_functions();
+	ASSERT_EQ(cached.get_cached_state_count(), state_count);
+	ASSERT_TRUE(mesh_vertices(cached) == mesh_vertices(fresh));
+}
+
+TEST(function_cache_reuses_states_across_rebuilt_graphs)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	trunk->add_child(branch);
+	Tree cached(trunk->clone());
+	cached.cache_functions = true;
+	cached.execute_functions();
+
+	// a new child replaces the edited one, executions run on clones of the graph
+	auto edited = std::make_shared<BranchFunction>();
+	edited->start_radius = ConstantProperty{0.6f};
+	trunk->clear_children();
+	trunk->add_child(edited);
+	cached.set_first_function(trunk->clone());
+	cached.execute_functions();
+	Tree fresh(trunk);
+	fresh.execute_functions();
+	ASSERT_TRUE(mesh_vertices(cached) == mesh_vertices(fresh));
+	// states of the trunk and of the edited branch, the unused branch state is dropped
+	ASSERT_EQ(cached.get_cached_state_count(), 2);
+}
+
+TEST(shared_graph_executes_concurrently)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	auto growth = std::make_shared<GrowthFunction>();
+	branch->randomness = RandomProperty{.2f, .6f};
+	growth->iterations = 3;
+	growth->enable_shadows = true;
+	trunk->add_child(branch);
+	branch->add_child(growth);
+
+	// one graph, several trees executing it at once, cached or not, with different seeds
+	const int tree_count = 6;
+	std::vector<Tree> trees(tree_count);
+	std::vector<std::vector<Vector3>> concurrent(tree_count);
+	Parallel::parallel_for(
+	    tree_count,
+	    [&](const int i)
+	    {
+		    trees[i].set_first_function(trunk);
+		    trees[i].cache_functions = i % 2 == 1;
+		    trees[i].execute_functions(nullptr, i / 2);
+		    concurrent[i] = mesh_vertices(trees[i]);
+	    },
+	    4);
+
+	for (int i = 0; i < tree_count; i++)
+	{
+		std::shared_ptr<TreeFunction> graph = trunk->clone();
+		graph->offset_seeds(i / 2);
+		Tree tree(graph);
+		tree.execute_functions();
+		ASSERT_TRUE(concurrent[i] == mesh_vertices(tree));
+	}
+	ASSERT_TRUE(concurrent[0] != concurrent[2]);
+}
+
+TEST(copy_stems_is_deep)
+{
+	Tree tree = make_branching_tree();
+	std::vector<Stem> copies = NodeUtilities::copy_stems(tree.get_stems());
+	Node& original = tree.get_stems()[0].node;
+	Node& copy = copies[0].node;
+	ASSERT_TRUE(copy.children[0].get() != original.children[0].get());
+	copy.children[0]->node.radius = 123.f;
+	ASSERT_TRUE(original.children[0]->node.radius != 123.f);
+	ASSERT_EQ(count_nodes_rec(copy), count_nodes_rec(original));
+}
+
+// =====================================================================
+// Creator index tests
+// =====================================================================
+
+static bool same_selection(const NodeUtilities::BranchSelection& a,
+                           const NodeUtilities::BranchSelection& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].size() != b[i].size())
+			return false;
+		for (size_t j = 0; j < a[i].size(); j++)
+			if (a[i][j].node != b[i][j].node || a[i][j].node_position != b[i][j].node_position)
+				return false;
+	}
+	return true;
+}
+
+TEST(creator_index_matches_select_from_tree)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	auto first_twig = std::make_shared<BranchFunction>();
+	auto second_twig = std::make_shared<BranchFunction>();
+	second_twig->distribution->density = 4;
+	trunk->add_child(branch);
+	branch->add_child(first_twig);
+	branch->add_child(second_twig);
+
+	std::vector<Stem> stems;
+	CreatorIndex index;
+	ExecutionContext context;
+	context.creator_index = &index;
+	trunk->execute(stems, context, 0, 0);
+	// the twigs registered their nodes since the index was built
+	ASSERT_TRUE(index.is_valid());
+	CreatorIndex rebuilt;
+	for (int id = 0; id <= 3; id++)
+	{
+		NodeUtilities::BranchSelection expected = NodeUtilities::select_from_tree(stems, id);
+		ASSERT_GT(expected.size(), 0);
+		ASSERT_TRUE(same_selection(index.select(stems, id), expected));
+		ASSERT_TRUE(same_selection(rebuilt.select(stems, id), expected));
+	}
+	ASSERT_EQ(index.select(stems, 4).size(), 0);
+}
+
+TEST(creator_index_keeps_sibling_functions_independent)
+{
+	auto get_second_twigs = [](const float first_density)
+	{
+		auto trunk = std::make_shared<TrunkFunction>();
+		auto branch = std::make_shared<BranchFunction>();
+		auto first_twig = std::make_shared<BranchFunction>();
+		auto second_twig = std::make_shared<BranchFunction>();
+		first_twig->distribution->density = first_density;
+		trunk->add_child(branch);
+		branch->add_child(first_twig);
+		branch->add_child(second_twig);
+		Tree tree(trunk);
+		tree.execute_functions();
+		std::vector<Vector3> positions;
+		for (auto& twig : NodeUtilities::select_from_tree(tree.get_stems(), 3))
+			for (auto& element : twig)
+				positions.push_back(element.node_position);
+		return positions;
+	};
+	std::vector<Vector3> positions = get_second_twigs(2);
+	ASSERT_GT(positions.size(), 0);
+	// the twigs of the second function don't depend on the ones of its sibling
+	ASSERT_TRUE(get_second_twigs(5) == positions);
+}
+
+// =====================================================================
+// Forest builder tests
+// =====================================================================
+
+TEST(forest_builder_deterministic_across_threads)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	branch->randomness = RandomProperty{.2f, .6f};
+	trunk->add_child(branch);
+
+	std::vector<ForestItem> items;
+	for (int i = 0; i < 6; i++)
+		items.push_back({.seed = i, .position = Vector3{i * 10.f, 0, 0}, .rotation = i * .5f});
+	ManifoldMesher mesher;
+	mesher.smooth_iterations = 0;
+
+	ForestBuilder forest(trunk);
+	forest.threads = 1;
+	std::vector<Mesh> serial = forest.build(items, mesher);
+	forest.threads = 4;
+	std::vector<Mesh> parallel = forest.build(items, mesher);
+
+	ASSERT_EQ(serial.size(), items.size());
+	for (size_t i = 0; i < items.size(); i++)
+		ASSERT_TRUE(serial[i].vertices == parallel[i].vertices);
+	ASSERT_TRUE(serial[0].vertices != serial[1].vertices);
+
+	// an unplaced item with seed 0 grows the template tree
+	Tree tree(trunk->clone());
+	tree.execute_functions();
+	ASSERT_TRUE(mesher.mesh_tree(tree).vertices == serial[0].vertices);
+}
+
+// Mesher recording the largest thread count it was run with
+struct ThreadRecordingMesher
+{
+	int threads = 8;
+	std::shared_ptr<std::atomic<int>> max_threads = std::make_shared<std::atomic<int>>(0);
+
+	Mesh mesh_tree(Tree&)
+	{
+		int seen = max_threads->load();
+		while (seen < threads && !max_threads->compare_exchange_weak(seen, threads))
+			;
+		return Mesh{};
+	}
+};
+
+TEST(forest_builder_runs_trees_single_threaded)
+{
+	ExecutionContext context;
+	ASSERT_EQ(context.get_threads(0), 0);
+	ASSERT_EQ(context.get_threads(4), 4);
+	context.max_threads = 1;
+	ASSERT_EQ(context.get_threads(0), 1);
+	ASSERT_EQ(context.get_threads(4), 1);
+
+	auto trunk = std::make_shared<TrunkFunction>();
+	ForestBuilder forest(trunk);
+	forest.threads = 2;
+	ThreadRecordingMesher mesher;
+	forest.build(std::vector<ForestItem>(4), mesher);
+	ASSERT_EQ(mesher.max_threads->load(), 1);
+	ASSERT_EQ(mesher.threads, 8);
+}
+
+TEST(forest_builder_places_trees)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	ForestItem item{.position = Vector3{5, -3, 1}, .rotation = 1.f, .scale = 2};
+	Tree tree;
+	ForestBuilder(trunk).build_tree(tree, item);
+
+	Tree reference(trunk);
+	reference.execute_functions();
+	NodeArena& placed = tree.get_arena();
+	NodeArena& original = reference.get_arena();
+	ASSERT_EQ(placed.size(), original.size());
+	int last = placed.size() - 1;
+	ASSERT_TRUE(placed.position[0].isApprox(item.position));
+	ASSERT_TRUE(std::abs(placed[last].length - original[last].length * 2) < 1e-5f);
+	ASSERT_TRUE(std::abs(placed[last].direction.z() - original[last].direction.z()) < 1e-5f);
+	float placed_height = placed.position[last].z() - item.position.z();
+	ASSERT_TRUE(std::abs(placed_height - original.position[last].z() * 2) < 1e-4f);
+}
+
+// =====================================================================
+// Random generator tests
+// =====================================================================
+
+TEST(random_generator_counter_based_streams)
+{
+	RandomGenerator a;
+	a.set_seed(7);
+	RandomGenerator b = a;
+	float sum = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		float value = a.get_0_1();
+		ASSERT_TRUE(value >= 0 && value < 1);
+		ASSERT_TRUE(value == b.get_0_1());
+		sum += value;
+	}
+	ASSERT_TRUE(std::abs(sum / 1000 - .5f) < .05f);
+
+	// derived streams only depend on the parent key, not on what was drawn from it
+	RandomGenerator fresh;
+	fresh.set_seed(7);
+	ASSERT_TRUE(a.derive(3).get_0_1() == fresh.derive(3).get_0_1());
+	ASSERT_TRUE(fresh.derive(3).get_0_1() != fresh.derive(4).get_0_1());
+}
+
+TEST(random_properties_reproducible_between_executions)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	branch->length = RandomProperty{4, 9};
+	branch->start_angle = RandomProperty{20, 70};
+	trunk->add_child(branch);
+	Tree tree(trunk);
+	tree.execute_functions();
+	std::vector<Vector3> first = mesh_vertices(tree);
+	tree.execute_functions();
+	ASSERT_TRUE(mesh_vertices(tree) == first);
+}
+
+struct SquareProperty : Property
+{
+	float execute(float x, RandomGenerator&) const override { return x * x; }
+	void hash(Fingerprint& fingerprint) const override { fingerprint.add(3); }
+	std::shared_ptr<Property> clone() const override
+	{
+		return std::make_shared<SquareProperty>(*this);
+	}
+};
+
+TEST(property_batches_match_single_evaluations)
+{
+	std::vector<PropertyWrapper> properties{
+	    PropertyWrapper{ConstantProperty{2}}, PropertyWrapper{RandomProperty{1, 3}},
+	    PropertyWrapper{SimpleCurveProperty{.2f, .8f, 1, 5, 2.5f}},
+	    PropertyWrapper{SimpleCurveProperty{0, 1, 3, -1, 1}}, PropertyWrapper{SquareProperty{}}};
+	std::vector<float> xs;
+	for (int i = 0; i <= 20; i++)
+		xs.push_back(i / 20.f - .1f);
+
+	for (PropertyWrapper& property : properties)
+	{
+		RandomGenerator base;
+		base.set_seed(3);
+		std::vector<RandomGenerator> batch_gens;
+		for (size_t i = 0; i < xs.size(); i++)
+			batch_gens.push_back(base.derive(i));
+		std::vector<float> out(xs.size());
+		property.execute_batch(xs, out, batch_gens);
+		for (size_t i = 0; i < xs.size(); i++)
+		{
+			RandomGenerator generator = base.derive(i);
+			ASSERT_TRUE(out[i] == property.execute(xs[i], generator));
+			// the streams advance as they would with single evaluations
+			ASSERT_TRUE(batch_gens[i].get_0_1() == generator.get_0_1());
+		}
+	}
+}
+
+TEST(branch_parallel_growth_matches_serial)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	branch->distribution->density = 8;
+	branch->split->probability = 1;
+	trunk->add_child(branch);
+
+	Tree tree(trunk);
+	tree.execute_functions();
+	std::vector<Vector3> serial = mesh_vertices(tree);
+	branch->threads = 4;
+	tree.execute_functions();
+	ASSERT_GT(serial.size(), 0u);
+	ASSERT_TRUE(mesh_vertices(tree) == serial);
+}
+
+// =====================================================================
+// Traversal tests
+// =====================================================================
+
+static void collect_pre_order_rec(Node& node, std::vector<Node*>& nodes)
+{
+	nodes.push_back(&node);
+	for (auto& child : node.children)
+		collect_pre_order_rec(child->node, nodes);
+}
+
+TEST(traversals_match_recursive_order)
+{
+	Tree tree = make_branching_tree();
+	Node& root = tree.get_stems()[0].node;
+	std::vector<Node*> expected;
+	collect_pre_order_rec(root, expected);
+
+	std::vector<Node*> pre_order;
+	NodeUtilities::visit_pre_order(root, [&](Node& node) { pre_order.push_back(&node); });
+	ASSERT_TRUE(pre_order == expected);
+
+	std::vector<Node*> post_order;
+	NodeUtilities::visit_post_order(root, [&](Node& node) { post_order.push_back(&node); });
+	ASSERT_EQ(post_order.size(), expected.size());
+	ASSERT_TRUE(post_order.back() == &root);
+
+	// depth propagated top-down, subtree sizes folded bottom-up
+	int max_depth = 0;
+	NodeUtilities::visit_pre_order(root, 0,
+	                               [&](Node& node, int depth, auto&& visit_child)
+	                               {
+		                               max_depth = std::max(max_depth, depth);
+		                               for (auto& child : node.children)
+			                               visit_child(child->node, depth + 1);
+	                               });
+	ASSERT_GT(max_depth, 0);
+	int size = NodeUtilities::fold_post_order<int>(root,
+	                                               [](Node&, std::span<const int> child_sizes)
+	                                               {
+		                                               int size = 1;
+		                                               for (int child_size : child_sizes)
+			                                               size += child_size;
+		                                               return size;
+	                                               });
+	ASSERT_EQ(size, (int)expected.size());
+}
+
+TEST(traversals_handle_long_chains)
+{
+	// far deeper than a recursive walk (or release) of the chain could go
+	const int length = 200000;
+	Node root{Vector3{0, 0, 1}, Vector3{1, 0, 0}, 1, 1, 0};
+	Node* tip = &root;
+	for (int i = 0; i < length; i++)
+	{
+		tip->children.push_back(std::make_shared<NodeChild>(
+		    NodeChild{Node{Vector3{0, 0, 1}, Vector3{1, 0, 0}, 1, 1, 0}, 1}));
+		tip = &tip->children.back()->node;
+	}
+	std::vector<Stem> stems{Stem{std::move(root), Vector3{0, 0, 0}}};
+
+	auto selection = NodeUtilities::select_from_tree(stems, 0);
+	ASSERT_EQ(selection.size(), 1u);
+	ASSERT_EQ((int)selection[0].size(), length + 1);
+	ASSERT_TRUE(selection[0].back().node_position.isApprox(Vector3{0, 0, (float)length}));
+	int count = NodeUtilities::fold_post_order<int>(
+	    stems[0].node, [](Node&, std::span<const int> children)
+	    { return 1 + (children.empty() ? 0 : children[0]); });
+	ASSERT_EQ(count, length + 1);
+}
+
+TEST(arena_sweeps_follow_hierarchy)
+{
+	Tree tree = make_branching_tree();
+	NodeArena& arena = tree.get_arena();
+
+	// bottom-up: every node is visited after its descendants
+	std::vector<int> subtree_sizes(arena.size(), 1);
+	arena.sweep_up(
+	    [&](const int i)
+	    {
+		    if (arena.parent[i] != NodeArena::none)
+			    subtree_sizes[arena.parent[i]] += subtree_sizes[i];
+	    });
+	for (int i = 0; i < arena.size(); i++)
+		ASSERT_EQ(subtree_sizes[i], arena.subtree_size(i));
+
+	// top-down: bending every node keeps the positions consistent with a rebuilt arena
+	Eigen::Matrix3f bend;
+	bend = Eigen::AngleAxisf(.05f, Vector3{1, 0, 0});
+	arena.sweep_down(Eigen::Matrix3f::Identity().eval(),
+	                 [&](const int i, const Eigen::Matrix3f& rotation)
+	                 {
+		                 Eigen::Matrix3f node_rotation = rotation * bend;
+		                 arena[i].direction = (node_rotation * arena[i].direction).normalized();
+		                 return node_rotation;
+	                 });
+	std::vector<Vector3> swept = arena.position;
+	tree.update_arena();
+	for (int i = 0; i < arena.size(); i++)
+		ASSERT_TRUE(swept[i].isApprox(arena.position[i], 1e-4f));
+}
+
+TEST(arena_split_partitions_subtrees)
+{
+	Tree tree = make_branching_tree();
+	NodeArena& arena = tree.get_arena();
+	const int grain = 8;
+	NodeArena::Split split = arena.split(grain);
+	ASSERT_GT(split.top.size(), 0u);
+	ASSERT_GT(split.subtrees.size(), 1u);
+
+	// every node is in exactly one part, subtrees hang from the top part
+	std::vector<int> part_of(arena.size(), -1);
+	for (int i : split.top)
+	{
+		ASSERT_GT(arena.subtree_size(i), grain);
+		part_of[i] = 0;
+	}
+	for (size_t s = 0; s < split.subtrees.size(); s++)
+	{
+		int root = split.subtrees[s];
+		ASSERT_LE(arena.subtree_size(root), grain);
+		ASSERT_TRUE(arena.parent[root] == NodeArena::none || part_of[arena.parent[root]] == 0);
+		for (int i = root; i < arena.subtree_end[root]; i++)
+		{
+			ASSERT_EQ(part_of[i], -1);
+			part_of[i] = (int)s + 1;
+		}
+	}
+	for (int i = 0; i < arena.size(); i++)
+		ASSERT_TRUE(part_of[i] != -1);
+
+	// the parallel sweeps keep the order of their serial counterparts on every node
+	std::vector<std::atomic<int>> subtree_sizes(arena.size());
+	arena.parallel_sweep_up(
+	    split,
+	    [&](const int i, const int part)
+	    {
+		    ASSERT_EQ(part, part_of[i]);
+		    subtree_sizes[i] += 1;
+		    if (arena.parent[i] != NodeArena::none)
+			    subtree_sizes[arena.parent[i]] += subtree_sizes[i];
+	    },
+	    4);
+	std::vector<int> depths(arena.size(), -1);
+	arena.parallel_sweep_down(
+	    split,
+	    [&](const int i, const int)
+	    {
+		    int parent = arena.parent[i];
+		    ASSERT_TRUE(parent == NodeArena::none || depths[parent] >= 0);
+		    depths[i] = parent == NodeArena::none ? 0 : depths[parent] + 1;
+	    },
+	    4);
+	for (int i = 0; i < arena.size(); i++)
+	{
+		ASSERT_EQ(subtree_sizes[i].load(), arena.subtree_size(i));
+		ASSERT_GE(depths[i], 0);
+	}
+}
+
+TEST(segment_index_matches_brute_force)
+{
+	Tree tree = make_branching_tree();
+	SegmentIndex index;
+	index.build(tree.get_arena());
+	ASSERT_EQ(index.size(), tree.get_arena().size());
+
+	RandomGenerator rand_gen;
+	rand_gen.set_seed(7);
+	for (int query = 0; query < 50; query++)
+	{
+		Vector3 point = Geometry::random_vec(rand_gen) * 2 + Vector3{0, 0, 5 * rand_gen.get_0_1()};
+		float radius = .5f * rand_gen.get_0_1();
+
+		std::vector<int> expected;
+		SegmentIndex::Hit closest;
+		for (int i = 0; i < index.size(); i++)
+		{
+			float distance = SegmentIndex::distance_to_segment(point, index.get_segment(i));
+			if (distance <= radius)
+				expected.push_back(i);
+			if (distance < closest.distance)
+				closest = SegmentIndex::Hit{i, distance};
+		}
+		std::vector<int> found = index.query_radius(point, radius);
+		std::sort(found.begin(), found.end());
+		ASSERT_TRUE(found == expected);
+		ASSERT_TRUE(std::abs(index.nearest(point).distance - closest.distance) < 1e-6f);
+
+		// a ray aimed at a segment stops at the first capsule it meets, never beyond the target
+		const SegmentIndex::Segment& target = index.get_segment(query % index.size());
+		if (target.radius < 1e-3f)
+			continue;
+		Vector3 origin = point + Vector3{0, 0, 30};
+		Vector3 direction = ((target.start + target.end) / 2 - origin).normalized();
+		SegmentIndex::Hit hit = index.raycast(origin, direction);
+		ASSERT_TRUE(hit.is_valid());
+		ASSERT_TRUE(hit.distance <= ((target.start + target.end) / 2 - origin).norm());
+		Vector3 hit_point = origin + direction * hit.distance;
+		ASSERT_LE(SegmentIndex::distance_to_segment(hit_point, index.get_segment(hit.segment)),
+		          1e-3f);
+		for (int i = 0; i < index.size(); i++)
+			ASSERT_TRUE(SegmentIndex::distance_to_segment(origin + direction * hit.distance * .999f,
+			                                              index.get_segment(i)) > 0);
+	}
+	ASSERT_TRUE(!index.raycast(Vector3{0, 0, 100}, Vector3{0, 0, 1}).is_valid());
+}
+
+TEST(branch_function_avoids_older_branches)
+{
+	auto make_tree = [](const float collision_avoidance)
+	{
+		auto trunk = std::make_shared<TrunkFunction>();
+		auto branch = std::make_shared<BranchFunction>();
+		branch->collision_avoidance = collision_avoidance;
+		trunk->add_child(branch);
+		Tree tree(trunk);
+		tree.execute_functions();
+		return tree;
+	};
+	Tree trunk_only(std::make_shared<TrunkFunction>());
+	trunk_only.execute_functions();
+	SegmentIndex trunk;
+	trunk.build(trunk_only.get_arena());
+
+	// nodes of the branches grown close to the trunk, the first node of a branch starts on it
+	auto count_close_nodes = [&](Tree& tree)
+	{
+		NodeArena& arena = tree.get_arena();
+		int trunk_id = arena[arena.roots[0]].creator_id;
+		int count = 0;
+		for (int i = 0; i < arena.size(); i++)
+		{
+			int parent = arena.parent[i];
+			if (arena[i].creator_id == trunk_id || arena[parent].creator_id == trunk_id)
+				continue;
+			Vector3 end = arena.position[i] + arena[i].direction * arena[i].length;
+			count += trunk.nearest(end, .2f).is_valid();
+		}
+		return count;
+	};
+	Tree plain = make_tree(0);
+	Tree avoiding = make_tree(4);
+	ASSERT_EQ(plain.get_arena().size(), make_branching_tree().get_arena().size());
+	ASSERT_GT(count_close_nodes(plain), count_close_nodes(avoiding));
+}
+
+TEST(shadow_grid_shades_below)
+{
+	ShadowGrid grid{1, .3f, 2, 3};
+	Vector3 bud{.5f, .5f, 5.5f};
+	grid.add_shadow(bud);
+	ASSERT_EQ(grid.get_exposure(bud), 1.f);                 // no self shading
+	ASSERT_EQ(grid.get_exposure(bud + Vector3{0, 0, 1}), 1.f); // light comes from above
+	float below = grid.get_exposure(bud - Vector3{0, 0, 1});
+	float further = grid.get_exposure(bud - Vector3{0, 0, 3});
+	ASSERT_TRUE(below < further && further < 1);
+	ASSERT_EQ(grid.get_exposure(bud - Vector3{0, 0, 4}), 1.f); // beyond the shadow depth
+	ASSERT_EQ(grid.get_exposure(bud + Vector3{-3, 2, -3}), further); // the pyramid widens
+	for (int i = 0; i < 10; i++)
+		grid.add_shadow(bud);
+	ASSERT_EQ(grid.get_exposure(bud - Vector3{0, 0, 1}), 0.f);
+}
+
+TEST(growth_shadows_are_deterministic)
+{
+	auto build = [](bool enable_shadows)
+	{
+		auto trunk = std::make_shared<TrunkFunction>();
+		auto growth = std::make_shared<GrowthFunction>();
+		growth->iterations = 6;
+		growth->enable_shadows = enable_shadows;
+		trunk->add_child(growth);
+		Tree tree(trunk);
+		tree.execute_functions();
+		return mesh_vertices(tree);
+	};
+	std::vector<Vector3> shaded = build(true);
+	ASSERT_TRUE(shaded == build(true));
+	ASSERT_TRUE(shaded != build(false));
+}
+
+TEST(growth_parallel_matches_serial)
+{
+	for (bool enable_shadows : {false, true})
+	{
+		auto trunk = std::make_shared<TrunkFunction>();
+		auto branch = std::make_shared<BranchFunction>();
+		auto growth = std::make_shared<GrowthFunction>();
+		growth->enable_shadows = enable_shadows;
+		growth->enable_flowering = true;
+		trunk->add_child(branch);
+		branch->add_child(growth);
+		Tree tree(trunk);
+		tree.execute_functions();
+		ASSERT_GT(NodeUtilities::count_nodes(tree.get_stems()), 4 * GrowthConstants::kSubtreeGrain);
+		std::vector<Vector3> serial = mesh_vertices(tree);
+		growth->threads = 4;
+		tree.execute_functions();
+		ASSERT_TRUE(mesh_vertices(tree) == serial);
+	}
+}
+
+TEST(growth_snapshots_restore_and_resume_previews)
+{
+	auto build = [](int preview_iteration, bool cache_iterations)
+	{
+		auto trunk = std::make_shared<TrunkFunction>();
+		auto growth = std::make_shared<GrowthFunction>();
+		growth->iterations = 6;
+		growth->preview_iteration = preview_iteration;
+		growth->enable_shadows = true;
+		growth->cache_iterations = cache_iterations;
+		trunk->add_child(growth);
+		Tree tree(trunk);
+		tree.execute_functions();
+		return mesh_vertices(tree);
+	};
+	std::vector<std::vector<Vector3>> expected;
+	for (int preview = 0; preview <= 6; preview++)
+		expected.push_back(build(preview, false));
+
+	GrowthSnapshotCache& cache = GrowthSnapshotCache::get_global();
+	cache.clear();
+	ASSERT_TRUE(build(2, true) == expected[2]); // grows iterations 0 to 2
+	ASSERT_EQ(cache.get_hit_count(), 0);
+	ASSERT_TRUE(build(5, true) == expected[5]); // carries on from iteration 2
+	ASSERT_TRUE(build(-1, true) == expected[6]);
+	for (int preview = 0; preview <= 6; preview++)
+		ASSERT_TRUE(build(preview, true) == expected[preview]); // every iteration is restored
+	ASSERT_EQ(cache.get_hit_count(), 7);
+
+	// the cap bounds the memory, the evicted iterations are grown again
+	size_t memory = cache.get_memory_usage();
+	ASSERT_GT(memory, 0u);
+	cache.set_memory_cap(memory / 4);
+	ASSERT_LE(cache.get_memory_usage(), memory / 4);
+	ASSERT_TRUE(build(0, true) == expected[0]);
+	ASSERT_TRUE(build(6, true) == expected[6]);
+	cache.set_memory_cap(256 << 20);
+	cache.clear();
+}
+
+TEST(leaves_function_emits_instances)
+{
+	Tree tree = make_branching_tree();
+	NodeArena& arena = tree.get_arena();
+	LeavesFunction leaves;
+	leaves.max_radius = .1f;
+	leaves.template_count = 3;
+	std::vector<LeafInstance> instances = leaves.execute(tree);
+	ASSERT_GT((int)instances.size(), 0);
+
+	float carrying_length = 0;
+	for (int i = 0; i < arena.size(); i++)
+		if (arena[i].radius <= leaves.max_radius)
+			carrying_length += arena[i].length;
+	ASSERT_TRUE(std::abs(instances.size() - carrying_length * leaves.density) <
+	            .1f * carrying_length * leaves.density + 5);
+
+	for (const LeafInstance& instance : instances)
+	{
+		const Node& node = arena[instance.node];
+		ASSERT_LE(node.radius, leaves.max_radius);
+		ASSERT_TRUE(instance.template_id >= 0 && instance.template_id < 3);
+		ASSERT_TRUE(std::abs(instance.rotation.norm() - 1) < 1e-4f);
+		// the leaf sits on the bark of its node
+		Vector3 origin = arena.position[instance.node];
+		float along = (instance.position - origin).dot(node.direction);
+		ASSERT_TRUE(along >= -1e-4f && along <= node.length + 1e-4f);
+		float bark = (instance.position - origin - node.direction * along).norm();
+		ASSERT_TRUE(std::abs(bark - node.radius) < 1e-4f);
+	}
+
+	leaves.threads = 4;
+	std::vector<LeafInstance> threaded = leaves.execute(tree);
+	ASSERT_EQ(threaded.size(), instances.size());
+	ASSERT_TRUE(std::memcmp(threaded.data(), instances.data(),
+	                        instances.size() * sizeof(LeafInstance)) == 0);
+}
+
+// Edges shared by more than two polygons, none on a manifold mesh
+static int count_overshared_edges(const Mesh& mesh)
+{
+	std::map<std::pair<int, int>, int> edges;
+	for (const auto& polygon : mesh.polygons)
+	{
+		int corners = polygon[2] == polygon[3] ? 3 : 4;
+		for (int k = 0; k < corners; k++)
+		{
+			int a = polygon[k];
+			int b = polygon[(k + 1) % corners];
+			edges[{std::min(a, b), std::max(a, b)}]++;
+		}
+	}
+	int count = 0;
+	for (const auto& [edge, polygons] : edges)
+		count += polygons > 2;
+	return count;
+}
+
+TEST(mesher_adaptive_resolution_reduces_thin_branches)
+{
+	Tree tree = make_branching_tree();
+	ManifoldMesher mesher;
+	mesher.radial_resolution = 16;
+	Mesh full = mesher.mesh_tree(tree);
+
+	mesher.adaptive_resolution = true;
+	mesher.resolution_tolerance = .01f;
+	MeshCounts predicted = mesher.predict_counts(tree);
+	Mesh adaptive = mesher.mesh_tree(tree);
+	ASSERT_GT(full.vertices.size(), adaptive.vertices.size());
+	ASSERT_EQ(predicted.vertices, static_cast<int>(adaptive.vertices.size()));
+	ASSERT_EQ(predicted.uvs, static_cast<int>(adaptive.uvs.size()));
+	ASSERT_EQ(predicted.polygons, static_cast<int>(adaptive.polygons.size()));
+	int triangles = 0;
+	for (const auto& polygon : adaptive.polygons)
+	{
+		for (int index : polygon)
+			ASSERT_TRUE(index >= 0 && index < static_cast<int>(adaptive.vertices.size()));
+		ASSERT_TRUE(polygon[0] != polygon[1] && polygon[1] != polygon[2]);
+		triangles += polygon[2] == polygon[3];
+	}
+	ASSERT_GT(triangles, 0);
+
+	std::vector<Mesh> lods = mesher.mesh_tree_lods(tree, {0, .01f, .1f});
+	ASSERT_EQ(lods.size(), size_t(3));
+	ASSERT_EQ(lods[0].vertices.size(), full.vertices.size());
+	ASSERT_TRUE(lods[1].vertices == adaptive.vertices && lods[1].polygons == adaptive.polygons);
+	ASSERT_GE(lods[1].vertices.size(), lods[2].vertices.size());
+	mesher.resolution_tolerance = .1f;
+	Mesh coarse = mesher.mesh_tree(tree);
+	ASSERT_TRUE(lods[2].vertices == coarse.vertices && lods[2].uvs == coarse.uvs);
+	ASSERT_TRUE(lods[2].polygons == coarse.polygons && lods[2].uv_loops == coarse.uv_loops);
+	for (const Mesh* mesh : {&full, &adaptive, &coarse})
+		ASSERT_EQ(count_overshared_edges(*mesh), 0);
+}
+
+TEST(mesher_adaptive_resolution_reduces_branch_carrying_nodes)
+{
+	// the twigs sit on the first node of the trunk, right above its start circle
+	Tree tree = make_mirrored_twigs_tree();
+	Node& trunk = tree.get_stems()[0].node;
+	Node& carrier = trunk.children[0]->node;
+	trunk.children.insert(trunk.children.end(), carrier.children.begin() + 1,
+	                      carrier.children.end());
+	carrier.children.resize(1);
+	ManifoldMesher mesher;
+	mesher.radial_resolution = 16;
+	mesher.smooth_iterations = 0;
+	mesher.adaptive_resolution = true;
+	mesher.resolution_tolerance = 1;
+	Mesh mesh = mesher.mesh_tree(tree);
+
+	// vertices of the circle ending the first node
+	float end_radius = carrier.radius;
+	int end_circle_count = 0;
+	for (const Vector3& vertex : mesh.vertices)
+	{
+		bool on_circle = std::abs(vertex.z() - trunk.length) < 1e-4f &&
+		                 std::abs(vertex.head<2>().norm() - end_radius) < 1e-4f;
+		end_circle_count += on_circle;
+	}
+	ASSERT_EQ(end_circle_count, mesher.min_radial_resolution);
+	ASSERT_EQ(count_overshared_edges(mesh), 0);
+	ASSERT_EQ(mesher.predict_counts(tree).vertices, (int)mesh.vertices.size());
+}
+
+TEST(simplify_merges_straight_runs)
+{
+	Tree tree = make_branching_tree();
+	NodeArena& arena = tree.get_arena();
+	// absolute positions of the side branches and tips, their nodes survive the simplification
+	std::vector<std::pair<const Node*, Vector3>> kept;
+	for (int i = 0; i < arena.size(); i++)
+	{
+		int parent = arena.parent[i];
+		bool side = parent != NodeArena::none && arena.child_rank[i] > 0;
+		if (side || arena.is_leaf(i))
+			kept.push_back({&arena[i], arena.position[i]});
+	}
+	int node_count = arena.size();
+
+	SimplifyFunction simplify;
+	simplify.angle_tolerance = 5;
+	simplify.radius_tolerance = .1f;
+	ExecutionContext context;
+	simplify.execute(tree.get_stems(), context, 0, 0);
+	tree.update_arena();
+	ASSERT_GT(node_count, arena.size());
+
+	std::unordered_map<const Node*, int> indices;
+	for (int i = 0; i < arena.size(); i++)
+		indices[&arena[i]] = i;
+	float shift = 0;
+	for (const auto& [node, position] : kept)
+	{
+		ASSERT_TRUE(indices.count(node) == 1);
+		shift = std::max(shift, (arena.position[indices[node]] - position).norm());
+	}
+	ASSERT_LE(shift, .25f);
+
+	ManifoldMesher mesher;
+	Mesh mesh = mesher.mesh_tree(tree);
+	ASSERT_GT(mesh.vertices.size(), size_t(0));
+}
+
+// =====================================================================
+// Mesh sink tests
+// =====================================================================
+
+template <typename T> static bool same_bytes(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+static bool same_mesh(const Mesh& a, const Mesh& b)
+{
+	if (!same_bytes(a.vertices, b.vertices) || !same_bytes(a.uvs, b.uvs) ||
+	    !same_bytes(a.polygons, b.polygons) || !same_bytes(a.uv_loops, b.uv_loops) ||
+	    !same_bytes(a.triangles, b.triangles) || !same_bytes(a.uv_triangles, b.uv_triangles) ||
+	    !same_bytes(a.normals, b.normals) || a.attributes.size() != b.attributes.size())
+		return false;
+	for (auto& [name, attribute] : a.attributes)
+	{
+		auto it = b.attributes.find(name);
+		if (it == b.attributes.end() || it->second->size() != attribute->size() ||
+		    std::memcmp(it->second->get_raw_data(), attribute->get_raw_data(),
+		                attribute->size() * attribute->get_element_size()) != 0)
+			return false;
+	}
+	return true;
+}
+
+TEST(mesh_sinks_stream_the_same_mesh)
+{
+	Tree tree = make_branching_tree();
+	// stems share nothing, copies sharing their nodes are enough to get several chunks
+	Stem stem = tree.get_stems()[0];
+	for (int i = 1; i < 3; i++)
+	{
+		stem.position = Vector3{i * 4.f, 0, 0};
+		tree.get_stems().push_back(stem);
+	}
+	ManifoldMesher mesher;
+	Mesh reference = mesher.mesh_tree(tree);
+
+	// one stem per chunk
+	mesher.chunk_vertices = (int)reference.vertices.size() / 3;
+	MeshBuilderSink builder;
+	mesher.stream_tree(tree, builder);
+	ASSERT_TRUE(same_mesh(reference, builder.mesh));
+
+	std::string path = (std::filesystem::temp_directory_path() / "mtree_sink_test.bin").string();
+	BinaryFileSink file{path};
+	mesher.stream_tree(tree, file);
+	ASSERT_TRUE(same_mesh(reference, BinaryFileSink::read_mesh(path)));
+	std::filesystem::remove(path);
+
+	MeshCounts counts = mesher.predict_counts(tree);
+	std::vector<float> vertices(counts.vertices * 3);
+	std::vector<int> polygons(counts.polygons * 4);
+	std::vector<float> radius(counts.vertices);
+	BufferSink buffers;
+	buffers.capacity = counts;
+	buffers.vertices = vertices.data();
+	buffers.polygons = polygons.data();
+	buffers.attributes["radius"] = {radius.data(), sizeof(float)};
+	mesher.stream_tree(tree, buffers);
+	ASSERT_TRUE(std::memcmp(vertices.data(), reference.vertices.data(),
+	                        vertices.size() * sizeof(float)) == 0);
+	ASSERT_TRUE(std::memcmp(polygons.data(), reference.polygons.data(),
+	                        polygons.size() * sizeof(int)) == 0);
+	ASSERT_TRUE(same_bytes(radius, reference.get_attribute<float>("radius").data()));
+
+	buffers.capacity.polygons -= 1;
+	bool threw = false;
+	try
+	{
+		mesher.stream_tree(tree, buffers);
+	}
+	catch (const std::runtime_error&)
+	{
+		threw = true;
+	}
+	ASSERT_TRUE(threw);
+}
+
+// Builder sink recording the vertex count of every chunk and the largest chunk it was handed
+class ChunkRecordingSink : public MeshBuilderSink
+{
+  public:
+	std::vector<int> chunk_vertex_counts;
+	size_t peak_chunk_bytes = 0;
+
+	void write(const MeshChunk& chunk) override
+	{
+		ASSERT_EQ(chunk.vertex_offset, (int)mesh.vertices.size());
+		chunk_vertex_counts.push_back((int)chunk.mesh.vertices.size());
+		peak_chunk_bytes = std::max(peak_chunk_bytes, chunk.mesh.memory_footprint().total());
+		MeshBuilderSink::write(chunk);
+	}
+};
+
+TEST(mesh_stream_splits_stems)
+{
+	Tree tree = make_branching_tree();
+	ASSERT_EQ(tree.get_stems().size(), size_t(1));
+	tree.track_memory = true;
+	ManifoldMesher mesher;
+	mesher.smooth_iterations = 0;
+	mesher.chunk_vertices = 512;
+	ChunkRecordingSink sink;
+	mesher.stream_tree(tree, sink);
+	size_t stream_peak = tree.get_meshing_memory_peak();
+	Mesh reference = mesher.mesh_tree(tree);
+	ASSERT_GT(tree.get_meshing_memory_peak(), stream_peak);
+
+	ASSERT_GT(sink.chunk_vertex_counts.size(), size_t(1));
+	for (int count : sink.chunk_vertex_counts)
+	{
+		ASSERT_GT(count, 0);
+		ASSERT_LE(count, mesher.chunk_vertices);
+	}
+	ASSERT_GT(reference.memory_footprint().total(), sink.peak_chunk_bytes);
+	// chunks only differ from the whole mesh where they are smoothed or shaded apart
+	ASSERT_TRUE(same_mesh(reference, sink.mesh));
+
+	mesher.smooth_iterations = 4;
+	mesher.compute_normals = true;
+	Mesh smoothed = mesher.mesh_tree(tree);
+	ChunkRecordingSink smoothed_sink;
+	mesher.stream_tree(tree, smoothed_sink);
+	const Mesh& streamed = smoothed_sink.mesh;
+	ASSERT_TRUE(same_bytes(smoothed.polygons, streamed.polygons));
+	ASSERT_TRUE(same_bytes(smoothed.uv_loops, streamed.uv_loops));
+	ASSERT_TRUE(same_bytes(smoothed.uvs, streamed.uvs));
+	ASSERT_EQ(streamed.normals.size(), streamed.vertices.size());
+	float smoothing_shift = 0;
+	float stream_shift = 0;
+	for (size_t i = 0; i < smoothed.vertices.size(); i++)
+	{
+		smoothing_shift =
+		    std::max(smoothing_shift, (smoothed.vertices[i] - reference.vertices[i]).norm());
+		stream_shift = std::max(stream_shift, (smoothed.vertices[i] - streamed.vertices[i]).norm());
+	}
+	ASSERT_GT(smoothing_shift, 0);
+	ASSERT_LE(stream_shift, smoothing_shift);
+}
+
+TEST(mesh_sinks_carry_triangles)
+{
+	// a tree made of quads followed by a leaf made of triangles
+	Tree tree = make_branching_tree();
+	ManifoldMesher mesher;
+	Mesh tree_mesh = mesher.mesh_tree(tree);
+	Mesh leaf = LeafShapeGenerator().generate();
+	leaf.attributes.clear();
+	leaf.add_attribute<float>("radius").data.resize(leaf.vertices.size());
+	ASSERT_GT(static_cast<int>(leaf.triangles.size()), 0);
+
+	offset_indices(leaf, (int)tree_mesh.vertices.size(), (int)tree_mesh.uvs.size());
+	MeshBuilderSink builder;
+	builder.write(MeshChunk{tree_mesh, 0, 0, 0});
+	builder.write(MeshChunk{leaf, (int)tree_mesh.vertices.size(), (int)tree_mesh.uvs.size(),
+	                        (int)tree_mesh.polygons.size()});
+	ASSERT_EQ(builder.mesh.get_face_count(), tree_mesh.polygons.size() + leaf.triangles.size());
+	ASSERT_TRUE(builder.mesh.triangles == leaf.triangles);
+	ASSERT_TRUE(builder.mesh.uv_triangles == leaf.uv_triangles);
+
+	std::string path = (std::filesystem::temp_directory_path() / "mtree_triangles.bin").string();
+	BinaryFileSink file{path};
+	file.begin(MeshCounts{});
+	file.write(MeshChunk{builder.mesh, 0, 0, 0});
+	file.end();
+	ASSERT_TRUE(same_mesh(builder.mesh, BinaryFileSink::read_mesh(path)));
+	std::filesystem::remove(path);
+
+	path = (std::filesystem::temp_directory_path() / "mtree_triangles.mtree").string();
+	AssetFile::write(path, nullptr, &builder.mesh);
+	ASSERT_TRUE(same_mesh(builder.mesh, AssetFile{path}.read_mesh()));
+	std::filesystem::remove(path);
+
+	std::vector<int> triangles(leaf.triangles.size() * 3);
+	BufferSink buffers;
+	buffers.capacity.triangles = (int)leaf.triangles.size();
+	buffers.triangles = triangles.data();
+	buffers.write(MeshChunk{builder.mesh, 0, 0, 0, 0});
+	ASSERT_TRUE(std::memcmp(triangles.data(), leaf.triangles.data(),
+	                        triangles.size() * sizeof(int)) == 0);
+}
+
+TEST(mesh_sinks_carry_normals)
+{
+	Tree tree = make_branching_tree();
+	ManifoldMesher mesher;
+	mesher.compute_normals = true;
+	Mesh reference = mesher.mesh_tree(tree);
+	ASSERT_EQ(reference.normals.size(), reference.vertices.size());
+
+	// split stems are shaded chunk by chunk, a single chunk gives the normals of mesh_tree
+	mesher.chunk_vertices = (int)reference.vertices.size();
+	std::string path = (std::filesystem::temp_directory_path() / "mtree_normals.bin").string();
+	BinaryFileSink file{path};
+	mesher.stream_tree(tree, file);
+	ASSERT_TRUE(same_mesh(reference, BinaryFileSink::read_mesh(path)));
+	std::filesystem::remove(path);
+
+	path = (std::filesystem::temp_directory_path() / "mtree_normals.mtree").string();
+	AssetFile::write(path, nullptr, &reference);
+	{
+		AssetFile asset{path};
+		ASSERT_TRUE(asset.find("mesh.normals") != nullptr);
+		ASSERT_TRUE(same_mesh(reference, asset.read_mesh()));
+	}
+	std::filesystem::remove(path);
+
+	std::vector<float> normals(reference.vertices.size() * 3);
+	BufferSink buffers;
+	buffers.capacity = mesher.predict_counts(tree);
+	buffers.normals = normals.data();
+	mesher.stream_tree(tree, buffers);
+	ASSERT_TRUE(std::memcmp(normals.data(), reference.normals.data(),
+	                        normals.size() * sizeof(float)) == 0);
+}
+
+TEST(forest_stream_matches_build)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	trunk->add_child(std::make_shared<BranchFunction>());
+	std::vector<ForestItem> items{ForestItem{.seed = 1}, ForestItem{.seed = 2},
+	                              ForestItem{.seed = 3, .position = Vector3{5, 0, 0}}};
+	ForestBuilder forest{trunk};
+	forest.threads = 2;
+	ManifoldMesher mesher;
+	std::vector<Mesh> meshes = forest.build(items, mesher);
+
+	MeshBuilderSink builder;
+	forest.stream(items, mesher, builder);
+	int vertex_offset = 0;
+	int polygon_offset = 0;
+	for (const Mesh& mesh : meshes)
+	{
+		for (int i = 0; i < (int)mesh.polygons.size(); i++)
+			for (int corner = 0; corner < 4; corner++)
+				ASSERT_EQ(builder.mesh.polygons[polygon_offset + i][corner],
+				          mesh.polygons[i][corner] + vertex_offset);
+		vertex_offset += (int)mesh.vertices.size();
+		polygon_offset += (int)mesh.polygons.size();
+	}
+	ASSERT_EQ(vertex_offset, (int)builder.mesh.vertices.size());
+	ASSERT_EQ(polygon_offset, (int)builder.mesh.polygons.size());
+}
+
+TEST(asset_file_round_trip)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto growth = std::make_shared<GrowthFunction>();
+	growth->iterations = 3;
+	trunk->add_child(growth);
+	Tree tree(trunk);
+	tree.execute_functions();
+	ManifoldMesher mesher;
+	Mesh mesh = mesher.mesh_tree(tree);
+
+	std::string path = (std::filesystem::temp_directory_path() / "mtree_asset_test.mtree").string();
+	AssetFile::write(path, &tree.get_stems(), &mesh);
+	{
+		AssetFile file{path};
+		ASSERT_TRUE(file.has_stems() && file.has_mesh());
+		for (const auto& section : file.get_sections())
+		{
+			uintptr_t address = reinterpret_cast<uintptr_t>(section.data);
+			ASSERT_EQ(address % AssetFile::alignment, uintptr_t(0));
+		}
+		ASSERT_EQ(file.get<Vector3>("mesh.vertices").size(), mesh.vertices.size());
+		ASSERT_TRUE(same_mesh(mesh, file.read_mesh()));
+
+		Tree loaded;
+		loaded.get_stems() = file.read_stems();
+		loaded.update_arena();
+		ASSERT_EQ(loaded.get_node_count(), tree.get_node_count());
+		ASSERT_TRUE(same_mesh(mesh, mesher.mesh_tree(loaded)));
+		NodeArena& original = tree.get_arena();
+		NodeArena& copy = loaded.get_arena();
+		for (int i = 0; i < original.size(); i++)
+		{
+			ASSERT_EQ(original[i].creator_id, copy[i].creator_id);
+			ASSERT_TRUE(original[i].radius == copy[i].radius);
+			ASSERT_TRUE(original.position[i] == copy.position[i]);
+		}
+	}
+
+	{
+		std::ofstream{path, std::ios::binary} << "not an asset";
+	}
+	bool threw = false;
+	try
+	{
+		AssetFile file{path};
+	}
+	catch (const std::runtime_error&)
+	{
+		threw = true;
+	}
+	ASSERT_TRUE(threw);
+	std::filesystem::remove(path);
+}
+
+TEST(attribute_packing_half_and_snorm)
+{
+	for (float value : {0.f, 1.5f, -2.f, 65504.f, 0.000061035156f, 0.000000059604645f})
+		ASSERT_TRUE(half_to_float(float_to_half(value)) == value);
+	ASSERT_TRUE(std::isinf(half_to_float(float_to_half(70000.f))));
+	ASSERT_TRUE(std::isnan(half_to_float(float_to_half(std::nanf("")))));
+	// 2049 is halfway between two halves and rounds to the even one
+	ASSERT_TRUE(half_to_float(float_to_half(2049.f)) == 2048.f);
+	for (float value = -100; value < 100; value += .37f)
+		ASSERT_LE(std::abs(half_to_float(float_to_half(value)) - value),
+		          std::abs(value) / 1024 + 1e-7f);
+
+	Attribute<Vector3> directions{"direction"};
+	directions.data = {Vector3{1, 0, 0}, Vector3{-1, .5f, 0}, Vector3{0, 2, -3}};
+	PackedAttribute packed = pack_attribute(directions, PackedFormat::Snorm16);
+	ASSERT_EQ(packed.components, (uint32_t)3);
+	ASSERT_EQ(packed.data.size(), (size_t)18);
+	std::vector<float> values = unpack_scalars(packed.format, packed.data.data(), 9);
+	ASSERT_TRUE(values[0] == 1 && values[3] == -1 && values[7] == 1 && values[8] == -1);
+	ASSERT_LE(std::abs(values[4] - .5f), 1.f / 32767);
+
+	Attribute<float> ids{"stem_id"};
+	ids.data = {0, 3, 65535};
+	packed = pack_attribute(ids, PackedFormat::UInt16);
+	values = unpack_scalars(packed.format, packed.data.data(), 3);
+	ASSERT_TRUE(values[1] == 3 && values[2] == 65535);
+	ids.data.push_back(65536);
+	bool threw = false;
+	try
+	{
+		pack_attribute(ids, PackedFormat::UInt16);
+	}
+	catch (const std::runtime_error&)
+	{
+		threw = true;
+	}
+	ASSERT_TRUE(threw);
+}
+
+TEST(mesher_writes_requested_attributes)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	trunk->add_child(branch);
+	Tree tree(trunk);
+	tree.execute_functions();
+	ManifoldMesher mesher;
+	Mesh full = mesher.mesh_tree(tree);
+	ASSERT_EQ(full.attributes.size(), (size_t)8);
+
+	mesher.attributes = {ManifoldMesher::AttributeNames::stem_id,
+	                     ManifoldMesher::AttributeNames::pivot_position};
+	Mesh subset = mesher.mesh_tree(tree);
+	ASSERT_EQ(subset.attributes.size(), (size_t)2);
+	ASSERT_TRUE(subset.vertices == full.vertices);
+	for (const auto& name : mesher.attributes)
+	{
+		const auto& expected = *full.attributes[name];
+		const auto& actual = *subset.attributes[name];
+		ASSERT_EQ(actual.size(), expected.size());
+		ASSERT_TRUE(std::memcmp(actual.get_raw_data(), expected.get_raw_data(),
+		                        actual.size() * actual.get_element_size()) == 0);
+	}
+}
+
+TEST(asset_file_compact_attributes)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	trunk->add_child(branch);
+	Tree tree(trunk);
+	tree.execute_functions();
+	Mesh mesh = ManifoldMesher{}.mesh_tree(tree);
+
+	auto temp = std::filesystem::temp_directory_path();
+	std::string full_path = (temp / "mtree_full_attributes.mtree").string();
+	std::string compact_path = (temp / "mtree_compact_attributes.mtree").string();
+	AttributeFormats formats = ManifoldMesher::get_compact_attribute_formats();
+	AssetFile::write(full_path, nullptr, &mesh);
+	AssetFile::write(compact_path, nullptr, &mesh, &formats);
+	{
+		AssetFile full{full_path};
+		AssetFile compact{compact_path};
+		size_t full_bytes = 0;
+		size_t compact_bytes = 0;
+		for (const auto& section : full.get_sections())
+			if (section.name.rfind("attribute.", 0) == 0)
+				full_bytes += section.get_byte_size();
+		for (const auto& section : compact.get_sections())
+			if (section.name.rfind("attribute.", 0) == 0)
+				compact_bytes += section.get_byte_size();
+		ASSERT_EQ(compact_bytes * 2, full_bytes);
+
+		Mesh loaded = compact.read_mesh();
+		ASSERT_TRUE(loaded.vertices == mesh.vertices);
+		ASSERT_EQ(loaded.attributes.size(), mesh.attributes.size());
+		auto ids = loaded.get_attribute<float>(ManifoldMesher::AttributeNames::stem_id);
+		auto directions = loaded.get_attribute<Vector3>(ManifoldMesher::AttributeNames::direction);
+		auto radii = loaded.get_attribute<float>(ManifoldMesher::AttributeNames::radius);
+		auto original_ids = mesh.get_attribute<float>(ManifoldMesher::AttributeNames::stem_id);
+		auto original_directions =
+		    mesh.get_attribute<Vector3>(ManifoldMesher::AttributeNames::direction);
+		auto original_radii = mesh.get_attribute<float>(ManifoldMesher::AttributeNames::radius);
+		ASSERT_TRUE(ids.is_valid() && directions.is_valid() && radii.is_valid());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			ASSERT_TRUE(ids[i] == original_ids[i]);
+			ASSERT_LE((directions[i] - original_directions[i]).cwiseAbs().maxCoeff(), 1e-4f);
+			ASSERT_LE(std::abs(radii[i] - original_radii[i]), original_radii[i] / 1024);
+		}
+	}
+	std::filesystem::remove(full_path);
+	std::filesystem::remove(compact_path);
+}
+
+// Corner positions and uvs of every triangle of an interleaved mesh, sorted
+static std::vector<std::array<float, 15>> get_sorted_triangles(const InterleavedMesh& mesh)
+{
+	std::vector<std::array<float, 15>> triangles(mesh.indices.size() / 3);
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		const float* vertex = mesh.vertices.data() + (size_t)mesh.indices[i] * mesh.stride;
+		std::copy_n(vertex, 3, triangles[i / 3].data() + i % 3 * 5);
+		std::copy_n(vertex + 6, 2, triangles[i / 3].data() + i % 3 * 5 + 3);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+TEST(interleaved_mesh_welds_and_splits_seams)
+{
+	Tree tree = make_branching_tree();
+	Mesh mesh = ManifoldMesher{}.mesh_tree(tree);
+	std::vector<std::string> attributes{ManifoldMesher::AttributeNames::radius,
+	                                    ManifoldMesher::AttributeNames::direction};
+	InterleavedMesh plain = interleave_mesh(mesh, attributes, false);
+
+	ASSERT_EQ(plain.stride, 12u);
+	ASSERT_EQ(plain.layout.back().offset, 9u);
+	ASSERT_GT(plain.get_vertex_count(), mesh.vertices.size()); // uv seams split vertices
+	ASSERT_LE(plain.get_vertex_count(), mesh.polygons.size() * 4);
+	size_t corner = 0;
+	auto radii = mesh.get_attribute<float>(ManifoldMesher::AttributeNames::radius);
+	for (size_t i = 0; i < mesh.polygons.size(); i++)
+	{
+		const auto& polygon = mesh.polygons[i];
+		std::vector<int> order{0, 1, 2};
+		if (polygon[3] != polygon[2])
+			order.insert(order.end(), {0, 2, 3});
+		for (int k : order)
+		{
+			const float* vertex = plain.vertices.data() + plain.indices[corner++] * plain.stride;
+			ASSERT_TRUE(Vector3(vertex[0], vertex[1], vertex[2]) == mesh.vertices[polygon[k]]);
+			ASSERT_TRUE(Vector2(vertex[6], vertex[7]) == mesh.uvs[mesh.uv_loops[i][k]]);
+			ASSERT_TRUE(vertex[8] == radii[polygon[k]]);
+			ASSERT_TRUE(std::abs(Vector3(vertex[3], vertex[4], vertex[5]).norm() - 1) < 1e-4f);
+		}
+	}
+	ASSERT_EQ(corner, plain.indices.size());
+
+	bool threw = false;
+	try
+	{
+		interleave_mesh(mesh, {"missing"});
+	}
+	catch (const std::invalid_argument&)
+	{
+		threw = true;
+	}
+	ASSERT_TRUE(threw);
+}
+
+TEST(interleaved_mesh_optimizes_vertex_cache)
+{
+	Tree tree = make_branching_tree();
+	Mesh mesh = ManifoldMesher{}.mesh_tree(tree);
+	InterleavedMesh plain = interleave_mesh(mesh, {}, false);
+	InterleavedMesh optimized = interleave_mesh(mesh);
+
+	ASSERT_EQ(optimized.get_vertex_count(), plain.get_vertex_count());
+	ASSERT_TRUE(get_sorted_triangles(optimized) == get_sorted_triangles(plain));
+	float plain_ratio = get_average_cache_miss_ratio(plain.indices, plain.get_vertex_count());
+	float optimized_ratio =
+	    get_average_cache_miss_ratio(optimized.indices, optimized.get_vertex_count());
+	ASSERT_GT(plain_ratio, optimized_ratio);
+	ASSERT_LE(optimized_ratio, 0.8f);
+	// vertices are in first use order
+	uint32_t next = 0;
+	for (uint32_t index : optimized.indices)
+	{
+		ASSERT_LE(index, next);
+		next = std::max(next, index + 1);
+	}
+}
+
+TEST(pivot_painter_branches_match_mesher_attributes)
+{
+	Tree tree = make_branching_tree();
+	// a second stem, its branches continue the stem ids of the first one
+	std::vector<Stem> copies = NodeUtilities::copy_stems(tree.get_stems());
+	copies[0].position += Vector3{3, 0, 0};
+	tree.get_stems().push_back(std::move(copies[0]));
+	tree.update_arena();
+	ManifoldMesher mesher;
+	Mesh mesh = mesher.mesh_tree(tree);
+
+	PivotPainterBaker baker;
+	baker.threads = 4;
+	auto branches = baker.collect_branches(tree.get_stems());
+	ASSERT_GT(branches.size(), (size_t)4);
+	using Names = ManifoldMesher::AttributeNames;
+	auto stem_ids = mesh.get_attribute<float>(Names::stem_id).data();
+	auto from_mesh = baker.collect_branches(
+	    stem_ids, mesh.get_attribute<float>(Names::hierarchy_depth).data(),
+	    mesh.get_attribute<Vector3>(Names::pivot_position).data(),
+	    mesh.get_attribute<Vector3>(Names::direction).data(),
+	    mesh.get_attribute<float>(Names::branch_extent).data());
+	ASSERT_EQ(from_mesh.size(), branches.size());
+	for (size_t i = 0; i < branches.size(); i++)
+	{
+		ASSERT_EQ(branches[i].stem_id, (int)i);
+		ASSERT_EQ(from_mesh[i].stem_id, (int)i);
+		ASSERT_EQ(from_mesh[i].hierarchy_depth, branches[i].hierarchy_depth);
+		ASSERT_TRUE(from_mesh[i].pivot_position == branches[i].pivot_position);
+		ASSERT_TRUE(from_mesh[i].extent == branches[i].extent);
+		ASSERT_LE(std::abs(branches[i].x_vector.norm() - 1), 1e-5f);
+	}
+	ASSERT_EQ(branches[0].hierarchy_depth, 0);
+	ASSERT_GT(branches[1].hierarchy_depth, 0);
+}
+
+TEST(pivot_painter_bakes_textures_and_vertex_colors)
+{
+	std::vector<PivotPainterBranch> branches{
+	    {0, 0, Vector3{0, 0, 0}, Vector3{0, 0, 1}, 4},
+	    {1, 1, Vector3{1, 2, 3}, Vector3{1, 0, 0}, 2},
+	    {5, 2, Vector3{-1, .5f, 2}, Vector3{0, 1, 0}, 1}};
+	PivotPainterBaker baker;
+	baker.texture_size = 4;
+	std::vector<float> pivot_index(64, -1);
+	std::vector<float> xvector_extent(64, -1);
+	baker.bake_textures(branches, PackedFormat::Float32, pivot_index.data(),
+	                    xvector_extent.data());
+	// stem id 5 is the second texel of the second row
+	ASSERT_TRUE(pivot_index[20] == -1 && pivot_index[21] == .5f && pivot_index[23] == 2);
+	ASSERT_TRUE(xvector_extent[21] == 1 && xvector_extent[23] == 1);
+	ASSERT_TRUE(pivot_index[4] == 1 && pivot_index[7] == 1 && xvector_extent[7] == 2);
+	ASSERT_TRUE(pivot_index[8] == 0 && xvector_extent[11] == 0);
+
+	std::vector<uint16_t> halves(64);
+	std::vector<uint16_t> half_extents(64);
+	baker.bake_textures(branches, PackedFormat::Float16, halves.data(), half_extents.data());
+	for (size_t i = 0; i < halves.size(); i++)
+		ASSERT_TRUE(half_to_float(halves[i]) == pivot_index[i]);
+
+	std::vector<float> stem_ids{0, 1, 1, 5, 7};
+	std::vector<uint8_t> colors(stem_ids.size() * 4);
+	baker.bake_vertex_colors(branches, stem_ids, colors.data());
+	ASSERT_TRUE(colors[0] == 0 && colors[1] == 255 && colors[2] == 0 && colors[3] == 255);
+	ASSERT_TRUE(colors[4] == 128 && colors[5] == 128 && colors[6] == 158);
+	ASSERT_TRUE(colors[12] == 255 && colors[13] == 64);
+	ASSERT_TRUE(colors[16] == 0 && colors[17] == 0); // no branch of id 7
+
+	std::vector<float> uvs(stem_ids.size() * 2);
+	baker.bake_lookup_uvs(stem_ids, uvs.data());
+	ASSERT_TRUE(uvs[0] == .125f && uvs[1] == .125f);
+	ASSERT_TRUE(uvs[6] == .375f && uvs[7] == .375f);
+}
+
+static const Profiler::ReportEntry* find_entry(const std::vector<Profiler::ReportEntry>& report,
+                                              const std::string& path)
+{
+	for (const auto& entry : report)
+		if (entry.path == path)
+			return &entry;
+	return nullptr;
+}
+
+static double get_counter(const Profiler::ReportEntry& entry, const std::string& name)
+{
+	for (const auto& [counter, value] : entry.counters)
+		if (counter == name)
+			return value;
+	return -1;
+}
+
+TEST(profiler_reports_functions_and_meshing)
+{
+	auto trunk = std::make_shared<TrunkFunction>();
+	auto branch = std::make_shared<BranchFunction>();
+	auto growth = std::make_shared<GrowthFunction>();
+	growth->iterations = 3;
+	trunk->add_child(branch);
+	branch->add_child(growth);
+	Tree tree(trunk);
+	tree.execute_functions();
+	ASSERT_TRUE(tree.get_profiler().get_events().empty());
+
+	tree.profile = true;
+	tree.execute_functions();
+	ManifoldMesher mesher;
+	mesher.threads = 2;
+	Mesh mesh = mesher.mesh_tree(tree);
+	auto report = tree.get_profiler().get_report();
+
+	const auto* build = find_entry(report, "execute_functions");
+	const auto* trunk_entry = find_entry(report, "execute_functions/TrunkFunction");
+	const auto* branch_entry = find_entry(report, "execute_functions/TrunkFunction/BranchFunction");
+	const auto* iteration = find_entry(
+	    report, "execute_functions/TrunkFunction/BranchFunction/GrowthFunction/iteration");
+	ASSERT_TRUE(build != nullptr && trunk_entry != nullptr && branch_entry != nullptr);
+	ASSERT_TRUE(iteration != nullptr);
+	ASSERT_EQ(iteration->calls, 3);
+	ASSERT_EQ((int)get_counter(*build, "nodes"), tree.get_node_count());
+	ASSERT_EQ((int)get_counter(*trunk_entry, "nodes"), tree.get_node_count());
+	ASSERT_LE(trunk_entry->total_ms, build->total_ms);
+	ASSERT_LE(branch_entry->self_ms, branch_entry->total_ms);
+
+	const auto* mesher_entry = find_entry(report, "ManifoldMesher");
+	ASSERT_TRUE(mesher_entry != nullptr);
+	ASSERT_EQ((int)get_counter(*mesher_entry, "vertices"), (int)mesh.vertices.size());
+	ASSERT_TRUE(find_entry(report, "ManifoldMesher/chains") != nullptr);
+	ASSERT_TRUE(find_entry(report, "ManifoldMesher/smooth_mesh/iterations") != nullptr);
+	std::string trace = tree.get_profiler().to_chrome_trace();
+	ASSERT_TRUE(trace.find("\"traceEvents\"") != std::string::npos);
+	ASSERT_TRUE(trace.find("\"name\":\"GrowthFunction\"") != std::string::npos);
+
+	// a new execution starts a new profile
+	tree.execute_functions();
+	ASSERT_TRUE(find_entry(tree.get_profiler().get_report(), "ManifoldMesher") == nullptr);
+}
+
+TEST(profiler_scopes_follow_parallel_workers)
+{
+	Profiler profiler;
+	{
+		ProfilerBinding binding{&profiler};
+		ProfileScope scope{"outer"};
+		Parallel::parallel_for(
+		    8,
+		    [](int)
+		    {
+			    ProfileScope work{"work"};
+			    work.add_counter("items", 1);
+			    work.add_counter("items", 1);
+		    },
+		    4);
+	}
+	ASSERT_TRUE(Profiler::get_current() == nullptr);
+	auto report = profiler.get_report();
+	const auto* work = find_entry(report, "outer/work");
+	ASSERT_TRUE(work != nullptr);
+	ASSERT_EQ(work->calls, 8);
+	ASSERT_EQ((int)get_counter(*work, "items"), 16);
+	ASSERT_EQ((int)find_entry(report, "outer")->calls, 1);
+}
+
 int main()
 {
 	std::cout << std::endl;
@@ -40,12 +40,48 @@ def create_mesh_from_cpp(
     _add_attributes(mesh, cpp_mesh)
     _add_uvs(mesh, cpp_mesh)
     mesh.update(calc_edges=True)
+    _add_normals(mesh, cpp_mesh)
+
+
+def _add_normals(mesh: bpy.types.Mesh, cpp_mesh) -> None:
+    """Use the normals computed by the mesher, if any, as custom normals."""
+    normals = cpp_mesh.get_normals()
+    if len(normals) == 0 or len(normals) != len(mesh.vertices) * 3:
+        return
+    mesh.normals_split_custom_set_from_vertices(normals.reshape(-1, 3))
+
+
+def _kept_loops(raw_faces) -> np.ndarray:
+    """Mask of the polygon loops to keep, dropping the repeated 4th vertex of triangles.
+
+    Adaptive resolution meshes mix quads with triangles stored as degenerate quads.
+    """
+    quads = raw_faces.reshape(-1, 4)
+    keep = np.ones(quads.shape, dtype=bool)
+    keep[:, 3] = quads[:, 3] != quads[:, 2]
+    return keep.flatten()
+
+
+def _face_loops(raw_polygons, raw_triangles, keep) -> np.ndarray:
+    """Loops of the polygons followed by the triangles, reversed to flip normals."""
+    loops = np.concatenate((raw_polygons[keep], raw_triangles)).astype(np.int32, copy=False)
+    return np.ascontiguousarray(loops[::-1])
 
 
 def _add_geometry(mesh: bpy.types.Mesh, cpp_mesh) -> None:
-    """Add vertices and polygons to the mesh."""
+    """Add vertices, polygons and triangles to the mesh."""
     verts = cpp_mesh.get_vertices()
-    faces = np.copy(cpp_mesh.get_polygons()[::-1])  # Reverse to flip normals
+    raw_faces = cpp_mesh.get_polygons()
+    raw_triangles = cpp_mesh.get_triangles()
+    keep = _kept_loops(raw_faces)
+    faces = _face_loops(raw_faces, raw_triangles, keep)
+    loop_total = np.concatenate(
+        (
+            keep.reshape(-1, 4).sum(axis=1, dtype=np.int32),
+            np.full(len(raw_triangles) // 3, 3, dtype=np.int32),
+        )
+    )[::-1]
+    polygon_count = len(loop_total)
 
     mesh.vertices.add(len(verts) // 3)
     mesh.vertices.foreach_set("co", verts)
@@ -53,12 +89,12 @@ def _add_geometry(mesh: bpy.types.Mesh, cpp_mesh) -> None:
     mesh.loops.add(len(faces))
     mesh.loops.foreach_set("vertex_index", faces)
 
-    loop_start = np.arange(0, len(faces), 4, dtype=np.int32)
-    loop_total = np.ones(len(faces) // 4, dtype=np.int32) * 4
-    mesh.polygons.add(len(faces) // 4)
+    loop_start = np.zeros(polygon_count, dtype=np.int32)
+    loop_start[1:] = np.cumsum(loop_total)[:-1]
+    mesh.polygons.add(polygon_count)
     mesh.polygons.foreach_set("loop_start", loop_start)
-    mesh.polygons.foreach_set("loop_total", loop_total)
-    mesh.polygons.foreach_set("use_smooth", np.ones(len(faces) // 4, dtype=bool))
+    mesh.polygons.foreach_set("loop_total", np.ascontiguousarray(loop_total))
+    mesh.polygons.foreach_set("use_smooth", np.ones(polygon_count, dtype=bool))
 
 
 def _add_attributes(mesh: bpy.types.Mesh, cpp_mesh) -> None:
@@ -86,7 +122,9 @@ def _add_uvs(mesh: bpy.types.Mesh, cpp_mesh) -> None:
     """Add UV coordinates to the mesh."""
     uv_data = cpp_mesh.get_uvs()
     uv_data.shape = (len(uv_data) // 2, 2)
-    uv_loops = np.copy(cpp_mesh.get_uv_loops()[::-1])  # Reverse since faces are reversed
+    keep = _kept_loops(cpp_mesh.get_polygons())
+    # Reversed like the faces
+    uv_loops = _face_loops(cpp_mesh.get_uv_loops(), cpp_mesh.get_uv_triangles(), keep)
     uvs = uv_data[uv_loops].flatten()
 
     uv_layer = mesh.uv_layers.new() if len(mesh.uv_layers) == 0 else mesh.uv_layers[0]
@@ -99,44 +137,19 @@ def create_leaf_mesh_from_cpp(
 ) -> None:
     """Populate a Blender mesh from C++ leaf mesh data.
 
-    Handles triangle meshes stored as degenerate quads (4th vertex = 3rd vertex)
-    by the LeafShapeGenerator's ear clipping triangulation.
+    Leaf meshes are made of triangles only, stored in the triangle buffer of the mesh.
 
     Args:
         mesh: The Blender mesh to populate.
         cpp_mesh: The C++ Mesh object from LeafShapeGenerator.generate().
     """
-    _add_leaf_geometry(mesh, cpp_mesh)
+    _add_geometry(mesh, cpp_mesh)
     _add_leaf_attributes(mesh, cpp_mesh)
-    _add_leaf_uvs(mesh, cpp_mesh)
+    if len(cpp_mesh.get_uvs()) > 0:
+        _add_uvs(mesh, cpp_mesh)
     mesh.update(calc_edges=True)
 
 
-def _add_leaf_geometry(mesh: bpy.types.Mesh, cpp_mesh) -> None:
-    """Add vertices and triangle polygons to the leaf mesh."""
-    verts = cpp_mesh.get_vertices()
-    raw_faces = cpp_mesh.get_polygons()  # Stride 4, degenerate quads
-
-    mesh.vertices.add(len(verts) // 3)
-    mesh.vertices.foreach_set("co", verts)
-
-    # Convert degenerate quads to proper triangles (take first 3 of each quad)
-    raw_faces = raw_faces.reshape(-1, 4)
-    tri_faces = np.ascontiguousarray(raw_faces[:, :3])
-    tri_faces_flat = np.copy(tri_faces[:, ::-1].flatten())  # Reverse winding to flip normals
-
-    num_tris = len(tri_faces)
-    mesh.loops.add(num_tris * 3)
-    mesh.loops.foreach_set("vertex_index", tri_faces_flat)
-
-    loop_start = np.arange(0, num_tris * 3, 3, dtype=np.int32)
-    loop_total = np.ones(num_tris, dtype=np.int32) * 3
-    mesh.polygons.add(num_tris)
-    mesh.polygons.foreach_set("loop_start", loop_start)
-    mesh.polygons.foreach_set("loop_total", loop_total)
-    mesh.polygons.foreach_set("use_smooth", np.ones(num_tris, dtype=bool))
-
-
 def _add_leaf_attributes(mesh: bpy.types.Mesh, cpp_mesh) -> None:
     """Add custom attributes to the leaf mesh (only those that exist)."""
     for attr_name in FLOAT_ATTRIBUTES:
@@ -147,25 +160,3 @@ def _add_leaf_attributes(mesh: bpy.types.Mesh, cpp_mesh) -> None:
             mesh.attributes.remove(mesh.attributes[attr_name])
         mesh.attributes.new(name=attr_name, type="FLOAT", domain="POINT")
         mesh.attributes[attr_name].data.foreach_set("value", data)
-
-
-def _add_leaf_uvs(mesh: bpy.types.Mesh, cpp_mesh) -> None:
-    """Add UV coordinates to the leaf mesh."""
-    uv_data = cpp_mesh.get_uvs()
-    if len(uv_data) == 0:
-        return
-
-    uv_data = uv_data.reshape(-1, 2)
-    raw_uv_loops = cpp_mesh.get_uv_loops()  # Stride 4
-
-    # Convert degenerate quad UV loops to triangle UV loops
-    raw_uv_loops = raw_uv_loops.reshape(-1, 4)
-    tri_uv_loops = np.ascontiguousarray(raw_uv_loops[:, :3])
-    tri_uv_loops_flat = np.copy(
-        tri_uv_loops[:, ::-1].flatten()
-    )  # Reverse winding to match face reversal
-
-    uvs = uv_data[tri_uv_loops_flat].flatten()
-
-    uv_layer = mesh.uv_layers.new() if len(mesh.uv_layers) == 0 else mesh.uv_layers[0]
-    uv_layer.data.foreach_set("uv", uvs)
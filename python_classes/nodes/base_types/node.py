@@ -117,7 +117,21 @@ class MtreeFunctionNode(MtreeNode):
         for parameter in self.exposed_parameters + self.advanced_parameters:
             layout.prop(self, parameter)
 
-    def construct_function(self):
+    def get_signature(self) -> tuple:
+        """Values the function of the node is built from, its children excluded."""
+        values = [getattr(self, parameter) for parameter in self.exposed_parameters]
+        for input_socket in self.inputs:
+            if not input_socket.is_property:
+                continue
+            if input_socket.bl_idname == "mt_PropertySocket":
+                value = input_socket.get_signature()
+            else:
+                value = input_socket.property_value
+            values.append((input_socket.property_name, value))
+        return tuple(values)
+
+    def create_function(self):
+        """Tree function of this node, without its children."""
         if self.tree_function is None:
             raise ValueError(f"tree_function not defined for {self.__class__.__name__}")
         function_instance = self.tree_function()
@@ -133,12 +147,26 @@ class MtreeFunctionNode(MtreeNode):
                     setattr(
                         function_instance, input_socket.property_name, input_socket.property_value
                     )
+        return function_instance
 
-        for child in self.get_child_nodes():
-            if isinstance(child, MtreeFunctionNode):
-                child_function = child.construct_function()
-                function_instance.add_child(child_function)
+    def construct_function(self, cache=None):
+        """Tree function of this node and of its children.
 
+        With an EvaluationCache, nodes whose signature didn't change reuse the function they
+        built the last time instead of building it again.
+        """
+        children = [
+            child.construct_function(cache)
+            for child in self.get_child_nodes()
+            if isinstance(child, MtreeFunctionNode)
+        ]
+        if cache is not None:
+            key = (self.id_data.name, self.name)
+            return cache.get_function(key, self.get_signature(), children, self.create_function)
+
+        function_instance = self.create_function()
+        for child_function in children:
+            function_instance.add_child(child_function)
         return function_instance
 
 
@@ -153,3 +181,10 @@ class MtreePropertyNode(MtreeNode):
             if input_socket.is_property:
                 setattr(property, input_socket.property_name, input_socket.property_value)
         return property
+
+    def get_signature(self) -> tuple:
+        values = [self.bl_idname]
+        for input_socket in self.inputs:
+            if input_socket.is_property:
+                values.append((input_socket.property_name, input_socket.property_value))
+        return tuple(values)
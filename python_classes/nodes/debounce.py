@@ -9,14 +9,18 @@ import logging
 
 import bpy
 
+from . import evaluation_cache
+
 logger = logging.getLogger(__name__)
 
 _pending_timers = {}  # {(tree_name, node_name): timer_func}
 _socket_value_cache = {}  # {(tree_name, node_name, socket_name): value}
 _node_prop_cache = {}  # {(tree_name, node_name, prop_name): value}
+_running_builds = {}  # {(tree_name, node_name): TreeBuild}
 
 DEBOUNCE_DELAY = 0.3  # seconds of inactivity before rebuild
 POLL_INTERVAL = 0.1  # seconds between socket-value polls
+BUILD_POLL_INTERVAL = 0.05  # seconds between async build completion polls
 
 # Node properties that should trigger auto-update when changed.
 # Maps bl_idname -> list of property names to watch.
@@ -55,6 +59,58 @@ def schedule_build(node, method="build_tree", delay=DEBOUNCE_DELAY):
     bpy.app.timers.register(_do_build, first_interval=delay)
 
 
+def track_async_build(node, build, on_finished, on_progress=None, on_preview=None):
+    """Poll a background *build* and call ``on_finished(node, build)`` once it is done.
+
+    While it runs, ``on_progress(node, stage, fraction)`` is called on every poll, and
+    ``on_preview(node, build)`` once when the preview of a progressive build is ready.
+
+    Starting a new build for the same node cancels the previous one, whose result
+    is dropped. Builds are only released once their worker thread has stopped so
+    that Blender never blocks on them.
+    """
+    key = (node.id_data.name, node.name)
+    previous = _running_builds.get(key)
+    if previous is not None:
+        previous.cancel()
+    _running_builds[key] = build
+    preview_shown = False
+
+    def _resolve_node():
+        node_tree = bpy.data.node_groups.get(key[0])
+        return node_tree.nodes.get(key[1]) if node_tree else None
+
+    def _poll_build():
+        nonlocal preview_shown
+        superseded = _running_builds.get(key) is not build
+        if not build.is_done():
+            if not superseded:
+                resolved = _resolve_node()
+                if resolved and on_preview is not None and not preview_shown:
+                    if build.has_preview():
+                        preview_shown = True
+                        on_preview(resolved, build)
+                if resolved and on_progress is not None:
+                    on_progress(resolved, *build.get_progress())
+            return BUILD_POLL_INTERVAL
+        if superseded:
+            return None
+        del _running_builds[key]
+        if build.is_cancelled():
+            return None
+        resolved = _resolve_node()
+        if resolved:
+            on_finished(resolved, build)
+        return None
+
+    bpy.app.timers.register(_poll_build, first_interval=BUILD_POLL_INTERVAL)
+
+
+def is_build_running(node):
+    """Whether a background build started for *node* is still tracked."""
+    return (node.id_data.name, node.name) in _running_builds
+
+
 # -- Socket-change polling ---------------------------------------------------
 
 
@@ -132,8 +188,12 @@ def register():
 
 
 def unregister():
+    for build in _running_builds.values():
+        build.cancel()
+    _running_builds.clear()
     _socket_value_cache.clear()
     _node_prop_cache.clear()
+    evaluation_cache.clear()
     try:
         bpy.app.timers.unregister(_poll_socket_changes)
     except ValueError:
@@ -0,0 +1,86 @@
+"""Dependency-aware cache of the tree functions built from a node graph.
+
+Every function node keeps the function it built, with the signature of the socket
+values it was built from. A node is only built again when its own values changed;
+a node whose children were rebuilt keeps its function and only has its children
+replaced. The resulting graph is executed on a persistent Tree with
+``cache_functions`` enabled, so that the C++ side restores the stems of the
+functions upstream of the edit instead of executing them again.
+
+This module doesn't import bpy so that it can be tested outside of Blender.
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass, field
+
+_caches = {}  # {(tree_name, mesher_name): EvaluationCache}
+
+
+@dataclass
+class _CachedFunction:
+    signature: tuple
+    function: object
+    children: list = field(default_factory=list)
+
+
+class EvaluationCache:
+    """Built functions of the nodes feeding one mesher, and the tree they run on."""
+
+    def __init__(self):
+        self._entries = {}  # {node_key: _CachedFunction}
+        self._used_keys = set()
+        self.tree = None
+        self.built_count = 0  # functions built since the cache was created
+
+    def begin_run(self):
+        self._used_keys.clear()
+
+    def end_run(self):
+        """Drop the functions of the nodes that were not evaluated since begin_run."""
+        for key in list(self._entries):
+            if key not in self._used_keys:
+                del self._entries[key]
+
+    def get_function(self, key, signature, children, create_function):
+        """Function of node *key*, built by ``create_function()`` unless *signature* is unchanged.
+
+        *children* are the functions of the child nodes, already resolved through this cache.
+        """
+        self._used_keys.add(key)
+        entry = self._entries.get(key)
+        if entry is None or entry.signature != signature:
+            entry = _CachedFunction(signature, create_function())
+            self._entries[key] = entry
+            self.built_count += 1
+        elif len(entry.children) == len(children) and all(
+            a is b for a, b in zip(entry.children, children)
+        ):
+            return entry.function
+        entry.function.clear_children()
+        for child in children:
+            entry.function.add_child(child)
+        entry.children = list(children)
+        return entry.function
+
+    def get_tree(self, m_tree, busy=False):
+        """Tree keeping the function cache between builds.
+
+        A tree still used by a running build is replaced by a new one, with an empty cache.
+        """
+        if self.tree is None or busy:
+            self.tree = m_tree.Tree()
+            self.tree.cache_functions = True
+        return self.tree
+
+
+def get_cache(tree_name, mesher_name):
+    key = (tree_name, mesher_name)
+    cache = _caches.get(key)
+    if cache is None:
+        cache = _caches[key] = EvaluationCache()
+    return cache
+
+
+def clear():
+    _caches.clear()
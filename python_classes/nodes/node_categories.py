@@ -44,6 +44,7 @@ node_categories = [
         "Modifiers",
         items=[
             NodeItem("mt_PipeRadiusNode"),
+            NodeItem("mt_SimplifyNode"),
         ],
     ),
     MTreeNodeCategory(
@@ -28,6 +28,12 @@ class MtreePropertySocket(bpy.types.NodeSocket, MtreeSocket):
             wrapper.set_constant_property(property)
             return wrapper
 
+    def get_signature(self):
+        """Value of the property, for EvaluationCache."""
+        if self.is_linked and self.links:
+            return self.links[0].from_node.get_signature()
+        return float(self.property_value)
+
     def draw(self, context, layout, node, text):
         if self.is_output or self.is_linked:
             layout.label(text=text)
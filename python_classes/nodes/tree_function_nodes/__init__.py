@@ -6,10 +6,19 @@ from .branch_node import BranchNode
 from .growth_node import GrowthNode
 from .leaf_shape_node import LeafShapeNode
 from .pipe_radius_node import PipeRadiusNode
+from .simplify_node import SimplifyNode
 from .tree_mesher_node import TreeMesherNode
 from .trunk_node import TrunkNode
 
-classes = [BranchNode, GrowthNode, LeafShapeNode, TreeMesherNode, TrunkNode, PipeRadiusNode]
+classes = [
+    BranchNode,
+    GrowthNode,
+    LeafShapeNode,
+    TreeMesherNode,
+    TrunkNode,
+    PipeRadiusNode,
+    SimplifyNode,
+]
 
 
 def register():
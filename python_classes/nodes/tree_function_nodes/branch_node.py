@@ -114,7 +114,10 @@ class BranchNode(bpy.types.Node, MtreeFunctionNode):
         "split_angle": ("split", "angle"),
     }
 
-    def construct_function(self):
+    def get_signature(self):
+        return (*super().get_signature(), self.crown_shape, self.angle_variation)
+
+    def create_function(self):
         func = self.tree_function()
 
         # Handle exposed_parameters (from base class pattern)
@@ -145,15 +148,6 @@ class BranchNode(bpy.types.Node, MtreeFunctionNode):
         py_shape = BLENDER_SHAPE_MAP.get(self.crown_shape, PyCrownShape.Cylindrical)
         func.crown.shape = lazy_m_tree.CrownShape(int(py_shape))
         func.crown.angle_variation = self.angle_variation
-
-        # Handle child nodes
-        for child in self.get_child_nodes():
-            from ..base_types.node import MtreeFunctionNode
-
-            if isinstance(child, MtreeFunctionNode):
-                child_function = child.construct_function()
-                func.add_child(child_function)
-
         return func
 
     def init(self, context):
@@ -70,7 +70,7 @@ class GrowthNode(bpy.types.Node, MtreeFunctionNode):
     def tree_function(self):
         return lazy_m_tree.GrowthFunction
 
-    def construct_function(self):
+    def construct_function(self, cache=None):
         """Override to validate threshold constraints before constructing the C++ function."""
         # Get current values from sockets
         cut_socket = self._get_socket_by_property("cut_threshold")
@@ -87,8 +87,13 @@ class GrowthNode(bpy.types.Node, MtreeFunctionNode):
                 # Adjust flower_threshold to be above cut_threshold
                 flower_socket.property_value = cut_val + self.THRESHOLD_GAP
 
-        # Call parent implementation
-        return super().construct_function()
+        return super().construct_function(cache)
+
+    def create_function(self):
+        function = super().create_function()
+        # Scrubbing the iterations restores the iterations grown by the previous updates
+        function.cache_iterations = True
+        return function
 
     def init(self, context):
         self.add_input("mt_TreeSocket", "Tree", is_property=False)
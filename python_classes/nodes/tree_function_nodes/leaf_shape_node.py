@@ -99,6 +99,17 @@ class LeafShapeNode(bpy.types.Node, MtreeNode):
         update=_on_leaf_prop_update,
     )
 
+    # Triangulation of the leaf blade
+    triangulation: bpy.props.EnumProperty(
+        name="Triangulation",
+        items=[
+            ("RINGS", "Rings", "Concentric rings shrinking toward the center"),
+            ("DELAUNAY", "Delaunay", "Fewer, well shaped triangles following the veins"),
+        ],
+        default="RINGS",
+        update=_on_leaf_prop_update,
+    )
+
     # Status feedback
     status_message: bpy.props.StringProperty(default="")
     status_is_error: bpy.props.BoolProperty(default=False)
@@ -116,6 +127,11 @@ class LeafShapeNode(bpy.types.Node, MtreeNode):
         "CLOSED": "Closed",
     }
 
+    _TRIANGULATION_MAP = {
+        "RINGS": "Rings",
+        "DELAUNAY": "Delaunay",
+    }
+
     def init(self, context):
         # Contour sockets
         self.add_input(
@@ -319,6 +335,9 @@ class LeafShapeNode(bpy.types.Node, MtreeNode):
                 venation_name = self._VENATION_TYPE_MAP.get(self.venation_type, "Open")
                 gen.venation_type = getattr(m_tree.VenationType, venation_name)
 
+            triangulation_name = self._TRIANGULATION_MAP.get(self.triangulation, "Rings")
+            gen.triangulation = getattr(m_tree.LeafTriangulation, triangulation_name)
+
             cpp_mesh = gen.generate()
 
             # Get or create Blender object
@@ -478,6 +497,8 @@ class LeafShapeNode(bpy.types.Node, MtreeNode):
                     if socket and socket.is_property:
                         socket.draw(context, box, self, socket.name)
 
+        layout.box().prop(self, "triangulation")
+
         # Surface deformation section
         self._draw_section(layout, "Surface", "show_surface", SURFACE_PARAMS)
 
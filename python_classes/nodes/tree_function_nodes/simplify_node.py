@@ -0,0 +1,35 @@
+import bpy
+
+from ...m_tree_wrapper import lazy_m_tree
+from ..base_types.node import MtreeFunctionNode
+
+
+class SimplifyNode(bpy.types.Node, MtreeFunctionNode):
+    bl_idname = "mt_SimplifyNode"
+    bl_label = "Simplify"
+
+    @property
+    def tree_function(self):
+        return lazy_m_tree.SimplifyFunction
+
+    def init(self, context):
+        self.add_input("mt_TreeSocket", "Tree", is_property=False)
+
+        self.add_input(
+            "mt_FloatSocket",
+            "Angle Tolerance",
+            min_value=0,
+            max_value=45,
+            property_name="angle_tolerance",
+            property_value=2,
+        )
+        self.add_input(
+            "mt_FloatSocket",
+            "Radius Tolerance",
+            min_value=0,
+            max_value=1,
+            property_name="radius_tolerance",
+            property_value=0.05,
+        )
+
+        self.add_output("mt_TreeSocket", "Tree", is_property=False)
@@ -8,8 +8,9 @@ import bpy
 
 from ...m_tree_wrapper import lazy_m_tree as m_tree
 from ...mesh_utils import create_mesh_from_cpp
+from .. import evaluation_cache
 from ..base_types.node import MtreeNode
-from ..debounce import schedule_build
+from ..debounce import is_build_running, schedule_build, track_async_build
 
 
 def on_update_prop(node, context):
@@ -31,6 +32,11 @@ class TreeMesherNode(bpy.types.Node, MtreeNode):
         name="Radial Resolution", default=32, min=3, update=on_update_prop
     )
     smoothness: bpy.props.IntProperty(name="smoothness", default=4, min=0, update=on_update_prop)
+    progressive_preview: bpy.props.BoolProperty(
+        name="Progressive Preview",
+        description="Show a coarse tree while the full resolution tree is generated",
+        default=True,
+    )
     tree_object: bpy.props.StringProperty(default="")
 
     # Status feedback properties
@@ -79,6 +85,7 @@ class TreeMesherNode(bpy.types.Node, MtreeNode):
         container.prop(self, "auto_update")
         container.prop(self, "radial_resolution")
         container.prop(self, "smoothness")
+        container.prop(self, "progressive_preview")
 
     def _draw_leaves_button(self, container):
         if self._has_valid_tree_object():
@@ -101,17 +108,54 @@ class TreeMesherNode(bpy.types.Node, MtreeNode):
         try:
             start_time = time.time()
 
-            tree = m_tree.Tree()
             output_links = self.outputs[0].links
             if not output_links:
                 raise ValueError("No connected trunk node")
-            trunk_function = output_links[0].to_node.construct_function()
+            # Only the nodes whose values changed since the last build are built again, and
+            # the tree restores the stems of the functions upstream of them
+            cache = evaluation_cache.get_cache(self.get_node_tree().name, self.name)
+            cache.begin_run()
+            trunk_function = output_links[0].to_node.construct_function(cache)
+            cache.end_run()
             if trunk_function is None:
                 raise ValueError("Connected node returned no tree function")
-            tree.set_trunk_function(trunk_function)
-            tree.execute_functions()
+            tree = cache.get_tree(m_tree, busy=is_build_running(self))
+            # The build runs on a copy so that the cached functions are never used by a worker
+            tree.set_trunk_function(trunk_function.clone())
+
+            # Generation runs on a background thread, the result is picked up by a timer
+            preview = m_tree.PreviewSettings() if self.progressive_preview else None
+            build = tree.build_async(self._create_mesher(), preview)
+            self.status_message = "Generating..."
+            track_async_build(
+                self,
+                build,
+                lambda node, done: node._finish_build(done, start_time),
+                on_progress=TreeMesherNode._show_progress,
+                on_preview=TreeMesherNode._show_preview,
+            )
+
+        except Exception as e:
+            self.status_message = f"Error: {str(e)}"
+            self.status_is_error = True
+
+    def _show_progress(self, stage, fraction):
+        """Show the progress of the running background build."""
+        if stage:
+            self.status_message = f"Generating ({stage} {fraction:.0%})..."
 
-            cpp_mesh = self._mesh_tree(tree)
+    def _show_preview(self, build):
+        """Output the coarse preview of a progressive build until the full mesh is done."""
+        try:
+            self._output_to_blender(build.get_preview())
+        except Exception as e:
+            self.status_message = f"Error: {str(e)}"
+            self.status_is_error = True
+
+    def _finish_build(self, build, start_time):
+        """Output the mesh of a finished background build."""
+        try:
+            cpp_mesh = build.get_mesh()
             self._output_to_blender(cpp_mesh)
 
             elapsed = time.time() - start_time
@@ -122,12 +166,13 @@ class TreeMesherNode(bpy.types.Node, MtreeNode):
             self.status_message = f"Error: {str(e)}"
             self.status_is_error = True
 
-    def _mesh_tree(self, tree):
-        """Convert tree structure to mesh using ManifoldMesher."""
+    def _create_mesher(self):
+        """Create the ManifoldMesher that converts the tree structure to a mesh."""
         mesher = m_tree.ManifoldMesher()
         mesher.radial_n_points = self.radial_resolution
         mesher.smooth_iterations = self.smoothness
-        return mesher.mesh_tree(tree)
+        mesher.compute_normals = True
+        return mesher
 
     def get_current_tree_object(self):
         """Get or create the Blender object for this tree."""
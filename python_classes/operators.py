@@ -212,7 +212,8 @@ class QuickGenerateTree(bpy.types.Operator):
         gen.seed = seed
         gen.asymmetry_seed = seed
 
-        cpp_mesh = gen.generate()
+        # Presets with a given seed always give the same leaf, reuse it across tree rebuilds
+        cpp_mesh = gen.generate_cached()
 
         obj_name = f"Leaf_{seed}"
         mesh = bpy.data.meshes.new(obj_name)
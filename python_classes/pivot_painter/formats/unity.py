@@ -9,7 +9,7 @@ import numpy as np
 if TYPE_CHECKING:
     import bpy
 
-from ..core import compute_stem_id_hash, normalize_with_minimum, pack_unity_vertex_colors
+from ...m_tree_wrapper import lazy_m_tree
 from ..exporter import ExportResult
 
 
@@ -51,26 +51,30 @@ class UnityExporter:
                 domain="POINT",
             )
 
+    def _read_attribute(self, name: str, components: int = 1) -> np.ndarray:
+        """Read a POINT domain attribute as a flat float32 array."""
+        values = np.zeros(len(self.mesh.vertices) * components, dtype=np.float32)
+        key = "vector" if components == 3 else "value"
+        self.mesh.attributes[name].data.foreach_get(key, values)
+        return values
+
     def _write_vertex_colors(self) -> None:
-        """Pack pivot painter data into vertex colors."""
+        """Pack pivot painter data into vertex colors with the native baker."""
         color_attr = self.mesh.color_attributes[self.VERTEX_COLOR_NAME]
         vertex_count = len(self.mesh.vertices)
 
-        # Extract attribute data
-        stem_ids = np.zeros(vertex_count)
-        hierarchy_depths = np.zeros(vertex_count)
-        branch_extents = np.zeros(vertex_count)
-
-        self.mesh.attributes["stem_id"].data.foreach_get("value", stem_ids)
-        self.mesh.attributes["hierarchy_depth"].data.foreach_get("value", hierarchy_depths)
-        self.mesh.attributes["branch_extent"].data.foreach_get("value", branch_extents)
-
-        # Normalize values and compute stem ID hashes
-        normalized_depths = normalize_with_minimum(hierarchy_depths)
-        normalized_extents = normalize_with_minimum(branch_extents)
-        stem_id_hashes = compute_stem_id_hash(stem_ids)
-
-        # Pack into RGBA vertex colors
-        colors = pack_unity_vertex_colors(normalized_depths, normalized_extents, stem_id_hashes)
+        stem_ids = self._read_attribute("stem_id")
+        baker = lazy_m_tree.PivotPainterBaker()
+        baker.threads = 0
+        branches = baker.collect_mesh_branches(
+            stem_ids=stem_ids,
+            hierarchy_depths=self._read_attribute("hierarchy_depth"),
+            pivot_positions=self._read_attribute("pivot_position", 3),
+            directions=self._read_attribute("direction", 3),
+            extents=self._read_attribute("branch_extent"),
+        )
 
-        color_attr.data.foreach_set("color", colors)
+        # RGBA8 colors, stored in the float color attribute
+        colors = np.zeros(vertex_count * 4, dtype=np.uint8)
+        baker.bake_vertex_colors(branches, stem_ids, colors)
+        color_attr.data.foreach_set("color", colors.astype(np.float32) / 255)
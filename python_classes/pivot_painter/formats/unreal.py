@@ -13,13 +13,8 @@ import numpy as np
 if TYPE_CHECKING:
     import bpy
 
-from ..core import (
-    create_leaf_attachment_pixels,
-    create_leaf_facing_pixels,
-    create_pivot_index_pixels,
-    create_xvector_extent_pixels,
-    stem_id_to_uv_coords,
-)
+from ...m_tree_wrapper import lazy_m_tree
+from ..core import create_leaf_attachment_pixels, create_leaf_facing_pixels
 from ..exporter import ExportResult
 
 
@@ -66,15 +61,16 @@ class UnrealExporter:
 
         # Generate textures in Epic's Pivot Painter 2.0 format
         files_created = []
+        baker = lazy_m_tree.PivotPainterBaker()
+        baker.texture_size = self.texture_size
+        baker.threads = 0
 
         # Texture 1: RGB = Pivot Position, A = Hierarchy Depth (parent index proxy)
-        pivot_path = os.path.join(export_dir, f"{self.object_name}_PivotPos_Index.exr")
-        self._create_pivot_index_texture(vertex_data, pivot_path)
-        files_created.append(pivot_path)
-
         # Texture 2: RGB = X-Vector (direction), A = X-Extent (branch length)
+        pivot_path = os.path.join(export_dir, f"{self.object_name}_PivotPos_Index.exr")
         xvector_path = os.path.join(export_dir, f"{self.object_name}_XVector_Extent.exr")
-        self._create_xvector_extent_texture(vertex_data, xvector_path)
+        self._create_branch_textures(baker, vertex_data, pivot_path, xvector_path)
+        files_created.append(pivot_path)
         files_created.append(xvector_path)
 
         # Leaf-specific textures (when leaf data is present)
@@ -92,7 +88,7 @@ class UnrealExporter:
             files_created.append(leaf_facing_path)
 
         # Add UV2 layer for texture lookup
-        self._add_pivot_painter_uv(vertex_data["stem_ids"])
+        self._add_pivot_painter_uv(baker, vertex_data["stem_ids"])
 
         engine = "UE5" if self.is_ue5 else "UE4"
         leaf_msg = " Includes leaf attachment and facing data." if self.include_leaf_data else ""
@@ -110,11 +106,11 @@ class UnrealExporter:
         """
         num_verts = len(self.mesh.vertices)
 
-        stem_ids = np.zeros(num_verts)
-        hierarchy_depths = np.zeros(num_verts)
-        pivot_positions = np.zeros((num_verts, 3))
-        branch_extents = np.zeros(num_verts)
-        directions = np.zeros((num_verts, 3))
+        stem_ids = np.zeros(num_verts, dtype=np.float32)
+        hierarchy_depths = np.zeros(num_verts, dtype=np.float32)
+        pivot_positions = np.zeros((num_verts, 3), dtype=np.float32)
+        branch_extents = np.zeros(num_verts, dtype=np.float32)
+        directions = np.zeros((num_verts, 3), dtype=np.float32)
 
         for attr_name, target, is_vector in [
             ("stem_id", stem_ids, False),
@@ -193,40 +189,34 @@ class UnrealExporter:
             loop_to_vert = np.zeros(num_loops, dtype=int)
             self.mesh.loops.foreach_get("vertex_index", loop_to_vert)
 
-            has_value = np.zeros(num_verts, dtype=bool)
-            for loop_idx, vert_idx in enumerate(loop_to_vert):
-                if not has_value[vert_idx]:
-                    target[vert_idx] = loop_data[loop_idx]
-                    has_value[vert_idx] = True
+            # Each vertex takes the value of its first loop
+            vert_indices, first_loops = np.unique(loop_to_vert, return_index=True)
+            target[vert_indices] = loop_data[first_loops]
 
-    def _create_pivot_index_texture(self, vertex_data: dict, filepath: str) -> None:
-        """Create texture with pivot position (RGB) and hierarchy depth (A).
+    def _create_branch_textures(
+        self, baker, vertex_data: dict, pivot_path: str, xvector_path: str
+    ) -> None:
+        """Bake the PivotPos_Index and XVector_Extent textures natively.
 
-        Epic's format: RGB = pivot world position, A = parent index.
-        We use hierarchy_depth as a proxy for parent index since it indicates
-        how many steps from the root this branch is.
+        Epic's format: RGB = pivot world position, A = parent index. We use
+        hierarchy_depth as a proxy for parent index since it indicates how many
+        steps from the root this branch is. XVector_Extent holds the normalized
+        branch direction, used for the rotation axis cross(XVector, WindDir),
+        and the branch length.
         """
-        pixels = create_pivot_index_pixels(
+        branches = baker.collect_mesh_branches(
             stem_ids=vertex_data["stem_ids"],
-            pivot_positions=vertex_data["pivot_positions"],
             hierarchy_depths=vertex_data["hierarchy_depths"],
-            texture_size=self.texture_size,
-        )
-        self._save_exr_texture("PivotPos_Index", pixels, filepath)
-
-    def _create_xvector_extent_texture(self, vertex_data: dict, filepath: str) -> None:
-        """Create texture with X-Vector (RGB) and branch extent (A).
-
-        Epic's format: RGB = normalized branch direction, A = branch length.
-        The X-Vector is used to calculate rotation axis: cross(XVector, WindDir).
-        """
-        pixels = create_xvector_extent_pixels(
-            stem_ids=vertex_data["stem_ids"],
+            pivot_positions=vertex_data["pivot_positions"],
             directions=vertex_data["directions"],
-            branch_extents=vertex_data["branch_extents"],
-            texture_size=self.texture_size,
+            extents=vertex_data["branch_extents"],
         )
-        self._save_exr_texture("XVector_Extent", pixels, filepath)
+        size = self.texture_size * self.texture_size * 4
+        pivot_pixels = np.zeros(size, dtype=np.float32)
+        xvector_pixels = np.zeros(size, dtype=np.float32)
+        baker.bake_textures(branches, pivot_pixels, xvector_pixels)
+        self._save_exr_texture("PivotPos_Index", pivot_pixels, pivot_path)
+        self._save_exr_texture("XVector_Extent", xvector_pixels, xvector_path)
 
     def _create_leaf_attachment_texture(self, leaf_data: dict, filepath: str) -> None:
         """Create texture with leaf attachment position (RGB) and 1.0 (A).
@@ -265,13 +255,13 @@ class UnrealExporter:
         size = self.texture_size
 
         image = bpy.data.images.new(name, width=size, height=size, alpha=True, float_buffer=True)
-        image.pixels = pixels.tolist()
+        image.pixels.foreach_set(np.asarray(pixels, dtype=np.float32))
         image.filepath_raw = filepath
         image.file_format = "OPEN_EXR"
         image.save()
         bpy.data.images.remove(image)
 
-    def _add_pivot_painter_uv(self, stem_ids: np.ndarray) -> None:
+    def _add_pivot_painter_uv(self, baker, stem_ids: np.ndarray) -> None:
         """Add UV2 layer with stem_id encoded as UV coordinates.
 
         Each vertex's UV points to the pixel containing its stem's data.
@@ -284,10 +274,9 @@ class UnrealExporter:
             self.mesh.uv_layers[1] if len(self.mesh.uv_layers) > 1 else self.mesh.uv_layers[0]
         )
 
-        # Set UV coordinates based on stem_id
-        for poly in self.mesh.polygons:
-            for loop_idx in poly.loop_indices:
-                vert_idx = self.mesh.loops[loop_idx].vertex_index
-                stem_id = int(stem_ids[vert_idx])
-                uv = stem_id_to_uv_coords(stem_id, self.texture_size)
-                uv_layer.data[loop_idx].uv = uv
+        # Set UV coordinates based on stem_id, baked per vertex then spread to the loops
+        vertex_uvs = np.zeros(len(stem_ids) * 2, dtype=np.float32)
+        baker.bake_lookup_uvs(stem_ids, vertex_uvs)
+        loop_to_vert = np.zeros(len(self.mesh.loops), dtype=np.int32)
+        self.mesh.loops.foreach_get("vertex_index", loop_to_vert)
+        uv_layer.data.foreach_set("uv", vertex_uvs.reshape(-1, 2)[loop_to_vert].ravel())
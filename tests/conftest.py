@@ -14,6 +14,7 @@ PYTHON_CLASSES = PROJECT_ROOT / "python_classes"
 # Add paths for modules that don't import bpy at top level
 paths_to_add = [
     str(PYTHON_CLASSES),
+    str(PYTHON_CLASSES / "nodes"),
     str(PYTHON_CLASSES / "presets"),
     str(PYTHON_CLASSES / "pivot_painter"),
     str(PYTHON_CLASSES / "viewport"),
@@ -0,0 +1,104 @@
+"""Unit tests for the node graph evaluation cache (evaluation_cache.py)."""
+
+from evaluation_cache import EvaluationCache, clear, get_cache
+
+
+class FakeFunction:
+    """Stands in for a m_tree tree function."""
+
+    def __init__(self, name):
+        self.name = name
+        self.children = []
+
+    def add_child(self, child):
+        self.children.append(child)
+
+    def clear_children(self):
+        self.children.clear()
+
+
+def evaluate(cache, graph, values, key="trunk"):
+    """Resolve *key* of *graph* ({key: child keys}) with the signatures in *values*."""
+    children = [evaluate(cache, graph, values, child) for child in graph.get(key, [])]
+    return cache.get_function(key, values[key], children, lambda: FakeFunction(key))
+
+
+GRAPH = {"trunk": ["branch"], "branch": ["twig"]}
+
+
+class TestEvaluationCache:
+    def test_unchanged_graph_is_reused(self):
+        cache = EvaluationCache()
+        values = {"trunk": (1,), "branch": (2,), "twig": (3,)}
+        first = evaluate(cache, GRAPH, values)
+        second = evaluate(cache, GRAPH, values)
+        assert second is first
+        assert cache.built_count == 3
+
+    def test_only_dirty_node_is_built_again(self):
+        cache = EvaluationCache()
+        values = {"trunk": (1,), "branch": (2,), "twig": (3,)}
+        trunk = evaluate(cache, GRAPH, values)
+        branch = trunk.children[0]
+        old_twig = branch.children[0]
+
+        values["twig"] = (4,)
+        assert evaluate(cache, GRAPH, values) is trunk
+        assert cache.built_count == 4
+        assert trunk.children == [branch]
+        assert branch.children[0] is not old_twig
+        assert branch.children[0].name == "twig"
+
+    def test_changed_parent_keeps_its_children(self):
+        cache = EvaluationCache()
+        values = {"trunk": (1,), "branch": (2,), "twig": (3,)}
+        trunk = evaluate(cache, GRAPH, values)
+        twig = trunk.children[0].children[0]
+
+        values["branch"] = (5,)
+        evaluate(cache, GRAPH, values)
+        assert cache.built_count == 4
+        assert trunk.children[0].children == [twig]
+
+    def test_end_run_drops_removed_nodes(self):
+        cache = EvaluationCache()
+        values = {"trunk": (1,), "branch": (2,), "twig": (3,)}
+        cache.begin_run()
+        evaluate(cache, GRAPH, values)
+        cache.end_run()
+
+        cache.begin_run()
+        trunk = evaluate(cache, {"trunk": ["branch"]}, values)
+        cache.end_run()
+        assert trunk.children[0].children == []
+        # the twig is built again once it is connected back
+        evaluate(cache, GRAPH, values)
+        assert cache.built_count == 4
+
+
+class FakeTree:
+    def __init__(self):
+        self.cache_functions = False
+
+
+class FakeMTree:
+    Tree = FakeTree
+
+
+class TestGetTree:
+    def test_tree_is_kept_between_builds(self):
+        cache = EvaluationCache()
+        tree = cache.get_tree(FakeMTree)
+        assert tree.cache_functions
+        assert cache.get_tree(FakeMTree) is tree
+
+    def test_busy_tree_is_replaced(self):
+        cache = EvaluationCache()
+        tree = cache.get_tree(FakeMTree)
+        assert cache.get_tree(FakeMTree, busy=True) is not tree
+
+    def test_caches_are_per_mesher(self):
+        clear()
+        assert get_cache("NodeTree", "Mesher") is get_cache("NodeTree", "Mesher")
+        assert get_cache("NodeTree", "Mesher") is not get_cache("NodeTree", "Mesher.001")
+        clear()
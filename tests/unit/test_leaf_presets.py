@@ -253,7 +253,7 @@ def test_apply_preset_produces_valid_mesh(preset_name):
     gen.asymmetry_seed = 456
     mesh = gen.generate()
     assert len(mesh.get_vertices()) > 0
-    assert len(mesh.get_polygons()) > 0
+    assert len(mesh.get_triangles()) > 0
 
 
 @requires_native
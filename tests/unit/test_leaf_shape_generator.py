@@ -35,10 +35,12 @@ class TestLeafShapeGeneratorBasic:
         mesh = gen.generate()
 
         verts = np.array(mesh.get_vertices())
-        polys = np.array(mesh.get_polygons())
+        tris = np.array(mesh.get_triangles())
 
         assert len(verts) > 3 * 3, "Mesh should have more than 3 vertices"
-        assert len(polys) > 0, "Mesh should have polygons"
+        assert len(tris) > 0, "Mesh should have triangles"
+        assert len(mesh.get_polygons()) == 0, "Triangles should not be padded to quads"
+        assert mesh.get_face_count() == len(tris) // 3
 
     def test_vertices_are_finite(self):
         """All vertex coordinates must be finite (no NaN or inf)."""
@@ -61,13 +63,13 @@ class TestLeafShapeGeneratorBasic:
         assert np.all(uvs <= 1.0), "UVs must be <= 1"
 
     def test_polygons_reference_valid_vertices(self):
-        """All polygon vertex indices must reference valid vertices."""
+        """All triangle vertex indices must reference valid vertices."""
         mt = get_m_tree()
         gen = mt.LeafShapeGenerator()
         mesh = gen.generate()
 
         verts = np.array(mesh.get_vertices())
-        polys = np.array(mesh.get_polygons())
+        polys = np.array(mesh.get_triangles())
         num_verts = len(verts) // 3
 
         assert np.all(polys >= 0), "Polygon indices must be non-negative"
@@ -454,9 +456,9 @@ class TestLeafLODGenerator:
         card = lod.generate_card(leaf_mesh)
 
         verts = np.array(card.get_vertices())
-        polys = np.array(card.get_polygons())
+        tris = np.array(card.get_triangles())
         assert len(verts) == 4 * 3, "Card should have exactly 4 vertices"
-        assert len(polys) == 2 * 4, "Card should have 2 triangles (as degenerate quads)"
+        assert len(tris) == 2 * 3, "Card should have 2 triangles"
 
     def test_card_uvs_cover_full_range(self):
         """Card mesh UVs should span 0-1 in both U and V."""
@@ -488,3 +490,48 @@ class TestLeafLODGenerator:
         # Eigen::Vector3f return type requires opaque type registration;
         # these methods are verified via C++ unit tests instead
         assert hasattr(lod, "get_impostor_view_directions")
+
+    def test_impostor_baker_fills_atlas(self):
+        """ImpostorBaker bakes a leaf into every tile of the atlas."""
+        mt = get_m_tree()
+        leaf_mesh = mt.LeafShapeGenerator().generate()
+
+        baker = mt.ImpostorBaker()
+        baker.resolution = 4
+        baker.tile_size = 16
+        atlas = baker.bake([leaf_mesh], [(0.2, 0.6, 0.1)])
+
+        size = atlas.get_size()
+        assert size == 64
+        albedo = np.array(atlas.get_albedo()).reshape(size, size, 4)
+        depth = np.array(atlas.get_depth()).reshape(size, size)
+        covered = albedo[:, :, 3] == 255
+        assert covered.any()
+        assert np.all(depth[covered] < 1.0)
+        assert np.all(depth[~covered] == 1.0)
+
+
+@requires_native
+class TestMeshBufferViews:
+    """Mesh getters return zero-copy views over the C++ buffers."""
+
+    def test_getters_share_mesh_memory(self):
+        """Repeated getters view the same storage instead of copying it."""
+        mt = get_m_tree()
+        mesh = mt.LeafShapeGenerator().generate()
+
+        for getter in ("get_vertices", "get_triangles", "get_uvs", "get_uv_triangles"):
+            first = getattr(mesh, getter)()
+            second = getattr(mesh, getter)()
+            assert first.ndim == 1
+            assert first.base is not None, f"{getter} should be a view"
+            assert np.shares_memory(first, second), f"{getter} should not copy"
+
+    def test_view_keeps_mesh_alive(self):
+        """A view stays valid after the Python mesh object is dropped."""
+        mt = get_m_tree()
+        mesh = mt.LeafShapeGenerator().generate()
+        expected = np.array(mesh.get_vertices())
+        verts = mesh.get_vertices()
+        del mesh
+        np.testing.assert_array_equal(verts, expected)